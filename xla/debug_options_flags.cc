@@ -103,6 +103,7 @@ DebugOptions DefaultDebugOptionsIgnoringFlags() {
   opts.set_xla_gpu_simplify_all_fp_conversions(true);
   opts.set_xla_dump_latency_hiding_schedule(false);
   opts.set_xla_gpu_enable_latency_hiding_scheduler(false);
+  opts.set_xla_gpu_enable_pipelined_collectives(false);
 
   opts.set_xla_cpu_enable_mlir_tiling_and_fusion(true);
   opts.set_xla_cpu_enable_experimental_deallocation(true);
@@ -880,6 +881,21 @@ void MakeDebugOptionsFlags(std::vector<tsl::Flag>* flag_list,
                     &DebugOptions::set_xla_gpu_enable_latency_hiding_scheduler),
                 debug_options->xla_gpu_enable_latency_hiding_scheduler(),
                 "Enable latency-hiding scheduler for XLA:GPU"));
+  flag_list->push_back(tsl::Flag(
+      "xla_gpu_latency_hiding_scheduler_profile",
+      string_setter_for(
+          &DebugOptions::set_xla_gpu_latency_hiding_scheduler_profile),
+      debug_options->xla_gpu_latency_hiding_scheduler_profile(),
+      "Path to a profile of instruction costs and collective latencies "
+      "recorded in previous runs. If set, the latency-hiding scheduler for "
+      "XLA:GPU uses it instead of its fixed estimates."));
+  flag_list->push_back(tsl::Flag(
+      "xla_gpu_enable_pipelined_collectives",
+      bool_setter_for(&DebugOptions::set_xla_gpu_enable_pipelined_collectives),
+      debug_options->xla_gpu_enable_pipelined_collectives(),
+      "Issue collectives in while loops one iteration ahead of their users, "
+      "so that the latency-hiding scheduler for XLA:GPU can overlap them with "
+      "the previous iteration."));
   flag_list->push_back(tsl::Flag(
       "xla_partitioning_algorithm", setter_for_xla_partitioning_algorithm,
       DebugOptions::PartitioningAlgorithm_Name(
@@ -903,6 +919,14 @@ void MakeDebugOptionsFlags(std::vector<tsl::Flag>* flag_list,
                 debug_options->xla_gpu_triton_gemm_any(),
                 "Use Triton-based matrix multiplication for any GEMM it "
                 "supports without filtering only faster ones."));
+  flag_list->push_back(tsl::Flag(
+      "xla_cpu_performance_profile",
+      string_setter_for(&DebugOptions::set_xla_cpu_performance_profile),
+      debug_options->xla_cpu_performance_profile(),
+      "Path to a CPU performance profile produced by "
+      "cpu_performance_calibration. If set, XLA:CPU uses it to model HLO run "
+      "times when assigning parallel tasks and deciding whether to run small "
+      "programs inline."));
 }  // NOLINT(readability/fn_size)
 
 // Allocates flag_values and flag_objects; this function must not be called more
@@ -29,11 +29,14 @@ limitations under the License.
 #include <utility>
 #include <vector>
 
+#include "absl/algorithm/container.h"
 #include "absl/container/flat_hash_map.h"
 #include "absl/strings/match.h"
 #include "absl/strings/str_cat.h"
 #include "absl/strings/str_join.h"
 #include "xla/hlo/experimental/auto_sharding/auto_sharding_cost_graph.h"
+#include "xla/hlo/experimental/auto_sharding/auto_sharding_solution.pb.h"
+#include "xla/hlo/experimental/auto_sharding/auto_sharding_solution_cache.h"
 #include "xla/hlo/experimental/auto_sharding/auto_sharding_strategy.h"
 #include "xla/hlo/experimental/auto_sharding/auto_sharding_util.h"
 #include "xla/hlo/experimental/auto_sharding/cluster_environment.h"
@@ -1921,6 +1924,20 @@ void PrintLargestInstructions(
 
 // NOLINTEND
 
+// Options of the ILP solver. A solution depends on them as well as on the ILP,
+// e.g. a shorter time limit may yield a worse solution, so they are part of the
+// fingerprint of cached solutions.
+constexpr MPSolver::OptimizationProblemType kSolverProblemType =
+    MPSolver::GLPK_MIXED_INTEGER_PROGRAMMING;
+constexpr int32_t kSolverNumWorkers = 32;
+constexpr int64_t kSolverTimeLimitMs = 3600 * 1000;
+
+std::string SolverOptionsToString() {
+  return absl::StrCat("problem_type:", static_cast<int>(kSolverProblemType),
+                      ",num_workers:", kSolverNumWorkers,
+                      ",time_limit_ms:", kSolverTimeLimitMs);
+}
+
 // We formulate the auto sharding process as the following ILP problem:
 // Variables:
 //   s[i]: Sharding strategy one-hot vector.
@@ -1964,7 +1981,8 @@ void PrintLargestInstructions(
 //     h. For all (i, j) in A and all (p, q),
 //        s[i][p] + s[j][q] <= 1 if v[p, q] == 1.0
 // Serialize parameters of the ILP problem as numpy arrays and call the python
-// solver.
+// solver. If s_hint[i] >= 0, the solver is hinted to choose strategy s_hint[i]
+// for node i.
 StatusOr<std::tuple<std::vector<int64_t>, std::vector<int64_t>, double>>
 CallORToolsSolver(int64_t N, int64_t M, const std::vector<int>& s_len,
                   const std::vector<int>& s_follow,
@@ -1976,12 +1994,14 @@ CallORToolsSolver(int64_t N, int64_t M, const std::vector<int>& s_len,
                   const std::vector<std::vector<double>>& r,
                   const std::vector<std::pair<int, int>>& A,
                   const std::vector<std::vector<double>>& v,
-                  const std::vector<std::string>& instruction_names) {
+                  const std::vector<std::string>& instruction_names,
+                  const std::vector<int64_t>& s_hint) {
   size_t num_edges = E.size();
 
-  int32_t num_workers = 32;
+  int32_t num_workers = kSolverNumWorkers;
   // SAT or SCIP
-  std::unique_ptr<MPSolver> solver(std::make_unique<MPSolver>("", MPSolver::GLPK_MIXED_INTEGER_PROGRAMMING));
+  std::unique_ptr<MPSolver> solver(
+      std::make_unique<MPSolver>("", kSolverProblemType));
   CHECK(solver);
   solver->MutableObjective()->SetMinimization();
   std::string solver_parameter_str;
@@ -2179,6 +2199,27 @@ CallORToolsSolver(int64_t N, int64_t M, const std::vector<int>& s_len,
     }
   }
 
+  // Warm start from the hinted strategies, e.g. from a cached solution of a
+  // similar program. GLPK ignores hints, so only SAT and SCIP get them.
+  const bool solver_honors_hints =
+      solver->ProblemType() ==
+          operations_research::MPSolver::SAT_INTEGER_PROGRAMMING ||
+      solver->ProblemType() ==
+          operations_research::MPSolver::SCIP_MIXED_INTEGER_PROGRAMMING;
+  std::vector<std::pair<const MPVariable*, double>> hint;
+  for (size_t i = 0; solver_honors_hints && i < N && i < s_hint.size(); ++i) {
+    if (s_follow[i] >= 0 || s_hint[i] < 0 || s_hint[i] >= s[i].size()) {
+      continue;
+    }
+    for (size_t j = 0; j < s[i].size(); ++j) {
+      hint.push_back({s[i][j], j == s_hint[i] ? 1.0 : 0.0});
+    }
+  }
+  if (!hint.empty()) {
+    VLOG(0) << "Hinting strategies of " << hint.size() << " variables.";
+    solver->SetHint(std::move(hint));
+  }
+
 #ifdef PLATFORM_GOOGLE
   // Exports the model for debugging.
   bool dump_model = false;
@@ -2194,7 +2235,7 @@ CallORToolsSolver(int64_t N, int64_t M, const std::vector<int>& s_len,
     }
   }
 #endif
-  solver->set_time_limit(3600 * 1000);  // in ms
+  solver->set_time_limit(kSolverTimeLimitMs);  // in ms
   VLOG(0) << "Starting solver " << solver->ProblemType() << "\n"
           << "Solver parameter string: " << solver_parameter_str << "\n"
           << "Number of workers: " << num_workers << "\n"
@@ -2294,11 +2335,17 @@ CallORToolsSolver(int64_t N, int64_t M, const std::vector<int>& s_len,
                          solver->Objective().Value());
 }
 
+// Solves the ILP of `cost_graph`. If `solution_cache` is not null, returns the
+// cached solution of an identical ILP if there is one, warm-starts the solver
+// from the latest solution of `module_name` otherwise, and stores the new
+// solution.
 StatusOr<std::tuple<std::vector<int64_t>, std::vector<int64_t>, double>>
 CallSolver(const HloInstructionSequence& sequence,
            const LivenessSet& liveness_set, const StrategyMap& strategy_map,
            const LeafStrategies& leaf_strategies, const CostGraph& cost_graph,
-           const AliasSet& alias_set, int64_t memory_budget_per_device) {
+           const AliasSet& alias_set, int64_t memory_budget_per_device,
+           const AutoShardingSolutionCache* solution_cache,
+           absl::string_view module_name) {
   // Serialize edges and edge costs to 1d numpy arrays
   int64_t N = leaf_strategies.size();
   int64_t M = memory_budget_per_device;
@@ -2306,10 +2353,18 @@ CallSolver(const HloInstructionSequence& sequence,
   const std::vector<int>& s_follow = cost_graph.follow_idx_;
   std::vector<std::pair<int, int>> E;
   std::vector<std::vector<double>> r;
+  // Hash map iteration order differs between processes, so serialize edges and
+  // alias pairs in sorted order to keep the ILP (and its fingerprint) stable.
+  std::vector<std::pair<int, int>> edges;
+  edges.reserve(cost_graph.edge_costs_.size());
   for (const auto& iter : cost_graph.edge_costs_) {
-    E.push_back(iter.first);
+    edges.push_back(iter.first);
+  }
+  absl::c_sort(edges);
+  for (const std::pair<int, int>& edge : edges) {
+    E.push_back(edge);
     std::vector<double> rij;
-    Matrix edge_cost = iter.second;
+    const Matrix& edge_cost = cost_graph.edge_costs_.at(edge);
     for (size_t i = 0; i < edge_cost.n_; i++) {
       for (size_t j = 0; j < edge_cost.m_; j++) {
         rij.push_back(edge_cost(i, j));
@@ -2343,7 +2398,10 @@ CallSolver(const HloInstructionSequence& sequence,
   // spec
   std::vector<std::pair<int, int>> A;
   std::vector<std::vector<double>> v;
-  for (const auto& pair : alias_set) {
+  std::vector<std::pair<int64_t, int64_t>> alias_pairs(alias_set.begin(),
+                                                       alias_set.end());
+  absl::c_sort(alias_pairs);
+  for (const auto& pair : alias_pairs) {
     const StrategyVector* src_strategies = leaf_strategies[pair.first];
     const StrategyVector* dst_strategies = leaf_strategies[pair.second];
     Matrix raw_cost(src_strategies->leaf_vector.size(),
@@ -2415,8 +2473,77 @@ CallSolver(const HloInstructionSequence& sequence,
                                  value->index());
     }
   }
-  return CallORToolsSolver(N, M, s_len, s_follow, E, L, c, d, m, r, A, v,
-                           instruction_names);
+
+  std::vector<int64_t> s_hint;
+  uint64_t fingerprint = 0;
+  if (solution_cache != nullptr) {
+    fingerprint = AutoShardingSolutionCache::Fingerprint(
+        N, M, s_len, s_follow, E, L, c, d, m, r, A, v,
+        SolverOptionsToString());
+    if (std::optional<AutoShardingSolutionProto> cached =
+            solution_cache->Lookup(fingerprint);
+        cached.has_value() && cached->s_val_size() == N &&
+        cached->e_val_size() == E.size()) {
+      LOG(INFO) << "Reusing cached auto-sharding solution with objective "
+                << cached->objective();
+      return std::make_tuple(
+          std::vector<int64_t>(cached->s_val().begin(), cached->s_val().end()),
+          std::vector<int64_t>(cached->e_val().begin(), cached->e_val().end()),
+          cached->objective());
+    }
+    if (std::optional<AutoShardingSolutionProto> latest =
+            solution_cache->LookupLatest(module_name);
+        latest.has_value() &&
+        latest->instruction_names_size() == latest->strategy_names_size()) {
+      // Map the strategies chosen for instructions of the same name back to
+      // this ILP.
+      StableHashMap<absl::string_view, absl::string_view> chosen;
+      for (int i = 0; i < latest->instruction_names_size(); ++i) {
+        chosen[latest->instruction_names(i)] = latest->strategy_names(i);
+      }
+      s_hint.assign(N, -1);
+      for (size_t i = 0; i < N; ++i) {
+        const StrategyVector* strategies = leaf_strategies[i];
+        auto it = chosen.find(
+            instructions.at(strategies->instruction_id)->name());
+        if (it == chosen.end()) {
+          continue;
+        }
+        for (size_t j = 0; j < strategies->leaf_vector.size(); ++j) {
+          if (strategies->leaf_vector[j].name == it->second) {
+            s_hint[i] = j;
+            break;
+          }
+        }
+      }
+    }
+  }
+
+  TF_ASSIGN_OR_RETURN(
+      auto solution,
+      CallORToolsSolver(N, M, s_len, s_follow, E, L, c, d, m, r, A, v,
+                        instruction_names, s_hint));
+
+  if (solution_cache != nullptr) {
+    const auto& [s_val, e_val, objective] = solution;
+    AutoShardingSolutionProto proto;
+    proto.set_fingerprint(fingerprint);
+    proto.set_objective(objective);
+    proto.mutable_s_val()->Add(s_val.begin(), s_val.end());
+    proto.mutable_e_val()->Add(e_val.begin(), e_val.end());
+    for (size_t i = 0; i < N; ++i) {
+      const StrategyVector* strategies = leaf_strategies[i];
+      proto.add_instruction_names(
+          instructions.at(strategies->instruction_id)->name());
+      proto.add_strategy_names(
+          s_val[i] >= 0 ? strategies->leaf_vector[cost_graph.RemapIndex(
+                                                      i, s_val[i])]
+                              .name
+                        : "");
+    }
+    solution_cache->Insert(module_name, proto);
+  }
+  return solution;
 }
 
 void CheckHloSharding(const HloInstructionSequence& sequence,
@@ -3862,6 +3989,11 @@ StatusOr<bool> AutoSharding::Run(
 
   std::unique_ptr<CallGraph> call_graph = CallGraph::Build(module);
 
+  std::optional<spmd::AutoShardingSolutionCache> solution_cache;
+  if (!option_.solution_cache_dir.empty()) {
+    solution_cache.emplace(option_.solution_cache_dir);
+  }
+
   for (size_t mesh_idx = 0; mesh_idx < partial_mesh_shapes.size(); ++mesh_idx) {
     // Adjust existing shardings with current partial mesh shapes;
     std::vector<int64_t> mesh_shape = partial_mesh_shapes[mesh_idx];
@@ -3957,7 +4089,9 @@ StatusOr<bool> AutoSharding::Run(
       TF_ASSIGN_OR_RETURN(
           auto solution,
           CallSolver(sequence, liveness_set, strategy_map, leaf_strategies,
-                     cost_graph, alias_set, option_.memory_budget_per_device));
+                     cost_graph, alias_set, option_.memory_budget_per_device,
+                     solution_cache ? &*solution_cache : nullptr,
+                     absl::StrCat(module->name(), "/", mesh_idx)));
       std::tie(s_val, e_val, objective) = solution;
     } else {
       s_val = option_.strategy_vector;
@@ -160,6 +160,10 @@ struct AutoShardingOption {
   // Load the strategy vector instead of solving one.
   bool load_strategy = false;
   std::vector<int64_t> strategy_vector;
+  // If not empty, ILP solutions are cached in this directory. Recompiling an
+  // unchanged program reuses its solution, and the solver for a modified one
+  // is warm-started from the latest solution of the module.
+  std::string solution_cache_dir;
 
   std::string ToString() {
     std::vector<std::string> lines;
@@ -228,6 +232,7 @@ struct AutoShardingOption {
       lines.push_back(absl::StrCat("strategy_vector: [",
                                    absl::StrJoin(strategy_vector, ","), "]"));
     }
+    lines.push_back(absl::StrCat("solution_cache_dir: ", solution_cache_dir));
 
     return absl::StrJoin(lines, "\n");
   }
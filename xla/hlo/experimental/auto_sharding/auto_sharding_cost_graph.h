@@ -17,6 +17,7 @@ limitations under the License.
 #define TENSORFLOW_COMPILER_XLA_HLO_EXPERIMENTAL_AUTO_SHARDING_AUTO_SHARDING_COST_GRAPH_H_
 
 #include <algorithm>
+#include <cmath>
 #include <numeric>
 #include <string>
 #include <utility>
@@ -262,6 +263,71 @@ class CostGraph {
     return node;
   }
 
+  // Returns whether edge_cost(i, j) == a[i] + b[j] for some vectors a and b,
+  // and if so stores them. Such an edge does not couple the strategy choices
+  // of its nodes, so its cost can be moved into their node costs. Edges with
+  // an infinite entry are never separable: folding kInfinityCost into node
+  // costs would hide the infeasibility it marks from the solver.
+  static bool IsSeparable(const Matrix& edge_cost, std::vector<double>* a,
+                          std::vector<double>* b) {
+    a->resize(edge_cost.n_);
+    b->resize(edge_cost.m_);
+    for (size_t i = 0; i < edge_cost.n_; ++i) {
+      for (size_t j = 0; j < edge_cost.m_; ++j) {
+        if (edge_cost(i, j) >= kInfinityCost) {
+          return false;
+        }
+      }
+    }
+    if (edge_cost.n_ == 0 || edge_cost.m_ == 0) {
+      return true;
+    }
+    for (size_t i = 0; i < edge_cost.n_; ++i) {
+      (*a)[i] = edge_cost(i, 0);
+    }
+    for (size_t j = 0; j < edge_cost.m_; ++j) {
+      (*b)[j] = edge_cost(0, j) - edge_cost(0, 0);
+    }
+    for (size_t i = 1; i < edge_cost.n_; ++i) {
+      for (size_t j = 1; j < edge_cost.m_; ++j) {
+        double expected = (*a)[i] + (*b)[j];
+        if (std::abs(edge_cost(i, j) - expected) >
+            1e-9 * std::max({1.0, std::abs(edge_cost(i, j)),
+                             std::abs(expected)})) {
+          return false;
+        }
+      }
+    }
+    return true;
+  }
+
+  // Removes the edges whose cost is separable (see IsSeparable), e.g. edges
+  // of nodes with a single strategy or edges without any resharding cost, by
+  // adding their costs to the extra node costs of both ends. This does not
+  // change the cost of any assignment, but saves the solver one variable per
+  // strategy pair of the edge. Must run after nodes have been merged.
+  void RemoveSeparableEdges() {
+    std::vector<std::pair<int, int>> removed;
+    std::vector<double> a, b;
+    for (const auto& [edge, edge_cost] : edge_costs_) {
+      if (!IsSeparable(edge_cost, &a, &b)) {
+        continue;
+      }
+      for (int i = 0; i < node_lens_[edge.first]; ++i) {
+        extra_node_costs_[edge.first][i] += a[i];
+      }
+      for (int j = 0; j < node_lens_[edge.second]; ++j) {
+        extra_node_costs_[edge.second][j] += b[j];
+      }
+      removed.push_back(edge);
+    }
+    for (const auto& [i, j] : removed) {
+      RemoveEdge(i, j);
+    }
+    VLOG(1) << "Removed " << removed.size() << " separable edges, "
+            << edge_costs_.size() << " edges left.";
+  }
+
   void Simplify(bool enable) {
     // Merge nodes
     for (const auto& pair : to_merge_pairs_) {
@@ -272,6 +338,9 @@ class CostGraph {
         MergeNode(src, dst);
       }
     }
+    if (enable) {
+      RemoveSeparableEdges();
+    }
 
     // Build follow map
     follow_idx_.reserve(node_lens_.size());
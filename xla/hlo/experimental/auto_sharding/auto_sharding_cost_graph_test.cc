@@ -0,0 +1,136 @@
+/* Copyright 2023 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "xla/hlo/experimental/auto_sharding/auto_sharding_cost_graph.h"
+
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "absl/strings/str_cat.h"
+#include "xla/hlo/experimental/auto_sharding/auto_sharding_strategy.h"
+#include "xla/hlo/experimental/auto_sharding/matrix.h"
+#include "xla/hlo/ir/hlo_sharding.h"
+#include "tsl/platform/test.h"
+
+namespace xla {
+namespace spmd {
+namespace {
+
+using ::testing::ElementsAre;
+
+// Returns a leaf strategy vector with node index `id`. If `in_node` is not
+// null, it is the only operand and `resharding_costs[k][j]` is the cost of
+// resharding its j-th strategy for the k-th strategy of the new node.
+std::unique_ptr<StrategyVector> MakeStrategies(
+    int64_t id, const StrategyVector* in_node,
+    const std::vector<std::vector<double>>& resharding_costs) {
+  auto strategies = std::make_unique<StrategyVector>();
+  strategies->is_tuple = false;
+  strategies->id = id;
+  strategies->instruction_id = id;
+  if (in_node != nullptr) {
+    strategies->in_nodes.push_back(in_node);
+  }
+  for (size_t k = 0; k < resharding_costs.size(); ++k) {
+    ShardingStrategy strategy{absl::StrCat("s", k), HloSharding::Replicate(),
+                              /*compute_cost=*/0, /*communication_cost=*/0,
+                              /*memory_cost=*/0};
+    if (in_node != nullptr) {
+      strategy.resharding_costs.push_back(resharding_costs[k]);
+    }
+    strategies->leaf_vector.push_back(std::move(strategy));
+  }
+  return strategies;
+}
+
+TEST(CostGraphTest, RemoveSeparableEdges) {
+  auto node0 = MakeStrategies(0, nullptr, {{}, {}});
+  // edge_cost(j, k) == a[j] + b[k] with a == {1, 2} and b == {0, 2}.
+  auto node1 = MakeStrategies(1, node0.get(), {{1, 2}, {3, 4}});
+  // Prefers the same strategy at both ends, which is not separable.
+  auto node2 = MakeStrategies(2, node0.get(), {{0, 1}, {1, 0}});
+  LeafStrategies leaf_strategies = {node0.get(), node1.get(), node2.get()};
+
+  CostGraph cost_graph(leaf_strategies, /*associative_dot_pairs=*/{});
+  ASSERT_EQ(cost_graph.edge_costs_.size(), 2);
+  cost_graph.Simplify(/*enable=*/true);
+
+  ASSERT_EQ(cost_graph.edge_costs_.size(), 1);
+  EXPECT_TRUE(cost_graph.edge_costs_.contains({0, 2}));
+  EXPECT_FALSE(cost_graph.adjacency_[0].contains(1));
+  EXPECT_FALSE(cost_graph.adjacency_[1].contains(0));
+  EXPECT_THAT(cost_graph.extra_node_costs_[0], ElementsAre(1, 2));
+  EXPECT_THAT(cost_graph.extra_node_costs_[1], ElementsAre(0, 2));
+  EXPECT_THAT(cost_graph.extra_node_costs_[2], ElementsAre(0, 0));
+}
+
+TEST(CostGraphTest, RemoveSeparableEdgesDisabled) {
+  auto node0 = MakeStrategies(0, nullptr, {{}, {}});
+  auto node1 = MakeStrategies(1, node0.get(), {{1, 2}, {3, 4}});
+  LeafStrategies leaf_strategies = {node0.get(), node1.get()};
+
+  CostGraph cost_graph(leaf_strategies, /*associative_dot_pairs=*/{});
+  cost_graph.Simplify(/*enable=*/false);
+
+  EXPECT_EQ(cost_graph.edge_costs_.size(), 1);
+  EXPECT_THAT(cost_graph.extra_node_costs_[0], ElementsAre(0, 0));
+}
+
+TEST(CostGraphTest, InfiniteSeparableEdgeIsKept) {
+  auto node0 = MakeStrategies(0, nullptr, {{}, {}});
+  // Separable with a == {kInfinityCost, 0} and b == {0, 0}, but the infinite
+  // row marks an infeasible strategy pair and must stay an edge cost.
+  auto node1 = MakeStrategies(1, node0.get(),
+                              {{kInfinityCost, 0}, {kInfinityCost, 0}});
+  LeafStrategies leaf_strategies = {node0.get(), node1.get()};
+
+  CostGraph cost_graph(leaf_strategies, /*associative_dot_pairs=*/{});
+  cost_graph.Simplify(/*enable=*/true);
+
+  EXPECT_EQ(cost_graph.edge_costs_.size(), 1);
+  EXPECT_THAT(cost_graph.extra_node_costs_[0], ElementsAre(0, 0));
+  EXPECT_THAT(cost_graph.extra_node_costs_[1], ElementsAre(0, 0));
+}
+
+TEST(CostGraphTest, IsSeparable) {
+  std::vector<double> a, b;
+  Matrix separable(2, 3);
+  Matrix coupled(2, 3);
+  for (int i = 0; i < 2; ++i) {
+    for (int j = 0; j < 3; ++j) {
+      separable(i, j) = 10 * i + j;
+      coupled(i, j) = i * j;
+    }
+  }
+  ASSERT_TRUE(CostGraph::IsSeparable(separable, &a, &b));
+  for (int i = 0; i < 2; ++i) {
+    for (int j = 0; j < 3; ++j) {
+      EXPECT_DOUBLE_EQ(a[i] + b[j], separable(i, j));
+    }
+  }
+  EXPECT_FALSE(CostGraph::IsSeparable(coupled, &a, &b));
+  // Edges of nodes with a single strategy are always separable.
+  Matrix single(1, 3);
+  single(0, 1) = 5;
+  EXPECT_TRUE(CostGraph::IsSeparable(single, &a, &b));
+  single(0, 2) = kInfinityCost;
+  EXPECT_FALSE(CostGraph::IsSeparable(single, &a, &b));
+}
+
+}  // namespace
+}  // namespace spmd
+}  // namespace xla
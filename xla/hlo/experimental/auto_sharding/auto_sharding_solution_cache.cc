@@ -0,0 +1,170 @@
+/* Copyright 2023 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "xla/hlo/experimental/auto_sharding/auto_sharding_solution_cache.h"
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "absl/strings/str_cat.h"
+#include "absl/strings/str_format.h"
+#include "absl/strings/string_view.h"
+#include "xla/status.h"
+#include "tsl/platform/env.h"
+#include "tsl/platform/errors.h"
+#include "tsl/platform/fingerprint.h"
+#include "tsl/platform/logging.h"
+#include "tsl/platform/path.h"
+
+namespace xla {
+namespace spmd {
+namespace {
+
+// Accumulates a fingerprint of vectors of trivially copyable values.
+class FingerprintBuilder {
+ public:
+  template <typename T>
+  void Add(const std::vector<T>& values) {
+    Add(static_cast<uint64_t>(values.size()));
+    fingerprint_ = tsl::FingerprintCat64(
+        fingerprint_,
+        tsl::Fingerprint64(absl::string_view(
+            reinterpret_cast<const char*>(values.data()),
+            values.size() * sizeof(T))));
+  }
+
+  template <typename T>
+  void Add(const std::vector<std::vector<T>>& values) {
+    Add(static_cast<uint64_t>(values.size()));
+    for (const std::vector<T>& inner : values) {
+      Add(inner);
+    }
+  }
+
+  void Add(uint64_t value) {
+    fingerprint_ = tsl::FingerprintCat64(fingerprint_, value);
+  }
+
+  uint64_t fingerprint() const { return fingerprint_; }
+
+ private:
+  uint64_t fingerprint_ = 0;
+};
+
+}  // namespace
+
+/*static*/ uint64_t AutoShardingSolutionCache::Fingerprint(
+    int64_t N, int64_t M, const std::vector<int>& s_len,
+    const std::vector<int>& s_follow, const std::vector<std::pair<int, int>>& E,
+    const std::vector<std::vector<int>>& L,
+    const std::vector<std::vector<double>>& c,
+    const std::vector<std::vector<double>>& d,
+    const std::vector<std::vector<double>>& m,
+    const std::vector<std::vector<double>>& r,
+    const std::vector<std::pair<int, int>>& A,
+    const std::vector<std::vector<double>>& v,
+    absl::string_view solver_options) {
+  FingerprintBuilder builder;
+  builder.Add(static_cast<uint64_t>(N));
+  builder.Add(static_cast<uint64_t>(M));
+  builder.Add(s_len);
+  builder.Add(s_follow);
+  builder.Add(E);
+  builder.Add(L);
+  builder.Add(c);
+  builder.Add(d);
+  builder.Add(m);
+  builder.Add(r);
+  builder.Add(A);
+  builder.Add(v);
+  builder.Add(tsl::Fingerprint64(solver_options));
+  return builder.fingerprint();
+}
+
+std::optional<AutoShardingSolutionProto> AutoShardingSolutionCache::Lookup(
+    uint64_t fingerprint) const {
+  std::optional<AutoShardingSolutionProto> solution = Read(tsl::io::JoinPath(
+      directory_, absl::StrFormat("solution_%016x.pb", fingerprint)));
+  if (solution.has_value() && solution->fingerprint() != fingerprint) {
+    LOG(WARNING) << "Ignoring cached auto-sharding solution with mismatching "
+                    "fingerprint.";
+    return std::nullopt;
+  }
+  return solution;
+}
+
+std::optional<AutoShardingSolutionProto>
+AutoShardingSolutionCache::LookupLatest(absl::string_view module_name) const {
+  return Read(tsl::io::JoinPath(
+      directory_, absl::StrCat("latest_", tsl::Fingerprint64(module_name),
+                               ".pb")));
+}
+
+void AutoShardingSolutionCache::Insert(
+    absl::string_view module_name,
+    const AutoShardingSolutionProto& solution) const {
+  tsl::Env* env = tsl::Env::Default();
+  if (Status status = env->RecursivelyCreateDir(directory_);
+      !status.ok() && !tsl::errors::IsAlreadyExists(status)) {
+    LOG(WARNING) << "Cannot create the auto-sharding solution cache: "
+                 << status;
+    return;
+  }
+  Write(tsl::io::JoinPath(directory_, absl::StrFormat("solution_%016x.pb",
+                                                      solution.fingerprint())),
+        solution);
+  Write(tsl::io::JoinPath(
+            directory_,
+            absl::StrCat("latest_", tsl::Fingerprint64(module_name), ".pb")),
+        solution);
+}
+
+std::optional<AutoShardingSolutionProto> AutoShardingSolutionCache::Read(
+    const std::string& path) const {
+  tsl::Env* env = tsl::Env::Default();
+  if (!env->FileExists(path).ok()) {
+    return std::nullopt;
+  }
+  AutoShardingSolutionProto solution;
+  if (Status status = tsl::ReadBinaryProto(env, path, &solution);
+      !status.ok()) {
+    LOG(WARNING) << "Cannot read cached auto-sharding solution " << path
+                 << ": " << status;
+    return std::nullopt;
+  }
+  return solution;
+}
+
+void AutoShardingSolutionCache::Write(
+    const std::string& path, const AutoShardingSolutionProto& solution) const {
+  // Write to a temporary file first so that concurrent compilations never
+  // read a partially written solution.
+  tsl::Env* env = tsl::Env::Default();
+  std::string tmp_path = absl::StrCat(path, ".tmp.", env->NowMicros());
+  Status status = tsl::WriteBinaryProto(env, tmp_path, solution);
+  if (status.ok()) {
+    status = env->RenameFile(tmp_path, path);
+  }
+  if (!status.ok()) {
+    LOG(WARNING) << "Cannot write auto-sharding solution " << path << ": "
+                 << status;
+  }
+}
+
+}  // namespace spmd
+}  // namespace xla
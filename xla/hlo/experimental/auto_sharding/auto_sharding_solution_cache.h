@@ -0,0 +1,83 @@
+/* Copyright 2023 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef TENSORFLOW_COMPILER_XLA_HLO_EXPERIMENTAL_AUTO_SHARDING_AUTO_SHARDING_SOLUTION_CACHE_H_
+#define TENSORFLOW_COMPILER_XLA_HLO_EXPERIMENTAL_AUTO_SHARDING_AUTO_SHARDING_SOLUTION_CACHE_H_
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "absl/strings/string_view.h"
+#include "xla/hlo/experimental/auto_sharding/auto_sharding_solution.pb.h"
+
+namespace xla {
+namespace spmd {
+
+// A persistent cache of auto-sharding ILP solutions in a directory.
+//
+// Solutions are keyed by a fingerprint of the serialized ILP, which only
+// depends on the structure and costs of the cost graph and not on instruction
+// names, so recompiling an unchanged program skips the solver. The latest
+// solution of each module is also kept under the module name; when the ILP of
+// a modified program misses the cache, it provides a hint to warm-start the
+// solver.
+class AutoShardingSolutionCache {
+ public:
+  explicit AutoShardingSolutionCache(std::string directory)
+      : directory_(std::move(directory)) {}
+
+  // Returns a fingerprint of the ILP given by the CallORToolsSolver
+  // arguments and of `solver_options`, which describes the solver options that
+  // the solution depends on, such as the time limit.
+  static uint64_t Fingerprint(int64_t N, int64_t M,
+                              const std::vector<int>& s_len,
+                              const std::vector<int>& s_follow,
+                              const std::vector<std::pair<int, int>>& E,
+                              const std::vector<std::vector<int>>& L,
+                              const std::vector<std::vector<double>>& c,
+                              const std::vector<std::vector<double>>& d,
+                              const std::vector<std::vector<double>>& m,
+                              const std::vector<std::vector<double>>& r,
+                              const std::vector<std::pair<int, int>>& A,
+                              const std::vector<std::vector<double>>& v,
+                              absl::string_view solver_options);
+
+  // Returns the solution of the ILP with `fingerprint`, if cached.
+  std::optional<AutoShardingSolutionProto> Lookup(uint64_t fingerprint) const;
+
+  // Returns the latest solution stored for the module `module_name`, if any.
+  std::optional<AutoShardingSolutionProto> LookupLatest(
+      absl::string_view module_name) const;
+
+  // Stores `solution` both under its fingerprint and as the latest solution
+  // of `module_name`. Failures are logged and otherwise ignored.
+  void Insert(absl::string_view module_name,
+              const AutoShardingSolutionProto& solution) const;
+
+ private:
+  std::optional<AutoShardingSolutionProto> Read(const std::string& path) const;
+  void Write(const std::string& path,
+             const AutoShardingSolutionProto& solution) const;
+
+  std::string directory_;
+};
+
+}  // namespace spmd
+}  // namespace xla
+
+#endif  // TENSORFLOW_COMPILER_XLA_HLO_EXPERIMENTAL_AUTO_SHARDING_AUTO_SHARDING_SOLUTION_CACHE_H_
@@ -0,0 +1,115 @@
+/* Copyright 2023 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "xla/hlo/experimental/auto_sharding/auto_sharding_solution_cache.h"
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "absl/strings/str_format.h"
+#include "absl/strings/string_view.h"
+#include "xla/hlo/experimental/auto_sharding/auto_sharding_solution.pb.h"
+#include "tsl/lib/core/status_test_util.h"
+#include "tsl/platform/env.h"
+#include "tsl/platform/path.h"
+#include "tsl/platform/test.h"
+
+namespace xla {
+namespace spmd {
+namespace {
+
+using ::testing::ElementsAre;
+
+uint64_t TestFingerprint(double cost, absl::string_view solver_options) {
+  return AutoShardingSolutionCache::Fingerprint(
+      /*N=*/2, /*M=*/-1, /*s_len=*/{2, 2}, /*s_follow=*/{-1, -1},
+      /*E=*/{{0, 1}}, /*L=*/{{0, 1}}, /*c=*/{{cost, 1}, {0, 1}},
+      /*d=*/{{0, 0}, {0, 0}}, /*m=*/{{1, 1}, {1, 1}},
+      /*r=*/{{0, 1, 1, 0}}, /*A=*/{}, /*v=*/{}, solver_options);
+}
+
+std::string CacheDirectory() {
+  return tsl::io::JoinPath(
+      ::testing::TempDir(),
+      ::testing::UnitTest::GetInstance()->current_test_info()->name());
+}
+
+TEST(AutoShardingSolutionCacheTest, Fingerprint) {
+  EXPECT_EQ(TestFingerprint(0, "time_limit_ms:1000"),
+            TestFingerprint(0, "time_limit_ms:1000"));
+  EXPECT_NE(TestFingerprint(0, "time_limit_ms:1000"),
+            TestFingerprint(1, "time_limit_ms:1000"));
+  // A solution found with other solver options is not reused.
+  EXPECT_NE(TestFingerprint(0, "time_limit_ms:1000"),
+            TestFingerprint(0, "time_limit_ms:2000"));
+}
+
+TEST(AutoShardingSolutionCacheTest, CacheHit) {
+  AutoShardingSolutionCache cache(CacheDirectory());
+  uint64_t fingerprint = TestFingerprint(0, "");
+  EXPECT_FALSE(cache.Lookup(fingerprint).has_value());
+  EXPECT_FALSE(cache.LookupLatest("module").has_value());
+
+  AutoShardingSolutionProto solution;
+  solution.set_fingerprint(fingerprint);
+  solution.set_objective(42);
+  solution.add_s_val(1);
+  solution.add_s_val(0);
+  solution.add_e_val(2);
+  solution.add_instruction_names("dot");
+  solution.add_strategy_names("S0 @ 0");
+  cache.Insert("module", solution);
+
+  std::optional<AutoShardingSolutionProto> cached = cache.Lookup(fingerprint);
+  ASSERT_TRUE(cached.has_value());
+  EXPECT_EQ(cached->fingerprint(), fingerprint);
+  EXPECT_EQ(cached->objective(), 42);
+  EXPECT_THAT(cached->s_val(), ElementsAre(1, 0));
+  EXPECT_THAT(cached->e_val(), ElementsAre(2));
+  EXPECT_THAT(cached->strategy_names(), ElementsAre("S0 @ 0"));
+  EXPECT_FALSE(cache.Lookup(TestFingerprint(1, "")).has_value());
+
+  std::optional<AutoShardingSolutionProto> latest =
+      cache.LookupLatest("module");
+  ASSERT_TRUE(latest.has_value());
+  EXPECT_EQ(latest->fingerprint(), fingerprint);
+  EXPECT_FALSE(cache.LookupLatest("other_module").has_value());
+}
+
+TEST(AutoShardingSolutionCacheTest, IgnoresMismatchingFingerprint) {
+  std::string directory = CacheDirectory();
+  AutoShardingSolutionCache cache(directory);
+  AutoShardingSolutionProto solution;
+  solution.set_fingerprint(TestFingerprint(0, ""));
+  cache.Insert("module", solution);
+
+  // Overwrite the file of another fingerprint with this solution.
+  std::vector<std::string> files;
+  TF_ASSERT_OK(tsl::Env::Default()->GetMatchingPaths(
+      tsl::io::JoinPath(directory, "solution_*.pb"), &files));
+  ASSERT_EQ(files.size(), 1);
+  uint64_t other = TestFingerprint(1, "");
+  TF_ASSERT_OK(tsl::Env::Default()->RenameFile(
+      files[0], tsl::io::JoinPath(directory, absl::StrFormat(
+                                                 "solution_%016x.pb", other))));
+  EXPECT_FALSE(cache.Lookup(other).has_value());
+}
+
+}  // namespace
+}  // namespace spmd
+}  // namespace xla
@@ -2253,7 +2253,7 @@ void HloInstruction::DetachFromOperandsAndUsers() {
     if (operand == nullptr) {
       continue;
     }
-    if (operand->user_map_.find(this) != operand->user_map_.end()) {
+    if (operand->FindUserIndex(this) >= 0) {
       operand->RemoveUser(this);
     }
     operands_[operand_num] = nullptr;
@@ -2513,16 +2513,52 @@ void HloInstruction::RemoveOperandsAtAscendingIndices(
 }
 
 void HloInstruction::AddUser(HloInstruction* user) {
-  if (!ContainsKey(user_map_, user)) {
-    user_map_.emplace(user, users_.size());
-    users_.push_back(user);
+  if (FindUserIndex(user) >= 0) {
+    return;
+  }
+  users_.push_back(user);
+  if (user_map_ != nullptr) {
+    user_map_->emplace(user, users_.size() - 1);
+  } else if (users_.size() > kUserMapThreshold) {
+    RebuildUserMap();
+  }
+}
+
+int64_t HloInstruction::FindUserIndex(const HloInstruction* user) const {
+  if (user_map_ != nullptr) {
+    auto it = user_map_->find(user);
+    return it == user_map_->end() ? -1 : it->second;
+  }
+  auto it = absl::c_find(users_, user);
+  return it == users_.end() ? -1 : std::distance(users_.begin(), it);
+}
+
+void HloInstruction::RebuildUserMap() {
+  if (users_.size() <= kUserMapThreshold) {
+    user_map_.reset();
+    return;
+  }
+  if (user_map_ == nullptr) {
+    user_map_ = std::make_unique<
+        absl::flat_hash_map<const HloInstruction*, int64_t>>();
+  } else {
+    user_map_->clear();
+  }
+  user_map_->reserve(users_.size());
+  for (int64_t i = 0; i < users_.size(); ++i) {
+    user_map_->emplace(users_[i], i);
   }
 }
 
+void HloInstruction::ClearUsers() {
+  users_.clear();
+  user_map_.reset();
+}
+
 int64_t HloInstruction::UserId(HloInstruction* user) {
-  auto result = user_map_.find(user);
-  CHECK(result != user_map_.end());
-  return result->second;
+  const int64_t index = FindUserIndex(user);
+  CHECK_GE(index, 0);
+  return index;
 }
 
 bool HloInstruction::HasConstantOperand() const {
@@ -2686,20 +2722,26 @@ bool HloInstruction::IdenticalSlowPath(
 }
 
 void HloInstruction::RemoveUser(HloInstruction* user) {
-  auto map_it = user_map_.find(user);
-  CHECK(map_it != user_map_.end());
-
-  const int64_t index = map_it->second;
+  const int64_t index = FindUserIndex(user);
+  CHECK_GE(index, 0);
   CHECK_EQ(users_[index], user);
 
-  // Move the last user into the position of the removed user.
+  // Move the last user into the position of the removed user and drop the last
+  // slot from the vector.
   users_[index] = users_.back();
-  user_map_[users_.back()] = index;
-
-  // Remove the user from the map and drop the last slot from the vector what
-  // have been moved to the position of the original user.
-  user_map_.erase(map_it);
   users_.pop_back();
+
+  if (user_map_ != nullptr) {
+    user_map_->erase(user);
+    if (index < users_.size()) {
+      (*user_map_)[users_[index]] = index;
+    }
+    // Stop maintaining the index once the users fit comfortably in a linear
+    // scan again.
+    if (users_.size() <= kUserMapThreshold / 2) {
+      user_map_.reset();
+    }
+  }
 }
 
 Status HloInstruction::ReplaceUseWith(HloInstruction* user,
@@ -2837,8 +2879,7 @@ Status HloInstruction::ReplaceAllUsesWithDifferentShape(
       }
     }
   }
-  users_.clear();
-  user_map_.clear();
+  ClearUsers();
   if (new_producer_is_user) {
     AddUser(new_producer);
   }
@@ -4588,10 +4629,7 @@ void HloInstruction::SortInstructionUsersAndControlLists(
     LOG(ERROR) << "Failed to sort instruction users for " << name() << "; "
                << status;
   }
-  user_map_.clear();
-  for (uint64_t i = 0; i < users_.size(); ++i) {
-    user_map_[users_[i]] = i;
-  }
+  RebuildUserMap();
   status = Sorter::Sort(map_fn, Sorter::IndexAfterMappedElementsFn(),
                         sorted_instruction.control_predecessors_,
                         control_predecessors_);
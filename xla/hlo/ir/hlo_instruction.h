@@ -1247,7 +1247,7 @@ class HloInstruction {
 
   // Returns true if this instruction is a user of 'instruction'.
   bool IsUserOf(const HloInstruction* instruction) const {
-    return ContainsKey(instruction->user_map_, this);
+    return instruction->FindUserIndex(this) >= 0;
   }
 
   // Adds a control dependency from this instruction to the given
@@ -2324,6 +2324,16 @@ class HloInstruction {
   // Removes a user for this instruction.
   void RemoveUser(HloInstruction* user);
 
+  // Returns the index of `user` in users_, or -1 if `user` is not a user of
+  // this instruction.
+  int64_t FindUserIndex(const HloInstruction* user) const;
+
+  // Rebuilds user_map_ from users_.
+  void RebuildUserMap();
+
+  // Removes all users of this instruction.
+  void ClearUsers();
+
   // Helper for implementing backend_config().  Parses backend_config_ into the
   // given proto.
   Status GetBackendConfigInternal(tsl::protobuf::Message* proto) const;
@@ -2351,12 +2361,19 @@ class HloInstruction {
   std::vector<HloInstruction*> control_predecessors_;
 
   // The users of this instruction. Users are HLOs where this instruction is an
-  // operand. The vector users_ and the map user_map_ contain identical members.
-  // The map enables fast membership testing and the vector enables fast, stable
-  // iteration. The value in the map contains the index of the instruction in
-  // the vector what enables fast removal.
+  // operand. The vector enables fast, stable iteration.
+  //
+  // Most instructions have only a handful of users, for which a linear scan of
+  // users_ is the cheapest way to test membership. Once the number of users
+  // exceeds kUserMapThreshold we additionally maintain user_map_, which maps
+  // each user to its index in users_ and keeps membership testing and removal
+  // O(1). The map is released again when the user count drops back below half
+  // the threshold, so that instructions which temporarily had many users do
+  // not keep paying for it.
+  static constexpr int64_t kUserMapThreshold = 16;
   std::vector<HloInstruction*> users_;
-  absl::flat_hash_map<const HloInstruction*, int64_t> user_map_;
+  std::unique_ptr<absl::flat_hash_map<const HloInstruction*, int64_t>>
+      user_map_;
 
   // The set of control successors of this instruction.
   std::vector<HloInstruction*> control_successors_;
@@ -853,6 +853,36 @@ PJRT_DEFINE_STRUCT_TRAITS(PJRT_LoadedExecutable_Execute_Args, execute_device);
 typedef PJRT_Error* PJRT_LoadedExecutable_Execute(
     PJRT_LoadedExecutable_Execute_Args* args);
 
+struct PJRT_LoadedExecutable_ExecuteBatch_Args {
+  size_t struct_size;
+  void* priv;
+  // The client that launches the executions. Every executable must have been
+  // loaded by it.
+  PJRT_Client* client;
+  // The executions to launch, of length `num_executions`. Each is specified as
+  // for PJRT_LoadedExecutable_Execute, and its outputs and
+  // `device_complete_events` are populated in the same way. The executables
+  // may differ between executions. Only needs to stay alive for the duration
+  // of the ExecuteBatch call.
+  PJRT_LoadedExecutable_Execute_Args* executions;
+  size_t num_executions;
+  // Of length `num_executions`, allocated by the caller. `errors[i]` is set if
+  // execution `i` failed to launch, in which case its outputs and events are
+  // not populated, and nullptr otherwise. The caller is responsible for calling
+  // PJRT_Error_Destroy on the returned PJRT_Error*s.
+  PJRT_Error** errors;  // in/out
+};
+PJRT_DEFINE_STRUCT_TRAITS(PJRT_LoadedExecutable_ExecuteBatch_Args, errors);
+
+// Launches several executions, in order, with a single call. This amortizes
+// the per-call overhead of PJRT_LoadedExecutable_Execute when launching many
+// small programs. A failing execution does not prevent the ones after it from
+// being launched; an execution whose executable belongs to another client
+// fails. The returned error is only set if `args` itself is invalid, e.g.
+// `executions` or `errors` is null, in which case no execution is launched.
+typedef PJRT_Error* PJRT_LoadedExecutable_ExecuteBatch(
+    PJRT_LoadedExecutable_ExecuteBatch_Args* args);
+
 struct PJRT_Executable_NumOutputs_Args {
   size_t struct_size;
   void* priv;
@@ -1283,9 +1313,12 @@ typedef struct {
   _PJRT_API_STRUCT_FIELD(PJRT_DeviceTopology_PlatformVersion);
 
   _PJRT_API_STRUCT_FIELD(PJRT_Compile);
+
+  _PJRT_API_STRUCT_FIELD(PJRT_LoadedExecutable_ExecuteBatch);
 } PJRT_Api;
 
-const size_t PJRT_Api_STRUCT_SIZE = PJRT_STRUCT_SIZE(PJRT_Api, PJRT_Compile);
+const size_t PJRT_Api_STRUCT_SIZE =
+    PJRT_STRUCT_SIZE(PJRT_Api, PJRT_LoadedExecutable_ExecuteBatch);
 
 #undef _PJRT_API_STRUCT_FIELD
 #undef PJRT_DEFINE_STRUCT_TRAITS
@@ -14,10 +14,22 @@ limitations under the License.
 ==============================================================================*/
 #include "xla/pjrt/c/pjrt_c_api_cpu.h"
 
+#include <memory>
+#include <optional>
+#include <utility>
+#include <vector>
+
 #include <gtest/gtest.h>
+#include "xla/client/xla_builder.h"
 #include "xla/pjrt/c/pjrt_c_api.h"
+#include "xla/pjrt/c/pjrt_c_api_helpers.h"
 #include "xla/pjrt/c/pjrt_c_api_wrapper_impl.h"
+#include "xla/pjrt/pjrt_c_api_client.h"
 #include "xla/pjrt/pjrt_client.h"
+#include "xla/shape_util.h"
+#include "tsl/lib/core/status_test_util.h"
+#include "tsl/platform/status.h"
+#include "tsl/platform/test_benchmark.h"
 
 namespace xla {
 namespace pjrt {
@@ -88,6 +100,140 @@ TEST_F(PjrtCApiCpuTest, PlatformName) {
   ASSERT_EQ("cpu", platform_name);
 }
 
+std::unique_ptr<PjRtCApiClient> CreateCApiClient() {
+  const PJRT_Api* api = GetPjrtApi();
+  PJRT_Client_Create_Args args;
+  args.struct_size = PJRT_Client_Create_Args_STRUCT_SIZE;
+  args.priv = nullptr;
+  args.client = nullptr;
+  CHECK_EQ(api->PJRT_Client_Create(&args), nullptr);
+  return std::make_unique<PjRtCApiClient>(api, args.client);
+}
+
+// Compiles f(x) = x + `addend` for a scalar x.
+StatusOr<std::unique_ptr<PjRtLoadedExecutable>> CompileAdd(PjRtClient& client,
+                                                           float addend) {
+  XlaBuilder builder("add");
+  Add(Parameter(&builder, 0, ShapeUtil::MakeScalarShape(F32), "x"),
+      ConstantR0<float>(&builder, addend));
+  TF_ASSIGN_OR_RETURN(XlaComputation computation, builder.Build());
+  return client.Compile(computation, CompileOptions());
+}
+
+StatusOr<std::unique_ptr<PjRtBuffer>> ScalarBuffer(PjRtClient& client,
+                                                   float value) {
+  return client.BufferFromHostBuffer(
+      &value, F32, /*dims=*/{}, /*byte_strides=*/std::nullopt,
+      PjRtClient::HostBufferSemantics::kImmutableOnlyDuringCall,
+      /*on_done_with_host_buffer=*/nullptr, client.addressable_devices()[0]);
+}
+
+TEST(PjrtCApiClientCpuTest, ExecuteBatch) {
+  std::unique_ptr<PjRtCApiClient> client = CreateCApiClient();
+  TF_ASSERT_OK_AND_ASSIGN(auto add_one, CompileAdd(*client, 1.0f));
+  TF_ASSERT_OK_AND_ASSIGN(auto add_two, CompileAdd(*client, 2.0f));
+  TF_ASSERT_OK_AND_ASSIGN(auto x, ScalarBuffer(*client, 40.0f));
+
+  std::vector<std::vector<PjRtBuffer*>> arguments = {{x.get()}};
+  std::vector<std::vector<PjRtBuffer*>> wrong_arguments = {{}};
+  std::vector<PjRtCApiClient::BatchedExecution> executions = {
+      {add_one.get(), arguments},
+      {add_two.get(), wrong_arguments},
+      {add_two.get(), arguments}};
+  TF_ASSERT_OK_AND_ASSIGN(
+      std::vector<PjRtCApiClient::BatchedExecutionResult> results,
+      client->ExecuteBatch(executions, ExecuteOptions(),
+                           /*fill_futures=*/true));
+  ASSERT_EQ(results.size(), 3);
+
+  // A failed execution does not prevent the ones after it.
+  EXPECT_FALSE(results[1].outputs.ok());
+  EXPECT_TRUE(results[1].device_complete_futures.empty());
+  const float expected[] = {41.0f, 0.0f, 42.0f};
+  for (int i : {0, 2}) {
+    TF_ASSERT_OK(results[i].outputs.status());
+    ASSERT_EQ(results[i].device_complete_futures.size(), 1);
+    TF_EXPECT_OK(results[i].device_complete_futures[0].Await());
+    TF_ASSERT_OK_AND_ASSIGN(auto literal,
+                            (*results[i].outputs)[0][0]->ToLiteralSync());
+    EXPECT_EQ(literal->Get<float>({}), expected[i]);
+  }
+}
+
+TEST(PjrtCApiClientCpuTest, ExecuteBatchRejectsOtherClients) {
+  std::unique_ptr<PjRtCApiClient> client = CreateCApiClient();
+  std::unique_ptr<PjRtCApiClient> other_client = CreateCApiClient();
+  TF_ASSERT_OK_AND_ASSIGN(auto add_one, CompileAdd(*client, 1.0f));
+  TF_ASSERT_OK_AND_ASSIGN(auto other_add_one, CompileAdd(*other_client, 1.0f));
+  TF_ASSERT_OK_AND_ASSIGN(auto x, ScalarBuffer(*client, 40.0f));
+
+  std::vector<std::vector<PjRtBuffer*>> arguments = {{x.get()}};
+  std::vector<PjRtCApiClient::BatchedExecution> executions = {
+      {other_add_one.get(), arguments}, {add_one.get(), arguments}};
+  TF_ASSERT_OK_AND_ASSIGN(
+      std::vector<PjRtCApiClient::BatchedExecutionResult> results,
+      client->ExecuteBatch(executions, ExecuteOptions(),
+                           /*fill_futures=*/false));
+  ASSERT_EQ(results.size(), 2);
+  EXPECT_FALSE(results[0].outputs.ok());
+  TF_EXPECT_OK(results[1].outputs.status());
+
+  // The C API checks the same for callers that do not go through
+  // PjRtCApiClient, and rejects missing arrays.
+  const PJRT_Api* api = GetPjrtApi();
+  PJRT_LoadedExecutable_ExecuteBatch_Args args;
+  args.struct_size = PJRT_LoadedExecutable_ExecuteBatch_Args_STRUCT_SIZE;
+  args.priv = nullptr;
+  args.client = client->pjrt_c_client();
+  args.executions = nullptr;
+  args.num_executions = 1;
+  args.errors = nullptr;
+  std::unique_ptr<PJRT_Error, ::pjrt::PJRT_ErrorDeleter> error(
+      api->PJRT_LoadedExecutable_ExecuteBatch(&args),
+      ::pjrt::MakeErrorDeleter(api));
+  EXPECT_NE(error, nullptr);
+}
+
+// Launches a batch of tiny programs through the C API, either one
+// PJRT_LoadedExecutable_Execute call at a time or with a single
+// PJRT_LoadedExecutable_ExecuteBatch call.
+void BM_CApiLaunchOverhead(benchmark::State& state) {
+  const bool batched = state.range(0);
+  const int num_executions = state.range(1);
+  std::unique_ptr<PjRtCApiClient> client = CreateCApiClient();
+  auto executable = CompileAdd(*client, 1.0f).value();
+  auto x = ScalarBuffer(*client, 1.0f).value();
+  std::vector<std::vector<PjRtBuffer*>> arguments = {{x.get()}};
+  std::vector<PjRtCApiClient::BatchedExecution> executions(
+      num_executions, {executable.get(), arguments});
+
+  for (auto s : state) {
+    std::unique_ptr<PjRtBuffer> last_output;
+    if (batched) {
+      auto results =
+          client->ExecuteBatch(executions, ExecuteOptions(),
+                               /*fill_futures=*/false)
+              .value();
+      last_output = std::move((*results.back().outputs)[0][0]);
+    } else {
+      for (const auto& execution : executions) {
+        auto outputs = execution.executable
+                           ->Execute(execution.argument_handles,
+                                     ExecuteOptions())
+                           .value();
+        last_output = std::move(outputs[0][0]);
+      }
+    }
+    TF_CHECK_OK(last_output->GetReadyFuture().Await());
+  }
+  state.SetItemsProcessed(state.iterations() * num_executions);
+}
+BENCHMARK(BM_CApiLaunchOverhead)
+    ->ArgPair(false, 1)
+    ->ArgPair(true, 1)
+    ->ArgPair(false, 64)
+    ->ArgPair(true, 64);
+
 }  // namespace
 }  // namespace pjrt
 }  // namespace xla
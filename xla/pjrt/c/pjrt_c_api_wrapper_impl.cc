@@ -910,6 +910,36 @@ PJRT_Error* PJRT_LoadedExecutable_Execute(
   return nullptr;
 }
 
+PJRT_Error* PJRT_LoadedExecutable_ExecuteBatch(
+    PJRT_LoadedExecutable_ExecuteBatch_Args* args) {
+  PJRT_RETURN_IF_ERROR(CheckMatchingStructSizes(
+      "PJRT_LoadedExecutable_ExecuteBatch_Args",
+      PJRT_LoadedExecutable_ExecuteBatch_Args_STRUCT_SIZE, args->struct_size));
+  if (args->client == nullptr) {
+    return new PJRT_Error{xla::InvalidArgument(
+        "PJRT_LoadedExecutable_ExecuteBatch requires a client")};
+  }
+  if (args->num_executions > 0 &&
+      (args->executions == nullptr || args->errors == nullptr)) {
+    return new PJRT_Error{xla::InvalidArgument(
+        "PJRT_LoadedExecutable_ExecuteBatch requires `executions` and "
+        "`errors` for %d executions",
+        args->num_executions)};
+  }
+  for (size_t i = 0; i < args->num_executions; ++i) {
+    const PJRT_LoadedExecutable* executable = args->executions[i].executable;
+    if (executable == nullptr || executable->client != args->client) {
+      args->errors[i] = new PJRT_Error{xla::InvalidArgument(
+          "Execution %d of PJRT_LoadedExecutable_ExecuteBatch does not have "
+          "an executable of the calling client",
+          i)};
+      continue;
+    }
+    args->errors[i] = PJRT_LoadedExecutable_Execute(&args->executions[i]);
+  }
+  return nullptr;
+}
+
 PJRT_Error* PJRT_Executable_Serialize(PJRT_Executable_Serialize_Args* args) {
   PJRT_RETURN_IF_ERROR(CheckMatchingStructSizes(
       "PJRT_Executable_Serialize_Args",
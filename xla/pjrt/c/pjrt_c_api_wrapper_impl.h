@@ -186,6 +186,8 @@ PJRT_Error* PJRT_LoadedExecutable_IsDeleted(
     PJRT_LoadedExecutable_IsDeleted_Args* args);
 PJRT_Error* PJRT_LoadedExecutable_Execute(
     PJRT_LoadedExecutable_Execute_Args* args);
+PJRT_Error* PJRT_LoadedExecutable_ExecuteBatch(
+    PJRT_LoadedExecutable_ExecuteBatch_Args* args);
 PJRT_Error* PJRT_Executable_DeserializeAndLoad(
     PJRT_Executable_DeserializeAndLoad_Args* args);
 PJRT_Error* PJRT_LoadedExecutable_GetExecutable(
@@ -354,6 +356,9 @@ constexpr PJRT_Api CreatePjrtApi(
           pjrt::PJRT_DeviceTopology_PlatformVersion,
 
       .PJRT_Compile = pjrt::PJRT_Compile,
+
+      .PJRT_LoadedExecutable_ExecuteBatch =
+          pjrt::PJRT_LoadedExecutable_ExecuteBatch,
   };
 }
 
@@ -17,6 +17,7 @@ limitations under the License.
 
 #include <algorithm>
 #include <chrono>  // NOLINT
+#include <functional>
 #include <memory>
 #include <optional>
 #include <random>
@@ -24,11 +25,15 @@ limitations under the License.
 #include <utility>
 #include <vector>
 
+#include "absl/strings/str_cat.h"
+#include "absl/strings/string_view.h"
 #include "absl/synchronization/mutex.h"
 #include "absl/synchronization/notification.h"
 #include "absl/time/time.h"
+#include "absl/types/span.h"
 #include "grpcpp/channel.h"
 #include "xla/pjrt/distributed/protocol.h"
+#include "xla/pjrt/distributed/topology_util.h"
 #include "xla/pjrt/distributed/util.h"
 #include "xla/util.h"
 #include "tsl/distributed_runtime/coordination/coordination_client.h"
@@ -41,6 +46,38 @@ limitations under the License.
 #include "tsl/protobuf/coordination_service.pb.h"
 
 namespace xla {
+namespace {
+
+// Sets the value of `entry`, compressed if that makes it smaller.
+void SetEntryValue(std::string value, KeyValueEntryProto* entry) {
+  std::string compressed;
+  if (CompressKeyValue(value, &compressed)) {
+    entry->set_value(std::move(compressed));
+    entry->set_compressed(true);
+  } else {
+    entry->set_value(std::move(value));
+  }
+}
+
+// Values of the barrier release entry of WaitAtBarrier() in tree mode.
+constexpr absl::string_view kBarrierPassed = "passed";
+constexpr absl::string_view kBarrierTimedOut = "timed out";
+
+bool IsTimeout(const xla::Status& status) {
+  return status.code() == tsl::error::DEADLINE_EXCEEDED ||
+         status.code() == tsl::error::NOT_FOUND;
+}
+
+// Moves the value out of `entry`, decompressing it if needed.
+xla::StatusOr<std::string> TakeEntryValue(KeyValueEntryProto* entry) {
+  if (entry->compressed()) {
+    return DecompressKeyValue(entry->value());
+  }
+  return std::move(*entry->mutable_value());
+}
+
+}  // namespace
+
 class DistributedRuntimeClientImpl : public DistributedRuntimeClient {
  public:
   DistributedRuntimeClientImpl(std::shared_ptr<::grpc::Channel> channel,
@@ -59,6 +96,14 @@ class DistributedRuntimeClientImpl : public DistributedRuntimeClient {
   xla::StatusOr<std::vector<std::pair<std::string, std::string>>>
   KeyValueDirGet(absl::string_view key) override;
   xla::Status KeyValueSet(std::string key, std::string value) override;
+  xla::StatusOr<std::vector<std::string>> KeyValueMultiGet(
+      absl::Span<const std::string> keys, absl::Duration timeout) override;
+  xla::Status KeyValueMultiSet(
+      absl::Span<const std::pair<std::string, std::string>> kvs) override;
+  xla::Status KeyValueDirWatch(
+      absl::string_view directory, int num_keys, absl::Duration timeout,
+      std::function<void(absl::string_view key, absl::string_view value)>
+          callback) override;
   xla::Status KeyValueDelete(std::string key) override;
   xla::Status WaitAtBarrier(std::string barrier_id,
                             absl::Duration timeout) override;
@@ -69,6 +114,13 @@ class DistributedRuntimeClientImpl : public DistributedRuntimeClient {
   // Entry point for the heartbeat thread.
   void HeartbeatLoop();
 
+  // EnumerateDevices() and WaitAtBarrier() for a `topology_tree_fanout`
+  // greater than one.
+  xla::Status TreeEnumerateDevices(const LocalTopologyProto& local_topology,
+                                   GlobalTopologyProto* global_topology);
+  xla::Status TreeWaitAtBarrier(const std::string& barrier_id,
+                                absl::Duration timeout);
+
   const std::unique_ptr<grpc::DistributedRuntimeService::Stub> stub_;
   const DistributedRuntimeClient::Options options_;
 
@@ -103,6 +155,9 @@ class DistributedRuntimeClientImpl : public DistributedRuntimeClient {
   // A unique session ID, assigned by the server during Connect().
   uint64_t session_id_;
 
+  // Number of nodes in the job, reported by the server during Connect().
+  int num_nodes_ = 0;
+
   // Notification that tells the heartbeat thread to stop running.
   absl::Notification stop_heartbeats_;
 
@@ -129,6 +184,14 @@ class DistributedRuntimeCoordinationServiceClient
   xla::StatusOr<std::vector<std::pair<std::string, std::string>>>
   KeyValueDirGet(absl::string_view key) override;
   xla::Status KeyValueSet(std::string key, std::string value) override;
+  xla::StatusOr<std::vector<std::string>> KeyValueMultiGet(
+      absl::Span<const std::string> keys, absl::Duration timeout) override;
+  xla::Status KeyValueMultiSet(
+      absl::Span<const std::pair<std::string, std::string>> kvs) override;
+  xla::Status KeyValueDirWatch(
+      absl::string_view directory, int num_keys, absl::Duration timeout,
+      std::function<void(absl::string_view key, absl::string_view value)>
+          callback) override;
   xla::Status KeyValueDelete(std::string key) override;
   xla::Status WaitAtBarrier(std::string barrier_id,
                             absl::Duration timeout) override;
@@ -237,6 +300,7 @@ xla::Status DistributedRuntimeClientImpl::Connect() {
     state_ = State::kConnected;
   }
   session_id_ = response.session_id();
+  num_nodes_ = response.num_nodes();
 
   heartbeat_thread_.reset(options_.env->StartThread(
       tsl::ThreadOptions(), "pjrt_distributed_heartbeat",
@@ -255,6 +319,9 @@ xla::Status DistributedRuntimeClientImpl::EnumerateDevices(
           "EnumerateDevices() called when client not connected.");
     }
   }
+  if (options_.topology_tree_fanout > 1) {
+    return TreeEnumerateDevices(local_topology, global_topology);
+  }
   ::grpc::ClientContext ctx;
   ctx.set_fail_fast(false);
   ctx.set_deadline(absl::ToChronoTime(absl::Now() + options_.rpc_timeout));
@@ -354,6 +421,111 @@ xla::Status DistributedRuntimeClientImpl::KeyValueSet(std::string key,
   return FromGrpcStatus(status);
 }
 
+xla::StatusOr<std::vector<std::string>>
+DistributedRuntimeClientImpl::KeyValueMultiGet(
+    absl::Span<const std::string> keys, absl::Duration timeout) {
+  {
+    absl::MutexLock lock(&mu_);
+    if (state_ != State::kConnected) {
+      return xla::FailedPrecondition(
+          "KeyValueMultiGet() called when client not connected.");
+    }
+  }
+  ::grpc::ClientContext ctx;
+  ctx.set_fail_fast(false);
+  ctx.set_deadline(absl::ToChronoTime(absl::Now() + timeout));
+  KeyValueMultiGetRequest request;
+  request.set_session_id(session_id_);
+  for (const std::string& key : keys) {
+    request.add_keys(key);
+  }
+  timeout = std::min(timeout, absl::Minutes(10));  // Avoid overflow
+  request.set_timeout_milliseconds(absl::ToInt64Milliseconds(timeout));
+  VLOG(10) << "KeyValueMultiGet: " << request.DebugString();
+  KeyValueMultiGetResponse response;
+  ::grpc::Status status = stub_->KeyValueMultiGet(&ctx, request, &response);
+  if (!status.ok()) {
+    return FromGrpcStatus(status);
+  }
+  std::vector<std::string> values;
+  values.reserve(response.entries_size());
+  for (KeyValueEntryProto& entry : *response.mutable_entries()) {
+    TF_ASSIGN_OR_RETURN(std::string value, TakeEntryValue(&entry));
+    values.push_back(std::move(value));
+  }
+  return values;
+}
+
+xla::Status DistributedRuntimeClientImpl::KeyValueMultiSet(
+    absl::Span<const std::pair<std::string, std::string>> kvs) {
+  {
+    absl::MutexLock lock(&mu_);
+    if (state_ != State::kConnected) {
+      return xla::FailedPrecondition(
+          "KeyValueMultiSet() called when client not connected.");
+    }
+  }
+  ::grpc::ClientContext ctx;
+  ctx.set_fail_fast(false);
+  ctx.set_deadline(absl::ToChronoTime(absl::Now() + options_.rpc_timeout));
+  KeyValueMultiSetRequest request;
+  request.set_session_id(session_id_);
+  for (const auto& [key, value] : kvs) {
+    KeyValueEntryProto* entry = request.add_entries();
+    entry->set_key(key);
+    SetEntryValue(value, entry);
+  }
+  VLOG(10) << "KeyValueMultiSet with " << request.entries_size() << " entries";
+  KeyValueMultiSetResponse response;
+  ::grpc::Status status = stub_->KeyValueMultiSet(&ctx, request, &response);
+  return FromGrpcStatus(status);
+}
+
+xla::Status DistributedRuntimeClientImpl::KeyValueDirWatch(
+    absl::string_view directory, int num_keys, absl::Duration timeout,
+    std::function<void(absl::string_view key, absl::string_view value)>
+        callback) {
+  {
+    absl::MutexLock lock(&mu_);
+    if (state_ != State::kConnected) {
+      return xla::FailedPrecondition(
+          "KeyValueDirWatch() called when client not connected.");
+    }
+  }
+  ::grpc::ClientContext ctx;
+  ctx.set_fail_fast(false);
+  // Set timeout to be at least 5 seconds so that there is time for service-side
+  // timeout logic to execute.
+  ctx.set_deadline(
+      absl::ToChronoTime(absl::Now() + std::max(timeout, absl::Seconds(5))));
+  KeyValueWatchRequest request;
+  request.set_session_id(session_id_);
+  request.set_directory(std::string(directory));
+  request.set_num_keys(num_keys);
+  timeout = std::min(timeout, absl::Minutes(10));  // Avoid overflow
+  request.set_timeout_milliseconds(absl::ToInt64Milliseconds(timeout));
+  VLOG(10) << "KeyValueDirWatch: " << request.DebugString();
+  std::unique_ptr<::grpc::ClientReader<KeyValueWatchResponse>> reader =
+      stub_->KeyValueWatch(&ctx, request);
+  KeyValueWatchResponse response;
+  xla::Status decode_status;
+  while (decode_status.ok() && reader->Read(&response)) {
+    for (KeyValueEntryProto& entry : *response.mutable_entries()) {
+      xla::StatusOr<std::string> value = TakeEntryValue(&entry);
+      if (!value.ok()) {
+        decode_status = value.status();
+        // Finish() waits for the stream to end, so end it early.
+        ctx.TryCancel();
+        break;
+      }
+      callback(entry.key(), *value);
+    }
+  }
+  ::grpc::Status status = reader->Finish();
+  TF_RETURN_IF_ERROR(decode_status);
+  return FromGrpcStatus(status);
+}
+
 xla::Status DistributedRuntimeClientImpl::WaitAtBarrier(
     std::string barrier_id, absl::Duration timeout) {
   {
@@ -363,6 +535,9 @@ xla::Status DistributedRuntimeClientImpl::WaitAtBarrier(
           "WaitAtBarrier() called when client not connected.");
     }
   }
+  if (options_.topology_tree_fanout > 1) {
+    return TreeWaitAtBarrier(barrier_id, timeout);
+  }
   ::grpc::ClientContext ctx;
   ctx.set_fail_fast(false);
   // Set timeout to be at least 5 seconds so that there is time for service-side
@@ -383,6 +558,125 @@ xla::Status DistributedRuntimeClientImpl::WaitAtBarrier(
   return FromGrpcStatus(status);
 }
 
+xla::Status DistributedRuntimeClientImpl::TreeEnumerateDevices(
+    const LocalTopologyProto& local_topology,
+    GlobalTopologyProto* global_topology) {
+  // Entries are scoped by the session, so that nodes cannot pick up those of a
+  // previous job.
+  const std::string prefix =
+      absl::StrCat("xla/topology_tree/", session_id_, "/");
+  const std::string global_key = absl::StrCat(prefix, "global");
+
+  // Collects the local topologies of the subtree rooted at this node.
+  GlobalTopologyProto subtree;
+  LocalTopologyProto* local = subtree.add_nodes();
+  *local = local_topology;
+  local->set_node_id(options_.node_id);
+  std::vector<std::string> child_keys;
+  for (int child : TopologyTreeChildren(options_.node_id, num_nodes_,
+                                        options_.topology_tree_fanout)) {
+    child_keys.push_back(absl::StrCat(prefix, "subtree/", child));
+  }
+  if (!child_keys.empty()) {
+    TF_ASSIGN_OR_RETURN(std::vector<std::string> child_subtrees,
+                        KeyValueMultiGet(child_keys, options_.rpc_timeout));
+    for (const std::string& serialized : child_subtrees) {
+      GlobalTopologyProto child_subtree;
+      if (!child_subtree.ParseFromString(serialized)) {
+        return xla::Internal("Failed to parse the topology of a subtree.");
+      }
+      for (LocalTopologyProto& node : *child_subtree.mutable_nodes()) {
+        subtree.add_nodes()->Swap(&node);
+      }
+    }
+  }
+
+  if (options_.node_id != 0) {
+    TF_RETURN_IF_ERROR(KeyValueMultiSet(
+        {{absl::StrCat(prefix, "subtree/", options_.node_id),
+          subtree.SerializeAsString()}}));
+    TF_ASSIGN_OR_RETURN(std::vector<std::string> global,
+                        KeyValueMultiGet({global_key}, options_.rpc_timeout));
+    global_topology->Clear();
+    if (!global_topology->ParseFromString(global.front())) {
+      return xla::Internal("Failed to parse the global topology.");
+    }
+    return OkStatus();
+  }
+
+  // Orders the nodes by ID, as the service does.
+  std::vector<LocalTopologyProto> local_topologies(num_nodes_);
+  for (LocalTopologyProto& node : *subtree.mutable_nodes()) {
+    if (node.node_id() < 0 || node.node_id() >= num_nodes_) {
+      return xla::Internal("Invalid node ID %d in the topology tree",
+                           node.node_id());
+    }
+    local_topologies[node.node_id()].Swap(&node);
+  }
+  if (subtree.nodes_size() != num_nodes_) {
+    return xla::Internal("Topology tree has %d nodes, expected %d",
+                         subtree.nodes_size(), num_nodes_);
+  }
+  global_topology->Clear();
+  BuildGlobalTopology(absl::MakeSpan(local_topologies), global_topology);
+  VLOG(10) << "EnumerateDevices() global topology: "
+           << global_topology->DebugString();
+  return KeyValueMultiSet({{global_key, global_topology->SerializeAsString()}});
+}
+
+xla::Status DistributedRuntimeClientImpl::TreeWaitAtBarrier(
+    const std::string& barrier_id, absl::Duration timeout) {
+  absl::Time deadline = absl::Now() + timeout;
+  // Unlike the service, this does not detect reused barrier IDs: a reused
+  // barrier passes immediately.
+  const std::string prefix =
+      absl::StrCat("xla/barrier_tree/", session_id_, "/", barrier_id, "/");
+  const std::string release_key = absl::StrCat(prefix, "release");
+  auto timed_out = [&]() {
+    return tsl::errors::DeadlineExceeded(
+        "Timed out after ", absl::FormatDuration(timeout),
+        " waiting for all nodes to be at WaitAtBarrier()");
+  };
+
+  std::vector<std::string> child_keys;
+  for (int child : TopologyTreeChildren(options_.node_id, num_nodes_,
+                                        options_.topology_tree_fanout)) {
+    child_keys.push_back(absl::StrCat(prefix, child));
+  }
+  if (!child_keys.empty()) {
+    xla::StatusOr<std::vector<std::string>> arrivals =
+        KeyValueMultiGet(child_keys, timeout);
+    if (!arrivals.ok()) {
+      if (!IsTimeout(arrivals.status())) {
+        return arrivals.status();
+      }
+      // Releases the nodes that are already waiting with the error, rather
+      // than leaving them to time out on their own.
+      KeyValueMultiSet({{release_key, std::string(kBarrierTimedOut)}})
+          .IgnoreError();
+      return timed_out();
+    }
+  }
+  if (options_.node_id == 0) {
+    return KeyValueMultiSet({{release_key, std::string(kBarrierPassed)}});
+  }
+
+  TF_RETURN_IF_ERROR(
+      KeyValueMultiSet({{absl::StrCat(prefix, options_.node_id), ""}}));
+  xla::StatusOr<std::vector<std::string>> release = KeyValueMultiGet(
+      {release_key}, std::max(deadline - absl::Now(), absl::ZeroDuration()));
+  if (!release.ok()) {
+    if (!IsTimeout(release.status())) {
+      return release.status();
+    }
+    return timed_out();
+  }
+  if (release->front() != kBarrierPassed) {
+    return timed_out();
+  }
+  return OkStatus();
+}
+
 xla::StatusOr<std::vector<std::pair<std::string, std::string>>>
 DistributedRuntimeClientImpl::KeyValueDirGet(absl::string_view key) {
   return xla::Unimplemented(
@@ -574,6 +868,41 @@ xla::Status DistributedRuntimeCoordinationServiceClient::KeyValueSet(
   return coord_agent_->InsertKeyValue(key, value);
 }
 
+xla::StatusOr<std::vector<std::string>>
+DistributedRuntimeCoordinationServiceClient::KeyValueMultiGet(
+    absl::Span<const std::string> keys, absl::Duration timeout) {
+  // The coordination service has no batched lookup, so look up the keys one
+  // by one within the overall timeout.
+  const absl::Time deadline = absl::Now() + timeout;
+  std::vector<std::string> values;
+  values.reserve(keys.size());
+  for (const std::string& key : keys) {
+    TF_ASSIGN_OR_RETURN(
+        std::string value,
+        coord_agent_->GetKeyValue(
+            key, std::max(deadline - absl::Now(), absl::ZeroDuration())));
+    values.push_back(std::move(value));
+  }
+  return values;
+}
+
+xla::Status DistributedRuntimeCoordinationServiceClient::KeyValueMultiSet(
+    absl::Span<const std::pair<std::string, std::string>> kvs) {
+  for (const auto& [key, value] : kvs) {
+    TF_RETURN_IF_ERROR(coord_agent_->InsertKeyValue(key, value));
+  }
+  return OkStatus();
+}
+
+xla::Status DistributedRuntimeCoordinationServiceClient::KeyValueDirWatch(
+    absl::string_view directory, int num_keys, absl::Duration timeout,
+    std::function<void(absl::string_view key, absl::string_view value)>
+        callback) {
+  return xla::Unimplemented(
+      "KeyValueDirWatch() is unimplemented with the coordination service. "
+      "Disable coordination service to use this method.");
+}
+
 xla::Status DistributedRuntimeCoordinationServiceClient::WaitAtBarrier(
     std::string barrier_id, absl::Duration timeout) {
   return coord_agent_->WaitAtBarrier(barrier_id, timeout, /*tasks=*/{});
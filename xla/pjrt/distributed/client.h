@@ -22,7 +22,9 @@ limitations under the License.
 #include <utility>
 #include <vector>
 
+#include "absl/strings/string_view.h"
 #include "absl/time/time.h"
+#include "absl/types/span.h"
 #include "grpcpp/channel.h"
 #include "xla/pjrt/distributed/protocol.grpc.pb.h"
 #include "xla/statusor.h"
@@ -90,6 +92,17 @@ class DistributedRuntimeClient {
               }
             };
 
+    // If greater than one, EnumerateDevices() and WaitAtBarrier() aggregate
+    // the topologies and barrier arrivals of the nodes through a tree with
+    // this fan-out rooted at node 0, using the key-value store: each node waits
+    // for its children, publishes its subtree to its parent, and node 0
+    // builds the global topology or releases the barrier for everyone. The
+    // coordinator then only stores and hands out entries, instead of holding
+    // every node's RPC on a single condition and building the global topology
+    // while serving them. All nodes of a job must use the same fan-out.
+    // Only supported without the coordination service.
+    int topology_tree_fanout = 0;
+
     // For testing. Should the client explicitly Shutdown() on destruction?
     bool shutdown_on_destruction = true;
   };
@@ -131,6 +144,28 @@ class DistributedRuntimeClient {
 
   virtual xla::Status KeyValueSet(std::string key, std::string value) = 0;
 
+  // Looks up several keys with a single RPC. Blocks until all of them are
+  // present or the timeout expires, and returns their values in the order of
+  // `keys`.
+  virtual xla::StatusOr<std::vector<std::string>> KeyValueMultiGet(
+      absl::Span<const std::string> keys, absl::Duration timeout) = 0;
+
+  // Sets several key-value pairs with a single RPC. Large values are
+  // compressed on the wire.
+  virtual xla::Status KeyValueMultiSet(
+      absl::Span<const std::pair<std::string, std::string>> kvs) = 0;
+
+  // Watches a directory (key prefix): calls `callback` with each key-value pair
+  // under the directory, first with the pairs that are already present and
+  // then with the ones that are set as they arrive, until `num_keys` distinct
+  // keys were seen. Returns an error if that does not happen before `timeout`
+  // expires. The pairs are streamed by the service in batches, so that a node
+  // can collect the values published by all other nodes with a single RPC.
+  virtual xla::Status KeyValueDirWatch(
+      absl::string_view directory, int num_keys, absl::Duration timeout,
+      std::function<void(absl::string_view key, absl::string_view value)>
+          callback) = 0;
+
   // Delete the key-value. If the key is a directory, recursively clean
   // up all key-values under the directory.
   virtual xla::Status KeyValueDelete(std::string key) = 0;
@@ -13,11 +13,13 @@ See the License for the specific language governing permissions and
 limitations under the License.
 ==============================================================================*/
 
+#include <algorithm>
 #include <functional>
 #include <memory>
 #include <string>
 #include <vector>
 
+#include "absl/container/flat_hash_map.h"
 #include "absl/strings/str_cat.h"
 #include "absl/strings/string_view.h"
 #include "absl/synchronization/barrier.h"
@@ -29,15 +31,18 @@ limitations under the License.
 #include "xla/pjrt/distributed/client.h"
 #include "xla/pjrt/distributed/protocol.pb.h"
 #include "xla/pjrt/distributed/service.h"
+#include "xla/pjrt/distributed/topology_util.h"
 #include "xla/protobuf_util.h"
 #include "xla/status_macros.h"
 #include "tsl/lib/core/status_test_util.h"
 #include "tsl/platform/env.h"
 #include "tsl/platform/errors.h"
 #include "tsl/platform/test.h"
+#include "tsl/platform/test_benchmark.h"
 
 namespace xla {
 namespace {
+using ::testing::ElementsAre;
 using ::testing::IsEmpty;
 using ::testing::Pair;
 using ::testing::UnorderedElementsAre;
@@ -102,8 +107,8 @@ class ClientServerTest : public testing::TestWithParam<ServiceParams> {
   // Shut down the server.
   void Stop() {
     // Avoid shutting down the server twice if the test has already called
-    // Stop() earlier.
-    if (stop_is_already_called_) {
+    // Stop() earlier, or if it skipped or started its own server.
+    if (stop_is_already_called_ || server_ == nullptr) {
       return;
     }
     server_->Shutdown();
@@ -791,6 +796,336 @@ TEST_P(ClientServerTest, KeyValueDelete_Directory) {
   }
 }
 
+TEST_P(ClientServerTest, KeyValueMultiGetAndMultiSet) {
+  StartService(/*num_nodes=*/1, GetParam().use_coordination_service);
+  auto client = GetClient(/*node_id=*/0, GetParam().use_coordination_service);
+  TF_ASSERT_OK(client->Connect());
+  // Large enough to be compressed.
+  std::string large_value(4096, 'x');
+  TF_ASSERT_OK(
+      client->KeyValueMultiSet({{"small", "1"}, {"large", large_value}}));
+
+  TF_ASSERT_OK_AND_ASSIGN(
+      std::vector<std::string> values,
+      client->KeyValueMultiGet({"large", "small"}, absl::Seconds(1)));
+  EXPECT_THAT(values, ElementsAre(large_value, "1"));
+  // Single key lookups see the uncompressed values too.
+  TF_ASSERT_OK_AND_ASSIGN(
+      std::string value,
+      client->BlockingKeyValueGet("large", absl::Seconds(1)));
+  EXPECT_EQ(value, large_value);
+
+  auto missing =
+      client->KeyValueMultiGet({"small", "missing"}, absl::Milliseconds(200));
+  EXPECT_FALSE(missing.ok());
+}
+
+TEST_P(ClientServerTest, KeyValueDirWatch) {
+  StartService(/*num_nodes=*/1, GetParam().use_coordination_service);
+  auto client = GetClient(/*node_id=*/0, GetParam().use_coordination_service);
+  TF_ASSERT_OK(client->Connect());
+  TF_ASSERT_OK(client->KeyValueSet("test_dir/1", "1"));
+  TF_ASSERT_OK(client->KeyValueSet("test", "not in the directory"));
+
+  absl::flat_hash_map<std::string, std::string> kvs;
+  xla::Status status;
+  {
+    tsl::thread::ThreadPool thread_pool(tsl::Env::Default(), "test_threads",
+                                        /*num_threads=*/1);
+    thread_pool.Schedule([&]() {
+      status = client->KeyValueDirWatch(
+          "test_dir/", /*num_keys=*/2, absl::Seconds(10),
+          [&](absl::string_view key, absl::string_view value) {
+            kvs[key] = value;
+          });
+    });
+    // Set the second key while the watch is streaming.
+    absl::SleepFor(absl::Milliseconds(200));
+    TF_ASSERT_OK(client->KeyValueSet("test_dir/2", "2"));
+  }
+
+  if (GetParam().use_coordination_service) {
+    EXPECT_EQ(status.code(), tsl::error::UNIMPLEMENTED);
+  } else {
+    TF_ASSERT_OK(status);
+    EXPECT_THAT(kvs, UnorderedElementsAre(Pair("test_dir/1", "1"),
+                                          Pair("test_dir/2", "2")));
+  }
+}
+
+// Runs the topology and NCCL id exchange of many hosts against the service:
+// every node publishes its values with one RPC, and collects the values of all
+// other nodes with one watch and one multi-key lookup.
+TEST_P(ClientServerTest, KeyValueExchangeLoadTest) {
+  if (GetParam().use_coordination_service) {
+    GTEST_SKIP() << "KeyValueDirWatch() requires the distributed runtime "
+                    "service";
+  }
+  const int num_nodes = 64;
+  StartService(num_nodes, GetParam().use_coordination_service);
+
+  auto topology = [](int node_id) {
+    return absl::StrCat("topology of node ", node_id, ": ",
+                        std::string(2048, 'a' + node_id % 26));
+  };
+  auto thread_fn = [&](int node_id) -> xla::Status {
+    auto client = GetClient(node_id, GetParam().use_coordination_service);
+    TF_RETURN_IF_ERROR(client->Connect());
+    TF_RETURN_IF_ERROR(client->KeyValueMultiSet(
+        {{absl::StrCat("topology/", node_id), topology(node_id)},
+         {absl::StrCat("nccl_id/", node_id), absl::StrCat("id", node_id)}}));
+
+    absl::flat_hash_map<std::string, std::string> topologies;
+    TF_RETURN_IF_ERROR(client->KeyValueDirWatch(
+        "topology/", num_nodes, absl::Seconds(60),
+        [&](absl::string_view key, absl::string_view value) {
+          topologies[key] = value;
+        }));
+    TF_RET_CHECK(topologies.size() == static_cast<size_t>(num_nodes));
+    std::vector<std::string> nccl_id_keys;
+    for (int i = 0; i < num_nodes; ++i) {
+      TF_RET_CHECK(topologies[absl::StrCat("topology/", i)] == topology(i));
+      nccl_id_keys.push_back(absl::StrCat("nccl_id/", i));
+    }
+    TF_ASSIGN_OR_RETURN(
+        std::vector<std::string> nccl_ids,
+        client->KeyValueMultiGet(nccl_id_keys, absl::Seconds(60)));
+    for (int i = 0; i < num_nodes; ++i) {
+      TF_RET_CHECK(nccl_ids[i] == absl::StrCat("id", i));
+    }
+    return client->Shutdown();
+  };
+
+  std::vector<xla::Status> statuses(num_nodes);
+  {
+    tsl::thread::ThreadPool thread_pool(tsl::Env::Default(), "test_threads",
+                                        num_nodes);
+    for (int i = 0; i < num_nodes; ++i) {
+      thread_pool.Schedule([&, i]() { statuses[i] = thread_fn(i); });
+    }
+  }
+  for (int i = 0; i < num_nodes; ++i) {
+    TF_EXPECT_OK(statuses[i]) << " node id: " << i;
+  }
+}
+
+TEST_P(ClientServerTest, TopologyTreeEnumerateDevicesAndBarrier) {
+  if (GetParam().use_coordination_service) {
+    GTEST_SKIP() << "The topology tree requires the distributed runtime "
+                    "service";
+  }
+  const int num_nodes = 10;
+  StartService(num_nodes, GetParam().use_coordination_service);
+
+  std::vector<LocalTopologyProto> locals(num_nodes);
+  for (int i = 0; i < num_nodes; ++i) {
+    locals[i].set_node_id(i);
+    // Two nodes per host.
+    locals[i].set_boot_id(absl::StrCat("host", i / 2));
+    locals[i].add_devices()->set_local_device_ordinal(0);
+    locals[i].add_devices()->set_local_device_ordinal(1);
+  }
+  GlobalTopologyProto expected_topology;
+  {
+    std::vector<LocalTopologyProto> copies = locals;
+    BuildGlobalTopology(absl::Span<LocalTopologyProto>(copies),
+                        &expected_topology);
+  }
+
+  auto thread_fn = [&](int node_id) -> xla::Status {
+    DistributedRuntimeClient::Options client_options;
+    client_options.topology_tree_fanout = 3;
+    auto client = GetClient(node_id, GetParam().use_coordination_service,
+                            client_options);
+    TF_RETURN_IF_ERROR(client->Connect());
+    GlobalTopologyProto topology;
+    TF_RETURN_IF_ERROR(client->EnumerateDevices(locals[node_id], &topology));
+    TF_RET_CHECK(
+        xla::protobuf_util::ProtobufEquals(topology, expected_topology))
+        << topology.DebugString();
+    TF_RETURN_IF_ERROR(client->WaitAtBarrier("barrier", absl::Seconds(10)));
+    return client->Shutdown();
+  };
+
+  std::vector<xla::Status> statuses(num_nodes);
+  {
+    tsl::thread::ThreadPool thread_pool(tsl::Env::Default(), "test_threads",
+                                        num_nodes);
+    for (int i = 0; i < num_nodes; ++i) {
+      thread_pool.Schedule([&, i]() { statuses[i] = thread_fn(i); });
+    }
+  }
+  for (int i = 0; i < num_nodes; ++i) {
+    TF_EXPECT_OK(statuses[i]) << " node id: " << i;
+  }
+}
+
+TEST_P(ClientServerTest, TopologyTreeBarrierTimeout) {
+  if (GetParam().use_coordination_service) {
+    GTEST_SKIP() << "The topology tree requires the distributed runtime "
+                    "service";
+  }
+  // Node 3 is the only child of node 1, whose timeout releases node 2 before
+  // its own timeout expires.
+  const int num_nodes = 4;
+  StartService(num_nodes, GetParam().use_coordination_service);
+
+  auto thread_fn = [&](int node_id) -> xla::Status {
+    DistributedRuntimeClient::Options client_options;
+    client_options.topology_tree_fanout = 2;
+    client_options.shutdown_on_destruction = false;
+    auto client = GetClient(node_id, GetParam().use_coordination_service,
+                            client_options);
+    TF_RETURN_IF_ERROR(client->Connect());
+    if (node_id == 3) {
+      return OkStatus();
+    }
+    absl::Duration timeout = node_id == 2 ? absl::Seconds(60) : kBarrierTimeout;
+    return client->WaitAtBarrier("barrier", timeout);
+  };
+
+  std::vector<xla::Status> statuses(num_nodes);
+  {
+    tsl::thread::ThreadPool thread_pool(tsl::Env::Default(), "test_threads",
+                                        num_nodes);
+    for (int i = 0; i < num_nodes; ++i) {
+      thread_pool.Schedule([&, i]() { statuses[i] = thread_fn(i); });
+    }
+  }
+  for (int i = 0; i < num_nodes - 1; ++i) {
+    EXPECT_EQ(statuses[i].code(), tsl::error::DEADLINE_EXCEEDED)
+        << " node id: " << i;
+  }
+  TF_EXPECT_OK(statuses[num_nodes - 1]);
+}
+
+// Starts `num_nodes` in-process clients of a new distributed runtime service,
+// which exchange their topologies with the given topology tree fan-out (0 for
+// none) and pass a barrier. Stores the topology that each node got in
+// `topologies` and returns the time from when all nodes were connected until
+// the last one passed the barrier.
+xla::StatusOr<absl::Duration> ExchangeTopologies(
+    int num_nodes, int num_devices_per_node, int fanout,
+    std::vector<GlobalTopologyProto>* topologies) {
+  topologies->assign(num_nodes, GlobalTopologyProto());
+  DistributedRuntimeServiceImpl::Options service_options;
+  service_options.num_nodes = num_nodes;
+  service_options.heartbeat_interval = kHeartbeatInterval;
+  service_options.max_missing_heartbeats = kMaxMissingHeartbeats;
+  DistributedRuntimeServiceImpl service(service_options);
+  ::grpc::ServerBuilder builder;
+  builder.RegisterService(&service);
+  std::unique_ptr<::grpc::Server> server = builder.BuildAndStart();
+
+  absl::Barrier connected(num_nodes);
+  absl::Mutex mu;
+  absl::Time start;
+  absl::Time end = absl::InfinitePast();
+  auto thread_fn = [&](int node_id) -> xla::Status {
+    DistributedRuntimeClient::Options client_options;
+    client_options.node_id = node_id;
+    client_options.heartbeat_interval = kHeartbeatInterval;
+    client_options.max_missing_heartbeats = kMaxMissingHeartbeats;
+    client_options.topology_tree_fanout = fanout;
+    auto client = GetDistributedRuntimeClient(
+        server->InProcessChannel(::grpc::ChannelArguments()), client_options,
+        /*use_coordination_service=*/false);
+    TF_RETURN_IF_ERROR(client->Connect());
+    if (connected.Block()) {
+      absl::MutexLock lock(&mu);
+      start = absl::Now();
+    }
+    LocalTopologyProto local;
+    local.set_node_id(node_id);
+    local.set_boot_id(absl::StrCat("host", node_id));
+    for (int i = 0; i < num_devices_per_node; ++i) {
+      local.add_devices()->set_local_device_ordinal(i);
+    }
+    GlobalTopologyProto& topology = (*topologies)[node_id];
+    TF_RETURN_IF_ERROR(client->EnumerateDevices(local, &topology));
+    TF_RET_CHECK(topology.nodes_size() == num_nodes);
+    TF_RETURN_IF_ERROR(client->WaitAtBarrier("barrier", absl::Seconds(60)));
+    {
+      absl::MutexLock lock(&mu);
+      end = std::max(end, absl::Now());
+    }
+    return client->Shutdown();
+  };
+
+  std::vector<xla::Status> statuses(num_nodes);
+  {
+    tsl::thread::ThreadPool thread_pool(tsl::Env::Default(), "test_threads",
+                                        num_nodes);
+    for (int i = 0; i < num_nodes; ++i) {
+      thread_pool.Schedule([&, i]() { statuses[i] = thread_fn(i); });
+    }
+  }
+  server->Shutdown();
+  for (const xla::Status& status : statuses) {
+    TF_RETURN_IF_ERROR(status);
+  }
+  return end - start;
+}
+
+// Checks that many in-process clients see the same global topology with and
+// without the topology tree.
+TEST_P(ClientServerTest, TopologyTreeManyNodes) {
+  if (GetParam().use_coordination_service) {
+    GTEST_SKIP() << "The topology tree requires the distributed runtime "
+                    "service";
+  }
+  const int num_nodes = 128;
+  const int num_devices_per_node = 8;
+
+  std::vector<GlobalTopologyProto> flat_topologies;
+  TF_ASSERT_OK(ExchangeTopologies(num_nodes, num_devices_per_node,
+                                  /*fanout=*/0, &flat_topologies)
+                   .status());
+  std::vector<GlobalTopologyProto> tree_topologies;
+  TF_ASSERT_OK(ExchangeTopologies(num_nodes, num_devices_per_node,
+                                  /*fanout=*/4, &tree_topologies)
+                   .status());
+  const GlobalTopologyProto& expected_topology = flat_topologies[0];
+  for (int node_id = 0; node_id < num_nodes; ++node_id) {
+    const LocalTopologyProto& node = expected_topology.nodes(node_id);
+    EXPECT_EQ(node.node_id(), node_id);
+    EXPECT_EQ(node.devices(0).global_device_id(),
+              node_id * num_devices_per_node);
+    EXPECT_TRUE(xla::protobuf_util::ProtobufEquals(flat_topologies[node_id],
+                                                   expected_topology))
+        << flat_topologies[node_id].DebugString();
+    EXPECT_TRUE(xla::protobuf_util::ProtobufEquals(tree_topologies[node_id],
+                                                   expected_topology))
+        << tree_topologies[node_id].DebugString();
+  }
+}
+
+// Measures the time for all nodes to exchange their topologies and pass a
+// barrier, with args (number of nodes, topology tree fan-out). Connecting the
+// nodes is not measured: Connect() still goes through the coordinator alone.
+void BM_TopologyExchange(::testing::benchmark::State& state) {
+  const int num_nodes = state.range(0);
+  const int fanout = state.range(1);
+  std::vector<GlobalTopologyProto> topologies;
+  for (auto s : state) {
+    absl::Duration time =
+        ExchangeTopologies(num_nodes, /*num_devices_per_node=*/8, fanout,
+                           &topologies)
+            .value();
+    state.SetIterationTime(absl::ToDoubleSeconds(time));
+  }
+}
+BENCHMARK(BM_TopologyExchange)
+    ->ArgPair(8, 0)
+    ->ArgPair(8, 4)
+    ->ArgPair(32, 0)
+    ->ArgPair(32, 4)
+    ->ArgPair(128, 0)
+    ->ArgPair(128, 4)
+    ->ArgPair(512, 0)
+    ->ArgPair(512, 4)
+    ->UseManualTime();
+
 INSTANTIATE_TEST_SUITE_P(
     ClientServerTests, ClientServerTest,
     ::testing::ValuesIn<ServiceParams>({
@@ -0,0 +1,62 @@
+/* Copyright 2023 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "xla/pjrt/distributed/cross_host_descriptors.h"
+
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "absl/strings/str_cat.h"
+#include "xla/util.h"
+#include "tsl/platform/env.h"
+
+namespace xla {
+
+static std::string DescriptorKey(absl::string_view key, int64_t index) {
+  return absl::StrCat(key, "/", index);
+}
+
+Status PublishCrossHostRecvDescriptors(
+    DistributedRuntimeClient& client, absl::string_view key,
+    absl::Span<const PjRtCrossHostRecvDescriptors> descriptors) {
+  std::vector<std::pair<std::string, std::string>> kvs;
+  kvs.reserve(descriptors.size());
+  for (int64_t i = 0; i < descriptors.size(); ++i) {
+    if (descriptors[i].serialized_descriptors.size() != 1) {
+      return InvalidArgument(
+          "Buffer %d has %d cross-host receive descriptors, expected 1", i,
+          descriptors[i].serialized_descriptors.size());
+    }
+    kvs.emplace_back(DescriptorKey(key, i),
+                     descriptors[i].serialized_descriptors[0]);
+  }
+  return client.KeyValueMultiSet(kvs);
+}
+
+PjRtFuture<StatusOr<std::string>> LookupCrossHostRecvDescriptor(
+    std::shared_ptr<DistributedRuntimeClient> client, absl::string_view key,
+    int64_t index, absl::Duration timeout) {
+  auto promise = PjRtFuture<StatusOr<std::string>>::CreatePromise();
+  tsl::Env::Default()->SchedClosure(
+      [client = std::move(client), key = DescriptorKey(key, index), timeout,
+       promise]() mutable {
+        promise.Set(client->BlockingKeyValueGet(key, timeout));
+      });
+  return PjRtFuture<StatusOr<std::string>>(std::move(promise));
+}
+
+}  // namespace xla
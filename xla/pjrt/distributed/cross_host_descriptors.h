@@ -0,0 +1,57 @@
+/* Copyright 2023 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef TENSORFLOW_COMPILER_XLA_PJRT_DISTRIBUTED_CROSS_HOST_DESCRIPTORS_H_
+#define TENSORFLOW_COMPILER_XLA_PJRT_DISTRIBUTED_CROSS_HOST_DESCRIPTORS_H_
+
+#include <cstdint>
+#include <memory>
+#include <string>
+
+#include "absl/strings/string_view.h"
+#include "absl/time/time.h"
+#include "absl/types/span.h"
+#include "xla/pjrt/distributed/client.h"
+#include "xla/pjrt/pjrt_client.h"
+#include "xla/pjrt/pjrt_future.h"
+#include "xla/status.h"
+#include "xla/statusor.h"
+
+namespace xla {
+
+// Helpers that exchange the descriptors of cross-host transfers through the
+// key-value store of the distributed runtime.
+//
+// The receiver publishes the descriptors returned to the notifier of
+// MakeCrossHostReceiveBuffers under `key`, and the sender passes the future
+// returned by LookupCrossHostRecvDescriptor to CopyToRemoteDevice, so that it
+// can enqueue the send before the receiver has made its buffers.
+
+// Publishes the descriptor of the i-th buffer under "<key>/<i>". Only
+// buffers with a single descriptor, i.e. not gathered ones, are supported.
+Status PublishCrossHostRecvDescriptors(
+    DistributedRuntimeClient& client, absl::string_view key,
+    absl::Span<const PjRtCrossHostRecvDescriptors> descriptors);
+
+// Returns a future for the descriptor of the `index`-th buffer published under
+// `key`. The lookup blocks a thread of its own until the descriptor is
+// published or `timeout` expires.
+PjRtFuture<StatusOr<std::string>> LookupCrossHostRecvDescriptor(
+    std::shared_ptr<DistributedRuntimeClient> client, absl::string_view key,
+    int64_t index, absl::Duration timeout);
+
+}  // namespace xla
+
+#endif  // TENSORFLOW_COMPILER_XLA_PJRT_DISTRIBUTED_CROSS_HOST_DESCRIPTORS_H_
@@ -0,0 +1,210 @@
+/* Copyright 2023 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "xla/pjrt/distributed/cross_host_descriptors.h"
+
+#include <cstdint>
+#include <cstdlib>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "absl/strings/numbers.h"
+#include "absl/strings/str_cat.h"
+#include "absl/time/time.h"
+#include "xla/literal_util.h"
+#include "xla/pjrt/distributed/client.h"
+#include "xla/pjrt/distributed/distributed.h"
+#include "xla/pjrt/distributed/service.h"
+#include "xla/pjrt/pjrt_client.h"
+#include "xla/pjrt/pjrt_future.h"
+#include "xla/pjrt/tfrt_cpu_pjrt_client.h"
+#include "xla/shape_util.h"
+#include "tsl/lib/core/status_test_util.h"
+#include "tsl/platform/env.h"
+#include "tsl/platform/subprocess.h"
+#include "tsl/platform/test.h"
+#include "tsl/platform/test_benchmark.h"
+
+namespace xla {
+namespace {
+
+constexpr absl::Duration kTimeout = absl::Seconds(60);
+
+// Environment variables that BM_CrossProcessTransfer passes to its sender.
+constexpr char kSenderPortEnv[] = "XLA_CROSS_PROCESS_TRANSFER_PORT";
+constexpr char kSenderBytesEnv[] = "XLA_CROSS_PROCESS_TRANSFER_BYTES";
+
+StatusOr<std::unique_ptr<DistributedRuntimeService>> StartService(
+    int port, int num_nodes) {
+  DistributedRuntimeServiceImpl::Options options;
+  options.num_nodes = num_nodes;
+  return GetDistributedRuntimeService(absl::StrCat("[::]:", port), options,
+                                      /*use_coordination_service=*/false);
+}
+
+std::shared_ptr<DistributedRuntimeClient> GetClient(int port, int node_id) {
+  DistributedRuntimeClient::Options options;
+  options.node_id = node_id;
+  return GetDistributedRuntimeClient(absl::StrCat("dns:///localhost:", port),
+                                     options,
+                                     /*use_coordination_service=*/false);
+}
+
+TEST(CrossHostDescriptorsTest, Transfer) {
+  int port = tsl::testing::PickUnusedPortOrDie();
+  TF_ASSERT_OK_AND_ASSIGN(auto service, StartService(port, /*num_nodes=*/1));
+  auto client = GetClient(port, /*node_id=*/0);
+  TF_ASSERT_OK(client->Connect());
+  TF_ASSERT_OK_AND_ASSIGN(auto src_client,
+                          GetTfrtCpuClient(/*asynchronous=*/true));
+  TF_ASSERT_OK_AND_ASSIGN(auto dst_client,
+                          GetTfrtCpuClient(/*asynchronous=*/true));
+
+  std::vector<float> data{1.0, 2.0, 3.0, 4.0};
+  Shape shape = ShapeUtil::MakeShape(F32, {4});
+  TF_ASSERT_OK_AND_ASSIGN(
+      auto src_buffer,
+      src_client->BufferFromHostBuffer(
+          data.data(), shape.element_type(), shape.dimensions(),
+          /*byte_strides=*/std::nullopt,
+          PjRtClient::HostBufferSemantics::kImmutableOnlyDuringCall, nullptr,
+          src_client->addressable_devices()[0]));
+
+  // The send is enqueued before the receive buffer exists.
+  auto send_status = PjRtFuture<Status>::CreatePromise();
+  src_buffer->CopyToRemoteDevice(
+      LookupCrossHostRecvDescriptor(client, "transfer", /*index=*/0, kTimeout),
+      [send_status](Status status, bool sends_were_enqueued) mutable {
+        send_status.Set(status);
+      });
+  TF_ASSERT_OK_AND_ASSIGN(
+      auto dst_buffers,
+      dst_client->MakeCrossHostReceiveBuffers(
+          {shape}, dst_client->addressable_devices()[0],
+          [&](StatusOr<PjRtCrossHostRecvState> state) {
+            TF_ASSERT_OK(state.status());
+            TF_ASSERT_OK(PublishCrossHostRecvDescriptors(*client, "transfer",
+                                                         state->descriptors));
+          }));
+
+  TF_ASSERT_OK(PjRtFuture<Status>(send_status).Await());
+  TF_ASSERT_OK_AND_ASSIGN(auto literal, dst_buffers[0]->ToLiteralSync());
+  EXPECT_EQ(*literal, LiteralUtil::CreateR1<float>(data));
+  TF_ASSERT_OK(client->Shutdown());
+}
+
+// Sending side of BM_CrossProcessTransfer, which runs it in a process of its
+// own.
+TEST(CrossHostDescriptorsTest, DISABLED_CrossProcessSender) {
+  const char* port = std::getenv(kSenderPortEnv);
+  const char* bytes = std::getenv(kSenderBytesEnv);
+  if (port == nullptr || bytes == nullptr) {
+    GTEST_SKIP() << "Only run by BM_CrossProcessTransfer";
+  }
+  int port_number;
+  int64_t num_bytes;
+  ASSERT_TRUE(absl::SimpleAtoi(port, &port_number));
+  ASSERT_TRUE(absl::SimpleAtoi(bytes, &num_bytes));
+
+  auto client = GetClient(port_number, /*node_id=*/1);
+  TF_ASSERT_OK(client->Connect());
+  TF_ASSERT_OK_AND_ASSIGN(auto cpu_client,
+                          GetTfrtCpuClient(/*asynchronous=*/true));
+  std::vector<uint8_t> data(num_bytes, 42);
+  Shape shape = ShapeUtil::MakeShape(U8, {num_bytes});
+  TF_ASSERT_OK_AND_ASSIGN(
+      auto buffer,
+      cpu_client->BufferFromHostBuffer(
+          data.data(), shape.element_type(), shape.dimensions(),
+          /*byte_strides=*/std::nullopt,
+          PjRtClient::HostBufferSemantics::kImmutableOnlyDuringCall, nullptr,
+          cpu_client->addressable_devices()[0]));
+
+  TF_ASSERT_OK_AND_ASSIGN(std::string iterations,
+                          client->BlockingKeyValueGet("iterations", kTimeout));
+  int64_t num_iterations;
+  ASSERT_TRUE(absl::SimpleAtoi(iterations, &num_iterations));
+  for (int64_t i = 0; i < num_iterations; ++i) {
+    auto send_status = PjRtFuture<Status>::CreatePromise();
+    buffer->CopyToRemoteDevice(
+        LookupCrossHostRecvDescriptor(client, absl::StrCat("transfer/", i),
+                                      /*index=*/0, kTimeout),
+        [send_status](Status status, bool sends_were_enqueued) mutable {
+          send_status.Set(status);
+        });
+    TF_ASSERT_OK(PjRtFuture<Status>(send_status).Await());
+  }
+  TF_ASSERT_OK(client->Shutdown());
+}
+
+// Measures the throughput of transfers between two CPU clients in different
+// processes, including the exchange of descriptors through the key-value
+// store. This process receives; the sender is a child process that runs
+// DISABLED_CrossProcessSender.
+void BM_CrossProcessTransfer(benchmark::State& state) {
+  const int64_t num_bytes = state.range(0);
+  const int port = tsl::testing::PickUnusedPortOrDie();
+  auto service = StartService(port, /*num_nodes=*/2).value();
+
+  setenv(kSenderPortEnv, absl::StrCat(port).c_str(), /*overwrite=*/1);
+  setenv(kSenderBytesEnv, absl::StrCat(num_bytes).c_str(), /*overwrite=*/1);
+  std::string binary = tsl::Env::Default()->GetExecutablePath();
+  tsl::SubProcess sender;
+  sender.SetProgram(
+      binary,
+      {binary, "--gtest_filter=CrossHostDescriptorsTest.DISABLED_*",
+       "--gtest_also_run_disabled_tests"});
+  sender.SetChannelAction(tsl::CHAN_STDOUT, tsl::ACTION_DUPPARENT);
+  sender.SetChannelAction(tsl::CHAN_STDERR, tsl::ACTION_DUPPARENT);
+  CHECK(sender.Start());
+
+  auto client = GetClient(port, /*node_id=*/0);
+  TF_CHECK_OK(client->Connect());
+  auto cpu_client = GetTfrtCpuClient(/*asynchronous=*/true).value();
+  PjRtDevice* device = cpu_client->addressable_devices()[0];
+  TF_CHECK_OK(
+      client->KeyValueSet("iterations", absl::StrCat(state.max_iterations)));
+
+  Shape shape = ShapeUtil::MakeShape(U8, {num_bytes});
+  int64_t i = 0;
+  for (auto s : state) {
+    auto buffers =
+        cpu_client
+            ->MakeCrossHostReceiveBuffers(
+                {shape}, device,
+                [&](StatusOr<PjRtCrossHostRecvState> recv_state) {
+                  TF_CHECK_OK(recv_state.status());
+                  TF_CHECK_OK(PublishCrossHostRecvDescriptors(
+                      *client, absl::StrCat("transfer/", i),
+                      recv_state->descriptors));
+                })
+            .value();
+    TF_CHECK_OK(buffers[0]->GetReadyFuture().Await());
+    ++i;
+  }
+  state.SetBytesProcessed(state.iterations() * num_bytes);
+
+  TF_CHECK_OK(client->Shutdown());
+  CHECK_EQ(sender.Communicate(nullptr, nullptr, nullptr), 0);
+}
+BENCHMARK(BM_CrossProcessTransfer)
+    ->Arg(4 << 10)
+    ->Arg(1 << 20)
+    ->Arg(64 << 20)
+    ->UseRealTime();
+
+}  // namespace
+}  // namespace xla
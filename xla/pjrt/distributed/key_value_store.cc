@@ -15,30 +15,136 @@ limitations under the License.
 
 #include "xla/pjrt/distributed/key_value_store.h"
 
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "absl/strings/match.h"
+
 namespace xla {
 
 KeyValueStore::KeyValueStore() = default;
 
 ::grpc::Status KeyValueStore::Get(const std::string& key,
-                                  absl::Duration timeout, std::string* value) {
-  auto key_is_present = [&]() {
-    mu_.AssertHeld();
-    return entries_.find(key) != entries_.end();
-  };
+                                  absl::Duration timeout, Value* value) {
+  std::vector<Value> values;
+  ::grpc::Status status = MultiGet({key}, timeout, &values);
+  if (status.ok()) {
+    *value = std::move(values.front());
+  }
+  return status;
+}
+
+::grpc::Status KeyValueStore::MultiGet(absl::Span<const std::string> keys,
+                                       absl::Duration timeout,
+                                       std::vector<Value>* values) {
+  absl::Time deadline = absl::Now() + timeout;
   absl::MutexLock lock(&mu_);
-  // TODO(phawkins): the synchronization here is very coarse, but probably
-  // sufficient for its current application.
-  if (!mu_.AwaitWithTimeout(absl::Condition(&key_is_present), timeout)) {
-    return ::grpc::Status(::grpc::StatusCode::NOT_FOUND, key);
+  for (const std::string& key : keys) {
+    while (!entries_.contains(key)) {
+      if (WaitLocked(key_waiters_, key, deadline) && !entries_.contains(key)) {
+        return ::grpc::Status(::grpc::StatusCode::NOT_FOUND, key);
+      }
+    }
+  }
+  values->clear();
+  values->reserve(keys.size());
+  for (const std::string& key : keys) {
+    values->push_back(entries_.find(key)->second.value);
   }
-  *value = entries_.find(key)->second;
   return ::grpc::Status::OK;
 }
 
-::grpc::Status KeyValueStore::Set(const std::string& key, std::string value) {
+::grpc::Status KeyValueStore::Set(const std::string& key, Value value) {
   absl::MutexLock lock(&mu_);
-  entries_[key] = std::move(value);
+  SetLocked(key, std::move(value));
   return ::grpc::Status::OK;
 }
 
+::grpc::Status KeyValueStore::MultiSet(
+    std::vector<std::pair<std::string, Value>> entries) {
+  absl::MutexLock lock(&mu_);
+  for (auto& [key, value] : entries) {
+    SetLocked(key, std::move(value));
+  }
+  return ::grpc::Status::OK;
+}
+
+::grpc::Status KeyValueStore::WaitForDirectoryUpdates(
+    absl::string_view directory, absl::Duration timeout, int64_t* version,
+    std::vector<std::pair<std::string, Value>>* entries) {
+  absl::Time deadline = absl::Now() + timeout;
+  absl::MutexLock lock(&mu_);
+  Directory& dir = GetOrCreateDirectoryLocked(std::string(directory));
+  while (true) {
+    auto it = dir.keys_by_version.upper_bound(*version);
+    if (it != dir.keys_by_version.end()) {
+      for (; it != dir.keys_by_version.end(); ++it) {
+        entries->emplace_back(it->second, entries_.at(it->second).value);
+      }
+      *version = dir.keys_by_version.rbegin()->first;
+      return ::grpc::Status::OK;
+    }
+    if (dir.cv.WaitWithDeadline(&mu_, deadline)) {
+      return ::grpc::Status::OK;
+    }
+  }
+}
+
+KeyValueStore::Directory& KeyValueStore::GetOrCreateDirectoryLocked(
+    const std::string& name) {
+  std::unique_ptr<Directory>& dir = directories_[name];
+  if (dir == nullptr) {
+    dir = std::make_unique<Directory>();
+    for (auto it = entries_.lower_bound(name);
+         it != entries_.end() && absl::StartsWith(it->first, name); ++it) {
+      dir->keys_by_version.emplace(it->second.version, it->first);
+    }
+    directory_lengths_.insert(name.size());
+  }
+  // Directories are never erased, so the reference outlives waits on `mu_`.
+  return *dir;
+}
+
+void KeyValueStore::SetLocked(const std::string& key, Value value) {
+  Entry& entry = entries_[key];
+  const int64_t old_version = entry.version;
+  entry.value = std::move(value);
+  entry.version = ++version_;
+  if (auto it = key_waiters_.find(key); it != key_waiters_.end()) {
+    it->second->cv.SignalAll();
+  }
+  for (size_t length : directory_lengths_) {
+    if (length > key.size()) {
+      continue;
+    }
+    auto it = directories_.find(absl::string_view(key).substr(0, length));
+    if (it == directories_.end()) {
+      continue;
+    }
+    Directory& dir = *it->second;
+    dir.keys_by_version.erase(old_version);
+    dir.keys_by_version.emplace(entry.version, key);
+    dir.cv.SignalAll();
+  }
+}
+
+bool KeyValueStore::WaitLocked(
+    absl::flat_hash_map<std::string, std::unique_ptr<Waiters>>& waiters,
+    const std::string& name, absl::Time deadline) {
+  std::unique_ptr<Waiters>& slot = waiters[name];
+  if (slot == nullptr) {
+    slot = std::make_unique<Waiters>();
+  }
+  // The map may rehash while we wait, but the Waiters object stays put.
+  Waiters* w = slot.get();
+  ++w->num_waiters;
+  bool timed_out = w->cv.WaitWithDeadline(&mu_, deadline);
+  if (--w->num_waiters == 0) {
+    waiters.erase(name);
+  }
+  return timed_out;
+}
+
 }  // namespace xla
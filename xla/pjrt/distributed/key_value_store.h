@@ -16,17 +16,38 @@ limitations under the License.
 #ifndef TENSORFLOW_COMPILER_XLA_PJRT_DISTRIBUTED_KEY_VALUE_STORE_H_
 #define TENSORFLOW_COMPILER_XLA_PJRT_DISTRIBUTED_KEY_VALUE_STORE_H_
 
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
 #include "absl/base/thread_annotations.h"
+#include "absl/container/btree_map.h"
 #include "absl/container/flat_hash_map.h"
+#include "absl/container/flat_hash_set.h"
+#include "absl/strings/string_view.h"
 #include "absl/synchronization/mutex.h"
 #include "absl/time/time.h"
+#include "absl/types/span.h"
 #include "grpcpp/grpcpp.h"
 
 namespace xla {
 
 // A simple blocking key-value store class.
+//
+// Getters wait on a condition variable per missing key and directory watchers
+// on one per watched directory, so that a Set() only wakes up the threads
+// that wait for the key it sets. Each watched directory keeps its keys ordered
+// by version, so that a watcher only visits the entries it has not seen yet.
 class KeyValueStore {
  public:
+  struct Value {
+    std::string data;
+    // Whether `data` is snappy compressed. The store does not interpret it.
+    bool compressed = false;
+  };
+
   KeyValueStore();
 
   KeyValueStore(const KeyValueStore&) = delete;
@@ -38,14 +59,79 @@ class KeyValueStore {
   // waits until `timeout` expires for the key to arrive. If the key does not
   // arrive by the expiry of `timeout`, returns NOT_FOUND.
   ::grpc::Status Get(const std::string& key, absl::Duration timeout,
-                     std::string* value);
+                     Value* value);
+
+  // Looks up all of `keys`, waiting until `timeout` expires for the missing
+  // ones to arrive, and returns their values in the same order. If a key does
+  // not arrive by the expiry of `timeout`, returns NOT_FOUND.
+  ::grpc::Status MultiGet(absl::Span<const std::string> keys,
+                          absl::Duration timeout, std::vector<Value>* values);
 
   // Replaces the value of `key` with `value`.
-  ::grpc::Status Set(const std::string& key, std::string value);
+  ::grpc::Status Set(const std::string& key, Value value);
+
+  // Replaces the values of all of `entries` at once.
+  ::grpc::Status MultiSet(std::vector<std::pair<std::string, Value>> entries);
+
+  // Appends to `entries` the entries whose keys are prefixed with `directory`
+  // and that were set after `*version`, and advances `*version` past them. A
+  // `*version` of 0 returns all entries of the directory. If there are none,
+  // waits until `timeout` expires for one to be set; returns OK with no
+  // entries if none is.
+  ::grpc::Status WaitForDirectoryUpdates(
+      absl::string_view directory, absl::Duration timeout, int64_t* version,
+      std::vector<std::pair<std::string, Value>>* entries);
 
  private:
+  struct Entry {
+    Value value;
+    // Value of version_ when the entry was last set.
+    int64_t version = 0;
+  };
+
+  // Threads waiting for a key to be set or for a directory to be updated.
+  struct Waiters {
+    absl::CondVar cv;
+    int num_waiters = 0;
+  };
+
+  // A directory that has been watched. Kept for the lifetime of the store, so
+  // that watchers that come back with a version find the keys set meanwhile.
+  struct Directory {
+    absl::CondVar cv;
+    // The keys of the directory, indexed by the version they were last set at.
+    absl::btree_map<int64_t, std::string> keys_by_version;
+  };
+
+  // Sets `key` and wakes up its waiters and the watchers of the directories
+  // that contain it.
+  void SetLocked(const std::string& key, Value value)
+      ABSL_EXCLUSIVE_LOCKS_REQUIRED(mu_);
+
+  // Waits on `waiters[name]` until it is signaled or `deadline` passes.
+  // Returns true if the deadline passed.
+  bool WaitLocked(
+      absl::flat_hash_map<std::string, std::unique_ptr<Waiters>>& waiters,
+      const std::string& name, absl::Time deadline)
+      ABSL_EXCLUSIVE_LOCKS_REQUIRED(mu_);
+
+  // Returns the watched directory `name`, indexing the keys it already holds
+  // when it is watched for the first time.
+  Directory& GetOrCreateDirectoryLocked(const std::string& name)
+      ABSL_EXCLUSIVE_LOCKS_REQUIRED(mu_);
+
   absl::Mutex mu_;
-  absl::flat_hash_map<std::string, std::string> entries_ ABSL_GUARDED_BY(mu_);
+  // Ordered, so that the entries of a directory can be found by a range scan.
+  absl::btree_map<std::string, Entry> entries_ ABSL_GUARDED_BY(mu_);
+  // Incremented by every Set().
+  int64_t version_ ABSL_GUARDED_BY(mu_) = 0;
+  absl::flat_hash_map<std::string, std::unique_ptr<Waiters>> key_waiters_
+      ABSL_GUARDED_BY(mu_);
+  absl::flat_hash_map<std::string, std::unique_ptr<Directory>> directories_
+      ABSL_GUARDED_BY(mu_);
+  // The distinct lengths of the names in `directories_`, so that SetLocked()
+  // only looks up the prefixes of a key that may name a watched directory.
+  absl::flat_hash_set<size_t> directory_lengths_ ABSL_GUARDED_BY(mu_);
 };
 
 }  // namespace xla
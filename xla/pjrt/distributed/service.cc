@@ -15,14 +15,19 @@ limitations under the License.
 
 #include "xla/pjrt/distributed/service.h"
 
+#include <algorithm>
 #include <memory>
 #include <string>
+#include <utility>
+#include <vector>
 
 #include "absl/container/flat_hash_map.h"
+#include "absl/container/flat_hash_set.h"
 #include "absl/strings/string_view.h"
 #include "absl/time/time.h"
 #include "grpcpp/server_builder.h"
 #include "xla/pjrt/distributed/protocol.h"
+#include "xla/pjrt/distributed/topology_util.h"
 #include "xla/pjrt/distributed/util.h"
 #include "xla/status.h"
 #include "xla/util.h"
@@ -120,36 +125,6 @@ DistributedRuntimeServiceImpl::~DistributedRuntimeServiceImpl() {
   }
 }
 
-// Steals the contents of `local_topologies`.
-void BuildGlobalTopology(absl::Span<LocalTopologyProto> local_topologies,
-                         GlobalTopologyProto* global_topology) {
-  int next_global_device_id = 0;
-  // Assign local devices of the same host to the same slice_index.
-  int next_slice_index = 0;
-  absl::flat_hash_map<std::string, int> boot_id_to_slice_index;
-  for (LocalTopologyProto& local : local_topologies) {
-    // Every new boot_id seen is treated as a new host/slice.
-    absl::string_view boot_id = local.boot_id();
-    auto [it, inserted] =
-        boot_id_to_slice_index.try_emplace(boot_id, next_slice_index);
-    if (inserted) {
-      ++next_slice_index;
-    }
-    for (DeviceProto& device : *local.mutable_devices()) {
-      device.set_global_device_id(next_global_device_id++);
-      device.set_slice_index(it->second);
-    }
-    global_topology->add_nodes()->Swap(&local);
-  }
-  if (VLOG_IS_ON(10)) {
-    for (auto it = boot_id_to_slice_index.begin();
-         it != boot_id_to_slice_index.end(); ++it) {
-      LOG(INFO) << "BuildGlobalTopology boot_id_to_slice_index " << it->first
-                << "->" << it->second;
-    }
-  }
-}
-
 xla::Status DistributedRuntimeServiceImpl::ValidateNodeId(int node_id) {
   if (node_id < 0) {
     return xla::InvalidArgument("Invalid node ID %d, must be non-negative",
@@ -245,6 +220,7 @@ xla::Status DistributedRuntimeServiceImpl::ValidateSessionId(
   }
   nodes_[node_id].last_heartbeat = absl::Now();
   response->set_session_id(session_id_);
+  response->set_num_nodes(options_.num_nodes);
   return ::grpc::Status::OK;
 }
 
@@ -419,9 +395,24 @@ void DistributedRuntimeServiceImpl::HeartbeatLoop() {
           "KeyValueGet() called when system is not running."));
     }
   }
-  return key_value_store_.Get(
+  KeyValueStore::Value value;
+  ::grpc::Status grpc_status = key_value_store_.Get(
       request->key(), absl::Milliseconds(request->timeout_milliseconds()),
-      response->mutable_value());
+      &value);
+  if (!grpc_status.ok()) {
+    return grpc_status;
+  }
+  // Values set by KeyValueMultiSet() may be compressed, which clients of this
+  // RPC do not expect.
+  if (value.compressed) {
+    StatusOr<std::string> decompressed = DecompressKeyValue(value.data);
+    if (!decompressed.ok()) {
+      return xla::ToGrpcStatus(decompressed.status());
+    }
+    value.data = *std::move(decompressed);
+  }
+  response->set_value(std::move(value.data));
+  return ::grpc::Status::OK;
 }
 
 ::grpc::Status DistributedRuntimeServiceImpl::KeyValueSet(
@@ -443,7 +434,137 @@ void DistributedRuntimeServiceImpl::HeartbeatLoop() {
           "Connect() first"));
     }
   }
-  return key_value_store_.Set(request->key(), request->value());
+  return key_value_store_.Set(request->key(),
+                              KeyValueStore::Value{request->value()});
+}
+
+xla::Status DistributedRuntimeServiceImpl::CheckRunning(
+    absl::string_view method) {
+  absl::MutexLock lock(&mu_);
+  if (state_ != State::kRunning) {
+    if (!service_status_.ok()) {
+      return service_status_;
+    }
+    return xla::FailedPrecondition(
+        "%s() called when system is not running; clients must call Connect() "
+        "first",
+        method);
+  }
+  return xla::OkStatus();
+}
+
+::grpc::Status DistributedRuntimeServiceImpl::KeyValueMultiGet(
+    ::grpc::ServerContext* context, const KeyValueMultiGetRequest* request,
+    KeyValueMultiGetResponse* response) {
+  VLOG(10) << "KeyValueMultiGet " << request->DebugString();
+  xla::Status status = ValidateSessionId(request->session_id());
+  if (status.ok()) {
+    status = CheckRunning("KeyValueMultiGet");
+  }
+  if (!status.ok()) {
+    return xla::ToGrpcStatus(status);
+  }
+  std::vector<std::string> keys(request->keys().begin(),
+                                request->keys().end());
+  std::vector<KeyValueStore::Value> values;
+  ::grpc::Status grpc_status = key_value_store_.MultiGet(
+      keys, absl::Milliseconds(request->timeout_milliseconds()), &values);
+  if (!grpc_status.ok()) {
+    return grpc_status;
+  }
+  for (int i = 0; i < keys.size(); ++i) {
+    KeyValueEntryProto* entry = response->add_entries();
+    entry->set_key(std::move(keys[i]));
+    entry->set_value(std::move(values[i].data));
+    entry->set_compressed(values[i].compressed);
+  }
+  return ::grpc::Status::OK;
+}
+
+::grpc::Status DistributedRuntimeServiceImpl::KeyValueMultiSet(
+    ::grpc::ServerContext* context, const KeyValueMultiSetRequest* request,
+    KeyValueMultiSetResponse* response) {
+  VLOG(10) << "KeyValueMultiSet with " << request->entries_size()
+           << " entries";
+  xla::Status status = ValidateSessionId(request->session_id());
+  if (status.ok()) {
+    status = CheckRunning("KeyValueMultiSet");
+  }
+  if (!status.ok()) {
+    return xla::ToGrpcStatus(status);
+  }
+  std::vector<std::pair<std::string, KeyValueStore::Value>> entries;
+  entries.reserve(request->entries_size());
+  for (const KeyValueEntryProto& entry : request->entries()) {
+    entries.emplace_back(
+        entry.key(), KeyValueStore::Value{entry.value(), entry.compressed()});
+  }
+  return key_value_store_.MultiSet(std::move(entries));
+}
+
+::grpc::Status DistributedRuntimeServiceImpl::KeyValueWatch(
+    ::grpc::ServerContext* context, const KeyValueWatchRequest* request,
+    ::grpc::ServerWriter<KeyValueWatchResponse>* writer) {
+  VLOG(10) << "KeyValueWatch " << request->DebugString();
+  xla::Status status = ValidateSessionId(request->session_id());
+  if (status.ok()) {
+    status = CheckRunning("KeyValueWatch");
+  }
+  if (!status.ok()) {
+    return xla::ToGrpcStatus(status);
+  }
+  if (request->num_keys() < 0) {
+    return xla::ToGrpcStatus(xla::InvalidArgument(
+        "Invalid number of keys %d, must be non-negative",
+        request->num_keys()));
+  }
+  absl::Duration timeout = absl::Milliseconds(request->timeout_milliseconds());
+  absl::Time deadline = absl::Now() + timeout;
+  absl::flat_hash_set<std::string> streamed_keys;
+  int64_t version = 0;
+  while (request->num_keys() == 0 ||
+         streamed_keys.size() < request->num_keys()) {
+    if (context->IsCancelled()) {
+      return ::grpc::Status(::grpc::StatusCode::CANCELLED,
+                            "KeyValueWatch() cancelled by the client.");
+    }
+    absl::Time now = absl::Now();
+    if (now >= deadline) {
+      if (request->num_keys() == 0) {
+        break;
+      }
+      return xla::ToGrpcStatus(tsl::errors::DeadlineExceeded(
+          "Timed out after ", absl::FormatDuration(timeout), " waiting for ",
+          request->num_keys(), " keys in directory ", request->directory(),
+          "; got ", streamed_keys.size()));
+    }
+    std::vector<std::pair<std::string, KeyValueStore::Value>> entries;
+    ::grpc::Status grpc_status = key_value_store_.WaitForDirectoryUpdates(
+        request->directory(),
+        std::min(deadline - now, options_.key_value_watch_poll_interval),
+        &version, &entries);
+    if (!grpc_status.ok()) {
+      return grpc_status;
+    }
+    if (entries.empty()) {
+      continue;
+    }
+    // The values are streamed as they were set, so each watcher gets the
+    // compressed bytes without the service recompressing them.
+    KeyValueWatchResponse response;
+    for (auto& [key, value] : entries) {
+      streamed_keys.insert(key);
+      KeyValueEntryProto* entry = response.add_entries();
+      entry->set_key(std::move(key));
+      entry->set_value(std::move(value.data));
+      entry->set_compressed(value.compressed);
+    }
+    if (!writer->Write(response)) {
+      return ::grpc::Status(::grpc::StatusCode::CANCELLED,
+                            "KeyValueWatch() stream closed by the client.");
+    }
+  }
+  return ::grpc::Status::OK;
 }
 
 ::grpc::Status DistributedRuntimeServiceImpl::WaitAtBarrier(
@@ -20,12 +20,14 @@ limitations under the License.
 #include <string>
 
 #include "absl/container/flat_hash_map.h"
+#include "absl/strings/string_view.h"
 #include "absl/synchronization/mutex.h"
 #include "absl/synchronization/notification.h"
 #include "absl/time/time.h"
 #include "grpcpp/security/server_credentials.h"
 #include "xla/pjrt/distributed/key_value_store.h"
 #include "xla/pjrt/distributed/protocol.grpc.pb.h"
+#include "xla/pjrt/distributed/topology_util.h"
 #include "xla/statusor.h"
 #include "xla/types.h"
 #include "tsl/distributed_runtime/coordination/coordination_service.h"
@@ -61,6 +63,10 @@ class DistributedRuntimeServiceImpl final
     // How long should we wait for all clients to call Shutdown() before giving
     // up and returning a failure?
     absl::Duration shutdown_timeout = absl::Minutes(5);
+
+    // How often KeyValueWatch() checks whether its client went away while no
+    // entries are set.
+    absl::Duration key_value_watch_poll_interval = absl::Seconds(1);
   };
   explicit DistributedRuntimeServiceImpl(const Options& options);
   ~DistributedRuntimeServiceImpl() override;
@@ -96,6 +102,18 @@ class DistributedRuntimeServiceImpl final
                              const KeyValueSetRequest* request,
                              KeyValueSetResponse* response) override;
 
+  ::grpc::Status KeyValueMultiGet(::grpc::ServerContext* context,
+                                  const KeyValueMultiGetRequest* request,
+                                  KeyValueMultiGetResponse* response) override;
+
+  ::grpc::Status KeyValueMultiSet(::grpc::ServerContext* context,
+                                  const KeyValueMultiSetRequest* request,
+                                  KeyValueMultiSetResponse* response) override;
+
+  ::grpc::Status KeyValueWatch(
+      ::grpc::ServerContext* context, const KeyValueWatchRequest* request,
+      ::grpc::ServerWriter<KeyValueWatchResponse>* writer) override;
+
   ::grpc::Status WaitAtBarrier(::grpc::ServerContext* context,
                                const WaitAtBarrierRequest* request,
                                WaitAtBarrierResponse* response) override;
@@ -110,6 +128,9 @@ class DistributedRuntimeServiceImpl final
   // Validates a node id number.
   xla::Status ValidateNodeId(int node_id);
 
+  // Returns an error if the service is not running.
+  xla::Status CheckRunning(absl::string_view method);
+
   const Options options_;
   const uint64_t session_id_;
 
@@ -207,13 +228,6 @@ class DistributedRuntimeService {
   std::unique_ptr<::grpc::Server> server_;
 };
 
-// Everything below this point is exposed only for tests.
-
-// Given a LocalTopologyProto object from each node, builds a
-// GlobalTopologyProto that describes all nodes.
-void BuildGlobalTopology(absl::Span<LocalTopologyProto> local_topologies,
-                         GlobalTopologyProto* global_topology);
-
 }  // namespace xla
 
 #endif  // TENSORFLOW_COMPILER_XLA_PJRT_DISTRIBUTED_SERVICE_H_
@@ -16,6 +16,7 @@ limitations under the License.
 #include "xla/pjrt/distributed/service.h"
 
 #include "xla/pjrt/distributed/protocol.pb.h"
+#include "xla/pjrt/distributed/topology_util.h"
 #include "tsl/lib/core/status_test_util.h"
 #include "tsl/platform/test.h"
 
@@ -40,5 +41,17 @@ TEST(TopologyTest, BuildGlobalTopology) {
   EXPECT_EQ(global.nodes()[1].devices_size(), 2);
 }
 
+TEST(TopologyTest, TopologyTree) {
+  EXPECT_EQ(TopologyTreeParent(0, /*fanout=*/3), -1);
+  EXPECT_EQ(TopologyTreeParent(3, /*fanout=*/3), 0);
+  EXPECT_EQ(TopologyTreeParent(4, /*fanout=*/3), 1);
+  EXPECT_THAT(TopologyTreeChildren(0, /*num_nodes=*/6, /*fanout=*/3),
+              ::testing::ElementsAre(1, 2, 3));
+  EXPECT_THAT(TopologyTreeChildren(1, /*num_nodes=*/6, /*fanout=*/3),
+              ::testing::ElementsAre(4, 5));
+  EXPECT_THAT(TopologyTreeChildren(2, /*num_nodes=*/6, /*fanout=*/3),
+              ::testing::IsEmpty());
+}
+
 }  // namespace
 }  // namespace xla
@@ -0,0 +1,74 @@
+/* Copyright 2023 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "xla/pjrt/distributed/topology_util.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "absl/container/flat_hash_map.h"
+#include "absl/strings/string_view.h"
+#include "tsl/platform/logging.h"
+
+namespace xla {
+
+void BuildGlobalTopology(absl::Span<LocalTopologyProto> local_topologies,
+                         GlobalTopologyProto* global_topology) {
+  int next_global_device_id = 0;
+  // Assign local devices of the same host to the same slice_index.
+  int next_slice_index = 0;
+  absl::flat_hash_map<std::string, int> boot_id_to_slice_index;
+  for (LocalTopologyProto& local : local_topologies) {
+    // Every new boot_id seen is treated as a new host/slice.
+    absl::string_view boot_id = local.boot_id();
+    auto [it, inserted] =
+        boot_id_to_slice_index.try_emplace(boot_id, next_slice_index);
+    if (inserted) {
+      ++next_slice_index;
+    }
+    for (DeviceProto& device : *local.mutable_devices()) {
+      device.set_global_device_id(next_global_device_id++);
+      device.set_slice_index(it->second);
+    }
+    global_topology->add_nodes()->Swap(&local);
+  }
+  if (VLOG_IS_ON(10)) {
+    for (auto it = boot_id_to_slice_index.begin();
+         it != boot_id_to_slice_index.end(); ++it) {
+      LOG(INFO) << "BuildGlobalTopology boot_id_to_slice_index " << it->first
+                << "->" << it->second;
+    }
+  }
+}
+
+int TopologyTreeParent(int node_id, int fanout) {
+  CHECK_GT(fanout, 0);
+  return node_id == 0 ? -1 : (node_id - 1) / fanout;
+}
+
+std::vector<int> TopologyTreeChildren(int node_id, int num_nodes, int fanout) {
+  CHECK_GT(fanout, 0);
+  std::vector<int> children;
+  int64_t first = static_cast<int64_t>(node_id) * fanout + 1;
+  for (int64_t child = first;
+       child < std::min<int64_t>(first + fanout, num_nodes); ++child) {
+    children.push_back(child);
+  }
+  return children;
+}
+
+}  // namespace xla
@@ -0,0 +1,42 @@
+/* Copyright 2023 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef TENSORFLOW_COMPILER_XLA_PJRT_DISTRIBUTED_TOPOLOGY_UTIL_H_
+#define TENSORFLOW_COMPILER_XLA_PJRT_DISTRIBUTED_TOPOLOGY_UTIL_H_
+
+#include <vector>
+
+#include "absl/types/span.h"
+#include "xla/pjrt/distributed/protocol.pb.h"
+
+namespace xla {
+
+// Given a LocalTopologyProto object from each node, builds a
+// GlobalTopologyProto that describes all nodes. Steals the contents of
+// `local_topologies`.
+void BuildGlobalTopology(absl::Span<LocalTopologyProto> local_topologies,
+                         GlobalTopologyProto* global_topology);
+
+// The nodes of a job form a complete `fanout`-ary tree rooted at node 0, in
+// which node i is the parent of nodes fanout * i + 1 ... fanout * (i + 1).
+// Returns the parent of `node_id`, or -1 for the root.
+int TopologyTreeParent(int node_id, int fanout);
+
+// Returns the children of `node_id` in the tree of `num_nodes` nodes.
+std::vector<int> TopologyTreeChildren(int node_id, int num_nodes, int fanout);
+
+}  // namespace xla
+
+#endif  // TENSORFLOW_COMPILER_XLA_PJRT_DISTRIBUTED_TOPOLOGY_UTIL_H_
@@ -16,8 +16,15 @@ limitations under the License.
 #ifndef TENSORFLOW_COMPILER_XLA_PJRT_DISTRIBUTED_UTIL_H_
 #define TENSORFLOW_COMPILER_XLA_PJRT_DISTRIBUTED_UTIL_H_
 
+#include <cstddef>
+#include <string>
+
+#include "absl/strings/string_view.h"
 #include "grpcpp/support/status.h"
 #include "xla/status.h"
+#include "xla/statusor.h"
+#include "tsl/platform/errors.h"
+#include "tsl/platform/snappy.h"
 
 namespace xla {
 
@@ -39,6 +46,33 @@ inline ::grpc::Status ToGrpcStatus(const Status& s) {
   }
 }
 
+// Key-value store values of at least this many bytes are snappy compressed by
+// the client before they are sent to the service.
+inline constexpr size_t kMinCompressedKeyValueBytes = 1024;
+
+// Compresses `value` into `*compressed` if it is large enough and compressing
+// makes it smaller. Returns whether it did.
+inline bool CompressKeyValue(absl::string_view value, std::string* compressed) {
+  return value.size() >= kMinCompressedKeyValueBytes &&
+         tsl::port::Snappy_Compress(value.data(), value.size(), compressed) &&
+         compressed->size() < value.size();
+}
+
+// Decompresses a value compressed by CompressKeyValue().
+inline StatusOr<std::string> DecompressKeyValue(absl::string_view compressed) {
+  size_t size;
+  if (!tsl::port::Snappy_GetUncompressedLength(compressed.data(),
+                                               compressed.size(), &size)) {
+    return tsl::errors::DataLoss("Invalid compressed key-value store value.");
+  }
+  std::string value(size, '\0');
+  if (!tsl::port::Snappy_Uncompress(compressed.data(), compressed.size(),
+                                    value.data())) {
+    return tsl::errors::DataLoss("Invalid compressed key-value store value.");
+  }
+  return value;
+}
+
 }  // namespace xla
 
 #endif  // TENSORFLOW_COMPILER_XLA_PJRT_DISTRIBUTED_UTIL_H_
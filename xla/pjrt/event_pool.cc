@@ -59,6 +59,20 @@ void EventPool::ThenRecordEvent(se::Stream* stream, EventPool::Handle& handle) {
 
 StatusOr<EventPool::Handle> EventPool::ThenAllocateAndRecordEvent(
     se::Stream* stream) {
+  // This runs several times per execution, so when a free event is available
+  // it is taken and recorded in a single critical section.
+  if (allow_reuse_) {
+    Handle handle;
+    handle.pool_ = this;
+    absl::MutexLock lock(&mu_);
+    if (!free_events_.empty()) {
+      handle.event_ = std::move(free_events_.top());
+      free_events_.pop();
+      stream->ThenRecordEvent(handle.event_.get());
+      handle.sequence_number_ = next_sequence_number_++;
+      return handle;
+    }
+  }
   TF_ASSIGN_OR_RETURN(EventPool::Handle handle,
                       AllocateEvent(stream->parent()));
   ThenRecordEvent(stream, handle);
@@ -0,0 +1,115 @@
+/* Copyright 2023 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "xla/pjrt/host_to_device_pipeline.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <utility>
+
+#include "absl/synchronization/mutex.h"
+#include "tsl/profiler/lib/traceme.h"
+
+namespace xla {
+
+StagingBufferPool::StagingBufferPool(tsl::Allocator* allocator,
+                                     int64_t buffer_size, int max_free_buffers)
+    : allocator_(allocator),
+      buffer_size_(buffer_size),
+      max_free_buffers_(max_free_buffers) {}
+
+StagingBufferPool::~StagingBufferPool() {
+  absl::MutexLock lock(&mu_);
+  for (void* buffer : free_buffers_) {
+    allocator_->DeallocateRaw(buffer);
+  }
+}
+
+void* StagingBufferPool::Allocate() {
+  {
+    absl::MutexLock lock(&mu_);
+    if (!free_buffers_.empty()) {
+      void* buffer = free_buffers_.back();
+      free_buffers_.pop_back();
+      return buffer;
+    }
+    ++num_allocations_;
+  }
+  return allocator_->AllocateRaw(tsl::Allocator::kAllocatorAlignment,
+                                 buffer_size_);
+}
+
+void StagingBufferPool::Free(void* buffer) {
+  {
+    absl::MutexLock lock(&mu_);
+    if (free_buffers_.size() < max_free_buffers_) {
+      free_buffers_.push_back(buffer);
+      return;
+    }
+  }
+  allocator_->DeallocateRaw(buffer);
+}
+
+int64_t StagingBufferPool::num_allocations() const {
+  absl::MutexLock lock(&mu_);
+  return num_allocations_;
+}
+
+void EnqueuePipelinedHostToDeviceTransfer(const void* src,
+                                          se::DeviceMemoryBase dst,
+                                          int64_t size, se::Stream* stream,
+                                          StagingBufferPool* pool,
+                                          tsl::thread::ThreadPool* thread_pool,
+                                          std::function<void()> on_enqueued) {
+  const int64_t slice_size = pool->buffer_size();
+  const int64_t num_slices = std::max<int64_t>(
+      1, (size + slice_size - 1) / slice_size);
+  struct State {
+    std::atomic<int64_t> remaining_slices;
+    std::function<void()> on_enqueued;
+  };
+  auto state = std::make_shared<State>();
+  state->remaining_slices = num_slices;
+  state->on_enqueued = std::move(on_enqueued);
+
+  for (int64_t i = 0; i < num_slices; ++i) {
+    const int64_t offset = i * slice_size;
+    const int64_t length = std::min(slice_size, size - offset);
+    auto transfer_slice = [src, dst, stream, pool, state, offset, length]() {
+      tsl::profiler::TraceMe traceme("H2D slice");
+      void* staging_buffer = pool->Allocate();
+      std::memcpy(staging_buffer, static_cast<const char*>(src) + offset,
+                  length);
+      se::DeviceMemoryBase dst_slice(static_cast<char*>(dst.opaque()) + offset,
+                                     length);
+      stream->ThenMemcpy(&dst_slice, staging_buffer, length);
+      stream->ThenDoHostCallback(
+          [pool, staging_buffer]() { pool->Free(staging_buffer); });
+      if (state->remaining_slices.fetch_sub(1) == 1) {
+        state->on_enqueued();
+      }
+    };
+    if (thread_pool != nullptr) {
+      thread_pool->Schedule(std::move(transfer_slice));
+    } else {
+      transfer_slice();
+    }
+  }
+}
+
+}  // namespace xla
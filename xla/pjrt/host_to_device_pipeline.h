@@ -0,0 +1,84 @@
+/* Copyright 2023 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef TENSORFLOW_COMPILER_XLA_PJRT_HOST_TO_DEVICE_PIPELINE_H_
+#define TENSORFLOW_COMPILER_XLA_PJRT_HOST_TO_DEVICE_PIPELINE_H_
+
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+#include "absl/synchronization/mutex.h"
+#include "xla/stream_executor/device_memory.h"
+#include "xla/stream_executor/stream.h"
+#include "tsl/framework/allocator.h"
+#include "tsl/platform/threadpool.h"
+
+namespace xla {
+
+// A pool of fixed size host buffers for staging host-to-device transfers. On
+// GPU the buffers come from the pinned host memory allocator, which is slow to
+// allocate from, so freed buffers are kept for reuse.
+class StagingBufferPool {
+ public:
+  // Keeps at most `max_free_buffers` freed buffers of `buffer_size` bytes
+  // allocated from `allocator`, which must outlive the pool.
+  StagingBufferPool(tsl::Allocator* allocator, int64_t buffer_size,
+                    int max_free_buffers);
+  ~StagingBufferPool();
+
+  StagingBufferPool(const StagingBufferPool&) = delete;
+  StagingBufferPool& operator=(const StagingBufferPool&) = delete;
+
+  int64_t buffer_size() const { return buffer_size_; }
+
+  // Returns a free buffer, or a new one if there is none.
+  void* Allocate();
+  void Free(void* buffer);
+
+  // Number of buffers allocated from the underlying allocator so far.
+  int64_t num_allocations() const;
+
+ private:
+  tsl::Allocator* const allocator_;
+  const int64_t buffer_size_;
+  const int max_free_buffers_;
+
+  mutable absl::Mutex mu_;
+  std::vector<void*> free_buffers_ ABSL_GUARDED_BY(mu_);
+  int64_t num_allocations_ ABSL_GUARDED_BY(mu_) = 0;
+};
+
+// Copies `size` bytes from `src` to `dst` on `stream`, in slices of the
+// buffer size of `pool`. Every slice is staged into a pool buffer by a task on
+// `thread_pool`, which enqueues the copy of the slice as soon as it is staged,
+// so that staging later slices overlaps with the copies of earlier ones. If
+// `thread_pool` is null the slices are staged in order by the calling thread,
+// which still overlaps staging with the copies. Pool buffers are returned to
+// the pool once their copy has completed.
+//
+// `on_enqueued` is called by the task that enqueues the last copy. By then
+// `src` is no longer needed and anything enqueued on `stream` runs after all
+// of the copies.
+void EnqueuePipelinedHostToDeviceTransfer(const void* src,
+                                          se::DeviceMemoryBase dst,
+                                          int64_t size, se::Stream* stream,
+                                          StagingBufferPool* pool,
+                                          tsl::thread::ThreadPool* thread_pool,
+                                          std::function<void()> on_enqueued);
+
+}  // namespace xla
+
+#endif  // TENSORFLOW_COMPILER_XLA_PJRT_HOST_TO_DEVICE_PIPELINE_H_
@@ -0,0 +1,152 @@
+/* Copyright 2023 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "xla/pjrt/host_to_device_pipeline.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <numeric>
+#include <vector>
+
+#include "absl/synchronization/notification.h"
+#include "xla/service/platform_util.h"
+#include "xla/stream_executor/stream.h"
+#include "xla/stream_executor/stream_executor.h"
+#include "tsl/framework/allocator.h"
+#include "tsl/lib/core/status_test_util.h"
+#include "tsl/platform/env.h"
+#include "tsl/platform/status.h"
+#include "tsl/platform/test.h"
+#include "tsl/platform/test_benchmark.h"
+#include "tsl/platform/threadpool.h"
+
+namespace xla {
+namespace {
+
+se::StreamExecutor* HostExecutor() {
+  se::Platform* platform = PlatformUtil::GetPlatform("Host").value();
+  return platform->ExecutorForDevice(0).value();
+}
+
+TEST(StagingBufferPoolTest, ReusesFreedBuffers) {
+  StagingBufferPool pool(tsl::cpu_allocator(), /*buffer_size=*/1024,
+                         /*max_free_buffers=*/1);
+  void* a = pool.Allocate();
+  void* b = pool.Allocate();
+  EXPECT_EQ(pool.num_allocations(), 2);
+
+  // Only one of the buffers is kept.
+  pool.Free(a);
+  pool.Free(b);
+  EXPECT_EQ(pool.Allocate(), a);
+  void* c = pool.Allocate();
+  EXPECT_EQ(pool.num_allocations(), 3);
+  pool.Free(a);
+  pool.Free(c);
+}
+
+void TestPipelinedTransfer(tsl::thread::ThreadPool* thread_pool) {
+  se::StreamExecutor* executor = HostExecutor();
+  se::Stream stream(executor);
+  stream.Init();
+
+  const int64_t size = (1 << 20) + 123;
+  const int64_t num_slices = 17;
+  const int max_free_buffers = 4;
+  std::vector<uint8_t> src(size);
+  std::iota(src.begin(), src.end(), 0);
+  se::DeviceMemory<uint8_t> dst = executor->AllocateArray<uint8_t>(size);
+  StagingBufferPool pool(tsl::cpu_allocator(), /*buffer_size=*/64 << 10,
+                         max_free_buffers);
+
+  auto transfer = [&]() {
+    std::memset(dst.opaque(), 0, size);
+    absl::Notification enqueued;
+    EnqueuePipelinedHostToDeviceTransfer(src.data(), dst, size, &stream, &pool,
+                                         thread_pool,
+                                         [&]() { enqueued.Notify(); });
+    enqueued.WaitForNotification();
+    TF_ASSERT_OK(stream.BlockHostUntilDone());
+    // The host platform's device memory is host memory.
+    EXPECT_EQ(std::memcmp(dst.opaque(), src.data(), size), 0);
+  };
+
+  transfer();
+  const int64_t first_allocations = pool.num_allocations();
+  EXPECT_GE(first_allocations, 1);
+  EXPECT_LE(first_allocations, num_slices);
+
+  // All buffers of the first transfer have been freed, so the first slices of
+  // the second transfer are staged in the buffers that the pool kept.
+  transfer();
+  EXPECT_LE(pool.num_allocations() - first_allocations,
+            num_slices - std::min<int64_t>(first_allocations,
+                                           max_free_buffers));
+  executor->Deallocate(&dst);
+}
+
+TEST(HostToDevicePipelineTest, Transfer) {
+  tsl::thread::ThreadPool thread_pool(tsl::Env::Default(), "test", 4);
+  TestPipelinedTransfer(&thread_pool);
+}
+
+TEST(HostToDevicePipelineTest, TransferWithoutThreadPool) {
+  TestPipelinedTransfer(/*thread_pool=*/nullptr);
+}
+
+// Transfers state.range(0) bytes, pipelined in slices of state.range(1)
+// bytes, or through a single staging buffer if the slice size is 0.
+void BM_HostToDeviceTransfer(::testing::benchmark::State& state) {
+  const int64_t size = state.range(0);
+  const int64_t slice_size = state.range(1);
+  se::StreamExecutor* executor = HostExecutor();
+  se::Stream stream(executor);
+  stream.Init();
+  std::vector<uint8_t> src(size, 1);
+  se::DeviceMemory<uint8_t> dst = executor->AllocateArray<uint8_t>(size);
+  tsl::thread::ThreadPool thread_pool(tsl::Env::Default(), "benchmark", 4);
+  StagingBufferPool pool(tsl::cpu_allocator(),
+                         slice_size > 0 ? slice_size : size,
+                         /*max_free_buffers=*/16);
+
+  for (auto s : state) {
+    if (slice_size > 0) {
+      absl::Notification enqueued;
+      EnqueuePipelinedHostToDeviceTransfer(src.data(), dst, size, &stream,
+                                           &pool, &thread_pool,
+                                           [&]() { enqueued.Notify(); });
+      enqueued.WaitForNotification();
+    } else {
+      void* staging_buffer = pool.Allocate();
+      std::memcpy(staging_buffer, src.data(), size);
+      stream.ThenMemcpy(&dst, staging_buffer, size);
+      stream.ThenDoHostCallback(
+          [&pool, staging_buffer]() { pool.Free(staging_buffer); });
+    }
+    TF_CHECK_OK(stream.BlockHostUntilDone());
+  }
+  state.SetBytesProcessed(state.iterations() * size);
+  executor->Deallocate(&dst);
+}
+BENCHMARK(BM_HostToDeviceTransfer)
+    ->ArgPair(64 << 20, 0)
+    ->ArgPair(64 << 20, 1 << 20)
+    ->ArgPair(64 << 20, 4 << 20)
+    ->UseRealTime();
+
+}  // namespace
+}  // namespace xla
@@ -0,0 +1,138 @@
+/* Copyright 2023 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "xla/pjrt/lock_free_block_pool.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+
+#include "absl/numeric/bits.h"
+#include "absl/synchronization/mutex.h"
+#include "tsl/platform/logging.h"
+#include "tsl/platform/mem.h"
+
+namespace xla {
+
+namespace {
+
+size_t RoundUp(size_t size, size_t alignment) {
+  return (size + alignment - 1) / alignment * alignment;
+}
+
+uint32_t ChunkOf(uint32_t index, uint32_t first_chunk_blocks) {
+  return absl::bit_width(index / first_chunk_blocks + 1) - 1;
+}
+
+uint32_t FirstIndexOf(uint32_t chunk, uint32_t first_chunk_blocks) {
+  return first_chunk_blocks * ((uint32_t{1} << chunk) - 1);
+}
+
+}  // namespace
+
+LockFreeBlockPool::LockFreeBlockPool(size_t block_size, size_t alignment)
+    : alignment_(std::max(alignment, sizeof(void*))),
+      stride_(RoundUp(sizeof(uint32_t), alignment_) +
+              RoundUp(block_size, alignment_)),
+      header_size_(RoundUp(sizeof(uint32_t), alignment_)) {}
+
+LockFreeBlockPool::~LockFreeBlockPool() {
+  for (std::atomic<Chunk*>& chunk : chunks_) {
+    Chunk* c = chunk.load();
+    if (c != nullptr) {
+      tsl::port::AlignedFree(c->storage);
+      delete c;
+    }
+  }
+}
+
+std::atomic<uint32_t>& LockFreeBlockPool::Next(uint32_t index) const {
+  uint32_t chunk = ChunkOf(index, kFirstChunkBlocks);
+  return chunks_[chunk].load(std::memory_order_acquire)
+      ->next[index - FirstIndexOf(chunk, kFirstChunkBlocks)];
+}
+
+char* LockFreeBlockPool::Header(uint32_t index) const {
+  uint32_t chunk = ChunkOf(index, kFirstChunkBlocks);
+  return chunks_[chunk].load(std::memory_order_acquire)->storage +
+         (index - FirstIndexOf(chunk, kFirstChunkBlocks)) * stride_;
+}
+
+void* LockFreeBlockPool::Allocate() {
+  while (true) {
+    uint64_t head = head_.load(std::memory_order_acquire);
+    while (Link(head) != 0) {
+      uint32_t index = Link(head) - 1;
+      // If another thread pops `index` first, `next` may be stale, but then
+      // the counter has changed and the exchange fails.
+      uint32_t next = Next(index).load(std::memory_order_relaxed);
+      if (head_.compare_exchange_weak(head, Pack(next, Counter(head) + 1),
+                                      std::memory_order_acquire,
+                                      std::memory_order_acquire)) {
+        return Header(index) + header_size_;
+      }
+    }
+    absl::MutexLock lock(&grow_mu_);
+    if (Link(head_.load(std::memory_order_acquire)) == 0) {
+      Grow();
+    }
+  }
+}
+
+void LockFreeBlockPool::Free(void* block) {
+  uint32_t index;
+  std::memcpy(&index, static_cast<char*>(block) - header_size_, sizeof(index));
+  Push(index, index);
+}
+
+void LockFreeBlockPool::Push(uint32_t first, uint32_t last) {
+  uint64_t head = head_.load(std::memory_order_relaxed);
+  do {
+    Next(last).store(Link(head), std::memory_order_relaxed);
+  } while (!head_.compare_exchange_weak(head,
+                                        Pack(first + 1, Counter(head) + 1),
+                                        std::memory_order_release,
+                                        std::memory_order_relaxed));
+}
+
+void LockFreeBlockPool::Grow() {
+  CHECK_LT(num_chunks_, kMaxChunks) << "LockFreeBlockPool is exhausted";
+  const uint32_t chunk_index = num_chunks_++;
+  const uint32_t num_blocks = kFirstChunkBlocks << chunk_index;
+  const uint32_t first = FirstIndexOf(chunk_index, kFirstChunkBlocks);
+
+  auto chunk = std::make_unique<Chunk>();
+  chunk->storage = static_cast<char*>(
+      tsl::port::AlignedMalloc(num_blocks * stride_, alignment_));
+  CHECK(chunk->storage != nullptr);
+  chunk->next = std::make_unique<std::atomic<uint32_t>[]>(num_blocks);
+  for (uint32_t i = 0; i < num_blocks; ++i) {
+    uint32_t index = first + i;
+    std::memcpy(chunk->storage + i * stride_, &index, sizeof(index));
+    // Links are indices plus one, so block i links to block i + 1.
+    chunk->next[i].store(index + 2, std::memory_order_relaxed);
+  }
+  chunks_[chunk_index].store(chunk.release(), std::memory_order_release);
+  Push(first, first + num_blocks - 1);
+}
+
+int64_t LockFreeBlockPool::num_blocks() const {
+  absl::MutexLock lock(&grow_mu_);
+  return FirstIndexOf(num_chunks_, kFirstChunkBlocks);
+}
+
+}  // namespace xla
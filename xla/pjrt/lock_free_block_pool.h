@@ -0,0 +1,92 @@
+/* Copyright 2023 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef TENSORFLOW_COMPILER_XLA_PJRT_LOCK_FREE_BLOCK_POOL_H_
+#define TENSORFLOW_COMPILER_XLA_PJRT_LOCK_FREE_BLOCK_POOL_H_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+#include "absl/synchronization/mutex.h"
+
+namespace xla {
+
+// A pool of fixed size memory blocks for objects that are allocated and freed
+// at a high rate from many threads. Freed blocks are kept on a lock-free free
+// list and are never returned to the system until the pool is destroyed. The
+// pool only takes a lock when the free list is empty and it has to grow.
+class LockFreeBlockPool {
+ public:
+  LockFreeBlockPool(size_t block_size, size_t alignment);
+  // All blocks must have been freed.
+  ~LockFreeBlockPool();
+
+  LockFreeBlockPool(const LockFreeBlockPool&) = delete;
+  LockFreeBlockPool& operator=(const LockFreeBlockPool&) = delete;
+
+  void* Allocate();
+  void Free(void* block);
+
+  // Number of blocks allocated from the system so far.
+  int64_t num_blocks() const;
+
+ private:
+  // The blocks live in chunks that double in size, so that block indices can
+  // be mapped to chunks without a lock. Each block is preceded by a header
+  // holding its index. The links of the free list are kept out of the blocks,
+  // so that a thread popping a stale head never reads memory that an object
+  // owns.
+  struct Chunk {
+    char* storage;
+    std::unique_ptr<std::atomic<uint32_t>[]> next;
+  };
+  static constexpr uint32_t kFirstChunkBlocks = 64;
+  static constexpr int kMaxChunks = 25;
+
+  // The head of the free list packs a counter that is incremented by every
+  // update into the upper half, to rule out ABA races, and the link to the
+  // first free block into the lower half. Links are block indices plus one,
+  // zero being the end of the list.
+  static uint64_t Pack(uint32_t link, uint64_t counter) {
+    return (counter << 32) | link;
+  }
+  static uint32_t Link(uint64_t head) { return static_cast<uint32_t>(head); }
+  static uint64_t Counter(uint64_t head) { return head >> 32; }
+
+  std::atomic<uint32_t>& Next(uint32_t index) const;
+  char* Header(uint32_t index) const;
+
+  // Pushes the list of blocks from `first` to `last`, which are already
+  // linked to each other.
+  void Push(uint32_t first, uint32_t last);
+  void Grow();
+
+  const size_t alignment_;
+  // Size of a block including its header.
+  const size_t stride_;
+  const size_t header_size_;
+
+  std::atomic<uint64_t> head_{0};
+  std::atomic<Chunk*> chunks_[kMaxChunks] = {};
+
+  mutable absl::Mutex grow_mu_;
+  int num_chunks_ ABSL_GUARDED_BY(grow_mu_) = 0;
+};
+
+}  // namespace xla
+
+#endif  // TENSORFLOW_COMPILER_XLA_PJRT_LOCK_FREE_BLOCK_POOL_H_
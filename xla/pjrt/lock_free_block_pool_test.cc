@@ -0,0 +1,108 @@
+/* Copyright 2023 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "xla/pjrt/lock_free_block_pool.h"
+
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <vector>
+
+#include "absl/container/flat_hash_set.h"
+#include "tsl/platform/env.h"
+#include "tsl/platform/test.h"
+#include "tsl/platform/test_benchmark.h"
+#include "tsl/platform/threadpool.h"
+
+namespace xla {
+namespace {
+
+TEST(LockFreeBlockPoolTest, ReusesFreedBlocks) {
+  LockFreeBlockPool pool(/*block_size=*/24, /*alignment=*/16);
+  absl::flat_hash_set<void*> blocks;
+  for (int i = 0; i < 1000; ++i) {
+    void* block = pool.Allocate();
+    EXPECT_EQ(reinterpret_cast<uintptr_t>(block) % 16, 0);
+    EXPECT_TRUE(blocks.insert(block).second);
+  }
+  const int64_t num_blocks = pool.num_blocks();
+  EXPECT_GE(num_blocks, 1000);
+  for (void* block : blocks) {
+    pool.Free(block);
+  }
+  for (int i = 0; i < 1000; ++i) {
+    EXPECT_TRUE(blocks.contains(pool.Allocate()));
+  }
+  EXPECT_EQ(pool.num_blocks(), num_blocks);
+  for (void* block : blocks) {
+    pool.Free(block);
+  }
+}
+
+TEST(LockFreeBlockPoolTest, ConcurrentAllocateAndFree) {
+  constexpr int kNumThreads = 8;
+  constexpr int kBlockSize = 32;
+  LockFreeBlockPool pool(kBlockSize, /*alignment=*/8);
+  {
+    tsl::thread::ThreadPool threads(tsl::Env::Default(), "test", kNumThreads);
+    for (int t = 0; t < kNumThreads; ++t) {
+      threads.Schedule([&pool, t]() {
+        std::vector<void*> blocks;
+        for (int i = 0; i < 10000; ++i) {
+          void* block = pool.Allocate();
+          std::memset(block, t, kBlockSize);
+          blocks.push_back(block);
+          if (blocks.size() == 100) {
+            // No other thread may have been handed one of our blocks.
+            for (void* b : blocks) {
+              for (int j = 0; j < kBlockSize; ++j) {
+                ASSERT_EQ(static_cast<char*>(b)[j], t);
+              }
+              pool.Free(b);
+            }
+            blocks.clear();
+          }
+        }
+        for (void* b : blocks) {
+          pool.Free(b);
+        }
+      });
+    }
+  }
+  EXPECT_LE(pool.num_blocks(), 64 * 31);
+}
+
+void BM_LockFreeBlockPool(benchmark::State& state) {
+  static auto* pool = new LockFreeBlockPool(/*block_size=*/128,
+                                            /*alignment=*/8);
+  for (auto s : state) {
+    void* block = pool->Allocate();
+    benchmark::DoNotOptimize(block);
+    pool->Free(block);
+  }
+}
+BENCHMARK(BM_LockFreeBlockPool)->ThreadRange(1, 8);
+
+void BM_OperatorNew(benchmark::State& state) {
+  for (auto s : state) {
+    void* block = ::operator new(128);
+    benchmark::DoNotOptimize(block);
+    ::operator delete(block);
+  }
+}
+BENCHMARK(BM_OperatorNew)->ThreadRange(1, 8);
+
+}  // namespace
+}  // namespace xla
@@ -899,14 +899,22 @@ PjRtCApiLoadedExecutable::GetCommonExecuteArgs(
   // Allocates memory for output. `c_buffer_lists_storage` and `c_buffer_lists`
   // needs to stay alive during the call of `PJRT_LoadedExecutable_Execute`.
 
-  PJRT_Executable_NumOutputs_Args numoutputs_args;
-  numoutputs_args.struct_size = PJRT_Executable_NumOutputs_Args_STRUCT_SIZE;
-  numoutputs_args.priv = nullptr;
-  numoutputs_args.executable = c_executable();
-  RETURN_STATUS_IF_ERROR(
-      pjrt_c_api()->PJRT_Executable_NumOutputs(&numoutputs_args), pjrt_c_api());
+  // The number of outputs is looked up once, since the plugin may have to
+  // inspect the HLO modules to answer.
+  int64_t num_outputs = num_outputs_.load(std::memory_order_relaxed);
+  if (num_outputs < 0) {
+    PJRT_Executable_NumOutputs_Args numoutputs_args;
+    numoutputs_args.struct_size = PJRT_Executable_NumOutputs_Args_STRUCT_SIZE;
+    numoutputs_args.priv = nullptr;
+    numoutputs_args.executable = c_executable();
+    RETURN_STATUS_IF_ERROR(
+        pjrt_c_api()->PJRT_Executable_NumOutputs(&numoutputs_args),
+        pjrt_c_api());
+    num_outputs = numoutputs_args.num_outputs;
+    num_outputs_.store(num_outputs, std::memory_order_relaxed);
+  }
   size_t outer_size = args.num_devices;
-  size_t inner_size = numoutputs_args.num_outputs;
+  size_t inner_size = num_outputs;
   c_output_lists_storage.resize(outer_size);
   c_output_lists.resize(outer_size);
   for (int i = 0; i < outer_size; ++i) {
@@ -997,6 +1005,98 @@ PjRtCApiLoadedExecutable::Execute(
                                        client_);
 }
 
+StatusOr<std::vector<PjRtCApiClient::BatchedExecutionResult>>
+PjRtCApiClient::ExecuteBatch(absl::Span<const BatchedExecution> executions,
+                             const ExecuteOptions& options, bool fill_futures) {
+  if (!options.send_callbacks.empty() || !options.recv_callbacks.empty()) {
+    return Unimplemented(
+        "Send/recv callbacks not implemented for "
+        "PjRtCApiClient::ExecuteBatch.");
+  }
+  std::vector<BatchedExecutionResult> results(executions.size());
+
+  // Everything that GetCommonExecuteArgs points the arguments of one execution
+  // to, which must stay alive during the call.
+  struct ExecutionStorage {
+    PJRT_ExecuteOptions c_options;
+    std::vector<std::vector<PJRT_Buffer*>> c_argument_lists_storage;
+    std::vector<PJRT_Buffer**> c_arguments;
+    std::vector<std::vector<PJRT_Buffer*>> c_output_lists_storage;
+    std::vector<PJRT_Buffer**> c_output_lists;
+    std::optional<std::vector<PJRT_Event*>> device_complete_events;
+    PjRtCApiLoadedExecutable::SendRecvCallbackData callback_data;
+  };
+  std::vector<ExecutionStorage> storage(executions.size());
+  // The executions whose arguments could be built, and the indices of their
+  // results. The others already hold their error.
+  std::vector<PJRT_LoadedExecutable_Execute_Args> c_executions;
+  std::vector<int> result_indices;
+  c_executions.reserve(executions.size());
+  result_indices.reserve(executions.size());
+  for (int i = 0; i < executions.size(); ++i) {
+    if (executions[i].executable->client() != this) {
+      results[i].outputs = InvalidArgument(
+          "ExecuteBatch called with an executable of another client");
+      continue;
+    }
+    auto* executable = tensorflow::down_cast<PjRtCApiLoadedExecutable*>(
+        executions[i].executable);
+    ExecutionStorage& s = storage[i];
+    if (fill_futures) {
+      s.device_complete_events.emplace();
+    }
+    StatusOr<PJRT_LoadedExecutable_Execute_Args> args =
+        executable->GetCommonExecuteArgs(
+            executions[i].argument_handles, options, s.c_options,
+            s.c_argument_lists_storage, s.c_arguments,
+            s.c_output_lists_storage, s.c_output_lists,
+            s.device_complete_events, s.callback_data);
+    if (!args.ok()) {
+      results[i].outputs = args.status();
+      continue;
+    }
+    args->execute_device = nullptr;
+    c_executions.push_back(*args);
+    result_indices.push_back(i);
+  }
+  if (c_executions.empty()) {
+    return results;
+  }
+
+  std::vector<PJRT_Error*> errors(c_executions.size(), nullptr);
+  PJRT_LoadedExecutable_ExecuteBatch_Args args;
+  args.struct_size = PJRT_LoadedExecutable_ExecuteBatch_Args_STRUCT_SIZE;
+  args.priv = nullptr;
+  args.client = c_client_.get();
+  args.executions = c_executions.data();
+  args.num_executions = c_executions.size();
+  args.errors = errors.data();
+  RETURN_STATUS_IF_ERROR(c_api_->PJRT_LoadedExecutable_ExecuteBatch(&args),
+                         c_api_);
+
+  for (int k = 0; k < c_executions.size(); ++k) {
+    const int i = result_indices[k];
+    if (errors[k] != nullptr) {
+      std::unique_ptr<PJRT_Error, pjrt::PJRT_ErrorDeleter> error(
+          errors[k], pjrt::MakeErrorDeleter(c_api_));
+      results[i].outputs = pjrt::PjrtErrorToStatus(error.get(), c_api_);
+      continue;
+    }
+    const PJRT_LoadedExecutable_Execute_Args& c_execution = c_executions[k];
+    if (fill_futures) {
+      for (int j = 0; j < c_execution.num_devices; ++j) {
+        results[i].device_complete_futures.push_back(
+            pjrt::ConvertCEventToCppFuture(
+                c_execution.device_complete_events[j], c_api_));
+      }
+    }
+    results[i].outputs = Convert2DCBuffersToCppBuffers(
+        c_execution.output_lists, c_execution.num_devices,
+        storage[i].c_output_lists_storage[0].size(), this);
+  }
+  return results;
+}
+
 StatusOr<std::vector<std::unique_ptr<PjRtBuffer>>>
 PjRtCApiLoadedExecutable::ExecuteWithSingleDevice(
     absl::Span<PjRtBuffer* const> argument_handles, PjRtDevice* device,
@@ -16,6 +16,8 @@ limitations under the License.
 #ifndef TENSORFLOW_COMPILER_XLA_PJRT_PJRT_C_API_CLIENT_H_
 #define TENSORFLOW_COMPILER_XLA_PJRT_PJRT_C_API_CLIENT_H_
 
+#include <atomic>
+#include <cstdint>
 #include <functional>
 #include <memory>
 #include <optional>
@@ -256,6 +258,28 @@ class PjRtCApiClient : public PjRtClient {
 
   PJRT_Client* pjrt_c_client() { return c_client_.get(); }
 
+  // One execution of ExecuteBatch. `executable` must belong to this client.
+  struct BatchedExecution {
+    PjRtLoadedExecutable* executable;
+    absl::Span<const std::vector<PjRtBuffer*>> argument_handles;
+  };
+  struct BatchedExecutionResult {
+    // As returned by PjRtLoadedExecutable::Execute.
+    StatusOr<std::vector<std::vector<std::unique_ptr<PjRtBuffer>>>> outputs;
+    // One future per device, if `fill_futures` was set and the execution was
+    // launched.
+    std::vector<PjRtFuture<Status>> device_complete_futures;
+  };
+
+  // Launches all of `executions` with `options` through a single
+  // PJRT_LoadedExecutable_ExecuteBatch call, which is cheaper than calling
+  // Execute for each of them when the programs are small. An execution that
+  // fails to launch reports its error in its result without affecting the
+  // others. Send/recv callbacks are not supported.
+  StatusOr<std::vector<BatchedExecutionResult>> ExecuteBatch(
+      absl::Span<const BatchedExecution> executions,
+      const ExecuteOptions& options, bool fill_futures);
+
   PjRtCApiDevice* GetCppDevice(PJRT_Device* c_device) const {
     auto it = c_to_cpp_device_map_.find(c_device);
     CHECK(it != c_to_cpp_device_map_.end());
@@ -520,6 +544,11 @@ class PjRtCApiLoadedExecutable : public PjRtLoadedExecutable {
   std::vector<PjRtDevice*> addressable_devices_;
 
   void InitDevices();
+
+  // Number of outputs per device, looked up on first use. -1 if unknown.
+  std::atomic<int64_t> num_outputs_{-1};
+
+  friend class PjRtCApiClient;
 };
 
 class PjRtCApiCompiler : public PjRtCompiler {
@@ -95,6 +95,7 @@ limitations under the License.
 #include "xla/literal.h"
 #include "xla/pjrt/distributed/protocol.pb.h"
 #include "xla/pjrt/event_pool.h"
+#include "xla/pjrt/host_to_device_pipeline.h"
 #include "xla/pjrt/local_device_state.h"
 #include "xla/pjrt/metrics.h"
 #include "xla/pjrt/mlir_to_hlo.h"
@@ -189,6 +190,13 @@ StatusOr<DeviceAssignment> DevicesToDeviceAssignment(
   return xla_assignment;
 }
 
+// Slice size of pipelined host-to-device transfers, large enough for the
+// copies to run at full bandwidth.
+constexpr int64_t kDefaultHostToDevicePipelineSliceSize = 4 << 20;
+
+// Number of free staging buffers of pipelined transfers kept for reuse.
+constexpr int kMaxFreeStagingBuffers = 16;
+
 class CpuAllocator : public tsl::Allocator {
  public:
   CpuAllocator() = default;
@@ -231,6 +239,9 @@ PjRtStreamExecutorClient::PjRtStreamExecutorClient(
   if (!host_memory_allocator_) {
     host_memory_allocator_ = std::make_unique<CpuAllocator>();
   }
+  if (should_stage_host_to_device_transfers_) {
+    SetHostToDevicePipelineSliceSize(kDefaultHostToDevicePipelineSliceSize);
+  }
 
   for (const std::unique_ptr<PjRtStreamExecutorDevice>& device :
        owned_devices_) {
@@ -407,7 +418,7 @@ StatusOr<std::unique_ptr<PjRtStreamExecutorBuffer>> AllocateDestinationBuffer(
         LocalDeviceState::kComputeSynchronized) {
       // The allocation is not valid until the compute stream passes this point,
       // so add a definition event in the compute stream.
-      definition_events.emplace_back(std::make_shared<BufferSequencingEvent>());
+      definition_events.emplace_back(BufferSequencingEvent::Create());
       TF_ASSIGN_OR_RETURN(EventPool::Handle event,
                           local_device->event_pool().ThenAllocateAndRecordEvent(
                               local_device->compute_stream()));
@@ -424,7 +435,7 @@ StatusOr<std::unique_ptr<PjRtStreamExecutorBuffer>> AllocateDestinationBuffer(
     if (definition_event) {
       definition_events.emplace_back(definition_event);
     } else {
-      definition_events.emplace_back(std::make_shared<BufferSequencingEvent>());
+      definition_events.emplace_back(BufferSequencingEvent::Create());
     }
   }
   se::Stream* tuple_table_stream = local_device->host_to_device_stream();
@@ -447,7 +458,7 @@ StatusOr<std::unique_ptr<PjRtStreamExecutorBuffer>> AllocateDestinationBuffer(
     // from error cases because we have started a transfer and must not allow
     // dst_buffer to be freed too soon in the non-async allocation models.
 
-    definition_events.emplace_back(std::make_shared<BufferSequencingEvent>());
+    definition_events.emplace_back(BufferSequencingEvent::Create());
     StatusOr<EventPool::Handle> event_or =
         local_device->event_pool().ThenAllocateAndRecordEvent(
             tuple_table_stream);
@@ -782,12 +793,50 @@ PjRtStreamExecutorClient::BufferFromHostBuffer(
       py_buffer->GetBufferWithUsageHold());
   CHECK(device_buffer.ok());
 
+  const bool stage_transfer =
+      host_buffer_semantics == HostBufferSemantics::kImmutableOnlyDuringCall ||
+      should_stage_host_to_device_transfers() ||
+      !host_and_device_strides_equal;
+
+  // Large staged transfers that are plain copies of the host data are split
+  // into slices, so that staging overlaps with the copies.
+  const Shape& device_shape = py_buffer->on_device_shape();
+  if (stage_transfer && host_and_device_strides_equal &&
+      staging_buffer_pool_ != nullptr &&
+      size >= 2 * staging_buffer_pool_->buffer_size() &&
+      device_shape.is_static() && device_shape.layout().tiles().empty() &&
+      transfer_manager->GetByteSizeRequirement(device_shape) == size) {
+    se::DeviceMemoryBase device_memory = device_buffer->device_memory()[0];
+    auto on_enqueued =
+        [local_device, movable_device_buffer{device_buffer.ToClosure()},
+         on_done_with_host_buffer{std::move(on_done_with_host_buffer)}]() {
+          PjRtStreamExecutorBuffer::ScopedHold device_buffer(
+              movable_device_buffer);
+          std::shared_ptr<BufferSequencingEvent> event =
+              device_buffer->definition_events()[0];
+          TF_CHECK_OK(AddDestinationBufferSynchronization(
+              local_device, std::move(device_buffer), event,
+              local_device->host_to_device_stream()));
+          if (on_done_with_host_buffer) {
+            on_done_with_host_buffer();
+          }
+        };
+    // If the caller only guarantees that `data` is valid for the duration of
+    // the call, the slices are staged by this thread before returning.
+    EnqueuePipelinedHostToDeviceTransfer(
+        data, device_memory, size, local_device->host_to_device_stream(),
+        staging_buffer_pool_.get(),
+        host_buffer_semantics == HostBufferSemantics::kImmutableOnlyDuringCall
+            ? nullptr
+            : thread_pool(),
+        std::move(on_enqueued));
+    return std::unique_ptr<PjRtBuffer>(std::move(py_buffer));
+  }
+
   // If necessary, allocate a host-side buffer for staging host-to-device
   // transfers. On GPU this is a buffer in pinned memory.
   std::shared_ptr<void> staging_buffer;
-  if (host_buffer_semantics == HostBufferSemantics::kImmutableOnlyDuringCall ||
-      should_stage_host_to_device_transfers() ||
-      !host_and_device_strides_equal) {
+  if (stage_transfer) {
     void* ptr = host_memory_allocator()->AllocateRaw(
         tsl::Allocator::kAllocatorAlignment, size);
     staging_buffer = std::shared_ptr<void>(
@@ -902,6 +951,16 @@ PjRtStreamExecutorClient::BufferFromHostBuffer(
   return std::unique_ptr<PjRtBuffer>(std::move(py_buffer));
 }
 
+void PjRtStreamExecutorClient::SetHostToDevicePipelineSliceSize(
+    int64_t slice_size) {
+  if (slice_size > 0) {
+    staging_buffer_pool_ = std::make_unique<StagingBufferPool>(
+        host_memory_allocator_.get(), slice_size, kMaxFreeStagingBuffers);
+  } else {
+    staging_buffer_pool_ = nullptr;
+  }
+}
+
 StatusOr<std::unique_ptr<PjRtBuffer>>
 PjRtStreamExecutorClient::CreateUninitializedBuffer(const Shape& shape,
                                                     PjRtDevice* device) {
@@ -1008,7 +1067,7 @@ PjRtStreamExecutorClient::MakeCrossHostReceiveBuffers(
                       tensorflow::down_cast<PjRtStreamExecutorDevice*>(device)
                           ->GetLocalDeviceState());
   std::shared_ptr<BufferSequencingEvent> definition_event =
-      std::make_shared<BufferSequencingEvent>();
+      BufferSequencingEvent::Create();
   std::vector<std::unique_ptr<PjRtBuffer>> buffers;
   buffers.reserve(shapes.size());
   for (const auto& shape : shapes) {
@@ -1050,7 +1109,7 @@ PjRtStreamExecutorClient::MakeCrossHostReceiveBuffersForGather(
                       tensorflow::down_cast<PjRtStreamExecutorDevice*>(device)
                           ->GetLocalDeviceState());
   std::shared_ptr<BufferSequencingEvent> definition_event =
-      std::make_shared<BufferSequencingEvent>();
+      BufferSequencingEvent::Create();
   std::vector<std::unique_ptr<PjRtBuffer>> buffers;
   buffers.reserve(shapes.size());
   for (int i = 0; i < shapes.size(); ++i) {
@@ -1355,7 +1414,7 @@ PjRtFuture<Status> PjRtStreamExecutorBuffer::ToLiteral(
       [promise](Status status) mutable { promise.Set(status); },
       transfer_metadata_ptr);
 
-  auto usage_event = std::make_shared<BufferSequencingEvent>();
+  auto usage_event = BufferSequencingEvent::Create();
   local_device->event_pool().ThenRecordEvent(stream, event_or.value());
   usage_event->SetSequencingEvent(std::move(event_or).value(), stream);
   // When using the ComputeSynchronized allocation model, retain a reference to
@@ -1759,7 +1818,7 @@ StatusOr<TupleHandle> MakeTupleHelper(
     return event_or.status();
   }
 
-  auto transfer_event = std::make_shared<BufferSequencingEvent>();
+  auto transfer_event = BufferSequencingEvent::Create();
   transfer_event->SetSequencingEvent(std::move(event_or).value(), stream);
   return TupleHandle({std::move(execution_input), std::move(transfer_event)});
 }
@@ -2429,7 +2488,7 @@ PjRtStreamExecutorExecutable::ExecuteHelper(
     }
     return event_or.status();
   }
-  auto definition_event = std::make_shared<BufferSequencingEvent>();
+  auto definition_event = BufferSequencingEvent::Create();
   definition_event->SetSequencingEvent(std::move(event_or).value(), stream);
   std::vector<std::shared_ptr<TrackedDeviceBuffer>> buffers_to_release;
   std::vector<std::unique_ptr<PjRtBuffer>> outputs = MakeOutputBuffers(
@@ -39,6 +39,7 @@ limitations under the License.
 #include "xla/hlo/ir/hlo_module.h"
 #include "xla/layout.h"
 #include "xla/literal.h"
+#include "xla/pjrt/host_to_device_pipeline.h"
 #include "xla/pjrt/local_device_state.h"
 #include "xla/pjrt/pjrt_client.h"
 #include "xla/pjrt/pjrt_future.h"
@@ -285,6 +286,16 @@ class PjRtStreamExecutorClient : public PjRtClient {
     return should_stage_host_to_device_transfers_;
   }
 
+  // Staged host-to-device transfers of arrays that span at least two slices
+  // of `slice_size` bytes are pipelined by EnqueuePipelinedHostToDeviceTransfer
+  // instead of going through a single staging buffer. A `slice_size` of 0
+  // disables pipelining. Pipelining is enabled by default on clients that stage
+  // host-to-device transfers. Must not be called while transfers are pending.
+  void SetHostToDevicePipelineSliceSize(int64_t slice_size);
+  StagingBufferPool* staging_buffer_pool() const {
+    return staging_buffer_pool_.get();
+  }
+
   gpu::GpuExecutableRunOptions* gpu_run_options() const {
     return gpu_run_options_.get();
   }
@@ -342,6 +353,9 @@ class PjRtStreamExecutorClient : public PjRtClient {
 
   // Allocator to be used for staging memory transfers to devices.
   std::unique_ptr<tsl::Allocator> host_memory_allocator_;
+  // Staging buffers of pipelined host-to-device transfers, allocated from
+  // `host_memory_allocator_`. Null if pipelining is disabled.
+  std::unique_ptr<StagingBufferPool> staging_buffer_pool_;
 
   // Device memory allocator. If owned, the allocator must outlive the devices,
   // because it is the device destructor that waits for any outstanding work to
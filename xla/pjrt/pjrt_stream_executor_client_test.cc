@@ -16,6 +16,8 @@ limitations under the License.
 #include "xla/pjrt/pjrt_stream_executor_client.h"
 
 #include <memory>
+#include <numeric>
+#include <optional>
 #include <string>
 #include <utility>
 #include <vector>
@@ -29,11 +31,15 @@ limitations under the License.
 #include "xla/shape_util.h"
 #include "xla/test.h"
 #include "xla/xla_data.pb.h"
+#include "tsl/lib/core/status_test_util.h"
+#include "tsl/platform/status.h"
+#include "tsl/platform/test_benchmark.h"
 
 namespace xla {
 namespace {
 
-xla::StatusOr<std::unique_ptr<PjRtStreamExecutorClient>> GetClient() {
+xla::StatusOr<std::unique_ptr<PjRtStreamExecutorClient>> GetClient(
+    bool should_stage_host_to_device_transfers = false) {
   LocalClient* local_client = xla::ClientLibrary::LocalClientOrDie();
   TF_ASSIGN_OR_RETURN(se::Platform * platform,
                       PlatformUtil::GetPlatform("Host"));
@@ -52,7 +58,7 @@ xla::StatusOr<std::unique_ptr<PjRtStreamExecutorClient>> GetClient() {
   return std::make_unique<PjRtStreamExecutorClient>(
       "cpu", local_client, std::move(devices), /*process_index=*/0,
       /*allocator=*/nullptr, /*host_memory_allocator=*/nullptr,
-      /*should_stage_host_to_device_transfers=*/false,
+      should_stage_host_to_device_transfers,
       /*gpu_run_options=*/nullptr);
 }
 
@@ -114,5 +120,44 @@ TEST(PjRtStreamExecutorClientTest, DonateSameBufferTwice) {
               ::testing::HasSubstr("f(donate(a), donate(a))"));
 }
 
+TEST(PjRtStreamExecutorClientTest, PipelinedHostToDeviceTransfer) {
+  TF_ASSERT_OK_AND_ASSIGN(
+      auto client, GetClient(/*should_stage_host_to_device_transfers=*/true));
+  client->SetHostToDevicePipelineSliceSize(4096);
+  TF_ASSERT_OK_AND_ASSIGN(auto* device, client->LookupDevice(0));
+
+  std::vector<float> data(64 * 1024 + 3);
+  std::iota(data.begin(), data.end(), 0.0f);
+  TF_ASSERT_OK_AND_ASSIGN(
+      auto buffer,
+      client->BufferFromHostBuffer(
+          data.data(), F32, {static_cast<int64_t>(data.size())},
+          /*byte_strides=*/std::nullopt,
+          PjRtClient::HostBufferSemantics::kImmutableUntilTransferCompletes,
+          /*on_done_with_host_buffer=*/nullptr, device));
+  TF_ASSERT_OK_AND_ASSIGN(auto literal, buffer->ToLiteralSync());
+  EXPECT_EQ(literal->data<float>(), absl::MakeConstSpan(data));
+  EXPECT_GT(client->staging_buffer_pool()->num_allocations(), 0);
+}
+
+// Measures the per-dispatch overhead of a tiny computation, which is dominated
+// by the events and buffers that every execution creates.
+void BM_ExecuteLoop(benchmark::State& state) {
+  auto shape = ShapeUtil::MakeScalarShape(F32);
+  auto client = GetClient().value();
+  PjRtDevice* device = client->LookupDevice(0).value();
+  auto buffer = client->CreateUninitializedBuffer(shape, device).value();
+  auto executable =
+      ToyExecutable(*client, shape, [](XlaBuilder& builder) {}).value();
+  ExecuteOptions options;
+  options.untuple_result = true;
+  for (auto s : state) {
+    auto results =
+        executable->Execute({{buffer.get(), buffer.get()}}, options).value();
+    TF_CHECK_OK(results[0][0]->BlockHostUntilReady());
+  }
+}
+BENCHMARK(BM_ExecuteLoop);
+
 }  // namespace
 }  // namespace xla
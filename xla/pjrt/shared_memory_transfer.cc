@@ -0,0 +1,249 @@
+/* Copyright 2023 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "xla/pjrt/shared_memory_transfer.h"
+
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <ctime>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "absl/memory/memory.h"
+#include "absl/strings/match.h"
+#include "absl/strings/numbers.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/str_format.h"
+#include "absl/strings/str_split.h"
+#include "absl/time/time.h"
+#include "xla/util.h"
+#include "tsl/platform/errors.h"
+#include "tsl/platform/random.h"
+
+namespace xla {
+namespace {
+
+constexpr absl::string_view kDescriptorPrefix = "shm";
+constexpr size_t kDataAlignment = 64;
+constexpr size_t kMaxErrorMessageSize = 1024;
+
+enum TransferState : int32_t { kPending = 0, kFinished = 1 };
+
+}  // namespace
+
+// Lives at the start of the segment and is shared by both processes.
+struct SharedMemoryTransfer::Header {
+  pthread_mutex_t mu;
+  pthread_cond_t cv;
+  int32_t state;
+  int32_t code;
+  char message[kMaxErrorMessageSize];
+};
+
+/*static*/ size_t SharedMemoryTransfer::DataOffset() {
+  return RoundUpTo(sizeof(Header), kDataAlignment);
+}
+
+// Maps `mapping_size` bytes of the segment open as `fd` and closes `fd`.
+static StatusOr<void*> MapSegment(int fd, size_t mapping_size,
+                                  absl::string_view name) {
+  void* mapping = mmap(nullptr, mapping_size, PROT_READ | PROT_WRITE,
+                       MAP_SHARED, fd, 0);
+  int mmap_errno = errno;
+  close(fd);
+  if (mapping == MAP_FAILED) {
+    return tsl::errors::IOError(absl::StrCat("mmap of ", name), mmap_errno);
+  }
+  return mapping;
+}
+
+/*static*/ StatusOr<std::unique_ptr<SharedMemoryTransfer>>
+SharedMemoryTransfer::Create(size_t size) {
+  static std::atomic<int64_t> next_id{0};
+  std::string name =
+      absl::StrFormat("/xla_cpu_transfer_%d_%d_%x", getpid(),
+                      next_id.fetch_add(1), tsl::random::New64());
+  int fd = shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+  if (fd < 0) {
+    return tsl::errors::IOError(absl::StrCat("shm_open of ", name), errno);
+  }
+  size_t mapping_size = DataOffset() + size;
+  if (ftruncate(fd, mapping_size) != 0) {
+    Status status =
+        tsl::errors::IOError(absl::StrCat("ftruncate of ", name), errno);
+    close(fd);
+    shm_unlink(name.c_str());
+    return status;
+  }
+  StatusOr<void*> mapping = MapSegment(fd, mapping_size, name);
+  if (!mapping.ok()) {
+    shm_unlink(name.c_str());
+    return mapping.status();
+  }
+
+  // The segment is zero filled, so only the synchronization primitives need
+  // to be initialized. The sender cannot open the segment before it gets the
+  // descriptor, so it never sees them uninitialized.
+  auto* header = static_cast<Header*>(*mapping);
+  pthread_mutexattr_t mutex_attr;
+  pthread_mutexattr_init(&mutex_attr);
+  pthread_mutexattr_setpshared(&mutex_attr, PTHREAD_PROCESS_SHARED);
+  pthread_mutexattr_setrobust(&mutex_attr, PTHREAD_MUTEX_ROBUST);
+  pthread_mutex_init(&header->mu, &mutex_attr);
+  pthread_mutexattr_destroy(&mutex_attr);
+  pthread_condattr_t cond_attr;
+  pthread_condattr_init(&cond_attr);
+  pthread_condattr_setpshared(&cond_attr, PTHREAD_PROCESS_SHARED);
+  // Await's deadline must not move with the wall clock.
+  pthread_condattr_setclock(&cond_attr, CLOCK_MONOTONIC);
+  pthread_cond_init(&header->cv, &cond_attr);
+  pthread_condattr_destroy(&cond_attr);
+  header->state = kPending;
+
+  std::string descriptor =
+      absl::StrCat(kDescriptorPrefix, ":", name, ":", size);
+  return absl::WrapUnique(new SharedMemoryTransfer(
+      std::move(name), std::move(descriptor), *mapping, mapping_size, size,
+      /*owner=*/true));
+}
+
+/*static*/ StatusOr<std::unique_ptr<SharedMemoryTransfer>>
+SharedMemoryTransfer::Open(absl::string_view descriptor) {
+  std::vector<absl::string_view> parts = absl::StrSplit(descriptor, ':');
+  size_t size;
+  if (parts.size() != 3 || parts[0] != kDescriptorPrefix ||
+      !absl::StartsWith(parts[1], "/") || !absl::SimpleAtoi(parts[2], &size)) {
+    return InvalidArgument("Invalid shared memory transfer descriptor: %s",
+                           descriptor);
+  }
+  std::string name(parts[1]);
+  int fd = shm_open(name.c_str(), O_RDWR, 0600);
+  if (fd < 0) {
+    return tsl::errors::IOError(absl::StrCat("shm_open of ", name), errno);
+  }
+  // The open descriptor keeps the segment alive, so its name is no longer
+  // needed.
+  shm_unlink(name.c_str());
+  size_t mapping_size = DataOffset() + size;
+  struct stat stat_buf;
+  if (fstat(fd, &stat_buf) != 0 ||
+      static_cast<size_t>(stat_buf.st_size) != mapping_size) {
+    close(fd);
+    return FailedPrecondition(
+        "Shared memory segment %s does not match its descriptor %s", name,
+        descriptor);
+  }
+  TF_ASSIGN_OR_RETURN(void* mapping, MapSegment(fd, mapping_size, name));
+  return absl::WrapUnique(new SharedMemoryTransfer(
+      std::move(name), std::string(descriptor), mapping, mapping_size, size,
+      /*owner=*/false));
+}
+
+SharedMemoryTransfer::SharedMemoryTransfer(std::string name,
+                                           std::string descriptor,
+                                           void* mapping, size_t mapping_size,
+                                           size_t size, bool owner)
+    : name_(std::move(name)),
+      descriptor_(std::move(descriptor)),
+      mapping_(mapping),
+      mapping_size_(mapping_size),
+      header_(static_cast<Header*>(mapping)),
+      data_(static_cast<char*>(mapping) + DataOffset()),
+      size_(size),
+      owner_(owner) {}
+
+SharedMemoryTransfer::~SharedMemoryTransfer() {
+  Unlink();
+  munmap(mapping_, mapping_size_);
+}
+
+void SharedMemoryTransfer::Unlink() {
+  if (owner_) {
+    shm_unlink(name_.c_str());
+    owner_ = false;
+  }
+}
+
+void SharedMemoryTransfer::Lock() {
+  if (pthread_mutex_lock(&header_->mu) == EOWNERDEAD) {
+    RecoverLocked();
+  }
+}
+
+void SharedMemoryTransfer::RecoverLocked() {
+  pthread_mutex_consistent(&header_->mu);
+  FinishLocked(tsl::errors::Aborted(
+      "The peer process of a shared memory transfer died"));
+}
+
+void SharedMemoryTransfer::FinishLocked(const Status& status) {
+  if (header_->state != kPending) {
+    return;
+  }
+  header_->code = static_cast<int32_t>(status.code());
+  size_t message_size =
+      std::min(status.error_message().size(), kMaxErrorMessageSize - 1);
+  std::memcpy(header_->message, status.error_message().data(), message_size);
+  header_->message[message_size] = '\0';
+  header_->state = kFinished;
+  pthread_cond_broadcast(&header_->cv);
+}
+
+void SharedMemoryTransfer::Finish(Status status) {
+  Lock();
+  FinishLocked(status);
+  pthread_mutex_unlock(&header_->mu);
+}
+
+Status SharedMemoryTransfer::Await(absl::Duration timeout) {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  struct timespec deadline =
+      absl::ToTimespec(absl::DurationFromTimespec(now) + timeout);
+  Lock();
+  while (header_->state == kPending) {
+    int result = pthread_cond_timedwait(&header_->cv, &header_->mu, &deadline);
+    if (result == EOWNERDEAD) {
+      RecoverLocked();
+    } else if (result == ETIMEDOUT) {
+      FinishLocked(tsl::errors::DeadlineExceeded(absl::StrCat(
+          "Shared memory transfer did not finish within ",
+          absl::FormatDuration(timeout))));
+    }
+  }
+  Status status;
+  if (header_->code != 0) {
+    status = Status(static_cast<absl::StatusCode>(header_->code),
+                    header_->message);
+  }
+  pthread_mutex_unlock(&header_->mu);
+  // The sender has already removed the name if it opened the segment, and
+  // must not open it once the transfer has finished without it.
+  Unlink();
+  return status;
+}
+
+}  // namespace xla
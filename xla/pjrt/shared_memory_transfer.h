@@ -0,0 +1,109 @@
+/* Copyright 2023 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef TENSORFLOW_COMPILER_XLA_PJRT_SHARED_MEMORY_TRANSFER_H_
+#define TENSORFLOW_COMPILER_XLA_PJRT_SHARED_MEMORY_TRANSFER_H_
+
+#include <cstddef>
+#include <memory>
+#include <string>
+
+#include "absl/strings/string_view.h"
+#include "absl/time/time.h"
+#include "xla/status.h"
+#include "xla/statusor.h"
+
+namespace xla {
+
+// A one-shot transfer of a buffer between two processes on the same host
+// through a POSIX shared memory segment.
+//
+// The receiver creates the segment and sends its descriptor to the sender,
+// which opens the segment, writes the data and calls Finish. The receiver can
+// use the data in place once Await has returned OK, so the data is copied
+// exactly once, from the sender's buffer into the segment. Besides the data,
+// the segment holds a process-shared mutex and condition variable that signal
+// completion, and the status that the transfer finished with. The mutex is
+// robust: if a process dies while holding it, the transfer fails with ABORTED
+// instead of blocking the other process forever.
+class SharedMemoryTransfer {
+ public:
+  // Creates a segment for `size` bytes of data. Called by the receiver.
+  static StatusOr<std::unique_ptr<SharedMemoryTransfer>> Create(size_t size);
+
+  // Opens the segment named by a descriptor returned by Create and removes its
+  // name, so that the segment is freed even if the receiver dies, and can only
+  // be opened once. Called by the sender.
+  static StatusOr<std::unique_ptr<SharedMemoryTransfer>> Open(
+      absl::string_view descriptor);
+
+  ~SharedMemoryTransfer();
+
+  SharedMemoryTransfer(const SharedMemoryTransfer&) = delete;
+  SharedMemoryTransfer& operator=(const SharedMemoryTransfer&) = delete;
+
+  // Serialized descriptor that the sender passes to Open.
+  const std::string& descriptor() const { return descriptor_; }
+
+  // The data, aligned to at least 64 bytes.
+  void* data() const { return data_; }
+  size_t size() const { return size_; }
+
+  // Marks the transfer as finished with `status` and wakes up the receiver.
+  // Only the first call has an effect, so that the receiver can also call it
+  // to cancel a transfer that was never started.
+  void Finish(Status status);
+
+  // Blocks until Finish has been called in either process and returns the
+  // status that it was called with. If it has not been called within
+  // `timeout`, finishes the transfer with DEADLINE_EXCEEDED. Once it has
+  // returned, the name of the segment is removed, but the mapping stays valid
+  // until this object is destroyed.
+  Status Await(absl::Duration timeout);
+
+ private:
+  struct Header;
+
+  // Offset of the data from the start of the segment.
+  static size_t DataOffset();
+
+  SharedMemoryTransfer(std::string name, std::string descriptor, void* mapping,
+                       size_t mapping_size, size_t size, bool owner);
+
+  // Locks the header mutex, recovering it if its owner died.
+  void Lock();
+
+  // Makes the header mutex consistent after its owner died while holding it,
+  // and fails the transfer, since the owner may have left it half finished.
+  void RecoverLocked();
+
+  void FinishLocked(const Status& status);
+
+  // Removes the name of the segment if this process created it.
+  void Unlink();
+
+  std::string name_;
+  std::string descriptor_;
+  void* mapping_;
+  size_t mapping_size_;
+  Header* header_;
+  void* data_;
+  size_t size_;
+  bool owner_;
+};
+
+}  // namespace xla
+
+#endif  // TENSORFLOW_COMPILER_XLA_PJRT_SHARED_MEMORY_TRANSFER_H_
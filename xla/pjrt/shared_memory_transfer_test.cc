@@ -0,0 +1,100 @@
+/* Copyright 2023 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "xla/pjrt/shared_memory_transfer.h"
+
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <numeric>
+#include <string>
+#include <vector>
+
+#include "absl/time/time.h"
+#include "tsl/lib/core/status_test_util.h"
+#include "tsl/platform/env.h"
+#include "tsl/platform/errors.h"
+#include "tsl/platform/test.h"
+
+namespace xla {
+namespace {
+
+TEST(SharedMemoryTransferTest, Transfer) {
+  std::vector<int32_t> data(1000);
+  std::iota(data.begin(), data.end(), 0);
+  TF_ASSERT_OK_AND_ASSIGN(auto receiver, SharedMemoryTransfer::Create(
+                                             data.size() * sizeof(int32_t)));
+  EXPECT_EQ(reinterpret_cast<uintptr_t>(receiver->data()) % 64, 0);
+
+  std::unique_ptr<tsl::Thread> sender_thread(tsl::Env::Default()->StartThread(
+      {}, "sender", [&, descriptor = receiver->descriptor()]() {
+        TF_ASSERT_OK_AND_ASSIGN(auto sender,
+                                SharedMemoryTransfer::Open(descriptor));
+        ASSERT_EQ(sender->size(), data.size() * sizeof(int32_t));
+        std::memcpy(sender->data(), data.data(), sender->size());
+        sender->Finish(OkStatus());
+      }));
+  TF_ASSERT_OK(receiver->Await(absl::InfiniteDuration()));
+  EXPECT_EQ(std::memcmp(receiver->data(), data.data(), receiver->size()), 0);
+
+  // The segment can no longer be opened once the transfer has finished.
+  EXPECT_FALSE(SharedMemoryTransfer::Open(receiver->descriptor()).ok());
+}
+
+TEST(SharedMemoryTransferTest, Error) {
+  TF_ASSERT_OK_AND_ASSIGN(auto receiver, SharedMemoryTransfer::Create(16));
+  TF_ASSERT_OK_AND_ASSIGN(auto sender,
+                          SharedMemoryTransfer::Open(receiver->descriptor()));
+  sender->Finish(tsl::errors::Internal("send failed"));
+  // Only the first call has an effect.
+  sender->Finish(OkStatus());
+  Status status = receiver->Await(absl::InfiniteDuration());
+  EXPECT_EQ(status.code(), tsl::error::INTERNAL);
+  EXPECT_EQ(status.error_message(), "send failed");
+}
+
+TEST(SharedMemoryTransferTest, OpenRemovesName) {
+  TF_ASSERT_OK_AND_ASSIGN(auto receiver, SharedMemoryTransfer::Create(16));
+  TF_ASSERT_OK_AND_ASSIGN(auto sender,
+                          SharedMemoryTransfer::Open(receiver->descriptor()));
+  EXPECT_FALSE(SharedMemoryTransfer::Open(receiver->descriptor()).ok());
+  sender->Finish(OkStatus());
+  TF_EXPECT_OK(receiver->Await(absl::InfiniteDuration()));
+}
+
+TEST(SharedMemoryTransferTest, Timeout) {
+  TF_ASSERT_OK_AND_ASSIGN(auto receiver, SharedMemoryTransfer::Create(16));
+  TF_ASSERT_OK_AND_ASSIGN(auto sender,
+                          SharedMemoryTransfer::Open(receiver->descriptor()));
+  Status status = receiver->Await(absl::Milliseconds(10));
+  EXPECT_EQ(status.code(), tsl::error::DEADLINE_EXCEEDED);
+  // A late sender cannot override the timeout.
+  sender->Finish(OkStatus());
+  EXPECT_EQ(receiver->Await(absl::InfiniteDuration()).code(),
+            tsl::error::DEADLINE_EXCEEDED);
+}
+
+TEST(SharedMemoryTransferTest, InvalidDescriptor) {
+  EXPECT_FALSE(SharedMemoryTransfer::Open("").ok());
+  EXPECT_FALSE(SharedMemoryTransfer::Open("shm:/xla_cpu_transfer_x").ok());
+  TF_ASSERT_OK_AND_ASSIGN(auto receiver, SharedMemoryTransfer::Create(16));
+  // The size must match the segment.
+  std::string descriptor = receiver->descriptor();
+  descriptor.back() = '7';
+  EXPECT_FALSE(SharedMemoryTransfer::Open(descriptor).ok());
+}
+
+}  // namespace
+}  // namespace xla
@@ -35,6 +35,7 @@ limitations under the License.
 #include "absl/container/flat_hash_map.h"
 #include "absl/strings/string_view.h"
 #include "absl/synchronization/mutex.h"
+#include "absl/time/time.h"
 #include "absl/types/span.h"
 #include "unsupported/Eigen/CXX11/Tensor"  // from @eigen_archive
 #include "xla/client/executable_build_options.h"
@@ -44,12 +45,14 @@ limitations under the License.
 #include "xla/pjrt/pjrt_client.h"
 #include "xla/pjrt/pjrt_future.h"
 #include "xla/pjrt/semaphore.h"
+#include "xla/pjrt/shared_memory_transfer.h"
 #include "xla/pjrt/tracked_tfrt_cpu_device_buffer.h"
 #include "xla/pjrt/utils.h"
 #include "xla/primitive_util.h"
 #include "xla/service/buffer_assignment.h"
 #include "xla/service/computation_placer.h"
 #include "xla/service/cpu/cpu_executable.h"
+#include "xla/service/cpu/cpu_performance_model.h"
 #include "xla/service/cpu/cpu_xfeed.h"
 #include "xla/service/dump.h"
 #include "xla/service/executable.h"
@@ -58,6 +61,7 @@ limitations under the License.
 #include "xla/statusor.h"
 #include "xla/xla_data.pb.h"
 #include "tsl/platform/denormal.h"
+#include "tsl/platform/env.h"
 #include "tsl/platform/setround.h"
 #include "tsl/profiler/lib/connected_traceme.h"
 #include "tfrt/host_context/async_value_ref.h"  // from @tf_runtime
@@ -97,6 +101,9 @@ class MarkEventReadyOnExit {
 
 static const char kCpuPlatformName[] = "cpu";
 static constexpr size_t kSmallDataTransferByteSize = 102400;  // 100 KiB
+// How long a cross-host receive buffer waits for its sender before it fails.
+// Deleting the buffer or canceling the receive ends the wait earlier.
+static constexpr absl::Duration kCrossHostReceiveTimeout = absl::Hours(1);
 
 static tfrt::AsyncValueRef<CpuEvent> GetOrCreateReadyEvent() {
   static const auto* ready_event = new tfrt::AsyncValueRef<CpuEvent>(
@@ -319,6 +326,27 @@ StatusOr<std::string> TfrtCpuExecutable::SerializeExecutable() const {
   return serialized;
 }
 
+StatusOr<const cpu::CpuPerformanceModel*> TfrtCpuClient::GetPerformanceModel(
+    const HloModule& module) {
+  const std::string& performance_profile =
+      module.config().debug_options().xla_cpu_performance_profile();
+  if (performance_profile.empty()) {
+    return nullptr;
+  }
+  absl::MutexLock lock(&performance_models_mu_);
+  std::unique_ptr<const cpu::CpuPerformanceModel>& performance_model =
+      performance_models_[performance_profile];
+  if (performance_model == nullptr) {
+    // Like CpuCompiler, fail rather than fall back to the heuristics when the
+    // profile can't be loaded.
+    TF_ASSIGN_OR_RETURN(cpu::CpuPerformanceModel loaded,
+                        cpu::CpuPerformanceModel::Load(performance_profile));
+    performance_model =
+        std::make_unique<const cpu::CpuPerformanceModel>(std::move(loaded));
+  }
+  return performance_model.get();
+}
+
 StatusOr<std::unique_ptr<PjRtLoadedExecutable>>
 TfrtCpuClient::DeserializeExecutable(absl::string_view serialized,
                                      std::optional<CompileOptions> options) {
@@ -400,12 +428,14 @@ TfrtCpuClient::DeserializeExecutable(absl::string_view serialized,
     }
   }
 
+  TF_ASSIGN_OR_RETURN(const cpu::CpuPerformanceModel* performance_model,
+                      GetPerformanceModel(executable->module()));
   auto tfrt_cpu_executable = std::make_unique<TfrtCpuExecutable>(
       num_replicas, num_partitions, std::move(device_assignment),
       options->parameter_is_tupled_arguments, std::move(executable),
       result_slice.index(), std::move(result_buffer_indices),
       std::move(addressable_device_logical_ids), std::move(addressable_devices),
-      this);
+      this, performance_model);
   TF_RETURN_IF_ERROR(tfrt_cpu_executable->SetUpDonation(
       options->parameter_is_tupled_arguments));
 
@@ -527,12 +557,14 @@ StatusOr<std::unique_ptr<PjRtLoadedExecutable>> TfrtCpuClient::Compile(
       FindResultBufferAllocationIndex(cpu_executable_ptr->buffer_assignment(),
                                       cpu_executable->module()));
 
+  TF_ASSIGN_OR_RETURN(const cpu::CpuPerformanceModel* performance_model,
+                      GetPerformanceModel(cpu_executable->module()));
   auto executable = std::make_unique<TfrtCpuExecutable>(
       num_replicas, num_partitions, std::move(device_assignment),
       options.parameter_is_tupled_arguments, std::move(cpu_executable),
       result_slice.index(), std::move(result_buffer_indices),
       std::move(addressable_device_logical_ids), std::move(addressable_devices),
-      this);
+      this, performance_model);
   TF_RETURN_IF_ERROR(
       executable->SetUpDonation(options.parameter_is_tupled_arguments));
 
@@ -598,6 +630,88 @@ StatusOr<std::unique_ptr<PjRtBuffer>> TfrtCpuClient::CreateViewOfDeviceBuffer(
       tensorflow::down_cast<TfrtCpuDevice*>(device)));
 }
 
+StatusOr<std::vector<std::unique_ptr<PjRtBuffer>>>
+TfrtCpuClient::MakeCrossHostReceiveBuffers(absl::Span<const Shape> shapes,
+                                           PjRtDevice* device,
+                                           PjRtCrossHostRecvNotifier notifier) {
+  tsl::profiler::TraceMe traceme("TfrtCpuClient::MakeCrossHostReceiveBuffers");
+  for (const Shape& shape : shapes) {
+    if (!shape.IsArray()) {
+      return Unimplemented(
+          "MakeCrossHostReceiveBuffers only supports arrays, got %s",
+          shape.ToString());
+    }
+  }
+
+  // Each buffer is received in place in a shared memory segment, which stays
+  // mapped until the buffer is deleted. Deleting the buffer cancels a transfer
+  // that has not finished yet.
+  std::vector<std::shared_ptr<SharedMemoryTransfer>> transfers;
+  std::vector<tfrt::AsyncValueRef<CpuEvent>> definition_events;
+  std::vector<std::unique_ptr<PjRtBuffer>> buffers;
+  PjRtCrossHostRecvState state;
+  transfers.reserve(shapes.size());
+  definition_events.reserve(shapes.size());
+  buffers.reserve(shapes.size());
+  state.descriptors.reserve(shapes.size());
+  for (const Shape& shape : shapes) {
+    TF_ASSIGN_OR_RETURN(
+        std::shared_ptr<SharedMemoryTransfer> transfer,
+        SharedMemoryTransfer::Create(ShapeUtil::ByteSizeOf(shape)));
+    absl::InlinedVector<std::shared_ptr<MaybeOwningCpuMemory>, 4> leaf_buffers;
+    leaf_buffers.push_back(std::make_shared<MaybeOwningCpuMemory>(
+        transfer->data(), transfer->size()));
+    auto definition_event = tfrt::MakeConstructedAsyncValueRef<CpuEvent>();
+    auto tracked_device_buffer = std::make_unique<TrackedTfrtCpuDeviceBuffer>(
+        /*is_tuple=*/false, std::move(leaf_buffers), definition_event.CopyRef(),
+        /*on_delete_callback=*/[transfer]() {});
+    buffers.push_back(std::make_unique<TfrtCpuBuffer>(
+        shape, std::move(tracked_device_buffer), this,
+        tensorflow::down_cast<TfrtCpuDevice*>(device),
+        /*on_delete=*/[transfer]() {
+          transfer->Finish(Cancelled("Cross-host receive buffer was deleted"));
+        }));
+    state.descriptors.emplace_back();
+    state.descriptors.back().serialized_descriptors.push_back(
+        transfer->descriptor());
+    transfers.push_back(std::move(transfer));
+    definition_events.push_back(std::move(definition_event));
+  }
+
+  state.cancel_notifier = [transfers](absl::string_view serialized_descriptor,
+                                      Status reason,
+                                      std::function<void(Status)> on_canceled) {
+    for (const auto& transfer : transfers) {
+      if (transfer->descriptor() == serialized_descriptor) {
+        transfer->Finish(std::move(reason));
+        on_canceled(OkStatus());
+        return;
+      }
+    }
+    on_canceled(InvalidArgument("Unknown cross-host receive descriptor: %s",
+                                serialized_descriptor));
+  };
+
+  // Waiting for a sender blocks, so it happens on a thread of its own rather
+  // than on the client's thread pool. Each buffer becomes ready as soon as its
+  // own transfer has finished.
+  for (int i = 0; i < transfers.size(); ++i) {
+    tsl::Env::Default()->SchedClosure(
+        [transfer = transfers[i],
+         definition_event = std::move(definition_events[i])]() mutable {
+          Status status = transfer->Await(kCrossHostReceiveTimeout);
+          if (status.ok()) {
+            definition_event.SetStateConcrete();
+          } else {
+            definition_event.SetError(ToAbslStatus(status));
+          }
+        });
+  }
+
+  notifier(std::move(state));
+  return buffers;
+}
+
 StatusOr<std::unique_ptr<PjRtBuffer>> TfrtCpuClient::CreateUninitializedBuffer(
     const Shape& shape, PjRtDevice* device) {
   tsl::profiler::TraceMe traceme("TfrtCpuClient::CreateUninitializedBuffer");
@@ -767,10 +881,12 @@ StatusOr<std::unique_ptr<PjRtBuffer>> TfrtCpuClient::BufferFromHostLiteral(
 TfrtCpuBuffer::TfrtCpuBuffer(
     Shape on_device_shape,
     std::unique_ptr<TrackedTfrtCpuDeviceBuffer> tracked_device_buffer,
-    TfrtCpuClient* client, TfrtCpuDevice* device)
+    TfrtCpuClient* client, TfrtCpuDevice* device,
+    std::function<void()> on_delete)
     : client_(client),
       on_device_shape_(std::move(on_device_shape)),
       device_(device),
+      on_delete_(std::move(on_delete)),
       tracked_device_buffer_(std::move(tracked_device_buffer)) {}
 
 TfrtCpuBuffer::~TfrtCpuBuffer() {
@@ -866,6 +982,7 @@ void TfrtCpuBuffer::AbortDonation(
 void TfrtCpuBuffer::Delete() {
   auto device_buffer = ReleaseBufferLocked();
   if (device_buffer == nullptr) return;
+  if (on_delete_) on_delete_();
 
   // Now that all holds have completed and no more can be added, we can get
   // the final set of usage events.
@@ -1210,6 +1327,75 @@ StatusOr<std::unique_ptr<PjRtBuffer>> TfrtCpuBuffer::CopyToDevice(
       client(), tensorflow::down_cast<TfrtCpuDevice*>(dst_device)));
 }
 
+void TfrtCpuBuffer::CopyToRemoteDevice(
+    PjRtFuture<StatusOr<std::string>> serialized_descriptor,
+    RemoteSendCallback on_done) {
+  tsl::profiler::TraceMe traceme("TfrtCpuBuffer::CopyToRemoteDevice");
+  if (!on_device_shape_.IsArray()) {
+    on_done(Unimplemented("CopyToRemoteDevice only supports arrays, got %s",
+                          on_device_shape_.ToString()),
+            /*sends_were_enqueued=*/false);
+    return;
+  }
+  auto usage_event = tfrt::MakeConstructedAsyncValueRef<CpuEvent>();
+  auto* src_device_buffer = AcquireUsage(usage_event);
+  if (src_device_buffer == nullptr) {
+    on_done(InvalidArgument(
+                "CopyToRemoteDevice called on deleted or donated buffer"),
+            /*sends_were_enqueued=*/false);
+    return;
+  }
+  MarkEventReadyOnExit ready_on_exit(std::move(usage_event));
+
+  serialized_descriptor.OnReady(
+      [pool = client()->pjrt_client_thread_pool(),
+       src_buffer = src_device_buffer->Buffers()[0],
+       src_definition_event = src_device_buffer->definition_event().CopyRef(),
+       ready_on_exit = std::move(ready_on_exit),
+       on_done = std::move(on_done)](
+          StatusOr<std::string> descriptor) mutable {
+        if (!descriptor.ok()) {
+          on_done(descriptor.status(), /*sends_were_enqueued=*/false);
+          return;
+        }
+        StatusOr<std::unique_ptr<SharedMemoryTransfer>> transfer =
+            SharedMemoryTransfer::Open(*descriptor);
+        if (!transfer.ok()) {
+          on_done(transfer.status(), /*sends_were_enqueued=*/false);
+          return;
+        }
+        if ((*transfer)->size() != src_buffer->size()) {
+          on_done(InvalidArgument("CopyToRemoteDevice of %d bytes into a "
+                                  "receive buffer of %d bytes",
+                                  src_buffer->size(), (*transfer)->size()),
+                  /*sends_were_enqueued=*/false);
+          return;
+        }
+
+        auto copy_task = [src_buffer = std::move(src_buffer),
+                          transfer = *std::move(transfer),
+                          src_definition_event, on_done = std::move(on_done),
+                          ready_on_exit = std::move(ready_on_exit)]() {
+          tsl::profiler::TraceMe traceme("Remote Send Dispatch");
+          if (auto* error = src_definition_event.GetErrorIfPresent()) {
+            // The error is propagated to the receive buffer.
+            Status status = InternalError("Error CopyToRemoteDevice: %s",
+                                          error->message());
+            transfer->Finish(status);
+            on_done(status, /*sends_were_enqueued=*/true);
+            return;
+          }
+          std::memcpy(transfer->data(), src_buffer->data(), src_buffer->size());
+          transfer->Finish(OkStatus());
+          on_done(OkStatus(), /*sends_were_enqueued=*/true);
+        };
+        src_definition_event.AndThen(
+            [pool, copy_task = std::move(copy_task)]() mutable {
+              EnqueueWork(pool, std::move(copy_task));
+            });
+      });
+}
+
 PjRtFuture<Status> TfrtCpuBuffer::GetReadyFuture() {
   tfrt::AsyncValueRef<CpuEvent> definition_event;
   {
@@ -1269,7 +1455,8 @@ TfrtCpuExecutable::TfrtCpuExecutable(
     BufferAllocation::Index result_buffer_index,
     absl::InlinedVector<BufferAllocation::Index, 4> result_buffer_indices,
     std::vector<LogicalDeviceIds> addressable_device_logical_ids,
-    std::vector<PjRtDevice*> addressable_devices, TfrtCpuClient* client)
+    std::vector<PjRtDevice*> addressable_devices, TfrtCpuClient* client,
+    const cpu::CpuPerformanceModel* performance_model)
     : client_(client),
       num_replicas_(num_replicas),
       num_partitions_(num_partitions),
@@ -1281,13 +1468,30 @@ TfrtCpuExecutable::TfrtCpuExecutable(
       addressable_device_logical_ids_(
           std::move(addressable_device_logical_ids)),
       addressable_devices_(std::move(addressable_devices)) {
+  const HloModule& module = cpu_executable_->module();
   auto hlo_cost_analysis =
       std::make_unique<HloCostAnalysis>(cpu::CpuExecutable::ShapeSizeBytes);
-  // Cache to avoid std::map lookup in flop_count() on critical path.
-  // The magic constant 1000 is determined by correlating computation with flop
-  // estimate. It is a crude heuristic to find computation less than the thread
-  // context switch time (~5us).
-  cheap_computation_ = hlo_cost_analysis->flop_count() < 1000;
+  Status cost_status =
+      module.entry_computation()->Accept(hlo_cost_analysis.get());
+  if (!cost_status.ok()) {
+    // Computations the cost analysis can't handle (e.g. custom calls) are
+    // assumed to be expensive.
+    VLOG(1) << "Cost analysis failed: " << cost_status;
+    cheap_computation_ = false;
+  } else if (performance_model != nullptr) {
+    // A computation is cheap if running it takes less time than handing it off
+    // to another thread.
+    cheap_computation_ =
+        performance_model->EstimateRunTime(*module.entry_computation(),
+                                           *hlo_cost_analysis) <
+        performance_model->task_dispatch_time();
+  } else {
+    // Cache to avoid std::map lookup in flop_count() on critical path.
+    // The magic constant 1000 is determined by correlating computation with
+    // flop estimate. It is a crude heuristic to find computation less than the
+    // thread context switch time (~5us).
+    cheap_computation_ = hlo_cost_analysis->flop_count() < 1000;
+  }
 
   const auto& computation_layout =
       cpu_executable_->module().entry_computation_layout();
@@ -41,6 +41,7 @@ limitations under the License.
 #include "xla/service/computation_placer.h"
 #include "xla/service/cpu/cpu_compiler.h"
 #include "xla/service/cpu/cpu_executable.h"
+#include "xla/service/cpu/cpu_performance_model.h"
 #include "xla/service/executable.h"
 #include "xla/service/hlo.pb.h"
 #include "xla/service/hlo_cost_analysis.h"
@@ -190,12 +191,12 @@ class TfrtCpuClient final : public PjRtClient {
   StatusOr<std::unique_ptr<PjRtBuffer>> BufferFromHostLiteral(
       const LiteralSlice& literal, PjRtDevice* device) override;
 
+  // Receives arrays from TfrtCpuBuffer::CopyToRemoteDevice in other processes
+  // on the same host, through POSIX shared memory.
   StatusOr<std::vector<std::unique_ptr<PjRtBuffer>>>
   MakeCrossHostReceiveBuffers(absl::Span<const Shape> shapes,
                               PjRtDevice* device,
-                              PjRtCrossHostRecvNotifier notifier) override {
-    return Unimplemented("MakeCrossHostReceiveBuffers not implemented.");
-  }
+                              PjRtCrossHostRecvNotifier notifier) override;
 
   StatusOr<std::vector<std::unique_ptr<PjRtBuffer>>>
   MakeCrossHostReceiveBuffersForGather(
@@ -243,6 +244,12 @@ class TfrtCpuClient final : public PjRtClient {
   }
 
  private:
+  // Returns the performance model for the xla_cpu_performance_profile that
+  // `module` was compiled with, or nullptr if it has none. Each profile is
+  // loaded once and owned by the client.
+  StatusOr<const cpu::CpuPerformanceModel*> GetPerformanceModel(
+      const HloModule& module);
+
   int process_index_;
   // Includes all devices, including non-addressable devices.
   std::vector<std::unique_ptr<TfrtCpuDevice>> owned_devices_;
@@ -280,14 +287,24 @@ class TfrtCpuClient final : public PjRtClient {
   // major-to-minor layout.
   absl::Mutex transpose_mu_;
   TransposePlanCache transpose_cache_ ABSL_GUARDED_BY(transpose_mu_);
+
+  // Performance models keyed by the path of their profile.
+  absl::Mutex performance_models_mu_;
+  absl::flat_hash_map<std::string,
+                      std::unique_ptr<const cpu::CpuPerformanceModel>>
+      performance_models_ ABSL_GUARDED_BY(performance_models_mu_);
 };
 
 class TfrtCpuBuffer final : public PjRtBuffer {
  public:
+  // `on_delete`, if set, is called by Delete() before it waits for the
+  // definition event, e.g. to cancel the transfer that would define the
+  // buffer.
   TfrtCpuBuffer(
       Shape on_device_shape,
       std::unique_ptr<TrackedTfrtCpuDeviceBuffer> tracked_device_buffer,
-      TfrtCpuClient* client, TfrtCpuDevice* device);
+      TfrtCpuClient* client, TfrtCpuDevice* device,
+      std::function<void()> on_delete = nullptr);
   ~TfrtCpuBuffer() override;
 
   TfrtCpuBuffer(const TfrtCpuBuffer&) = delete;
@@ -324,12 +341,11 @@ class TfrtCpuBuffer final : public PjRtBuffer {
   StatusOr<std::unique_ptr<PjRtBuffer>> CopyToDevice(
       PjRtDevice* dst_device) override;
 
+  // Sends an array to a receive buffer made by MakeCrossHostReceiveBuffers in
+  // another process on the same host.
   void CopyToRemoteDevice(
       PjRtFuture<StatusOr<std::string>> serialized_descriptor,
-      RemoteSendCallback on_done) override {
-    on_done(Unimplemented("CopyToRemoteDevice not implemented."),
-            /*sends_were_enqueued=*/false);
-  }
+      RemoteSendCallback on_done) override;
 
   void CopyToRemoteDeviceScattered(
       PjRtFuture<StatusOr<std::vector<std::string>>> serialized_descriptors,
@@ -453,6 +469,7 @@ class TfrtCpuBuffer final : public PjRtBuffer {
   TfrtCpuClient* client_;
   const Shape on_device_shape_;
   TfrtCpuDevice* const device_;
+  const std::function<void()> on_delete_;
 
   mutable absl::Mutex mu_;
   std::unique_ptr<TrackedTfrtCpuDeviceBuffer> tracked_device_buffer_
@@ -472,6 +489,8 @@ class TfrtCpuBuffer final : public PjRtBuffer {
 
 class TfrtCpuExecutable final : public PjRtLoadedExecutable {
  public:
+  // `performance_model`, if not null, must outlive the executable and decides
+  // whether the program is cheap enough to run inline.
   TfrtCpuExecutable(
       int num_replicas, int num_partitions,
       std::shared_ptr<DeviceAssignment> device_assignment,
@@ -480,7 +499,8 @@ class TfrtCpuExecutable final : public PjRtLoadedExecutable {
       BufferAllocation::Index result_buffer_index,
       absl::InlinedVector<BufferAllocation::Index, 4> result_buffer_indices,
       std::vector<LogicalDeviceIds> addressable_device_logical_ids,
-      std::vector<PjRtDevice*> addressable_devices, TfrtCpuClient* client);
+      std::vector<PjRtDevice*> addressable_devices, TfrtCpuClient* client,
+      const cpu::CpuPerformanceModel* performance_model = nullptr);
 
   ~TfrtCpuExecutable() override = default;
 
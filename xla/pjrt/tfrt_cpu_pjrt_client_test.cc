@@ -20,11 +20,16 @@ limitations under the License.
 
 #include <gmock/gmock.h>
 #include <gtest/gtest.h>
+#include "absl/time/time.h"
 #include "xla/literal_util.h"
+#include "xla/pjrt/shared_memory_transfer.h"
 #include "xla/service/custom_call_status.h"
 #include "xla/service/custom_call_target_registry.h"
 #include "xla/service/hlo_parser.h"
+#include "tsl/lib/core/status_test_util.h"
+#include "tsl/platform/path.h"
 #include "tsl/platform/env.h"
+#include "tsl/platform/errors.h"
 #include "tsl/platform/file_system.h"
 #include "tsl/platform/test.h"
 
@@ -143,5 +148,116 @@ TEST(TfrtCpuClientTest, HloSnapshot) {
       LiteralUtil::CreateR2<float>({{11.0, 22.0}, {33.0, 44.0}, {55.0, 66.0}}));
 }
 
+TEST(TfrtCpuClientTest, MissingPerformanceProfileFailsCompile) {
+  constexpr char kProgram[] = R"(
+    HloModule add
+    ENTRY add {
+      x = f32[3,2] parameter(0)
+      y = f32[3,2] parameter(1)
+      ROOT add = f32[3,2] add(x, y)
+    })";
+
+  TF_ASSERT_OK_AND_ASSIGN(auto client, GetTfrtCpuClient(/*asynchronous=*/true));
+  TF_ASSERT_OK_AND_ASSIGN(auto hlo_module,
+                          ParseAndReturnUnverifiedModule(kProgram, {}));
+
+  xla::CompileOptions options;
+  options.executable_build_options.mutable_debug_options()
+      ->set_xla_cpu_performance_profile(tsl::io::JoinPath(
+          tsl::testing::TmpDir(), "missing_performance_profile.pbtxt"));
+  XlaComputation xla_computation(hlo_module->ToProto());
+  EXPECT_FALSE(client->Compile(xla_computation, options).ok());
+}
+
+TEST(TfrtCpuClientTest, CrossHostTransfer) {
+  TF_ASSERT_OK_AND_ASSIGN(auto src_client,
+                          GetTfrtCpuClient(/*asynchronous=*/true));
+  TF_ASSERT_OK_AND_ASSIGN(auto dst_client,
+                          GetTfrtCpuClient(/*asynchronous=*/true));
+  std::vector<float> data{1.0, 2.0, 3.0, 4.0, 5.0, 6.0};
+  Shape shape = ShapeUtil::MakeShape(F32, {3, 2});
+  TF_ASSERT_OK_AND_ASSIGN(
+      auto src_buffer,
+      src_client->BufferFromHostBuffer(
+          data.data(), shape.element_type(), shape.dimensions(),
+          /*byte_strides=*/std::nullopt,
+          PjRtClient::HostBufferSemantics::kImmutableOnlyDuringCall, nullptr,
+          src_client->addressable_devices()[0]));
+
+  auto descriptor = PjRtFuture<StatusOr<std::string>>::CreatePromise();
+  TF_ASSERT_OK_AND_ASSIGN(
+      auto dst_buffers,
+      dst_client->MakeCrossHostReceiveBuffers(
+          {shape}, dst_client->addressable_devices()[0],
+          [&](StatusOr<PjRtCrossHostRecvState> state) {
+            TF_ASSERT_OK(state.status());
+            ASSERT_EQ(state->descriptors.size(), 1);
+            descriptor.Set(state->descriptors[0].serialized_descriptors[0]);
+          }));
+  ASSERT_EQ(dst_buffers.size(), 1);
+
+  auto send_status = PjRtFuture<Status>::CreatePromise();
+  src_buffer->CopyToRemoteDevice(
+      PjRtFuture<StatusOr<std::string>>(descriptor),
+      [&](Status status, bool sends_were_enqueued) {
+        EXPECT_TRUE(sends_were_enqueued);
+        send_status.Set(status);
+      });
+  TF_ASSERT_OK(PjRtFuture<Status>(send_status).Await());
+  TF_ASSERT_OK_AND_ASSIGN(auto literal, dst_buffers[0]->ToLiteralSync());
+  EXPECT_EQ(*literal, LiteralUtil::CreateR2<float>(
+                          {{1.0, 2.0}, {3.0, 4.0}, {5.0, 6.0}}));
+}
+
+TEST(TfrtCpuClientTest, CrossHostTransferCanceled) {
+  TF_ASSERT_OK_AND_ASSIGN(auto client, GetTfrtCpuClient(/*asynchronous=*/true));
+  Shape shape = ShapeUtil::MakeShape(F32, {3, 2});
+  PjRtCrossHostRecvState recv_state;
+  TF_ASSERT_OK_AND_ASSIGN(
+      auto buffers,
+      client->MakeCrossHostReceiveBuffers(
+          {shape}, client->addressable_devices()[0],
+          [&](StatusOr<PjRtCrossHostRecvState> state) {
+            TF_ASSERT_OK(state.status());
+            recv_state = *std::move(state);
+          }));
+
+  Status cancel_status = InternalError("not called");
+  recv_state.cancel_notifier(
+      recv_state.descriptors[0].serialized_descriptors[0],
+      tsl::errors::Cancelled("no sender"),
+      [&](Status status) { cancel_status = status; });
+  TF_EXPECT_OK(cancel_status);
+  Status ready = buffers[0]->GetReadyFuture().Await();
+  EXPECT_FALSE(ready.ok());
+  EXPECT_THAT(ready.error_message(), ::testing::HasSubstr("no sender"));
+}
+
+TEST(TfrtCpuClientTest, DeletingCrossHostReceiveBufferCancelsTransfer) {
+  TF_ASSERT_OK_AND_ASSIGN(auto client, GetTfrtCpuClient(/*asynchronous=*/true));
+  Shape shape = ShapeUtil::MakeShape(F32, {3, 2});
+  PjRtCrossHostRecvState recv_state;
+  TF_ASSERT_OK_AND_ASSIGN(
+      auto buffers,
+      client->MakeCrossHostReceiveBuffers(
+          {shape, shape}, client->addressable_devices()[0],
+          [&](StatusOr<PjRtCrossHostRecvState> state) {
+            TF_ASSERT_OK(state.status());
+            recv_state = *std::move(state);
+          }));
+  TF_ASSERT_OK_AND_ASSIGN(
+      auto sender, SharedMemoryTransfer::Open(
+                       recv_state.descriptors[0].serialized_descriptors[0]));
+
+  // The second buffer completes while the first transfer is still pending.
+  recv_state.cancel_notifier(
+      recv_state.descriptors[1].serialized_descriptors[0],
+      tsl::errors::Cancelled("no sender"), [](Status status) {});
+  EXPECT_FALSE(buffers[1]->GetReadyFuture().Await().ok());
+
+  buffers[0].reset();
+  EXPECT_EQ(sender->Await(absl::Seconds(10)).code(), tsl::error::CANCELLED);
+}
+
 }  // namespace
 }  // namespace xla
@@ -21,6 +21,7 @@ limitations under the License.
 
 #include "absl/synchronization/mutex.h"
 #include "xla/pjrt/local_device_state.h"
+#include "xla/pjrt/lock_free_block_pool.h"
 #include "xla/service/shaped_buffer.h"
 #include "xla/stream_executor/device_memory.h"
 #include "xla/stream_executor/device_memory_allocator.h"
@@ -30,6 +31,59 @@ limitations under the License.
 
 namespace xla {
 
+namespace {
+
+// Allocator for std::allocate_shared, which allocates the object and its
+// reference count as a single block.
+template <typename T>
+class PooledAllocator {
+ public:
+  using value_type = T;
+
+  PooledAllocator() = default;
+  template <typename U>
+  PooledAllocator(const PooledAllocator<U>&) {}  // NOLINT
+
+  T* allocate(size_t n) {
+    if (n != 1) {
+      return std::allocator<T>().allocate(n);
+    }
+    return static_cast<T*>(pool()->Allocate());
+  }
+  void deallocate(T* p, size_t n) {
+    if (n != 1) {
+      std::allocator<T>().deallocate(p, n);
+      return;
+    }
+    pool()->Free(p);
+  }
+
+  template <typename U>
+  bool operator==(const PooledAllocator<U>&) const {
+    return true;
+  }
+  template <typename U>
+  bool operator!=(const PooledAllocator<U>&) const {
+    return false;
+  }
+
+ private:
+  // Never destroyed, since events may outlive static destructors.
+  static LockFreeBlockPool* pool() {
+    static LockFreeBlockPool* pool =
+        new LockFreeBlockPool(sizeof(T), alignof(T));
+    return pool;
+  }
+};
+
+}  // namespace
+
+/* static */ std::shared_ptr<BufferSequencingEvent>
+BufferSequencingEvent::Create() {
+  return std::allocate_shared<BufferSequencingEvent>(
+      PooledAllocator<BufferSequencingEvent>());
+}
+
 void BufferSequencingEvent::SetSequencingEvent(EventPool::Handle event,
                                                se::Stream* stream) {
   absl::MutexLock lock(&mu_);
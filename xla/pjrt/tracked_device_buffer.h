@@ -55,10 +55,18 @@ namespace xla {
 // The dependency logic caches the set of streams at the tail of which the
 // definition event is known to have occurred; waiting for the same event on the
 // same stream causes no additional waiting.
+//
+// Events should be created with Create() rather than std::make_shared.
 class BufferSequencingEvent {
  public:
   BufferSequencingEvent() = default;
 
+  // Returns a new event. Several events are created for every execution, so
+  // the events and their reference counts are allocated together from a
+  // lock-free pool. An event is destroyed, which returns its EventPool handle,
+  // and its memory recycled once the last reference to it is dropped.
+  static std::shared_ptr<BufferSequencingEvent> Create();
+
   // Sets the sequencing event to 'event', which is recorded on 'stream'. Must
   // be called at most once. Unblocks any other host threads that are blocked in
   // WaitForEventOnStream.
@@ -23,6 +23,7 @@ limitations under the License.
 #include "xla/status_macros.h"
 #include "xla/stream_executor/device_memory_allocator.h"
 #include "xla/test.h"
+#include "tsl/platform/test_benchmark.h"
 
 namespace xla {
 namespace {
@@ -111,5 +112,29 @@ TEST(TrackedDeviceBufferTest, FromScopedShapedBuffer) {
                     literal.shape())));
 }
 
+TEST(TrackedDeviceBufferTest, BufferSequencingEventsAreRecycled) {
+  BufferSequencingEvent* event = BufferSequencingEvent::Create().get();
+  std::shared_ptr<BufferSequencingEvent> reused =
+      BufferSequencingEvent::Create();
+  EXPECT_EQ(reused.get(), event);
+  std::shared_ptr<BufferSequencingEvent> other =
+      BufferSequencingEvent::Create();
+  EXPECT_NE(other.get(), reused.get());
+}
+
+// Every execution creates a usage event per argument and a definition event
+// for its outputs, which are dropped again once the buffers are.
+void BM_CreateBufferSequencingEvent(benchmark::State& state) {
+  const bool pooled = state.range(0);
+  for (auto s : state) {
+    std::shared_ptr<BufferSequencingEvent> event =
+        pooled ? BufferSequencingEvent::Create()
+               : std::make_shared<BufferSequencingEvent>();
+    std::shared_ptr<BufferSequencingEvent> copy = event;
+    benchmark::DoNotOptimize(copy);
+  }
+}
+BENCHMARK(BM_CreateBufferSequencingEvent)->Arg(0)->Arg(1)->ThreadRange(1, 8);
+
 }  // namespace
 }  // namespace xla
@@ -15,9 +15,11 @@ limitations under the License.
 
 #include "xla/python/dlpack.h"
 
+#include <cstdint>
 #include <functional>
 #include <memory>
 #include <numeric>
+#include <optional>
 #include <utility>
 #include <vector>
 
@@ -26,12 +28,15 @@ limitations under the License.
 #include "absl/types/span.h"
 #include "include/dlpack/dlpack.h"  // from @dlpack
 #include "pybind11/pytypes.h"  // from @pybind11
+#include "xla/cpu_function_runtime.h"
 #include "xla/pjrt/gpu/se_gpu_pjrt_client.h"
 #include "xla/pjrt/pjrt_client.h"
+#include "xla/primitive_util.h"
 #include "xla/python/python_ref_manager.h"
 #include "xla/python/traceback.h"
 #include "xla/types.h"
 #include "xla/util.h"
+#include "tsl/lib/monitoring/counter.h"
 
 namespace py = pybind11;
 
@@ -40,6 +45,17 @@ namespace {
 
 const char* const kDlTensorCapsuleName = "dltensor";
 
+auto* dlpack_exchanges = tsl::monitoring::Counter<2>::New(
+    "/jax/dlpack/exchanges",
+    "The number of DLPack exports and imports, by whether the buffer was "
+    "shared or copied.",
+    "direction", "path");
+
+void ReportDLPackExchange(const char* direction, bool zero_copy) {
+  dlpack_exchanges->GetCell(direction, zero_copy ? "zero_copy" : "copy")
+      ->IncrementBy(1);
+}
+
 struct DLPackTensor {
   ~DLPackTensor();
 
@@ -336,6 +352,7 @@ StatusOr<py::capsule> BufferToDLPackManagedTensor(py::handle py_buffer,
   dt.shape = reinterpret_cast<std::int64_t*>(pack->shape.data());
   dt.strides = reinterpret_cast<std::int64_t*>(pack->strides.data());
   dt.byte_offset = 0;
+  ReportDLPackExchange("export", /*zero_copy=*/true);
 
   py::capsule capsule(&pack.release()->tensor, kDlTensorCapsuleName,
                       [](PyObject* obj) {
@@ -392,29 +409,79 @@ StatusOr<PyBuffer::object> DLPackManagedTensorToBuffer(
   TF_ASSIGN_OR_RETURN(PrimitiveType element_type,
                       DLDataTypeToPrimitiveType(dlmt->dl_tensor.dtype));
 
+  char* data =
+      static_cast<char*>(dlmt->dl_tensor.data) + dlmt->dl_tensor.byte_offset;
+  const bool is_cpu = device->client()->platform_id() == CpuId();
+
+  std::optional<absl::Span<int64_t const>> strides;
   std::vector<int64_t> minor_to_major;
   if (dlmt->dl_tensor.strides &&
       absl::c_find(dimensions, 0) == dimensions.end()) {
-    absl::Span<int64_t const> strides(
+    strides = absl::Span<int64_t const>(
         reinterpret_cast<int64_t*>(dlmt->dl_tensor.strides),
         dlmt->dl_tensor.ndim);
-    TF_ASSIGN_OR_RETURN(minor_to_major, StridesToLayout(dimensions, strides));
+    StatusOr<std::vector<int64_t>> layout =
+        StridesToLayout(dimensions, *strides);
+    // On CPU, strides that don't describe a dense layout are handled by the
+    // copy below.
+    if (layout.ok()) {
+      minor_to_major = std::move(layout).value();
+    } else if (!is_cpu) {
+      return layout.status();
+    }
   } else {
     minor_to_major.resize(dlmt->dl_tensor.ndim);
     std::iota(minor_to_major.rbegin(), minor_to_major.rend(), 0);
   }
-  Shape shape = ShapeUtil::MakeShapeWithDenseLayout(element_type, dimensions,
-                                                    minor_to_major);
 
-  std::function<void()> on_delete_callback;
-  if (dlmt->deleter) {
-    on_delete_callback = [dlmt]() { dlmt->deleter(dlmt); };
+  // XLA:CPU code expects its parameters in the default major-to-minor layout
+  // and may use aligned loads on them, so a CPU tensor can only be used in
+  // place if it meets both requirements, as in
+  // PjRtClient::BufferFromHostBuffer. Other tensors are copied into a buffer
+  // owned by the client, which relayouts them if needed.
+  bool zero_copy = true;
+  if (is_cpu) {
+    const bool has_default_layout =
+        minor_to_major.size() == dimensions.size() &&
+        absl::c_is_sorted(minor_to_major, std::greater<int64_t>());
+    const bool is_aligned = (reinterpret_cast<std::uintptr_t>(data) &
+                             (cpu_function_runtime::MinAlign() - 1)) == 0;
+    zero_copy = has_default_layout && is_aligned;
+  }
+  std::unique_ptr<PjRtBuffer> pjrt_buffer;
+  if (zero_copy) {
+    Shape shape = ShapeUtil::MakeShapeWithDenseLayout(element_type, dimensions,
+                                                      minor_to_major);
+    std::function<void()> on_delete_callback;
+    if (dlmt->deleter) {
+      on_delete_callback = [dlmt]() { dlmt->deleter(dlmt); };
+    }
+    TF_ASSIGN_OR_RETURN(pjrt_buffer,
+                        device->client()->CreateViewOfDeviceBuffer(
+                            data, shape, device, on_delete_callback));
+  } else {
+    std::vector<int64_t> byte_strides;
+    if (strides) {
+      const int64_t byte_width = primitive_util::ByteWidth(element_type);
+      byte_strides.reserve(strides->size());
+      for (int64_t stride : *strides) {
+        byte_strides.push_back(stride * byte_width);
+      }
+    }
+    TF_ASSIGN_OR_RETURN(
+        pjrt_buffer,
+        device->client()->BufferFromHostBuffer(
+            data, element_type, dimensions,
+            strides ? std::optional<absl::Span<int64_t const>>(byte_strides)
+                    : std::nullopt,
+            PjRtClient::HostBufferSemantics::kImmutableOnlyDuringCall,
+            /*on_done_with_host_buffer=*/nullptr, device));
+    // The tensor was copied, so the producer can release it right away.
+    if (dlmt->deleter) {
+      dlmt->deleter(dlmt);
+    }
   }
-  TF_ASSIGN_OR_RETURN(auto pjrt_buffer,
-                      device->client()->CreateViewOfDeviceBuffer(
-                          static_cast<char*>(dlmt->dl_tensor.data) +
-                              dlmt->dl_tensor.byte_offset,
-                          shape, device, on_delete_callback));
+  ReportDLPackExchange("import", zero_copy);
   // We have taken ownership of the array inside the capsule; make sure the
   // capsule it cannot be used again.
   PyCapsule_SetName(tensor.ptr(), "used_dltensor");
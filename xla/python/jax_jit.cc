@@ -1508,7 +1508,13 @@ void BuildJaxjitSubmodule(py::module& m) {
   jitlib.def("jit_is_disabled", &GetDisableJit);
   jitlib.def("get_enable_x64", &GetEnableX64);
   jitlib.def("set_thread_local_state_initialization_callback",
-             [](py::object f) { initialize_local_state = f; });
+             [](py::object f) {
+               // None restores the unset state returned by the getter below.
+               initialize_local_state = f.is_none() ? py::object() : f;
+             });
+  jitlib.def("get_thread_local_state_initialization_callback", []() {
+    return initialize_local_state ? initialize_local_state : py::none();
+  });
 
   jitlib.def(
       "jit",
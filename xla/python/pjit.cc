@@ -16,6 +16,8 @@ limitations under the License.
 #include "xla/python/pjit.h"
 
 #include <algorithm>
+#include <array>
+#include <cstdint>
 #include <exception>
 #include <memory>
 #include <optional>
@@ -26,9 +28,12 @@ limitations under the License.
 #include <utility>
 #include <vector>
 
+#include "absl/container/inlined_vector.h"
 #include "absl/synchronization/notification.h"
+#include "absl/types/span.h"
 #include "xla/pjrt/lru_cache.h"
 #include "xla/python/ifrt/array.h"
+#include "xla/python/ifrt/dtype.h"
 #include "xla/python/jax_jit.h"
 #include "xla/python/py_array.h"
 #include "xla/python/py_executable.h"
@@ -70,6 +75,34 @@ struct PjitCacheEntry {
   bool fall_back_to_python = false;
 };
 
+// The part of the signature of a jitted call that a jax.Array argument
+// determines. A fastpath entry matches a call only if the fingerprints of the
+// arguments are equal and their FastpathArgs are equal, so that two arguments
+// whose fingerprints collide cannot share an executable.
+struct FastpathArg {
+  explicit FastpathArg(const xla::PyArray& py_array)
+      : dtype(py_array.ifrt_array()->dtype()),
+        shape(py_array.shape().begin(), py_array.shape().end()),
+        weak_type(py_array.weak_type()),
+        committed(py_array.committed()),
+        sharding(py_array.sharding().ptr()) {}
+
+  bool Matches(const xla::PyArray& py_array) const {
+    return sharding == py_array.sharding().ptr() &&
+           weak_type == py_array.weak_type() &&
+           committed == py_array.committed() &&
+           absl::MakeConstSpan(shape) == py_array.shape() &&
+           dtype == py_array.ifrt_array()->dtype();
+  }
+
+  xla::ifrt::DType dtype;
+  absl::InlinedVector<int64_t, 4> shape;
+  bool weak_type;
+  bool committed;
+  // Identified by address, and kept alive by the signature of the entry.
+  PyObject* sharding;
+};
+
 // A PjitFunctionCache represents a cache of compiled functions that can be
 // shared between one or more PjitFunction objects. It serves two goals:
 // - reduce the number of lru caches (hash map) across multiple JITs.
@@ -220,7 +253,12 @@ class PjitFunction {
 
   int cache_capacity() const { return executables_->Size(); }
 
-  void ClearCache() { executables_->Clear(); }
+  void ClearCache() {
+    executables_->Clear();
+    for (std::unique_ptr<FastpathEntry>& entry : fastpath_entries_) {
+      entry.reset();
+    }
+  }
 
   py::object PythonSignature() {
     if (!fun_.has_value()) {
@@ -233,6 +271,30 @@ class PjitFunction {
   }
 
  private:
+  // A recently used cache entry, with the fingerprints of the jax.Array
+  // arguments it was used with (see PyArray::SignatureFingerprint()).
+  struct FastpathEntry {
+    absl::InlinedVector<uint64_t, 4> arg_fingerprints;
+    absl::InlinedVector<FastpathArg, 4> args;
+    // The full signature, which also keeps the shardings that the fingerprints
+    // and `args` identify by address alive.
+    CallSignature signature;
+    std::shared_ptr<PjitCacheEntry> cache_entry;
+  };
+
+  // Looks up a call whose dynamic arguments are all jax.Arrays in
+  // `fastpath_entries_`, comparing argument fingerprints and the identity of
+  // the static arguments and jit context instead of computing, hashing and
+  // comparing a full CallSignature. `arguments` must have been parsed.
+  // Returns nullptr if there is no match.
+  std::shared_ptr<PjitCacheEntry> LookupFastpath(
+      ParsedArgumentsAsBuffers& arguments,
+      absl::Span<const uint64_t> arg_fingerprints);
+  // `arguments` must have a full signature.
+  void InsertFastpath(const ParsedArgumentsAsBuffers& arguments,
+                      absl::Span<const uint64_t> arg_fingerprints,
+                      std::shared_ptr<PjitCacheEntry> cache_entry);
+
   xla::Status UpdateArgsSignature(ParsedArgumentsAsBuffers& arguments);
 
   void PopulateCacheEntry(PjitCacheEntry& cache_entry,
@@ -247,6 +309,15 @@ class PjitFunction {
   std::vector<int> donate_argnums_;
   std::shared_ptr<PjitFunctionCache> cache_;
   std::shared_ptr<PjitFunctionCache::Cache> executables_;
+
+  // Small cache of the most recently used entries of `executables_`, replaced
+  // round robin, in front of the LRU cache. The entries stay usable if the LRU
+  // cache evicts them, until they are replaced or ClearCache() is called.
+  // Protected by the GIL.
+  static constexpr int kNumFastpathEntries = 4;
+  std::array<std::unique_ptr<FastpathEntry>, kNumFastpathEntries>
+      fastpath_entries_;
+  int next_fastpath_entry_ = 0;
 };
 
 // thread-compatible.
@@ -454,8 +525,14 @@ xla::StatusOr<py::object> PjitFunction::Call(py::handle callable,
   // committed PyArray inputs. For other cases, e.g. Tracers or ShapedArray, it
   // will fallback to python. For jit, numpy arrays and scalars are also
   // allowed, which we will check later.
+  //
+  // Also collects the fingerprints of the arguments if they are all PyArrays,
+  // for the fastpath cache.
+  bool use_fastpath = true;
+  absl::InlinedVector<uint64_t, 4> arg_fingerprints;
   for (const auto& arg : arguments.flat_dynamic_args) {
     if (arg.get_type() != xla::PyArray::type()) {
+      use_fastpath = false;
       continue;
     }
 
@@ -463,6 +540,14 @@ xla::StatusOr<py::object> PjitFunction::Call(py::handle callable,
     if (!py_array.fastpath_enabled()) {
       return fallback_to_cache_miss();
     }
+    if (use_fastpath) {
+      xla::StatusOr<uint64_t> fingerprint = py_array.SignatureFingerprint();
+      if (fingerprint.ok()) {
+        arg_fingerprints.push_back(*fingerprint);
+      } else {
+        use_fastpath = false;
+      }
+    }
 
     // Only allow committed PyArray in cpp pjit for now as the logic on handling
     // sharding for uncommited PyArray is complicated and still under
@@ -478,20 +563,26 @@ xla::StatusOr<py::object> PjitFunction::Call(py::handle callable,
     }
   }
 
-  status = UpdateArgsSignature(arguments);
-  if (!status.ok()) {
-    VLOG(2) << "UpdateArgsSignature failed: " << status;
-    return fallback_to_cache_miss();
+  std::shared_ptr<PjitCacheEntry> cache_entry;
+  if (use_fastpath) {
+    cache_entry = LookupFastpath(arguments, arg_fingerprints);
   }
-
-  VLOG(2) << "CallSignature:\n" << arguments.signature.DebugString();
+  const bool fastpath_hit = cache_entry != nullptr;
   bool inserted = false;
-  std::shared_ptr<PjitCacheEntry> cache_entry =
-      executables_->GetOrCreateIfAbsent(
-          arguments.signature, [&inserted](const CallSignature& unused) {
-            inserted = true;
-            return std::make_shared<PjitCacheEntry>();
-          });
+  if (!fastpath_hit) {
+    status = UpdateArgsSignature(arguments);
+    if (!status.ok()) {
+      VLOG(2) << "UpdateArgsSignature failed: " << status;
+      return fallback_to_cache_miss();
+    }
+
+    VLOG(2) << "CallSignature:\n" << arguments.signature.DebugString();
+    cache_entry = executables_->GetOrCreateIfAbsent(
+        arguments.signature, [&inserted](const CallSignature& unused) {
+          inserted = true;
+          return std::make_shared<PjitCacheEntry>();
+        });
+  }
 
   if (!cache_entry->compilation_complete.HasBeenNotified()) {
     // In case of several threads attempting to compile the executable, only
@@ -541,6 +632,10 @@ xla::StatusOr<py::object> PjitFunction::Call(py::handle callable,
     return fallback_to_cache_miss();
   }
 
+  if (use_fastpath && !fastpath_hit) {
+    InsertFastpath(arguments, arg_fingerprints, cache_entry);
+  }
+
   // A vector of [num_inputs].
   auto num_args_arrays = PrepareIfrtInputs(*cache_entry->executable, arguments,
                                            cache_entry->kept_var_bitvec);
@@ -605,6 +700,92 @@ xla::StatusOr<py::object> PjitFunction::Call(py::handle callable,
   return out;
 }
 
+bool IsSameObject(const std::optional<py::object>& a,
+                  const std::optional<py::object>& b) {
+  return a.has_value() == b.has_value() && (!a.has_value() || a->is(*b));
+}
+
+bool AreSameObjects(absl::Span<const py::object> a,
+                    absl::Span<const py::object> b) {
+  return std::equal(
+      a.begin(), a.end(), b.begin(), b.end(),
+      [](const py::object& x, const py::object& y) { return x.is(y); });
+}
+
+std::shared_ptr<PjitCacheEntry> PjitFunction::LookupFastpath(
+    ParsedArgumentsAsBuffers& arguments,
+    absl::Span<const uint64_t> arg_fingerprints) {
+  const CallSignature& signature = arguments.signature;
+  bool jax_enable_x64 = GetEnableX64();
+  std::optional<py::object> default_device;
+  bool default_device_fetched = false;
+  for (const std::unique_ptr<FastpathEntry>& entry : fastpath_entries_) {
+    if (entry == nullptr) {
+      continue;
+    }
+    const CallSignature& cached = entry->signature;
+    // Ordered from the cheapest and most discriminating comparison.
+    if (absl::MakeConstSpan(entry->arg_fingerprints) != arg_fingerprints ||
+        cached.jax_enable_x64 != jax_enable_x64 ||
+        cached.dynamic_arg_treedefs != signature.dynamic_arg_treedefs ||
+        !AreSameObjects(cached.dynamic_arg_names,
+                        signature.dynamic_arg_names) ||
+        !AreSameObjects(cached.static_arg_names, signature.static_arg_names) ||
+        !AreSameObjects(cached.static_args, signature.static_args) ||
+        !IsSameObject(cached.thread_local_extra_jit_context,
+                      ThreadLocalJitState().extra_jit_context) ||
+        !IsSameObject(cached.global_extra_jit_context,
+                      GlobalJitState().extra_jit_context)) {
+      continue;
+    }
+    if (!default_device_fetched) {
+      default_device = GetDefaultDevice();
+      default_device_fetched = true;
+    }
+    if (!IsSameObject(cached.default_device, default_device)) {
+      continue;
+    }
+    // Rules out fingerprint collisions.
+    bool args_match = true;
+    for (int i = 0; i < entry->args.size() && args_match; ++i) {
+      args_match = entry->args[i].Matches(
+          py::reinterpret_borrow<xla::PyArray>(arguments.flat_dynamic_args[i]));
+    }
+    if (!args_match) {
+      continue;
+    }
+    // The remaining fields are only read for the inputs and error messages.
+    arguments.signature.function_name = function_name_;
+    arguments.signature.jax_enable_x64 = jax_enable_x64;
+    return entry->cache_entry;
+  }
+  return nullptr;
+}
+
+void PjitFunction::InsertFastpath(const ParsedArgumentsAsBuffers& arguments,
+                                  absl::Span<const uint64_t> arg_fingerprints,
+                                  std::shared_ptr<PjitCacheEntry> cache_entry) {
+  // If an entry already leads to `cache_entry`, this call only missed it
+  // because its static arguments or jit context are equal but not identical.
+  // Keeps that entry, rather than copying the signature on every such call.
+  for (const std::unique_ptr<FastpathEntry>& entry : fastpath_entries_) {
+    if (entry != nullptr && entry->cache_entry == cache_entry) {
+      return;
+    }
+  }
+  absl::InlinedVector<FastpathArg, 4> args;
+  args.reserve(arguments.flat_dynamic_args.size());
+  for (const py::object& arg : arguments.flat_dynamic_args) {
+    args.emplace_back(py::reinterpret_borrow<xla::PyArray>(arg));
+  }
+  fastpath_entries_[next_fastpath_entry_] =
+      std::make_unique<FastpathEntry>(FastpathEntry{
+          absl::InlinedVector<uint64_t, 4>(arg_fingerprints.begin(),
+                                           arg_fingerprints.end()),
+          std::move(args), arguments.signature, std::move(cache_entry)});
+  next_fastpath_entry_ = (next_fastpath_entry_ + 1) % kNumFastpathEntries;
+}
+
 xla::Status PjitFunction::UpdateArgsSignature(
     ParsedArgumentsAsBuffers& arguments) {
   arguments.signature.function_name = function_name_;
@@ -22,6 +22,8 @@ limitations under the License.
 #include <utility>
 #include <vector>
 
+#include "absl/hash/hash.h"
+#include "absl/types/span.h"
 #include "llvm/Support/Casting.h"
 #include "pybind11_abseil/absl_casters.h"  // from @pybind11_abseil
 #include "xla/python/ifrt/array.h"
@@ -332,6 +334,21 @@ void PyArray::SetIfrtArray(tsl::RCReference<ifrt::Array> ifrt_array) {
   GetStorage().ifrt_array = std::move(ifrt_array);
 }
 
+StatusOr<uint64_t> PyArray::SignatureFingerprint() {
+  Storage& storage = GetStorage();
+  if (storage.ifrt_array == nullptr) {
+    return InvalidArgument("Array has been deleted.");
+  }
+  if (!storage.signature_fingerprint.has_value()) {
+    TF_ASSIGN_OR_RETURN(PrimitiveType primitive_type,
+                        ifrt::ToPrimitiveType(storage.ifrt_array->dtype()));
+    storage.signature_fingerprint = absl::HashOf(
+        primitive_type, absl::MakeConstSpan(storage.shape), storage.weak_type,
+        storage.committed, storage.sharding.ptr());
+  }
+  return *storage.signature_fingerprint;
+}
+
 py::object PyArray::arrays() {
 // For performance, we only keep pjrt buffers by default. But on python side
 // "_arrays" returns PyBuffers instead, and subsequent calls to "_arrays"
@@ -16,7 +16,9 @@ limitations under the License.
 #ifndef TENSORFLOW_COMPILER_XLA_PYTHON_PY_ARRAY_H_
 #define TENSORFLOW_COMPILER_XLA_PYTHON_PY_ARRAY_H_
 
+#include <cstdint>
 #include <memory>
+#include <optional>
 #include <utility>
 #include <vector>
 
@@ -56,6 +58,9 @@ struct PyArray_Storage {
   pybind11::object npy_value = pybind11::none();
   bool committed = false;
 
+  // Cached by PyArray::SignatureFingerprint().
+  std::optional<uint64_t> signature_fingerprint;
+
   std::shared_ptr<PyClient> py_client;
   std::shared_ptr<Traceback> traceback;
   tsl::RCReference<ifrt::Array> ifrt_array;
@@ -178,6 +183,14 @@ class PyArray : public pybind11::object {
   // TODO(yashkatariya): remove this once the transition completes.
   bool fastpath_enabled() const { return GetStorage().fastpath_enabled; }
 
+  // Returns a fingerprint of the dtype, shape, weak type, sharding and
+  // committedness of the array, i.e., of its contribution to the signature of
+  // a jitted call. Computed on first use and cached; the sharding is
+  // identified by its address. Equal fingerprints only make equal signatures
+  // likely, so callers must compare the fields themselves before relying on a
+  // match. Returns an error if the array was deleted.
+  StatusOr<uint64_t> SignatureFingerprint();
+
   static pybind11::handle type() {
     DCHECK(type_);
     return pybind11::handle(type_);
@@ -266,6 +266,131 @@ PyTreeDef::Flatten(py::handle x, std::optional<py::function> leaf_predicate) {
   return std::make_pair(std::move(leaves), std::move(tree));
 }
 
+template <typename T>
+bool PyTreeDef::FlattenWithHintImpl(py::handle x, T& leaves) const {
+  if (traversal_.empty()) {
+    return false;
+  }
+  const size_t start_num_leaves = leaves.size();
+  auto mismatch = [&]() {
+    leaves.resize(start_num_leaves);
+    return false;
+  };
+  // Visits the nodes in reverse post-order, i.e., in pre-order with the
+  // children of each node visited last to first, so the leaves are found in
+  // reverse order.
+  absl::InlinedVector<py::object, 4> agenda;
+  agenda.push_back(py::reinterpret_borrow<py::object>(x));
+  for (auto it = traversal_.rbegin(); it != traversal_.rend(); ++it) {
+    const Node& node = *it;
+    DCHECK(!agenda.empty());
+    py::object object = std::move(agenda.back());
+    agenda.pop_back();
+    PyObject* ptr = object.ptr();
+
+    switch (node.kind) {
+      case PyTreeKind::kLeaf: {
+        const PyTreeTypeRegistry::Registration* custom;
+        if (GetKind(object, &custom) != PyTreeKind::kLeaf) {
+          return mismatch();
+        }
+        leaves.push_back(std::move(object));
+        break;
+      }
+
+      case PyTreeKind::kNone:
+        if (ptr != Py_None) {
+          return mismatch();
+        }
+        break;
+
+      case PyTreeKind::kTuple:
+      case PyTreeKind::kNamedTuple: {
+        // Namedtuple types are never registered, so an object of the recorded
+        // type is classified as a namedtuple again.
+        if ((node.kind == PyTreeKind::kTuple
+                 ? !PyTuple_CheckExact(ptr)
+                 : Py_TYPE(ptr) !=
+                       reinterpret_cast<PyTypeObject*>(node.node_data.ptr())) ||
+            PyTuple_GET_SIZE(ptr) != node.arity) {
+          return mismatch();
+        }
+        for (int i = 0; i < node.arity; ++i) {
+          agenda.push_back(
+              py::reinterpret_borrow<py::object>(PyTuple_GET_ITEM(ptr, i)));
+        }
+        break;
+      }
+
+      case PyTreeKind::kList: {
+        if (!PyList_CheckExact(ptr) || PyList_GET_SIZE(ptr) != node.arity) {
+          return mismatch();
+        }
+        for (int i = 0; i < node.arity; ++i) {
+          agenda.push_back(
+              py::reinterpret_borrow<py::object>(PyList_GET_ITEM(ptr, i)));
+        }
+        break;
+      }
+
+      case PyTreeKind::kDict: {
+        if (!PyDict_CheckExact(ptr) || PyDict_Size(ptr) != node.arity) {
+          return mismatch();
+        }
+        // A dict of the same size that contains all of the recorded keys has
+        // the same sorted keys, so there is no need to sort them again.
+        for (const py::object& key : node.sorted_dict_keys) {
+          PyObject* value = PyDict_GetItemWithError(ptr, key.ptr());
+          if (value == nullptr) {
+            if (PyErr_Occurred()) {
+              throw py::error_already_set();
+            }
+            return mismatch();
+          }
+          agenda.push_back(py::reinterpret_borrow<py::object>(value));
+        }
+        break;
+      }
+
+      case PyTreeKind::kCustom: {
+        if (Py_TYPE(ptr) !=
+            reinterpret_cast<PyTypeObject*>(node.custom->type.ptr())) {
+          return mismatch();
+        }
+        py::tuple out = py::cast<py::tuple>(node.custom->to_iterable(object));
+        if (out.size() != 2) {
+          throw xla::XlaRuntimeError(
+              "PyTree custom to_iterable function should return a pair");
+        }
+        if (node.node_data.not_equal(out[1])) {
+          return mismatch();
+        }
+        const size_t start_agenda_size = agenda.size();
+        for (py::handle entry : py::cast<py::iterable>(out[0])) {
+          agenda.push_back(py::reinterpret_borrow<py::object>(entry));
+        }
+        if (agenda.size() - start_agenda_size != node.arity) {
+          return mismatch();
+        }
+        break;
+      }
+    }
+  }
+  DCHECK(agenda.empty());
+  std::reverse(leaves.begin() + start_num_leaves, leaves.end());
+  return true;
+}
+
+bool PyTreeDef::FlattenWithHint(py::handle x,
+                                std::vector<py::object>& leaves) const {
+  return FlattenWithHintImpl(x, leaves);
+}
+
+bool PyTreeDef::FlattenWithHint(
+    py::handle x, absl::InlinedVector<py::object, 2>& leaves) const {
+  return FlattenWithHintImpl(x, leaves);
+}
+
 /*static*/ bool PyTreeDef::AllLeaves(const py::iterable& x) {
   const PyTreeTypeRegistry::Registration* custom;
   for (const py::handle& h : x) {
@@ -343,14 +468,23 @@ py::object PyTreeDef::Unflatten(absl::Span<const py::object> leaves) const {
     case PyTreeKind::kNone:
       return py::none();
 
+    // The containers are filled through the C API, which steals the
+    // references of the children, rather than through pybind11 accessors.
     case PyTreeKind::kTuple:
     case PyTreeKind::kNamedTuple: {
       py::tuple tuple(node.arity);
       for (int i = 0; i < node.arity; ++i) {
-        tuple[i] = std::move(children[i]);
+        PyTuple_SET_ITEM(tuple.ptr(), i, children[i].release().ptr());
       }
       if (node.kind == PyTreeKind::kNamedTuple) {
-        return node.node_data(*tuple);
+        // Calls the type with the tuple as its arguments directly, instead of
+        // unpacking it into a new argument tuple.
+        PyObject* result =
+            PyObject_Call(node.node_data.ptr(), tuple.ptr(), nullptr);
+        if (result == nullptr) {
+          throw py::error_already_set();
+        }
+        return py::reinterpret_steal<py::object>(result);
       } else {
         return std::move(tuple);
       }
@@ -359,7 +493,7 @@ py::object PyTreeDef::Unflatten(absl::Span<const py::object> leaves) const {
     case PyTreeKind::kList: {
       py::list list(node.arity);
       for (int i = 0; i < node.arity; ++i) {
-        list[i] = std::move(children[i]);
+        PyList_SET_ITEM(list.ptr(), i, children[i].release().ptr());
       }
       return std::move(list);
     }
@@ -367,15 +501,17 @@ py::object PyTreeDef::Unflatten(absl::Span<const py::object> leaves) const {
     case PyTreeKind::kDict: {
       py::dict dict;
       for (int i = 0; i < node.arity; ++i) {
-        dict[node.sorted_dict_keys[i]] = std::move(children[i]);
+        if (PyDict_SetItem(dict.ptr(), node.sorted_dict_keys[i].ptr(),
+                           children[i].ptr()) < 0) {
+          throw py::error_already_set();
+        }
       }
       return std::move(dict);
-      break;
     }
     case PyTreeKind::kCustom: {
       py::tuple tuple(node.arity);
       for (int i = 0; i < node.arity; ++i) {
-        tuple[i] = std::move(children[i]);
+        PyTuple_SET_ITEM(tuple.ptr(), i, children[i].release().ptr());
       }
       return node.custom->from_iterable(node.node_data, tuple);
     }
@@ -813,9 +949,24 @@ PyTreeDef PyTreeDef::FromPickleable(py::object pickleable) {
 
 void BuildPytreeSubmodule(py::module& m) {
   py::module pytree = m.def_submodule("pytree", "Python tree library");
-  pytree.attr("version") = py::int_(3);
+  pytree.attr("version") = py::int_(4);
   pytree.def("flatten", &PyTreeDef::Flatten, py::arg("tree"),
              py::arg("leaf_predicate") = std::nullopt);
+  pytree.def(
+      "flatten_with_hint",
+      [](py::handle tree, py::object hint) -> py::tuple {
+        std::vector<py::object> leaves;
+        if (py::cast<const PyTreeDef&>(hint).FlattenWithHint(tree, leaves)) {
+          return py::make_tuple(py::cast(leaves), hint);
+        }
+        std::pair<std::vector<py::object>, std::unique_ptr<PyTreeDef>>
+            flattened = PyTreeDef::Flatten(tree);
+        return py::make_tuple(py::cast(flattened.first),
+                              py::cast(std::move(flattened.second)));
+      },
+      "Flattens `tree` like `flatten`, returning `hint` as the treedef without "
+      "rebuilding it if `tree` has the structure it describes.",
+      py::arg("tree"), py::arg("hint"));
   pytree.def("tuple", &PyTreeDef::Tuple);
   pytree.def("all_leaves", &PyTreeDef::AllLeaves);
 
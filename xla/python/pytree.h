@@ -121,6 +121,16 @@ class PyTreeDef {
       pybind11::handle handle, absl::InlinedVector<pybind11::object, 2>& leaves,
       std::optional<pybind11::function> leaf_predicate = std::nullopt);
 
+  // Flattens `x` into `leaves` if it has the same structure as this
+  // PyTreeDef, e.g. one built by flattening a value in a previous step. The
+  // structure is checked in a single pass over the cached traversal, without
+  // building nodes or sorting dictionary keys. Returns false, leaving `leaves`
+  // unchanged, if the structure differs; callers then fall back to Flatten().
+  bool FlattenWithHint(pybind11::handle x,
+                       std::vector<pybind11::object>& leaves) const;
+  bool FlattenWithHint(pybind11::handle x,
+                       absl::InlinedVector<pybind11::object, 2>& leaves) const;
+
   // Tests whether the given list is a flat list of leaves.
   static bool AllLeaves(const pybind11::iterable& x);
 
@@ -230,6 +240,9 @@ class PyTreeDef {
   void FlattenIntoImpl(pybind11::handle handle, T& leaves,
                        const std::optional<pybind11::function>& leaf_predicate);
 
+  template <typename T>
+  bool FlattenWithHintImpl(pybind11::handle x, T& leaves) const;
+
   template <typename T>
   pybind11::object UnflattenImpl(T leaves) const;
 
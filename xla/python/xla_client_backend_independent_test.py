@@ -14,6 +14,7 @@
 # ==============================================================================
 """Backend-independent tests for the Python XLA client."""
 
+import collections
 import unittest
 
 from absl.testing import absltest
@@ -29,6 +30,7 @@ except ImportError:
 # pylint: enable=g-import-not-at-top
 
 ops = xla_client.ops
+pytree = xla_client._xla.pytree
 
 
 class ShapeTest(absltest.TestCase):
@@ -191,5 +193,120 @@ class RunHloPassTest(absltest.TestCase):
     self.assertTrue(xla_client._xla.HloDCE().run(hlo_module))
 
 
+_Point = collections.namedtuple("_Point", ["x", "y"])
+_OtherPoint = collections.namedtuple("_OtherPoint", ["x", "y"])
+
+
+class _CustomNode:
+  """A registered pytree node whose node data is its name."""
+
+  def __init__(self, children, name):
+    self.children = list(children)
+    self.name = name
+
+  def __eq__(self, other):
+    return (isinstance(other, _CustomNode) and
+            self.children == other.children and self.name == other.name)
+
+
+pytree.register_node(_CustomNode, lambda node: (node.children, node.name),
+                     lambda name, children: _CustomNode(children, name))
+
+
+def _MakeTree(leaves, name="node"):
+  a, b, c, d, e, f = leaves
+  return {
+      "x": (a, [b, c]),
+      "y": _Point(d, None),
+      "z": _CustomNode([e, f], name),
+  }
+
+
+class PyTreeFlattenWithHintTest(absltest.TestCase):
+
+  def testHintMatchReturnsHint(self):
+    _, treedef = pytree.flatten(_MakeTree(range(6)))
+    leaves, hinted_treedef = pytree.flatten_with_hint(
+        _MakeTree(range(10, 16)), treedef)
+    self.assertIs(hinted_treedef, treedef)
+    # Dict entries are visited in key order, and children in order.
+    self.assertEqual(leaves, list(range(10, 16)))
+
+  def testLeafOrderMatchesFlatten(self):
+    tree = {"b": [1, (2, 3)], "a": 4, "c": {"e": 5, "d": 6}}
+    expected_leaves, treedef = pytree.flatten(tree)
+    leaves, hinted_treedef = pytree.flatten_with_hint(tree, treedef)
+    self.assertIs(hinted_treedef, treedef)
+    self.assertEqual(leaves, expected_leaves)
+    self.assertEqual(leaves, [4, 1, 2, 3, 6, 5])
+
+  def testMismatchFallsBackToFlatten(self):
+    _, treedef = pytree.flatten(_MakeTree(range(6)))
+    mismatches = {
+        "dict keys": {
+            "x": (0, [1, 2]),
+            "w": _Point(3, None),
+            "z": _CustomNode([4, 5], "node")
+        },
+        "tuple arity": {
+            "x": (0, [1, 2], 6),
+            "y": _Point(3, None),
+            "z": _CustomNode([4, 5], "node")
+        },
+        "list arity": {
+            "x": (0, [1]),
+            "y": _Point(3, None),
+            "z": _CustomNode([4, 5], "node")
+        },
+        "list type": {
+            "x": (0, (1, 2)),
+            "y": _Point(3, None),
+            "z": _CustomNode([4, 5], "node")
+        },
+        "namedtuple type": {
+            "x": (0, [1, 2]),
+            "y": _OtherPoint(3, None),
+            "z": _CustomNode([4, 5], "node")
+        },
+        "custom node data": _MakeTree(range(6), name="other"),
+        "custom node arity": {
+            "x": (0, [1, 2]),
+            "y": _Point(3, None),
+            "z": _CustomNode([4, 5, 6], "node")
+        },
+        "leaf": _MakeTree([0, 1, 2, 3, 4, (5,)]),
+        "none": {
+            "x": (0, [1, 2]),
+            "y": _Point(3, 4),
+            "z": _CustomNode([5, 6], "node")
+        },
+    }
+    for name, tree in mismatches.items():
+      expected_leaves, expected_treedef = pytree.flatten(tree)
+      leaves, hinted_treedef = pytree.flatten_with_hint(tree, treedef)
+      self.assertIsNot(hinted_treedef, treedef, name)
+      self.assertEqual(hinted_treedef, expected_treedef, name)
+      self.assertEqual(leaves, expected_leaves, name)
+
+  def testUnflattenRoundTrip(self):
+    trees = [
+        (1, 2),
+        [1, [2, 3]],
+        {"b": 1, "a": (2, None)},
+        _Point(1, _Point(2, 3)),
+        _CustomNode([1, {"c": 2}], "node"),
+        _MakeTree(range(6)),
+    ]
+    for tree in trees:
+      _, hint = pytree.flatten(tree)
+      leaves, treedef = pytree.flatten_with_hint(tree, hint)
+      self.assertIs(treedef, hint)
+      unflattened = treedef.unflatten(leaves)
+      self.assertEqual(unflattened, tree)
+      self.assertIs(type(unflattened), type(tree))
+    point = pytree.flatten(_Point(1, _Point(2, 3)))[1].unflatten([4, 5, 6])
+    self.assertIs(type(point.y), _Point)
+
+
 if __name__ == "__main__":
   absltest.main()
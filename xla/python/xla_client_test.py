@@ -19,6 +19,7 @@ import functools
 import itertools
 import re
 import threading
+import timeit
 import unittest
 
 from absl import flags
@@ -2426,6 +2427,27 @@ def TestFactory(xla_backend,
       np.testing.assert_array_equal(x, np.asarray(y))
       np.testing.assert_array_equal(x, np.asarray(z))
 
+    @unittest.skipIf(not hasattr(np.ndarray, "__dlpack__"),
+                     "NumPy does not support DLPack")
+    def testCpuImportIsZeroCopyOnlyWhenAlignedAndMajorToMinor(self):
+      raw = np.zeros(8 * 8 * 4 + 64, dtype=np.uint8)
+      offset = -raw.ctypes.data % 64
+      x = raw[offset:offset + 8 * 8 * 4].view(np.float32).reshape(8, 8)
+      x[...] = np.arange(64, dtype=np.float32).reshape(8, 8)
+
+      y = xla_client._xla.dlpack_managed_tensor_to_buffer(
+          x.__dlpack__(), self.cpu_backend)
+      self.assertEqual(y.unsafe_buffer_pointer(), x.ctypes.data)
+      np.testing.assert_array_equal(x, np.asarray(y))
+
+      # Misaligned, transposed and non-compact tensors are copied.
+      misaligned = raw[offset + 4:offset + 4 + 16 * 4].view(np.float32)
+      for z in [misaligned, x.T, x[:, ::2]]:
+        w = xla_client._xla.dlpack_managed_tensor_to_buffer(
+            z.__dlpack__(), self.cpu_backend)
+        self.assertNotEqual(w.unsafe_buffer_pointer(), z.ctypes.data)
+        np.testing.assert_array_equal(z, np.asarray(w))
+
   tests.append(DLPackTest)
 
   class BufferProtocolTest(parameterized.TestCase):
@@ -2979,6 +3001,144 @@ def TestFactory(xla_backend,
 
   tests.append(ExecuteShardedOverloadTest)
 
+  class PjitFastpathTest(ComputationTest):
+    """Tests that the C++ pjit dispatch only reuses executables it should."""
+
+    Aval = collections.namedtuple("Aval", ["shape", "dtype", "weak_type"])
+
+    _JIT_STATE_FIELDS = ("disable_jit", "enable_x64", "jax_array")
+
+    def setUp(self):
+      super(PjitFastpathTest, self).setUp()
+      jax_jit = xla_client._xla.jax_jit
+      global_state = jax_jit.global_state()
+      # The jit state is global, so it is restored for the other tests.
+      self.saved_initialization_callback = (
+          jax_jit.get_thread_local_state_initialization_callback())
+      self.saved_jit_state = {
+          field: getattr(global_state, field)
+          for field in self._JIT_STATE_FIELDS
+      }
+      jax_jit.set_thread_local_state_initialization_callback(lambda: None)
+      global_state.disable_jit = False
+      global_state.enable_x64 = True
+      global_state.jax_array = True
+      self.device = self.backend.local_devices()[0]
+      self.sharding = xla_client.SingleDeviceSharding(self.device)
+      self.cache = xla_client._xla.PjitFunctionCache()
+      self.num_cache_misses = 0
+
+    def tearDown(self):
+      super().tearDown()
+      jax_jit = xla_client._xla.jax_jit
+      global_state = jax_jit.global_state()
+      for field, value in self.saved_jit_state.items():
+        setattr(global_state, field, value)
+      jax_jit.set_thread_local_state_initialization_callback(
+          self.saved_initialization_callback)
+
+    def _Array(self, value, sharding=None, weak_type=False):
+      aval = self.Aval(value.shape, value.dtype, weak_type)
+      buffer = self.backend.buffer_from_pyval(value, self.device)
+      return xla_client.ArrayImpl(
+          aval,
+          sharding or self.sharding, [buffer],
+          committed=True,
+          _skip_checks=True)
+
+    def _CacheMiss(self, x, unused_static_arg):
+      """Compiles the identity function for `x`."""
+      self.num_cache_misses += 1
+      c = self._NewComputation()
+      ops.Parameter(
+          c, 0,
+          xla_client.shape_from_pyval(np.zeros(x.aval.shape, x.aval.dtype)))
+      executable = self.backend.compile(
+          xla_computation_to_mlir_module(c.build()))
+      fastpath_data = collections.namedtuple("FastpathData", [
+          "xla_executable", "in_shardings", "out_shardings", "out_committed",
+          "out_avals", "out_pytree_def", "kept_var_bitvec"
+      ])(executable, [x._sharding], [x._sharding], [True], [x.aval],
+         xla_client._xla.pytree.flatten(x)[1], [True])
+      return x, fastpath_data
+
+    def testChangedSignatureMissesFastpath(self):
+      f = xla_client._xla.pjit(
+          "f", None, self._CacheMiss, static_argnums=[1], cache=self.cache)
+      x = self._Array(np.arange(4, dtype=np.float32))
+      f(x, 0)
+      self.assertEqual(self.num_cache_misses, 1)
+      f(x, 0)
+      # Another array with the same signature reuses the executable.
+      f(self._Array(np.ones(4, dtype=np.float32)), 0)
+      self.assertEqual(self.num_cache_misses, 1)
+
+      op_sharding = xla_client.OpSharding()
+      op_sharding.type = xla_client.OpSharding.Type.REPLICATED
+      gspmd_sharding = xla_client.GSPMDSharding([self.device], op_sharding)
+      # Each of these calls has a signature that has not been seen before, so
+      # it must reach the cache miss handler rather than reuse an executable.
+      changed_calls = [
+          ("dtype", self._Array(np.arange(4, dtype=np.int32)), 0),
+          ("shape", self._Array(np.arange(5, dtype=np.float32)), 0),
+          ("weak type",
+           self._Array(np.arange(4, dtype=np.float32), weak_type=True), 0),
+          ("sharding",
+           self._Array(np.arange(4, dtype=np.float32),
+                       sharding=gspmd_sharding), 0),
+          ("static argument", x, 1),
+      ]
+      for name, array, static_arg in changed_calls:
+        num_cache_misses = self.num_cache_misses
+        f(array, static_arg)
+        self.assertEqual(self.num_cache_misses, num_cache_misses + 1, name)
+        f(array, static_arg)
+        self.assertEqual(self.num_cache_misses, num_cache_misses + 1, name)
+
+      # The original signature is still compiled.
+      num_cache_misses = self.num_cache_misses
+      f(x, 0)
+      self.assertEqual(self.num_cache_misses, num_cache_misses)
+
+    def testDispatchLatency(self):
+      """Compares the dispatch time of cached and uncached pjit calls."""
+      x = self._Array(np.arange(4, dtype=np.float32))
+      cached = xla_client._xla.pjit(
+          "cached", None, self._CacheMiss, static_argnums=[1],
+          cache=self.cache)
+      _, fastpath_data = self._CacheMiss(x, 0)
+      executable = fastpath_data.xla_executable
+
+      def UncachedMiss(x, unused_static_arg):
+        # Reuses the executable but returns no fast path data, so that every
+        # call goes through Python, like a call whose signature changes.
+        self.num_cache_misses += 1
+        return executable.execute_sharded_on_local_devices([[x]])[0][0], None
+
+      uncached = xla_client._xla.pjit(
+          "uncached", None, UncachedMiss, static_argnums=[1],
+          cache=xla_client._xla.PjitFunctionCache())
+
+      num_calls = 100
+      num_repeats = 5
+      num_cache_misses = {}
+      for name, f in (("cached", cached), ("uncached", uncached)):
+        f(x, 0)
+        start_cache_misses = self.num_cache_misses
+        time_us = min(
+            timeit.repeat(
+                functools.partial(f, x, 0),
+                number=num_calls,
+                repeat=num_repeats)) / num_calls * 1e6
+        logging.info("%s pjit dispatch: %.1f us per call", name, time_us)
+        num_cache_misses[name] = self.num_cache_misses - start_cache_misses
+      self.assertEqual(num_cache_misses, {
+          "cached": 0,
+          "uncached": num_repeats * num_calls
+      })
+
+  tests.append(PjitFastpathTest)
+
   return tests
 
 
@@ -45,7 +45,9 @@ def thread_local_state() -> JitState: ...
 def jit_is_disabled() -> bool: ...
 def get_enable_x64() -> bool: ...
 def set_thread_local_state_initialization_callback(
-    function: Callable[[], None]): ...
+    function: Optional[Callable[[], None]]): ...
+def get_thread_local_state_initialization_callback(
+    ) -> Optional[Callable[[], None]]: ...
 
 def jit(fun: Callable[..., Any],
         cache_miss: Callable[..., Any],
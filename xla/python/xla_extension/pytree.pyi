@@ -24,6 +24,10 @@ def flatten(
     tree: Any,
     leaf_predicate: Optional[Callable[[Any], bool]] = ...,
 ) -> Tuple[List[Any], PyTreeDef]: ...
+def flatten_with_hint(
+    tree: Any,
+    hint: PyTreeDef,
+) -> Tuple[List[Any], PyTreeDef]: ...
 def tuple(arg0: Sequence[PyTreeDef]) -> PyTreeDef: ...
 def all_leaves(arg0: Iterable[Any]) -> bool: ...
 
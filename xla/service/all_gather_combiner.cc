@@ -130,10 +130,12 @@ std::optional<GroupKey> CombineKey(const HloInstruction* instruction,
 
 }  // namespace
 
-AllGatherCombiner::AllGatherCombiner(int64_t combine_threshold_in_bytes,
-                                     int64_t combine_threshold_count)
+AllGatherCombiner::AllGatherCombiner(
+    int64_t combine_threshold_in_bytes, int64_t combine_threshold_count,
+    std::shared_ptr<const CollectiveCombinerCostModel> cost_model)
     : combine_threshold_in_bytes_(combine_threshold_in_bytes),
-      combine_threshold_count_(combine_threshold_count) {}
+      combine_threshold_count_(combine_threshold_count),
+      cost_model_(std::move(cost_model)) {}
 
 StatusOr<bool> AllGatherCombiner::Run(
     HloModule* module,
@@ -162,11 +164,21 @@ StatusOr<bool> AllGatherCombiner::Run(
       return CombineKey(instruction, *domain_map);
     };
 
-    TF_ASSIGN_OR_RETURN(
-        bool computation_changed,
-        CombineInstructionsByKey<GroupKey>(
-            computation, key_fn, &CombineAllGathers,
-            combine_threshold_in_bytes_, combine_threshold_count_));
+    bool computation_changed;
+    if (cost_model_ != nullptr) {
+      TF_ASSIGN_OR_RETURN(
+          computation_changed,
+          CombineInstructionsByCost<GroupKey>(
+              computation, key_fn, &CombineAllGathers,
+              combine_threshold_in_bytes_, combine_threshold_count_,
+              *cost_model_));
+    } else {
+      TF_ASSIGN_OR_RETURN(
+          computation_changed,
+          CombineInstructionsByKey<GroupKey>(
+              computation, key_fn, &CombineAllGathers,
+              combine_threshold_in_bytes_, combine_threshold_count_));
+    }
     changed |= computation_changed;
   }
 
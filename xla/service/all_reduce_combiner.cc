@@ -103,10 +103,12 @@ Status CombineAllReduces(absl::Span<HloInstruction* const> to_combine) {
 }
 }  // namespace
 
-AllReduceCombiner::AllReduceCombiner(int64_t combine_threshold_in_bytes,
-                                     int64_t combine_threshold_count)
+AllReduceCombiner::AllReduceCombiner(
+    int64_t combine_threshold_in_bytes, int64_t combine_threshold_count,
+    std::shared_ptr<const CollectiveCombinerCostModel> cost_model)
     : combine_threshold_in_bytes_(combine_threshold_in_bytes),
-      combine_threshold_count_(combine_threshold_count) {}
+      combine_threshold_count_(combine_threshold_count),
+      cost_model_(std::move(cost_model)) {}
 
 StatusOr<bool> AllReduceCombiner::Run(
     HloModule* module,
@@ -139,11 +141,21 @@ StatusOr<bool> AllReduceCombiner::Run(
       return GetAllReduceKey(instruction, domain_map.get());
     };
 
-    TF_ASSIGN_OR_RETURN(
-        bool computation_changed,
-        CombineInstructionsByKey<AllReduceKey>(
-            computation, key_fn, &CombineAllReduces,
-            combine_threshold_in_bytes_, combine_threshold_count_));
+    bool computation_changed;
+    if (cost_model_ != nullptr) {
+      TF_ASSIGN_OR_RETURN(
+          computation_changed,
+          CombineInstructionsByCost<AllReduceKey>(
+              computation, key_fn, &CombineAllReduces,
+              combine_threshold_in_bytes_, combine_threshold_count_,
+              *cost_model_));
+    } else {
+      TF_ASSIGN_OR_RETURN(
+          computation_changed,
+          CombineInstructionsByKey<AllReduceKey>(
+              computation, key_fn, &CombineAllReduces,
+              combine_threshold_in_bytes_, combine_threshold_count_));
+    }
     changed |= computation_changed;
   }
 
@@ -16,9 +16,13 @@ limitations under the License.
 #ifndef TENSORFLOW_COMPILER_XLA_SERVICE_ALL_REDUCE_COMBINER_H_
 #define TENSORFLOW_COMPILER_XLA_SERVICE_ALL_REDUCE_COMBINER_H_
 
+#include <cstdint>
+#include <memory>
+
 #include "absl/strings/string_view.h"
 #include "xla/array2d.h"
 #include "xla/hlo/ir/hlo_module.h"
+#include "xla/service/collective_combiner_cost_model.h"
 #include "xla/service/hlo_pass_interface.h"
 #include "xla/statusor.h"
 #include "xla/xla_data.pb.h"
@@ -31,8 +35,13 @@ namespace xla {
 // more efficient than many small ones.
 class AllReduceCombiner : public HloModulePass {
  public:
+  // If `cost_model` is set, the thresholds only bound the combined ops, whose
+  // grouping is chosen to minimize the exposed communication time. See
+  // CombineInstructionsByCost.
   AllReduceCombiner(int64_t combine_threshold_in_bytes,
-                    int64_t combine_threshold_count);
+                    int64_t combine_threshold_count,
+                    std::shared_ptr<const CollectiveCombinerCostModel>
+                        cost_model = nullptr);
 
   absl::string_view name() const override { return "all-reduce-combiner"; }
 
@@ -47,6 +56,8 @@ class AllReduceCombiner : public HloModulePass {
 
   // Combine all reduce ops up to this threshold (number of operands).
   int64_t combine_threshold_count_;
+
+  std::shared_ptr<const CollectiveCombinerCostModel> cost_model_;
 };
 
 }  // namespace xla
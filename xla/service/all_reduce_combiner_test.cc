@@ -24,6 +24,7 @@ limitations under the License.
 #include "xla/hlo/ir/hlo_opcode.h"
 #include "xla/literal.h"
 #include "xla/literal_util.h"
+#include "xla/service/collective_combiner_cost_model.h"
 #include "xla/service/hlo_matchers.h"
 #include "xla/shape_util.h"
 #include "xla/tests/hlo_test_base.h"
@@ -477,5 +478,105 @@ ENTRY %comp {
       op::Tuple(op::GetTupleElement(crs1, 0), op::GetTupleElement(crs1, 1)));
 }
 
+// Each all-reduce takes less time than the dot that follows it, so they can all
+// be overlapped with compute when kept apart, whereas combining them delays
+// the communication until the last dot has finished.
+constexpr char kOverlappableAllReduces[] = R"(
+HloModule module
+
+%add {
+  lhs = f32[] parameter(0)
+  rhs = f32[] parameter(1)
+  ROOT add = f32[] add(lhs, rhs)
+}
+
+ENTRY %comp {
+  p0 = f32[512,512] parameter(0)
+  w = f32[512,512] parameter(1)
+  d1 = f32[512,512] dot(p0, w), lhs_contracting_dims={1},
+    rhs_contracting_dims={0}
+  crs1 = f32[512,512] all-reduce(d1), to_apply=add
+  d2 = f32[512,512] dot(d1, w), lhs_contracting_dims={1},
+    rhs_contracting_dims={0}
+  crs2 = f32[512,512] all-reduce(d2), to_apply=add
+  d3 = f32[512,512] dot(d2, w), lhs_contracting_dims={1},
+    rhs_contracting_dims={0}
+  crs3 = f32[512,512] all-reduce(d3), to_apply=add
+  d4 = f32[512,512] dot(d3, w), lhs_contracting_dims={1},
+    rhs_contracting_dims={0}
+  crs4 = f32[512,512] all-reduce(d4), to_apply=add
+  ROOT tuple = (f32[512,512], f32[512,512], f32[512,512], f32[512,512])
+    tuple(crs1, crs2, crs3, crs4)
+})";
+
+TEST_F(AllReduceCombinerTest, CostModelKeepsOverlappableAllReducesApart) {
+  auto cost_model = std::make_shared<CollectiveCombinerCostModel>(
+      CollectiveCombinerCostModel::Options());
+  TF_ASSERT_OK_AND_ASSIGN(
+      auto by_threshold, ParseAndReturnVerifiedModule(kOverlappableAllReduces));
+  TF_ASSERT_OK_AND_ASSIGN(
+      auto by_cost, ParseAndReturnVerifiedModule(kOverlappableAllReduces));
+
+  AllReduceCombiner threshold_combine(16 * 1024 * 1024, kMaxCombineCount);
+  TF_ASSERT_OK_AND_ASSIGN(bool changed,
+                          threshold_combine.Run(by_threshold.get()));
+  EXPECT_TRUE(changed);
+  EXPECT_EQ(AllReduceCount(*by_threshold), 1);
+
+  AllReduceCombiner cost_combine(16 * 1024 * 1024, kMaxCombineCount,
+                                 cost_model);
+  TF_ASSERT_OK_AND_ASSIGN(changed, cost_combine.Run(by_cost.get()));
+  EXPECT_FALSE(changed);
+  EXPECT_EQ(AllReduceCount(*by_cost), 4);
+
+  // Only the last all-reduce is exposed.
+  CollectiveSimulationResult threshold_result = SimulateCollectiveOverlap(
+      *by_threshold->entry_computation(), *cost_model);
+  CollectiveSimulationResult cost_result =
+      SimulateCollectiveOverlap(*by_cost->entry_computation(), *cost_model);
+  VLOG(1) << "Combined by threshold: " << threshold_result.ToString();
+  VLOG(1) << "Combined by cost: " << cost_result.ToString();
+  EXPECT_DOUBLE_EQ(threshold_result.compute_seconds,
+                   cost_result.compute_seconds);
+  EXPECT_NEAR(cost_result.exposed_collective_seconds,
+              cost_model->CollectiveSeconds(
+                  *by_cost->entry_computation()->GetInstructionWithName("crs4"),
+                  512 * 512 * 4),
+              1e-12);
+  EXPECT_LT(cost_result.total_seconds, threshold_result.total_seconds);
+}
+
+TEST_F(AllReduceCombinerTest, CostModelCombinesLatencyBoundAllReduces) {
+  const char* const hlo_string = R"(
+HloModule module
+
+%add {
+  lhs = f32[] parameter(0)
+  rhs = f32[] parameter(1)
+  ROOT add = f32[] add(lhs, rhs)
+}
+
+ENTRY %comp {
+  p0 = f32[128] parameter(0)
+  p1 = f32[128] parameter(1)
+  p2 = f32[128] parameter(2)
+  crs0 = f32[128] all-reduce(p0), to_apply=add
+  crs1 = f32[128] all-reduce(p1), to_apply=add
+  crs2 = f32[128] all-reduce(p2), to_apply=add
+  ROOT tuple = (f32[128], f32[128], f32[128]) tuple(crs0, crs1, crs2)
+})";
+  TF_ASSERT_OK_AND_ASSIGN(auto module,
+                          ParseAndReturnVerifiedModule(hlo_string));
+  auto cost_model = std::make_shared<CollectiveCombinerCostModel>(
+      CollectiveCombinerCostModel::Options());
+
+  // The count threshold still bounds the combined all-reduces.
+  AllReduceCombiner combine(1024 * 1024, /*combine_threshold_count=*/2,
+                            cost_model);
+  TF_ASSERT_OK_AND_ASSIGN(bool changed, combine.Run(module.get()));
+  EXPECT_TRUE(changed);
+  EXPECT_EQ(AllReduceCount(*module), 2);
+}
+
 }  // namespace
 }  // namespace xla
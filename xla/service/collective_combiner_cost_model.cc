@@ -0,0 +1,237 @@
+/* Copyright 2023 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "xla/service/collective_combiner_cost_model.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "absl/strings/str_cat.h"
+#include "xla/hlo/ir/hlo_opcode.h"
+#include "xla/service/hlo_cost_analysis.h"
+#include "xla/shape_util.h"
+
+namespace xla {
+namespace {
+
+// Instructions that only forward (parts of) their operands.
+bool IsForwarding(const HloInstruction& instruction) {
+  switch (instruction.opcode()) {
+    case HloOpcode::kBitcast:
+    case HloOpcode::kGetTupleElement:
+    case HloOpcode::kTuple:
+      return true;
+    default:
+      return false;
+  }
+}
+
+int64_t ArrayBytes(const Shape& shape) {
+  int64_t bytes = 0;
+  ShapeUtil::ForEachSubshape(
+      shape, [&](const Shape& subshape, const ShapeIndex& /*index*/) {
+        if (subshape.IsArray()) {
+          bytes += ShapeUtil::ByteSizeOf(subshape);
+        }
+      });
+  return bytes;
+}
+
+}  // namespace
+
+bool IsCombinableCollective(const HloInstruction& instruction) {
+  switch (instruction.opcode()) {
+    case HloOpcode::kAllGather:
+    case HloOpcode::kAllReduce:
+    case HloOpcode::kReduceScatter:
+      return true;
+    default:
+      return false;
+  }
+}
+
+double CollectiveCombinerCostModel::CollectiveSeconds(
+    const HloInstruction& collective, int64_t bytes) const {
+  double transfers = collective.opcode() == HloOpcode::kAllReduce ? 2 : 1;
+  return options_.collective_latency_seconds +
+         transfers * bytes / options_.collective_bytes_per_second;
+}
+
+double CollectiveCombinerCostModel::ComputeSeconds(
+    const HloInstruction& instruction) const {
+  if (IsCombinableCollective(instruction) || IsForwarding(instruction) ||
+      instruction.opcode() == HloOpcode::kParameter ||
+      instruction.opcode() == HloOpcode::kConstant) {
+    return 0;
+  }
+  int64_t flops;
+  if (instruction.opcode() == HloOpcode::kDot) {
+    flops = HloCostAnalysis::GetDotFlops(instruction.operand(0)->shape(),
+                                         instruction.shape(),
+                                         instruction.dot_dimension_numbers());
+  } else if (instruction.opcode() == HloOpcode::kConvolution) {
+    flops = HloCostAnalysis::GetConvolutionFlops(
+        &instruction, instruction.operand(0)->shape(),
+        instruction.operand(1)->shape(), instruction.shape());
+  } else {
+    flops = ShapeUtil::ElementsInRecursive(instruction.shape());
+  }
+  int64_t bytes = ArrayBytes(instruction.shape());
+  for (const HloInstruction* operand : instruction.operands()) {
+    bytes += ArrayBytes(operand->shape());
+  }
+  return std::max(flops / options_.flops_per_second,
+                  bytes / options_.memory_bytes_per_second);
+}
+
+CollectiveOverlapAnalysis::CollectiveOverlapAnalysis(
+    absl::Span<HloInstruction* const> sequence,
+    const CollectiveCombinerCostModel& cost_model) {
+  positions_.reserve(sequence.size());
+  compute_prefix_seconds_.reserve(sequence.size() + 1);
+  compute_prefix_seconds_.push_back(0);
+  for (int64_t i = 0; i < sequence.size(); ++i) {
+    positions_[sequence[i]] = i;
+    compute_prefix_seconds_.push_back(compute_prefix_seconds_.back() +
+                                      cost_model.ComputeSeconds(*sequence[i]));
+  }
+}
+
+CollectiveOverlapWindow CollectiveOverlapAnalysis::GetWindow(
+    const HloInstruction* instruction) const {
+  CollectiveOverlapWindow window;
+  for (const HloInstruction* operand : instruction->operands()) {
+    auto it = positions_.find(operand);
+    if (it != positions_.end()) {
+      window.ready = std::max(window.ready, it->second + 1);
+    }
+  }
+  // Results are only needed by the first user that is not merely forwarding
+  // them.
+  window.needed = compute_prefix_seconds_.size() - 1;
+  std::vector<const HloInstruction*> worklist = {instruction};
+  while (!worklist.empty()) {
+    const HloInstruction* value = worklist.back();
+    worklist.pop_back();
+    for (const HloInstruction* user : value->users()) {
+      if (IsForwarding(*user)) {
+        worklist.push_back(user);
+        continue;
+      }
+      auto it = positions_.find(user);
+      if (it != positions_.end()) {
+        window.needed = std::min(window.needed, it->second);
+      }
+    }
+  }
+  return window;
+}
+
+CollectiveOverlapWindow CollectiveOverlapAnalysis::GetCombinedWindow(
+    absl::Span<HloInstruction* const> instructions) const {
+  CollectiveOverlapWindow combined;
+  combined.needed = compute_prefix_seconds_.size() - 1;
+  for (const HloInstruction* instruction : instructions) {
+    CollectiveOverlapWindow window = GetWindow(instruction);
+    combined.ready = std::max(combined.ready, window.ready);
+    combined.needed = std::min(combined.needed, window.needed);
+  }
+  return combined;
+}
+
+std::string CollectiveSimulationResult::ToString() const {
+  return absl::StrCat("total: ", total_seconds * 1e6,
+                      " us, compute: ", compute_seconds * 1e6,
+                      " us, exposed collectives: ",
+                      exposed_collective_seconds * 1e6, " us, ",
+                      num_collectives, " collectives");
+}
+
+CollectiveSimulationResult SimulateCollectiveOverlap(
+    absl::Span<HloInstruction* const> sequence,
+    const CollectiveCombinerCostModel& cost_model) {
+  CollectiveOverlapAnalysis overlap(sequence, cost_model);
+
+  // Collectives issued right before each position.
+  std::vector<std::vector<const HloInstruction*>> issued(sequence.size() + 1);
+  for (const HloInstruction* instruction : sequence) {
+    if (IsCombinableCollective(*instruction)) {
+      issued[overlap.GetWindow(instruction).ready].push_back(instruction);
+    }
+  }
+
+  CollectiveSimulationResult result;
+  double time = 0;
+  double link_free = 0;
+  // Completion times of collectives and of the values forwarding them.
+  absl::flat_hash_map<const HloInstruction*, double> done;
+  auto wait_for = [&](double until) {
+    if (until > time) {
+      result.exposed_collective_seconds += until - time;
+      time = until;
+    }
+  };
+  for (int64_t position = 0; position <= sequence.size(); ++position) {
+    for (const HloInstruction* collective : issued[position]) {
+      double start = std::max(time, link_free);
+      int64_t bytes = ArrayBytes(collective->shape());
+      link_free = start + cost_model.CollectiveSeconds(*collective, bytes);
+      done[collective] = link_free;
+      ++result.num_collectives;
+    }
+    if (position == sequence.size()) {
+      break;
+    }
+    const HloInstruction* instruction = sequence[position];
+    if (IsCombinableCollective(*instruction)) {
+      continue;
+    }
+    double forwarded_done = 0;
+    bool forwards_pending = false;
+    for (const HloInstruction* operand : instruction->operands()) {
+      auto it = done.find(operand);
+      if (it == done.end()) {
+        continue;
+      }
+      if (IsForwarding(*instruction)) {
+        forwarded_done = std::max(forwarded_done, it->second);
+        forwards_pending = true;
+      } else {
+        wait_for(it->second);
+      }
+    }
+    if (forwards_pending) {
+      done[instruction] = forwarded_done;
+    }
+    double seconds = cost_model.ComputeSeconds(*instruction);
+    time += seconds;
+    result.compute_seconds += seconds;
+  }
+  // The computation ends when all of its collectives have finished.
+  wait_for(link_free);
+  result.total_seconds = time;
+  return result;
+}
+
+CollectiveSimulationResult SimulateCollectiveOverlap(
+    const HloComputation& computation,
+    const CollectiveCombinerCostModel& cost_model) {
+  return SimulateCollectiveOverlap(computation.MakeInstructionPostOrder(),
+                                   cost_model);
+}
+
+}  // namespace xla
@@ -0,0 +1,131 @@
+/* Copyright 2023 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef TENSORFLOW_COMPILER_XLA_SERVICE_COLLECTIVE_COMBINER_COST_MODEL_H_
+#define TENSORFLOW_COMPILER_XLA_SERVICE_COLLECTIVE_COMBINER_COST_MODEL_H_
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "absl/container/flat_hash_map.h"
+#include "absl/types/span.h"
+#include "xla/hlo/ir/hlo_computation.h"
+#include "xla/hlo/ir/hlo_instruction.h"
+
+namespace xla {
+
+// Estimates the times that the collective combiners trade off when they run
+// in cost based mode: combining collectives saves their fixed latency, but a
+// combined collective can only start once all of its operands are ready and
+// has to finish before any of its results is used, which shrinks the compute
+// it can be overlapped with.
+class CollectiveCombinerCostModel {
+ public:
+  struct Options {
+    // Fixed cost of every collective, independent of its size.
+    double collective_latency_seconds = 10e-6;
+    // Bandwidth of collectives. All-reduces move their data twice.
+    double collective_bytes_per_second = 1e10;
+    // Throughputs of the device, used to estimate the time of the compute
+    // that collectives can be overlapped with.
+    double flops_per_second = 1e12;
+    double memory_bytes_per_second = 1e11;
+  };
+
+  explicit CollectiveCombinerCostModel(Options options) : options_(options) {}
+  virtual ~CollectiveCombinerCostModel() = default;
+
+  const Options& options() const { return options_; }
+
+  // Returns the time of a collective of the same kind as `collective` whose
+  // results total `bytes`.
+  virtual double CollectiveSeconds(const HloInstruction& collective,
+                                   int64_t bytes) const;
+
+  // Returns the time of a non-collective instruction, as the larger of its
+  // compute and memory times.
+  virtual double ComputeSeconds(const HloInstruction& instruction) const;
+
+ private:
+  Options options_;
+};
+
+// Returns true if `instruction` is a collective that the cost based combining
+// mode and SimulateCollectiveOverlap treat as asynchronous.
+bool IsCombinableCollective(const HloInstruction& instruction);
+
+// The positions at which a collective could start and must have finished in
+// a sequence of instructions.
+struct CollectiveOverlapWindow {
+  // Position right after the last operand of the collective.
+  int64_t ready = 0;
+  // Position of the first user of the collective that does not merely forward
+  // its result, or the length of the sequence if there is none.
+  int64_t needed = 0;
+};
+
+// Precomputes the overlap windows of the instructions of `sequence` and the
+// compute time up to each position.
+class CollectiveOverlapAnalysis {
+ public:
+  CollectiveOverlapAnalysis(absl::Span<HloInstruction* const> sequence,
+                            const CollectiveCombinerCostModel& cost_model);
+
+  CollectiveOverlapWindow GetWindow(const HloInstruction* instruction) const;
+
+  // Returns the window of a collective combining all of `instructions`.
+  CollectiveOverlapWindow GetCombinedWindow(
+      absl::Span<HloInstruction* const> instructions) const;
+
+  // Returns the time of the non-collective instructions before `position`.
+  double ComputeSecondsBefore(int64_t position) const {
+    return compute_prefix_seconds_[position];
+  }
+
+ private:
+  absl::flat_hash_map<const HloInstruction*, int64_t> positions_;
+  // compute_prefix_seconds_[i] is the compute time of the first i
+  // instructions.
+  std::vector<double> compute_prefix_seconds_;
+};
+
+struct CollectiveSimulationResult {
+  double total_seconds = 0;
+  double compute_seconds = 0;
+  // Time the compute waited for collectives.
+  double exposed_collective_seconds = 0;
+  int64_t num_collectives = 0;
+
+  std::string ToString() const;
+};
+
+// Simulates `sequence` on `cost_model` as a latency hiding scheduler would
+// ideally run it: every collective is issued as soon as its operands are
+// ready, collectives share a single link in issue order, and compute only
+// waits for a collective when it uses its result. Nested computations are not
+// simulated.
+CollectiveSimulationResult SimulateCollectiveOverlap(
+    absl::Span<HloInstruction* const> sequence,
+    const CollectiveCombinerCostModel& cost_model);
+
+// Simulates the post order of `computation`.
+CollectiveSimulationResult SimulateCollectiveOverlap(
+    const HloComputation& computation,
+    const CollectiveCombinerCostModel& cost_model);
+
+}  // namespace xla
+
+#endif  // TENSORFLOW_COMPILER_XLA_SERVICE_COLLECTIVE_COMBINER_COST_MODEL_H_
@@ -0,0 +1,132 @@
+/* Copyright 2023 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "xla/service/collective_combiner_cost_model.h"
+
+#include <vector>
+
+#include "xla/hlo/ir/hlo_computation.h"
+#include "xla/hlo/ir/hlo_instruction.h"
+#include "xla/tests/hlo_test_base.h"
+#include "tsl/lib/core/status_test_util.h"
+#include "tsl/platform/test.h"
+
+namespace xla {
+namespace {
+
+using CollectiveCombinerCostModelTest = HloTestBase;
+
+constexpr char kHloString[] = R"(
+HloModule module
+
+add {
+  lhs = f32[] parameter(0)
+  rhs = f32[] parameter(1)
+  ROOT add = f32[] add(lhs, rhs)
+}
+
+ENTRY entry {
+  p0 = f32[1000] parameter(0)
+  ar0 = f32[1000] all-reduce(p0), to_apply=add
+  bitcast = f32[1000] bitcast(ar0)
+  negate0 = f32[1000] negate(p0)
+  negate1 = f32[1000] negate(negate0)
+  sum = f32[1000] add(bitcast, negate1)
+  ar1 = f32[1000] all-reduce(negate1), to_apply=add
+  ROOT tuple = (f32[1000], f32[1000]) tuple(sum, ar1)
+})";
+
+CollectiveCombinerCostModel::Options TestOptions() {
+  CollectiveCombinerCostModel::Options options;
+  options.collective_latency_seconds = 1e-6;
+  options.collective_bytes_per_second = 1e8;
+  options.flops_per_second = 1e12;
+  options.memory_bytes_per_second = 1e9;
+  return options;
+}
+
+TEST_F(CollectiveCombinerCostModelTest, Costs) {
+  TF_ASSERT_OK_AND_ASSIGN(auto module,
+                          ParseAndReturnVerifiedModule(kHloString));
+  CollectiveCombinerCostModel cost_model(TestOptions());
+  const HloComputation* entry = module->entry_computation();
+
+  // All-reduces move their data twice.
+  EXPECT_DOUBLE_EQ(cost_model.CollectiveSeconds(
+                       *entry->GetInstructionWithName("ar0"), 4000),
+                   1e-6 + 8000 / 1e8);
+  // A negate reads and writes 4000 bytes.
+  EXPECT_DOUBLE_EQ(
+      cost_model.ComputeSeconds(*entry->GetInstructionWithName("negate0")),
+      8000 / 1e9);
+  EXPECT_EQ(
+      cost_model.ComputeSeconds(*entry->GetInstructionWithName("bitcast")), 0);
+}
+
+TEST_F(CollectiveCombinerCostModelTest, Windows) {
+  TF_ASSERT_OK_AND_ASSIGN(auto module,
+                          ParseAndReturnVerifiedModule(kHloString));
+  CollectiveCombinerCostModel cost_model(TestOptions());
+  HloComputation* entry = module->entry_computation();
+  std::vector<HloInstruction*> sequence = {
+      entry->GetInstructionWithName("p0"),
+      entry->GetInstructionWithName("ar0"),
+      entry->GetInstructionWithName("bitcast"),
+      entry->GetInstructionWithName("negate0"),
+      entry->GetInstructionWithName("negate1"),
+      entry->GetInstructionWithName("sum"),
+      entry->GetInstructionWithName("ar1"),
+      entry->GetInstructionWithName("tuple")};
+  CollectiveOverlapAnalysis overlap(sequence, cost_model);
+
+  // ar0 is needed by the sum through the bitcast.
+  CollectiveOverlapWindow ar0 = overlap.GetWindow(sequence[1]);
+  EXPECT_EQ(ar0.ready, 1);
+  EXPECT_EQ(ar0.needed, 5);
+  EXPECT_DOUBLE_EQ(overlap.ComputeSecondsBefore(ar0.needed) -
+                       overlap.ComputeSecondsBefore(ar0.ready),
+                   2 * 8000 / 1e9);
+  // ar1 is only forwarded to the root tuple.
+  CollectiveOverlapWindow ar1 = overlap.GetWindow(sequence[6]);
+  EXPECT_EQ(ar1.ready, 5);
+  EXPECT_EQ(ar1.needed, 8);
+
+  CollectiveOverlapWindow combined =
+      overlap.GetCombinedWindow({sequence[1], sequence[6]});
+  EXPECT_EQ(combined.ready, 5);
+  EXPECT_EQ(combined.needed, 5);
+}
+
+TEST_F(CollectiveCombinerCostModelTest, Simulation) {
+  TF_ASSERT_OK_AND_ASSIGN(auto module,
+                          ParseAndReturnVerifiedModule(kHloString));
+  CollectiveCombinerCostModel cost_model(TestOptions());
+  CollectiveSimulationResult result =
+      SimulateCollectiveOverlap(*module->entry_computation(), cost_model);
+
+  // ar0 overlaps with the two negates, after which the sum waits for it. ar1
+  // is issued before the sum but has to wait for ar0 to free the link.
+  const double negate_seconds = 8000 / 1e9;
+  const double add_seconds = 12000 / 1e9;
+  const double all_reduce_seconds = 1e-6 + 8000 / 1e8;
+  EXPECT_EQ(result.num_collectives, 2);
+  EXPECT_DOUBLE_EQ(result.compute_seconds, 2 * negate_seconds + add_seconds);
+  EXPECT_DOUBLE_EQ(result.total_seconds, 2 * all_reduce_seconds);
+  EXPECT_DOUBLE_EQ(result.total_seconds,
+                   result.compute_seconds + result.exposed_collective_seconds);
+}
+
+}  // namespace
+}  // namespace xla
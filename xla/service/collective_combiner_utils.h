@@ -16,10 +16,15 @@ limitations under the License.
 #ifndef TENSORFLOW_COMPILER_XLA_SERVICE_COLLECTIVE_COMBINER_UTILS_H_
 #define TENSORFLOW_COMPILER_XLA_SERVICE_COLLECTIVE_COMBINER_UTILS_H_
 
+#include <algorithm>
 #include <functional>
+#include <limits>
+#include <memory>
+#include <optional>
 #include <utility>
 #include <vector>
 
+#include "absl/algorithm/container.h"
 #include "absl/container/flat_hash_map.h"
 #include "absl/container/flat_hash_set.h"
 #include "absl/functional/function_ref.h"
@@ -27,6 +32,7 @@ limitations under the License.
 #include "xla/hlo/ir/hlo_instructions.h"
 #include "xla/hlo/ir/hlo_opcode.h"
 #include "xla/hlo/ir/hlo_reachability.h"
+#include "xla/service/collective_combiner_cost_model.h"
 #include "xla/service/hlo_domain_map.h"
 #include "xla/shape_util.h"
 #include "xla/status_macros.h"
@@ -149,6 +155,135 @@ StatusOr<bool> CombineInstructionsByKey(
   return changed;
 }
 
+// Combines instructions with matching keys together, choosing the groups
+// that minimize the time `cost_model` estimates the compute stalls waiting
+// for them.
+//
+// Each key's instructions are split, in topological post-order, into runs of
+// independent instructions below the byte size and count thresholds. A
+// combined instruction can only start once all of its operands are ready and
+// must finish before any of its results is used, so the split trades the
+// latency saved by combining against the overlap window lost. Runs are
+// evaluated as SimulateCollectiveOverlap would run them, sharing one link,
+// assuming that their results are needed in the order they become ready.
+template <typename K>
+StatusOr<bool> CombineInstructionsByCost(
+    HloComputation* computation,
+    absl::FunctionRef<std::optional<K>(const HloInstruction*)> key_fn,
+    absl::FunctionRef<Status(absl::Span<HloInstruction* const>)> combine_fn,
+    int64_t combine_threshold_bytes, int64_t combine_threshold_count,
+    const CollectiveCombinerCostModel& cost_model) {
+  std::vector<HloInstruction*> post_order =
+      computation->MakeInstructionPostOrder();
+  CollectiveOverlapAnalysis overlap(post_order, cost_model);
+  std::unique_ptr<HloReachabilityMap> reachability =
+      HloReachabilityMap::Build(computation);
+
+  std::vector<K> key_order;
+  absl::flat_hash_map<K, std::vector<HloInstruction*>> candidates;
+  for (HloInstruction* instruction : post_order) {
+    std::optional<K> key = key_fn(instruction);
+    // We do not handle ops that have more than one operand since that is
+    // simpler and this pass is the only way to generate such ops.
+    if (!key || instruction->operands().size() != 1) {
+      continue;
+    }
+    TF_RET_CHECK(instruction->shape().IsArray());
+    auto [it, inserted] = candidates.try_emplace(*key);
+    if (inserted) {
+      key_order.push_back(*key);
+    }
+    it->second.push_back(instruction);
+  }
+
+  std::vector<std::vector<HloInstruction*>> to_combine;
+  for (const K& key : key_order) {
+    const std::vector<HloInstruction*>& instructions = candidates[key];
+    const int64_t n = instructions.size();
+    // cost[j] is the (stall, link free) time after the best split of the
+    // first j instructions, whose last run starts at split[j]. Stalls delay
+    // the compute of later runs.
+    using Cost = std::pair<double, double>;
+    std::vector<Cost> cost(n + 1, {std::numeric_limits<double>::infinity(),
+                                   std::numeric_limits<double>::infinity()});
+    std::vector<int64_t> split(n + 1, 0);
+    cost[0] = {0, 0};
+    for (int64_t j = 1; j <= n; ++j) {
+      int64_t bytes = 0;
+      CollectiveOverlapWindow window;
+      window.needed = std::numeric_limits<int64_t>::max();
+      for (int64_t i = j - 1; i >= 0 && j - i <= combine_threshold_count;
+           --i) {
+        bytes += ShapeUtil::ByteSizeOf(instructions[i]->shape());
+        if (i < j - 1 && bytes > combine_threshold_bytes) {
+          break;
+        }
+        // We can't combine dependent instructions.
+        bool is_reachable = false;
+        for (int64_t k = i + 1; k < j && !is_reachable; ++k) {
+          is_reachable =
+              reachability->IsReachable(instructions[i], instructions[k]);
+        }
+        if (is_reachable) {
+          break;
+        }
+        CollectiveOverlapWindow member = overlap.GetWindow(instructions[i]);
+        window.ready = std::max(window.ready, member.ready);
+        window.needed = std::min(window.needed, member.needed);
+        const auto& [stall, link_free] = cost[i];
+        double start = std::max(
+            stall + overlap.ComputeSecondsBefore(window.ready), link_free);
+        double end =
+            start + cost_model.CollectiveSeconds(*instructions[i], bytes);
+        double needed = stall + overlap.ComputeSecondsBefore(window.needed);
+        Cost candidate = {stall + std::max(0.0, end - needed), end};
+        if (candidate < cost[j]) {
+          cost[j] = candidate;
+          split[j] = i;
+        }
+      }
+    }
+    VLOG(1) << "Cost based combining of " << n << " instructions stalls for "
+            << cost[n].first << " seconds";
+    for (int64_t j = n; j > 0; j = split[j]) {
+      if (j - split[j] > 1) {
+        to_combine.emplace_back(instructions.begin() + split[j],
+                                instructions.begin() + j);
+      }
+    }
+  }
+
+  bool changed = false;
+  for (const std::vector<HloInstruction*>& group : to_combine) {
+    // Combining earlier groups may have made the instructions of this group
+    // dependent, in which case it is combined in independent pieces.
+    if (changed) {
+      reachability = HloReachabilityMap::Build(computation);
+    }
+    std::vector<HloInstruction*> piece;
+    for (HloInstruction* instruction : group) {
+      bool is_reachable =
+          absl::c_any_of(piece, [&](HloInstruction* to_combine_inst) {
+            return reachability->IsReachable(to_combine_inst, instruction);
+          });
+      if (is_reachable) {
+        if (piece.size() > 1) {
+          TF_RETURN_IF_ERROR(combine_fn(piece));
+          changed = true;
+          reachability = HloReachabilityMap::Build(computation);
+        }
+        piece.clear();
+      }
+      piece.push_back(instruction);
+    }
+    if (piece.size() > 1) {
+      TF_RETURN_IF_ERROR(combine_fn(piece));
+      changed = true;
+    }
+  }
+  return changed;
+}
+
 }  // namespace xla
 
 #endif  // TENSORFLOW_COMPILER_XLA_SERVICE_COLLECTIVE_COMBINER_UTILS_H_
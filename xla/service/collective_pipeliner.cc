@@ -0,0 +1,509 @@
+/* Copyright 2023 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "xla/service/collective_pipeliner.h"
+
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <vector>
+
+#include "absl/container/flat_hash_map.h"
+#include "absl/container/flat_hash_set.h"
+#include "absl/types/span.h"
+#include "xla/comparison_util.h"
+#include "xla/hlo/ir/hlo_clone_context.h"
+#include "xla/hlo/ir/hlo_computation.h"
+#include "xla/hlo/ir/hlo_instruction.h"
+#include "xla/hlo/ir/hlo_opcode.h"
+#include "xla/service/call_graph.h"
+#include "xla/service/call_inliner.h"
+#include "xla/service/hlo_creation_utils.h"
+#include "xla/service/hlo_query.h"
+#include "xla/service/while_loop_analysis.h"
+#include "xla/service/while_util.h"
+#include "xla/shape_util.h"
+#include "xla/xla_data.pb.h"
+#include "tsl/platform/errors.h"
+#include "tsl/platform/logging.h"
+#include "tsl/platform/statusor.h"
+
+namespace xla {
+namespace {
+
+bool IsPipelinableCollective(const HloInstruction* hlo) {
+  switch (hlo->opcode()) {
+    case HloOpcode::kAllGather:
+    case HloOpcode::kAllReduce:
+    case HloOpcode::kAllToAll:
+    case HloOpcode::kReduceScatter:
+      return true;
+    default:
+      return false;
+  }
+}
+
+// Instructions with the same value in every iteration that can be recomputed
+// outside of the loop.
+bool IsLoopIndependentLeaf(const HloInstruction* hlo) {
+  return hlo->IsConstant() || hlo->opcode() == HloOpcode::kIota ||
+         hlo->opcode() == HloOpcode::kReplicaId ||
+         hlo->opcode() == HloOpcode::kPartitionId;
+}
+
+// Instructions that prevent peeling the last iteration of a loop into an
+// epilogue, because the epilogue would share their called computations or
+// break their pairing.
+bool PreventsPeeling(const HloInstruction* hlo) {
+  switch (hlo->opcode()) {
+    case HloOpcode::kCall:
+    case HloOpcode::kConditional:
+    case HloOpcode::kWhile:
+    case HloOpcode::kSend:
+    case HloOpcode::kSendDone:
+    case HloOpcode::kRecv:
+    case HloOpcode::kRecvDone:
+    case HloOpcode::kAsyncStart:
+    case HloOpcode::kAsyncUpdate:
+    case HloOpcode::kAsyncDone:
+    case HloOpcode::kAllGatherStart:
+    case HloOpcode::kAllGatherDone:
+    case HloOpcode::kAllReduceStart:
+    case HloOpcode::kAllReduceDone:
+    case HloOpcode::kCollectivePermuteStart:
+    case HloOpcode::kCollectivePermuteDone:
+      return true;
+    default:
+      return false;
+  }
+}
+
+struct LoopInfo {
+  HloInstruction* loop;
+  int64_t induction_var_index;
+  int64_t trip_count;
+  // Value of the induction variable in the last iteration.
+  int64_t last_induction_var;
+  // Indices of loop state elements that do not change across iterations.
+  absl::flat_hash_set<int64_t> invariant_indices;
+};
+
+std::optional<LoopInfo> AnalyzeLoop(HloInstruction* loop,
+                                    const CallGraph& call_graph) {
+  HloComputation* body = loop->while_body();
+  HloComputation* cond = loop->while_condition();
+  const HloInstruction* init = loop->operand(0);
+  const HloInstruction* root = body->root_instruction();
+  if (init->opcode() != HloOpcode::kTuple ||
+      root->opcode() != HloOpcode::kTuple) {
+    VLOG(2) << "Skip " << loop->name() << ", non-tuple loop state";
+    return std::nullopt;
+  }
+  if (loop->has_sharding() || !loop->control_predecessors().empty() ||
+      !loop->control_successors().empty()) {
+    VLOG(2) << "Skip " << loop->name() << ", sharded loop or control deps";
+    return std::nullopt;
+  }
+  for (const HloComputation* computation : {body, cond}) {
+    if (call_graph.GetNode(computation).caller_callsites().size() != 1) {
+      VLOG(2) << "Skip " << loop->name() << ", " << computation->name()
+              << " has multiple callers";
+      return std::nullopt;
+    }
+    for (const HloInstruction* user :
+         computation->parameter_instruction(0)->users()) {
+      if (user->opcode() != HloOpcode::kGetTupleElement) {
+        VLOG(2) << "Skip " << loop->name() << ", non-GTE use of "
+                << computation->name() << " parameter";
+        return std::nullopt;
+      }
+    }
+  }
+  for (const HloInstruction* hlo : body->instructions()) {
+    if (PreventsPeeling(hlo)) {
+      VLOG(2) << "Skip " << loop->name() << ", body contains " << hlo->name();
+      return std::nullopt;
+    }
+  }
+  for (const HloInstruction* hlo : cond->instructions()) {
+    if (hlo->HasSideEffect()) {
+      VLOG(2) << "Skip " << loop->name() << ", side-effecting condition";
+      return std::nullopt;
+    }
+  }
+
+  std::optional<int64_t> index = GetLoopInductionVarTupleIdx(loop);
+  if (!index.has_value()) {
+    VLOG(2) << "Skip " << loop->name() << ", no induction var";
+    return std::nullopt;
+  }
+  const HloInstruction* initial = init->operand(*index);
+  std::optional<int64_t> initial_value;
+  if (initial->IsConstant() && initial->shape().rank() == 0) {
+    initial_value = initial->literal().GetFirstInteger();
+  }
+  auto is_induction_var = [&](const HloInstruction* hlo) {
+    return hlo->opcode() == HloOpcode::kGetTupleElement &&
+           hlo->operand(0) == body->parameter_instruction(0) &&
+           hlo->tuple_index() == *index;
+  };
+  const HloInstruction* update = root->operand(*index);
+  std::optional<int64_t> step;
+  if (update->opcode() == HloOpcode::kAdd ||
+      update->opcode() == HloOpcode::kSubtract) {
+    const HloInstruction* lhs = update->operand(0);
+    const HloInstruction* rhs = update->operand(1);
+    if (is_induction_var(lhs) && rhs->IsConstant()) {
+      step = rhs->literal().GetFirstInteger();
+      if (step.has_value() && update->opcode() == HloOpcode::kSubtract) {
+        step = -*step;
+      }
+    } else if (update->opcode() == HloOpcode::kAdd && is_induction_var(rhs) &&
+               lhs->IsConstant()) {
+      step = lhs->literal().GetFirstInteger();
+    }
+  }
+  if (!initial_value.has_value() || !step.has_value()) {
+    VLOG(2) << "Skip " << loop->name()
+            << ", induction var is not a constant incremented by a constant";
+    return std::nullopt;
+  }
+  std::optional<int64_t> trip_count = ComputeWhileLoopTripCount(loop);
+  if (!trip_count.has_value() || *trip_count < 1) {
+    VLOG(2) << "Skip " << loop->name() << ", unknown trip count";
+    return std::nullopt;
+  }
+
+  LoopInfo info;
+  info.loop = loop;
+  info.induction_var_index = *index;
+  info.trip_count = *trip_count;
+  info.last_induction_var = *initial_value + (*trip_count - 1) * *step;
+  for (const HloInstruction* gte :
+       WhileUtil::GetInvariantGTEsForWhileBody(*body)) {
+    info.invariant_indices.insert(gte->tuple_index());
+  }
+  return info;
+}
+
+struct PipelinedCollective {
+  HloInstruction* collective;
+  // The instructions computing the operands of `collective`, followed by the
+  // collective itself, in post order.
+  std::vector<HloInstruction*> instructions;
+};
+
+// Returns the instructions computing the operands of `collective` if they only
+// depend on loop invariants and the induction variable.
+std::optional<PipelinedCollective> FindLoopIndependentOperands(
+    HloInstruction* collective, const LoopInfo& info,
+    absl::Span<HloInstruction* const> post_order,
+    int64_t max_operand_instructions) {
+  const HloInstruction* param =
+      collective->parent()->parameter_instruction(0);
+  absl::flat_hash_set<HloInstruction*> visited;
+  std::vector<HloInstruction*> worklist(collective->operands().begin(),
+                                        collective->operands().end());
+  int64_t num_computed = 0;
+  while (!worklist.empty()) {
+    HloInstruction* hlo = worklist.back();
+    worklist.pop_back();
+    if (!visited.insert(hlo).second) {
+      continue;
+    }
+    if (hlo->opcode() == HloOpcode::kGetTupleElement &&
+        hlo->operand(0) == param) {
+      if (hlo->tuple_index() != info.induction_var_index &&
+          !info.invariant_indices.contains(hlo->tuple_index())) {
+        return std::nullopt;
+      }
+      continue;
+    }
+    if (IsLoopIndependentLeaf(hlo)) {
+      continue;
+    }
+    if (++num_computed > max_operand_instructions ||
+        hlo->opcode() == HloOpcode::kParameter ||
+        hlo->opcode() == HloOpcode::kRng || hlo->HasSideEffectNoRecurse() ||
+        IsPipelinableCollective(hlo) || !hlo->called_computations().empty() ||
+        !hlo->control_predecessors().empty()) {
+      return std::nullopt;
+    }
+    worklist.insert(worklist.end(), hlo->operands().begin(),
+                    hlo->operands().end());
+  }
+  visited.insert(collective);
+  PipelinedCollective pipelined;
+  pipelined.collective = collective;
+  for (HloInstruction* hlo : post_order) {
+    if (visited.contains(hlo)) {
+      pipelined.instructions.push_back(hlo);
+    }
+  }
+  return pipelined;
+}
+
+// Returns the cost of the instructions of the loop body that neither feed nor
+// use `collective`.
+LatencyEstimator::TimeCost IndependentCost(
+    const HloInstruction* collective,
+    const LatencyEstimator& latency_estimator) {
+  absl::flat_hash_set<const HloInstruction*> dependent = {collective};
+  std::vector<const HloInstruction*> worklist = {collective};
+  while (!worklist.empty()) {
+    const HloInstruction* hlo = worklist.back();
+    worklist.pop_back();
+    for (const HloInstruction* operand : hlo->operands()) {
+      if (dependent.insert(operand).second) {
+        worklist.push_back(operand);
+      }
+    }
+  }
+  worklist = {collective};
+  while (!worklist.empty()) {
+    const HloInstruction* hlo = worklist.back();
+    worklist.pop_back();
+    for (const HloInstruction* user : hlo->users()) {
+      if (dependent.insert(user).second) {
+        worklist.push_back(user);
+      }
+    }
+  }
+  LatencyEstimator::TimeCost cost = 0;
+  for (const HloInstruction* hlo : collective->parent()->instructions()) {
+    if (!dependent.contains(hlo)) {
+      cost += latency_estimator.NodeCost(hlo);
+    }
+  }
+  return cost;
+}
+
+std::vector<PipelinedCollective> FindPipelinedCollectives(
+    const LoopInfo& info, const CollectivePipeliner::Config& config) {
+  std::vector<HloInstruction*> post_order =
+      info.loop->while_body()->MakeInstructionPostOrder();
+  std::vector<PipelinedCollective> collectives;
+  for (HloInstruction* hlo : post_order) {
+    if (!IsPipelinableCollective(hlo) || hlo->HasSideEffectNoRecurse() ||
+        !hlo->control_predecessors().empty() ||
+        !hlo->control_successors().empty()) {
+      continue;
+    }
+    std::optional<PipelinedCollective> pipelined = FindLoopIndependentOperands(
+        hlo, info, post_order, config.max_operand_instructions);
+    if (!pipelined.has_value()) {
+      VLOG(2) << "Not pipelining " << hlo->name()
+              << ", operands depend on the loop state";
+      continue;
+    }
+    if (config.latency_estimator != nullptr) {
+      LatencyEstimator::TimeCost cost =
+          IndependentCost(hlo, *config.latency_estimator);
+      if (cost >= config.collective_latency) {
+        VLOG(2) << "Not pipelining " << hlo->name()
+                << ", can be overlapped with " << cost
+                << " within the iteration";
+        continue;
+      }
+    }
+    collectives.push_back(*std::move(pipelined));
+  }
+  return collectives;
+}
+
+// Rewrites the loop of `info` to compute `collectives` one iteration ahead, as
+// described in the header, and peels its last iteration into an epilogue.
+Status PipelineCollectives(const LoopInfo& info,
+                           absl::Span<const PipelinedCollective> collectives,
+                           int64_t* next_channel_id) {
+  HloInstruction* loop = info.loop;
+  HloComputation* computation = loop->parent();
+  HloModule* module = computation->parent();
+  HloComputation* body = loop->while_body();
+  HloComputation* cond = loop->while_condition();
+  HloInstruction* init = loop->mutable_operand(0);
+  HloInstruction* body_param = body->parameter_instruction(0);
+  const int64_t num_elements = loop->shape().tuple_shapes_size();
+  auto assign_channel_id = [&](HloInstruction* hlo) {
+    if (hlo->channel_id().has_value()) {
+      hlo->set_channel_id((*next_channel_id)++);
+    }
+  };
+
+  // The results of the collectives are carried to the next iteration in new
+  // elements of the loop state.
+  Shape shape = loop->shape();
+  for (const PipelinedCollective& pipelined : collectives) {
+    ShapeUtil::AppendShapeToTuple(pipelined.collective->shape(), &shape);
+  }
+  *body_param->mutable_shape() = shape;
+  *cond->parameter_instruction(0)->mutable_shape() = shape;
+  for (int64_t i = 0; i < collectives.size(); ++i) {
+    HloInstruction* carried =
+        body->AddInstruction(HloInstruction::CreateGetTupleElement(
+            body_param, num_elements + i));
+    TF_RETURN_IF_ERROR(
+        collectives[i].collective->ReplaceAllUsesWith(carried));
+  }
+
+  // The epilogue runs the last iteration on the carried results, without
+  // issuing the collectives for the iteration after it.
+  HloCloneContext context(module);
+  HloComputation* epilogue =
+      module->AddEmbeddedComputation(body->Clone("epilogue", &context));
+  for (const PipelinedCollective& pipelined : collectives) {
+    TF_RETURN_IF_ERROR(epilogue->RemoveInstructionAndUnusedOperands(
+        context.GetInstruction(pipelined.collective)));
+  }
+
+  // Clone the collectives and their operands into the prologue, reading the
+  // initial loop state, and into the body, reading the induction variable of
+  // the next iteration.
+  HloInstruction* next_induction_var =
+      body->root_instruction()->mutable_operand(info.induction_var_index);
+  absl::flat_hash_map<HloInstruction*, HloInstruction*> prologue_map;
+  absl::flat_hash_map<HloInstruction*, HloInstruction*> next_map;
+  std::vector<HloInstruction*> prologue_results;
+  std::vector<HloInstruction*> next_results;
+  for (const PipelinedCollective& pipelined : collectives) {
+    for (HloInstruction* hlo : pipelined.instructions) {
+      if (prologue_map.contains(hlo)) {
+        continue;
+      }
+      if (hlo->opcode() == HloOpcode::kGetTupleElement &&
+          hlo->operand(0) == body_param) {
+        prologue_map[hlo] = init->mutable_operand(hlo->tuple_index());
+        next_map[hlo] = hlo->tuple_index() == info.induction_var_index
+                            ? next_induction_var
+                            : hlo;
+        continue;
+      }
+      if (IsLoopIndependentLeaf(hlo)) {
+        prologue_map[hlo] = computation->AddInstruction(hlo->Clone());
+        next_map[hlo] = hlo;
+        continue;
+      }
+      for (auto* map : {&prologue_map, &next_map}) {
+        std::vector<HloInstruction*> operands;
+        for (HloInstruction* operand : hlo->operands()) {
+          operands.push_back(map->at(operand));
+        }
+        HloComputation* target = map == &prologue_map ? computation : body;
+        HloInstruction* clone = target->AddInstruction(
+            hlo->CloneWithNewOperands(hlo->shape(), operands));
+        assign_channel_id(clone);
+        (*map)[hlo] = clone;
+      }
+    }
+    prologue_results.push_back(prologue_map.at(pipelined.collective));
+    next_results.push_back(next_map.at(pipelined.collective));
+  }
+  for (const PipelinedCollective& pipelined : collectives) {
+    TF_RETURN_IF_ERROR(
+        body->RemoveInstructionAndUnusedOperands(pipelined.collective));
+  }
+
+  HloInstruction* old_root = body->root_instruction();
+  std::vector<HloInstruction*> root_operands(old_root->operands().begin(),
+                                             old_root->operands().end());
+  root_operands.insert(root_operands.end(), next_results.begin(),
+                       next_results.end());
+  body->set_root_instruction(
+      body->AddInstruction(HloInstruction::CreateTuple(root_operands)),
+      /*accept_different_shape=*/true);
+  TF_RETURN_IF_ERROR(body->RemoveInstruction(old_root));
+
+  // The loop stops one iteration early, which the epilogue runs instead.
+  HloInstruction* old_cond_root = cond->root_instruction();
+  HloInstruction* induction_var =
+      cond->AddInstruction(HloInstruction::CreateGetTupleElement(
+          cond->parameter_instruction(0), info.induction_var_index));
+  TF_ASSIGN_OR_RETURN(
+      HloInstruction * not_last,
+      MakeCompareHlo(Comparison::Direction::kNe, induction_var,
+                     MakeScalarLike(induction_var, info.last_induction_var)));
+  cond->set_root_instruction(not_last);
+  TF_RETURN_IF_ERROR(cond->RemoveInstructionAndUnusedOperands(old_cond_root));
+
+  std::vector<HloInstruction*> init_operands(init->operands().begin(),
+                                             init->operands().end());
+  init_operands.insert(init_operands.end(), prologue_results.begin(),
+                       prologue_results.end());
+  HloInstruction* new_loop =
+      computation->AddInstruction(HloInstruction::CreateWhile(
+          shape, cond, body,
+          computation->AddInstruction(
+              HloInstruction::CreateTuple(init_operands))));
+  new_loop->set_metadata(loop->metadata());
+  TF_ASSIGN_OR_RETURN(WhileLoopBackendConfig config,
+                      loop->backend_config<WhileLoopBackendConfig>());
+  if (config.has_known_trip_count()) {
+    config.mutable_known_trip_count()->set_n(info.trip_count - 1);
+    TF_RETURN_IF_ERROR(new_loop->set_backend_config(config));
+  }
+
+  HloInstruction* call = computation->AddInstruction(
+      HloInstruction::CreateCall(loop->shape(), {new_loop}, epilogue));
+  TF_RETURN_IF_ERROR(computation->ReplaceInstruction(loop, call));
+  std::vector<HloInstruction*> epilogue_order =
+      epilogue->MakeInstructionPostOrder();
+  TF_ASSIGN_OR_RETURN(CallInliner::InlinedInstructionMap inlined,
+                      CallInliner::Inline(call));
+  for (HloInstruction* hlo : epilogue_order) {
+    if (hlo->opcode() != HloOpcode::kParameter) {
+      assign_channel_id(inlined.at(hlo));
+    }
+  }
+  return module->RemoveEmbeddedComputation(epilogue);
+}
+
+}  // namespace
+
+StatusOr<bool> CollectivePipeliner::Run(
+    HloModule* module,
+    const absl::flat_hash_set<absl::string_view>& execution_threads) {
+  std::unique_ptr<CallGraph> call_graph = CallGraph::Build(module);
+  std::vector<HloInstruction*> loops;
+  for (HloComputation* computation :
+       module->MakeNonfusionComputations(execution_threads)) {
+    for (HloInstruction* hlo : computation->MakeInstructionPostOrder()) {
+      if (hlo->opcode() == HloOpcode::kWhile) {
+        loops.push_back(hlo);
+      }
+    }
+  }
+
+  int64_t next_channel_id = hlo_query::NextChannelId(*module);
+  bool changed = false;
+  for (HloInstruction* loop : loops) {
+    std::optional<LoopInfo> info = AnalyzeLoop(loop, *call_graph);
+    if (!info.has_value()) {
+      continue;
+    }
+    std::vector<PipelinedCollective> collectives =
+        FindPipelinedCollectives(*info, config_);
+    if (collectives.empty()) {
+      continue;
+    }
+    VLOG(1) << "Pipelining " << collectives.size() << " collectives of "
+            << loop->name();
+    TF_RETURN_IF_ERROR(
+        PipelineCollectives(*info, collectives, &next_channel_id));
+    changed = true;
+  }
+  return changed;
+}
+
+}  // namespace xla
@@ -0,0 +1,90 @@
+/* Copyright 2023 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef TENSORFLOW_COMPILER_XLA_SERVICE_COLLECTIVE_PIPELINER_H_
+#define TENSORFLOW_COMPILER_XLA_SERVICE_COLLECTIVE_PIPELINER_H_
+
+#include <cstdint>
+
+#include "absl/container/flat_hash_set.h"
+#include "absl/strings/string_view.h"
+#include "xla/hlo/ir/hlo_module.h"
+#include "xla/service/hlo_pass_interface.h"
+#include "xla/service/latency_hiding_scheduler.h"
+#include "xla/statusor.h"
+
+namespace xla {
+
+// HLO pass that software-pipelines while loops, so that collectives whose
+// operands only depend on loop invariants and the induction variable are
+// issued one iteration ahead of their users. The latency hiding scheduler can
+// then overlap the collective for iteration i+1 with all of the compute of
+// iteration i, instead of only with the compute that neither feeds nor uses
+// it.
+//
+// Pattern before this pass:
+// i = 0
+// while (i < n):
+//   a = all-gather(dynamic-slice(w, i))
+//   x = f(a, x)
+//   i += 1
+// Pattern after this pass:
+// i = 0
+// a = all-gather(dynamic-slice(w, i))
+// while (i != n - 1):
+//   next_a = all-gather(dynamic-slice(w, i + 1))
+//   x = f(a, x)
+//   a = next_a
+//   i += 1
+// x = f(a, x)
+//
+// Only loops with a statically known trip count, whose induction variable
+// starts at a constant and is incremented by a constant, and whose body has
+// no control flow or send/recv are pipelined.
+class CollectivePipeliner : public HloModulePass {
+ public:
+  struct Config {
+    // If set, a collective is only pipelined if the instructions of the loop
+    // body that neither feed nor use it, which are all that the scheduler can
+    // overlap it with otherwise, cost less than `collective_latency`.
+    const LatencyEstimator* latency_estimator = nullptr;
+    // Latency of a collective in the TimeCost units of `latency_estimator`,
+    // i.e. latency_estimator->CyclesPerMicrosecond() per microsecond for
+    // estimators that measure time. The default is what
+    // ApproximateLatencyEstimator assumes for an async collective.
+    LatencyEstimator::TimeCost collective_latency =
+        ApproximateLatencyEstimator::kHighLatency;
+    // Maximum number of instructions computing the operands of a collective,
+    // which are cloned into the prologue and into the loop body to compute
+    // the operands for the next iteration.
+    int64_t max_operand_instructions = 16;
+  };
+
+  explicit CollectivePipeliner(const Config& config) : config_(config) {}
+  ~CollectivePipeliner() override = default;
+
+  absl::string_view name() const override { return "collective-pipeliner"; }
+  using HloPassInterface::Run;
+  StatusOr<bool> Run(
+      HloModule* module,
+      const absl::flat_hash_set<absl::string_view>& execution_threads) override;
+
+ private:
+  Config config_;
+};
+
+}  // namespace xla
+
+#endif  // TENSORFLOW_COMPILER_XLA_SERVICE_COLLECTIVE_PIPELINER_H_
@@ -0,0 +1,196 @@
+/* Copyright 2023 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "xla/service/collective_pipeliner.h"
+
+#include "absl/strings/string_view.h"
+#include "xla/hlo/ir/hlo_computation.h"
+#include "xla/hlo/ir/hlo_instruction.h"
+#include "xla/hlo/ir/hlo_opcode.h"
+#include "xla/service/hlo_matchers.h"
+#include "xla/service/hlo_verifier.h"
+#include "xla/service/latency_hiding_scheduler.h"
+#include "xla/service/while_loop_analysis.h"
+#include "xla/tests/hlo_test_base.h"
+#include "tsl/lib/core/status_test_util.h"
+#include "tsl/platform/test.h"
+
+namespace xla {
+namespace {
+
+namespace op = ::xla::testing::opcode_matchers;
+
+class CollectivePipelinerTest : public HloTestBase {
+ protected:
+  StatusOr<bool> RunPipeliner(HloModule* module,
+                              const CollectivePipeliner::Config& config) {
+    CollectivePipeliner pipeliner(config);
+    TF_ASSIGN_OR_RETURN(bool changed, RunHloPass(&pipeliner, module));
+    TF_RETURN_IF_ERROR(HloVerifier(/*layout_sensitive=*/false,
+                                   /*allow_mixed_precision=*/false)
+                           .Run(module)
+                           .status());
+    return changed;
+  }
+};
+
+// Each iteration gathers one slice of a loop invariant stack of weights.
+constexpr absl::string_view kAllGatherLoop = R"(
+HloModule module
+
+cond {
+  param = (s32[], f32[4,8], f32[3,2,8]) parameter(0)
+  i = s32[] get-tuple-element(param), index=0
+  n = s32[] constant(3)
+  ROOT lt = pred[] compare(i, n), direction=LT
+}
+
+body {
+  param = (s32[], f32[4,8], f32[3,2,8]) parameter(0)
+  i = s32[] get-tuple-element(param), index=0
+  x = f32[4,8] get-tuple-element(param), index=1
+  w = f32[3,2,8] get-tuple-element(param), index=2
+  zero = s32[] constant(0)
+  ds = f32[1,2,8] dynamic-slice(w, i, zero, zero), dynamic_slice_sizes={1,2,8}
+  slice = f32[2,8] reshape(ds)
+  ag = f32[4,8] all-gather(slice), channel_id=1, replica_groups={{0,1}},
+    dimensions={0}, use_global_device_ids=true
+  mul = f32[4,8] multiply(x, ag)
+  next_x = f32[4,8] add(mul, ag)
+  one = s32[] constant(1)
+  next_i = s32[] add(i, one)
+  ROOT tuple = (s32[], f32[4,8], f32[3,2,8]) tuple(next_i, next_x, w)
+}
+
+ENTRY entry {
+  p0 = f32[4,8] parameter(0)
+  p1 = f32[3,2,8] parameter(1)
+  zero = s32[] constant(0)
+  init = (s32[], f32[4,8], f32[3,2,8]) tuple(zero, p0, p1)
+  while = (s32[], f32[4,8], f32[3,2,8]) while(init), condition=cond, body=body
+  ROOT result = f32[4,8] get-tuple-element(while), index=1
+})";
+
+TEST_F(CollectivePipelinerTest, AllGatherOfInvariantSlice) {
+  TF_ASSERT_OK_AND_ASSIGN(
+      auto module, ParseAndReturnVerifiedModule(kAllGatherLoop,
+                                                /*replica_count=*/1,
+                                                /*num_partitions=*/2));
+  TF_ASSERT_OK_AND_ASSIGN(bool changed,
+                          RunPipeliner(module.get(), /*config=*/{}));
+  EXPECT_TRUE(changed);
+
+  HloInstruction* loop = FindInstruction(module.get(), HloOpcode::kWhile);
+  ASSERT_NE(loop, nullptr);
+  EXPECT_EQ(ComputeWhileLoopTripCount(loop), 2);
+
+  // The prologue gathers the slice of the first iteration.
+  const HloInstruction* prologue = loop->operand(0)->operand(3);
+  EXPECT_THAT(prologue, op::AllGather(op::Reshape(op::DynamicSlice(
+                            op::Parameter(1), op::Constant(), op::Constant(),
+                            op::Constant()))));
+  // The body gathers the slice of the next iteration and uses the one that
+  // the previous iteration gathered.
+  const HloComputation* body = loop->while_body();
+  const HloInstruction* next = body->root_instruction()->operand(3);
+  EXPECT_THAT(next, op::AllGather(op::Reshape(op::DynamicSlice(
+                        op::GetTupleElement(op::Parameter(0), 2),
+                        op::Add(op::GetTupleElement(op::Parameter(0), 0),
+                                op::Constant()),
+                        op::Constant(), op::Constant()))));
+  auto carried = op::GetTupleElement(op::Parameter(0), 3);
+  EXPECT_THAT(body->root_instruction()->operand(1),
+              op::Add(op::Multiply(op::GetTupleElement(op::Parameter(0), 1),
+                                   carried),
+                      carried));
+  EXPECT_NE(prologue->channel_id(), next->channel_id());
+
+  // The epilogue runs the last iteration on the carried result.
+  auto loop_carried = op::GetTupleElement(op::While(), 3);
+  EXPECT_THAT(
+      module->entry_computation()->root_instruction(),
+      op::GetTupleElement(
+          op::Tuple(op::Add(),
+                    op::Add(op::Multiply(op::GetTupleElement(op::While(), 1),
+                                         loop_carried),
+                            loop_carried),
+                    op::GetTupleElement(op::While(), 2)),
+          1));
+  EXPECT_EQ(module->computation_count(), 3);
+}
+
+TEST_F(CollectivePipelinerTest, AllGatherOfLoopState) {
+  constexpr absl::string_view kHloString = R"(
+HloModule module
+
+cond {
+  param = (s32[], f32[2,8]) parameter(0)
+  i = s32[] get-tuple-element(param), index=0
+  n = s32[] constant(3)
+  ROOT lt = pred[] compare(i, n), direction=LT
+}
+
+body {
+  param = (s32[], f32[2,8]) parameter(0)
+  i = s32[] get-tuple-element(param), index=0
+  x = f32[2,8] get-tuple-element(param), index=1
+  ag = f32[4,8] all-gather(x), channel_id=1, replica_groups={{0,1}},
+    dimensions={0}, use_global_device_ids=true
+  next_x = f32[2,8] slice(ag), slice={[1:3], [0:8]}
+  one = s32[] constant(1)
+  next_i = s32[] add(i, one)
+  ROOT tuple = (s32[], f32[2,8]) tuple(next_i, next_x)
+}
+
+ENTRY entry {
+  p0 = f32[2,8] parameter(0)
+  zero = s32[] constant(0)
+  init = (s32[], f32[2,8]) tuple(zero, p0)
+  ROOT while = (s32[], f32[2,8]) while(init), condition=cond, body=body
+})";
+  TF_ASSERT_OK_AND_ASSIGN(
+      auto module, ParseAndReturnVerifiedModule(kHloString,
+                                                /*replica_count=*/1,
+                                                /*num_partitions=*/2));
+  TF_ASSERT_OK_AND_ASSIGN(bool changed,
+                          RunPipeliner(module.get(), /*config=*/{}));
+  EXPECT_FALSE(changed);
+}
+
+TEST_F(CollectivePipelinerTest, ScheduleAware) {
+  ApproximateLatencyEstimator latency_estimator;
+  CollectivePipeliner::Config config;
+  config.latency_estimator = &latency_estimator;
+
+  // Only trivial instructions of the body are independent of the all-gather,
+  // so the scheduler could not hide it without pipelining.
+  TF_ASSERT_OK_AND_ASSIGN(
+      auto module, ParseAndReturnVerifiedModule(kAllGatherLoop,
+                                                /*replica_count=*/1,
+                                                /*num_partitions=*/2));
+  TF_ASSERT_OK_AND_ASSIGN(bool changed, RunPipeliner(module.get(), config));
+  EXPECT_TRUE(changed);
+
+  // Nothing is gained if the body has enough independent compute.
+  config.collective_latency = 1;
+  TF_ASSERT_OK_AND_ASSIGN(module, ParseAndReturnVerifiedModule(
+                                      kAllGatherLoop, /*replica_count=*/1,
+                                      /*num_partitions=*/2));
+  TF_ASSERT_OK_AND_ASSIGN(changed, RunPipeliner(module.get(), config));
+  EXPECT_FALSE(changed);
+}
+
+}  // namespace
+}  // namespace xla
@@ -0,0 +1,197 @@
+/* Copyright 2023 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+// Usage:
+//   cpu_performance_calibration --output_file=/path/to/profile.pbtxt
+//
+// Runs microbenchmarks measuring the throughputs of the host CPU and writes
+// them as a text CpuPerformanceProfile, which can be passed to XLA:CPU with
+//
+//   --xla_cpu_performance_profile=/path/to/profile.pbtxt
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "absl/synchronization/blocking_counter.h"
+#include "absl/time/clock.h"
+#include "absl/time/time.h"
+#include "xla/hlo/ir/hlo_opcode.h"
+#include "xla/service/cpu/cpu_performance_profile.pb.h"
+#include "xla/service/cpu/runtime_single_threaded_matmul.h"
+#include "tsl/platform/cpu_info.h"
+#include "tsl/platform/env.h"
+#include "tsl/platform/init_main.h"
+#include "tsl/platform/logging.h"
+#include "tsl/platform/status.h"
+#include "tsl/platform/threadpool.h"
+#include "tsl/util/command_line_flags.h"
+
+namespace xla {
+namespace cpu {
+namespace {
+
+// Keeps the results of a benchmark loop observable so that the compiler can't
+// eliminate the loop.
+void Consume(const std::vector<float>& values) {
+  static volatile float sink;
+  float sum = 0;
+  for (float value : values) {
+    sum += value;
+  }
+  sink = sum;
+}
+
+// Runs `fn` repeatedly for at least `min_time` and returns the fastest time
+// of a single run, in seconds.
+double MinSeconds(const std::function<void()>& fn,
+                  absl::Duration min_time = absl::Milliseconds(200)) {
+  fn();  // Warm up.
+  absl::Duration best = absl::InfiniteDuration();
+  const absl::Time deadline = absl::Now() + min_time;
+  do {
+    const absl::Time start = absl::Now();
+    fn();
+    best = std::min(best, absl::Now() - start);
+  } while (absl::Now() < deadline);
+  return absl::ToDoubleSeconds(best);
+}
+
+// Multiply-adds over a buffer small enough to stay in L1, so that the loop is
+// bound by arithmetic rather than memory.
+double MeasureFlopsPerSecond() {
+  constexpr int64_t kSize = 1024;
+  constexpr int64_t kIterations = 4096;
+  std::vector<float> x(kSize, 1.0f), y(kSize, 0.5f);
+  const double seconds = MinSeconds([&] {
+    for (int64_t i = 0; i < kIterations; ++i) {
+      for (int64_t j = 0; j < kSize; ++j) {
+        y[j] = y[j] * 0.999f + x[j];
+      }
+    }
+    Consume(y);
+  });
+  return 2.0 * kSize * kIterations / seconds;
+}
+
+double MeasureTranscendentalsPerSecond() {
+  constexpr int64_t kSize = 1024;
+  constexpr int64_t kIterations = 256;
+  std::vector<float> x(kSize, 0.5f);
+  const double seconds = MinSeconds([&] {
+    for (int64_t i = 0; i < kIterations; ++i) {
+      for (int64_t j = 0; j < kSize; ++j) {
+        x[j] = std::tanh(x[j]) + 0.5f;
+      }
+    }
+    Consume(x);
+  });
+  return 1.0 * kSize * kIterations / seconds;
+}
+
+// Throughput of the single-threaded Eigen matmul XLA:CPU calls for dots.
+double MeasureDotFlopsPerSecond() {
+  constexpr int64_t kDim = 256;
+  std::vector<float> lhs(kDim * kDim, 1.0f), rhs(kDim * kDim, 1.0f),
+      out(kDim * kDim);
+  const double seconds = MinSeconds([&] {
+    __xla_cpu_runtime_EigenSingleThreadedMatMulF32(
+        /*run_options_ptr=*/nullptr, out.data(), lhs.data(), rhs.data(), kDim,
+        kDim, kDim, /*transpose_lhs=*/0, /*transpose_rhs=*/0);
+  });
+  return 2.0 * kDim * kDim * kDim / seconds;
+}
+
+// Copies `num_threads` slices of a buffer much larger than the last level
+// cache, one slice per thread. Returns bytes read and written per second.
+double MeasureMemoryBandwidth(tsl::thread::ThreadPool* pool,
+                              int64_t num_threads) {
+  constexpr int64_t kBytes = int64_t{256} << 20;
+  std::vector<char> src(kBytes, 1), dst(kBytes);
+  const int64_t slice = kBytes / num_threads;
+  const double seconds = MinSeconds([&] {
+    absl::BlockingCounter counter(num_threads);
+    for (int64_t i = 0; i < num_threads; ++i) {
+      pool->Schedule([&, i] {
+        std::memcpy(dst.data() + i * slice, src.data() + i * slice, slice);
+        counter.DecrementCount();
+      });
+    }
+    counter.Wait();
+  });
+  return 2.0 * slice * num_threads / seconds;
+}
+
+// Round trip latency of scheduling an empty closure on the thread pool and
+// waiting for it, as done by the fork-join runtime and the PjRt client.
+double MeasureTaskDispatchSeconds(tsl::thread::ThreadPool* pool) {
+  constexpr int64_t kTasks = 1000;
+  const double seconds = MinSeconds([&] {
+    for (int64_t i = 0; i < kTasks; ++i) {
+      absl::BlockingCounter counter(1);
+      pool->Schedule([&] { counter.DecrementCount(); });
+      counter.Wait();
+    }
+  });
+  return seconds / kTasks;
+}
+
+CpuPerformanceProfile Calibrate(int64_t num_threads) {
+  tsl::thread::ThreadPool pool(tsl::Env::Default(), "calibration",
+                               num_threads);
+  CpuPerformanceProfile profile;
+  profile.set_description(tsl::port::CPUVendorIDString());
+  profile.set_num_threads(num_threads);
+  profile.set_flops_per_second(MeasureFlopsPerSecond());
+  profile.set_transcendentals_per_second(MeasureTranscendentalsPerSecond());
+  (*profile.mutable_opcode_flops_per_second())[std::string(
+      HloOpcodeString(HloOpcode::kDot))] = MeasureDotFlopsPerSecond();
+  profile.set_memory_bandwidth(MeasureMemoryBandwidth(&pool, 1));
+  profile.set_parallel_memory_bandwidth(
+      MeasureMemoryBandwidth(&pool, num_threads));
+  profile.set_task_dispatch_seconds(MeasureTaskDispatchSeconds(&pool));
+  return profile;
+}
+
+}  // namespace
+}  // namespace cpu
+}  // namespace xla
+
+int main(int argc, char** argv) {
+  std::string output_file;
+  int64_t num_threads = tsl::port::MaxParallelism();
+  const std::vector<tsl::Flag> flag_list = {
+      tsl::Flag("output_file", &output_file,
+                "Path to write the text CpuPerformanceProfile to."),
+      tsl::Flag("num_threads", &num_threads,
+                "Number of threads to measure parallel throughputs with."),
+  };
+  const std::string usage = tsl::Flags::Usage(argv[0], flag_list);
+  bool parse_ok = tsl::Flags::Parse(&argc, argv, flag_list);
+  tsl::port::InitMain(usage.c_str(), &argc, &argv);
+  QCHECK(parse_ok && argc == 1) << "\n" << usage;
+  QCHECK(!output_file.empty()) << "--output_file is required";
+  QCHECK_GT(num_threads, 0) << "--num_threads must be positive";
+
+  xla::cpu::CpuPerformanceProfile profile =
+      xla::cpu::Calibrate(num_threads);
+  LOG(INFO) << "Measured CPU performance profile:\n" << profile.DebugString();
+  TF_CHECK_OK(tsl::WriteTextProto(tsl::Env::Default(), output_file, profile));
+  return 0;
+}
@@ -0,0 +1,146 @@
+/* Copyright 2023 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "xla/service/cpu/cpu_performance_model.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <string>
+#include <utility>
+
+#include "xla/hlo/ir/hlo_opcode.h"
+#include "xla/util.h"
+#include "tsl/platform/env.h"
+#include "tsl/platform/errors.h"
+
+namespace xla {
+namespace cpu {
+namespace {
+
+// Time in seconds to process `amount` at `rate` per second. Unmeasured (i.e.
+// non-positive) rates are treated as infinitely fast.
+double SecondsAtRate(double amount, double rate) {
+  return rate > 0 ? amount / rate : 0;
+}
+
+}  // namespace
+
+CpuPerformanceModel::CpuPerformanceModel(CpuPerformanceProfile profile)
+    : profile_(std::move(profile)) {}
+
+/*static*/ StatusOr<CpuPerformanceModel> CpuPerformanceModel::Load(
+    const std::string& path) {
+  CpuPerformanceProfile profile;
+  TF_RETURN_IF_ERROR(
+      tsl::ReadTextOrBinaryProto(tsl::Env::Default(), path, &profile));
+  if (profile.flops_per_second() <= 0 || profile.memory_bandwidth() <= 0) {
+    return InvalidArgument(
+        "CPU performance profile %s must specify positive flops_per_second "
+        "and memory_bandwidth",
+        path);
+  }
+  return CpuPerformanceModel(std::move(profile));
+}
+
+std::pair<double, double> CpuPerformanceModel::ComputeAndMemorySeconds(
+    const HloInstruction& instruction,
+    const HloCostAnalysis& cost_analysis) const {
+  // Fusions run at the throughput of the operation they are built around.
+  const HloOpcode opcode = instruction.opcode() == HloOpcode::kFusion
+                               ? instruction.fused_expression_root()->opcode()
+                               : instruction.opcode();
+  double flops_per_second = profile_.flops_per_second();
+  auto it = profile_.opcode_flops_per_second().find(
+      std::string(HloOpcodeString(opcode)));
+  if (it != profile_.opcode_flops_per_second().end()) {
+    flops_per_second = it->second;
+  }
+  const double compute_seconds =
+      SecondsAtRate(cost_analysis.flop_count(instruction), flops_per_second) +
+      SecondsAtRate(cost_analysis.transcendental_count(instruction),
+                    profile_.transcendentals_per_second());
+  const double memory_seconds = SecondsAtRate(
+      cost_analysis.bytes_accessed(instruction), profile_.memory_bandwidth());
+  return {compute_seconds, memory_seconds};
+}
+
+double CpuPerformanceModel::ParallelSeconds(double compute_seconds,
+                                            double memory_seconds,
+                                            int64_t num_tasks) const {
+  // Compute scales with the number of tasks up to the number of hardware
+  // threads, memory time up to the measured parallel bandwidth.
+  double compute_speedup = num_tasks;
+  if (profile_.num_threads() > 0) {
+    compute_speedup = std::min<double>(compute_speedup, profile_.num_threads());
+  }
+  double memory_speedup = num_tasks;
+  if (profile_.parallel_memory_bandwidth() > 0) {
+    memory_speedup =
+        std::min(memory_speedup, profile_.parallel_memory_bandwidth() /
+                                     profile_.memory_bandwidth());
+  }
+  memory_speedup = std::max(memory_speedup, 1.0);
+  // Every task beyond the first one is dispatched to the thread pool.
+  return std::max(compute_seconds / compute_speedup,
+                  memory_seconds / memory_speedup) +
+         (num_tasks - 1) * profile_.task_dispatch_seconds();
+}
+
+absl::Duration CpuPerformanceModel::EstimateRunTime(
+    const HloInstruction& instruction,
+    const HloCostAnalysis& cost_analysis) const {
+  return EstimateParallelRunTime(instruction, cost_analysis, /*num_tasks=*/1);
+}
+
+absl::Duration CpuPerformanceModel::EstimateRunTime(
+    const HloComputation& computation,
+    const HloCostAnalysis& cost_analysis) const {
+  absl::Duration run_time;
+  for (const HloInstruction* instruction : computation.instructions()) {
+    run_time += EstimateRunTime(*instruction, cost_analysis);
+  }
+  return run_time;
+}
+
+absl::Duration CpuPerformanceModel::EstimateParallelRunTime(
+    const HloInstruction& instruction, const HloCostAnalysis& cost_analysis,
+    int64_t num_tasks) const {
+  CHECK_GE(num_tasks, 1);
+  auto [compute_seconds, memory_seconds] =
+      ComputeAndMemorySeconds(instruction, cost_analysis);
+  return absl::Seconds(
+      ParallelSeconds(compute_seconds, memory_seconds, num_tasks));
+}
+
+int64_t CpuPerformanceModel::OptimalTaskCount(
+    const HloInstruction& instruction, const HloCostAnalysis& cost_analysis,
+    int64_t max_parallelism) const {
+  auto [compute_seconds, memory_seconds] =
+      ComputeAndMemorySeconds(instruction, cost_analysis);
+  int64_t best_num_tasks = 1;
+  double best_seconds = ParallelSeconds(compute_seconds, memory_seconds, 1);
+  for (int64_t num_tasks = 2; num_tasks <= max_parallelism; ++num_tasks) {
+    const double seconds =
+        ParallelSeconds(compute_seconds, memory_seconds, num_tasks);
+    if (seconds < best_seconds) {
+      best_seconds = seconds;
+      best_num_tasks = num_tasks;
+    }
+  }
+  return best_num_tasks;
+}
+
+}  // namespace cpu
+}  // namespace xla
@@ -0,0 +1,94 @@
+/* Copyright 2023 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef TENSORFLOW_COMPILER_XLA_SERVICE_CPU_CPU_PERFORMANCE_MODEL_H_
+#define TENSORFLOW_COMPILER_XLA_SERVICE_CPU_CPU_PERFORMANCE_MODEL_H_
+
+#include <cstdint>
+#include <string>
+#include <utility>
+
+#include "absl/time/time.h"
+#include "xla/hlo/ir/hlo_computation.h"
+#include "xla/hlo/ir/hlo_instruction.h"
+#include "xla/service/cpu/cpu_performance_profile.pb.h"
+#include "xla/service/hlo_cost_analysis.h"
+#include "xla/statusor.h"
+
+namespace xla {
+namespace cpu {
+
+// Roofline model of HLO run time on the host CPU. The compute time of an
+// instruction is derived from its flop and transcendental counts and the
+// measured per-op throughputs, the memory time from the bytes it accesses and
+// the measured memory bandwidth, and the run time is the larger of the two.
+//
+// The throughputs come from a CpuPerformanceProfile measured on the target
+// machine by the cpu_performance_calibration tool.
+class CpuPerformanceModel {
+ public:
+  explicit CpuPerformanceModel(CpuPerformanceProfile profile);
+
+  // Loads a text or binary CpuPerformanceProfile from `path`.
+  static StatusOr<CpuPerformanceModel> Load(const std::string& path);
+
+  // Estimated single-threaded run time of `instruction`. `cost_analysis` must
+  // have been run on the computation containing `instruction`.
+  absl::Duration EstimateRunTime(const HloInstruction& instruction,
+                                 const HloCostAnalysis& cost_analysis) const;
+
+  // Estimated single-threaded run time of `computation`, the sum of the
+  // estimates of its instructions. `cost_analysis` must have been run on
+  // `computation`.
+  absl::Duration EstimateRunTime(const HloComputation& computation,
+                                 const HloCostAnalysis& cost_analysis) const;
+
+  // Estimated run time of `instruction` when split into `num_tasks` parallel
+  // tasks, including the cost of dispatching the tasks.
+  absl::Duration EstimateParallelRunTime(const HloInstruction& instruction,
+                                         const HloCostAnalysis& cost_analysis,
+                                         int64_t num_tasks) const;
+
+  // Returns the task count in [1, max_parallelism] minimizing
+  // EstimateParallelRunTime.
+  int64_t OptimalTaskCount(const HloInstruction& instruction,
+                           const HloCostAnalysis& cost_analysis,
+                           int64_t max_parallelism) const;
+
+  // Latency of dispatching work to a thread pool and waiting for it.
+  absl::Duration task_dispatch_time() const {
+    return absl::Seconds(profile_.task_dispatch_seconds());
+  }
+
+  const CpuPerformanceProfile& profile() const { return profile_; }
+
+ private:
+  // Single-threaded compute and memory times of `instruction`, in seconds.
+  std::pair<double, double> ComputeAndMemorySeconds(
+      const HloInstruction& instruction,
+      const HloCostAnalysis& cost_analysis) const;
+
+  // Time in seconds to run work with the given single-threaded compute and
+  // memory times on `num_tasks` threads.
+  double ParallelSeconds(double compute_seconds, double memory_seconds,
+                         int64_t num_tasks) const;
+
+  CpuPerformanceProfile profile_;
+};
+
+}  // namespace cpu
+}  // namespace xla
+
+#endif  // TENSORFLOW_COMPILER_XLA_SERVICE_CPU_CPU_PERFORMANCE_MODEL_H_
@@ -0,0 +1,165 @@
+/* Copyright 2023 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "xla/service/cpu/cpu_performance_model.h"
+
+#include <memory>
+#include <string>
+
+#include "absl/time/time.h"
+#include "xla/hlo/ir/hlo_computation.h"
+#include "xla/hlo/ir/hlo_instruction.h"
+#include "xla/service/cpu/cpu_performance_profile.pb.h"
+#include "xla/service/hlo_cost_analysis.h"
+#include "xla/shape_util.h"
+#include "xla/tests/hlo_test_base.h"
+#include "tsl/lib/core/status_test_util.h"
+#include "tsl/platform/env.h"
+#include "tsl/platform/path.h"
+#include "tsl/platform/test.h"
+
+namespace xla {
+namespace cpu {
+namespace {
+
+class CpuPerformanceModelTest : public HloTestBase {
+ protected:
+  CpuPerformanceModelTest() {
+    profile_.set_num_threads(16);
+    profile_.set_flops_per_second(1e10);
+    profile_.set_transcendentals_per_second(1e9);
+    (*profile_.mutable_opcode_flops_per_second())["dot"] = 1e11;
+    profile_.set_memory_bandwidth(1e9);
+    profile_.set_parallel_memory_bandwidth(4e9);
+    profile_.set_task_dispatch_seconds(1e-5);
+  }
+
+  // Parses `hlo_string` and runs the cost analysis on its entry computation.
+  void Analyze(absl::string_view hlo_string) {
+    TF_ASSERT_OK_AND_ASSIGN(module_, ParseAndReturnVerifiedModule(hlo_string));
+    cost_analysis_ = std::make_unique<HloCostAnalysis>(
+        [](const Shape& shape) { return ShapeUtil::ByteSizeOf(shape, 8); });
+    TF_ASSERT_OK(module_->entry_computation()->Accept(cost_analysis_.get()));
+  }
+
+  HloInstruction* root() {
+    return module_->entry_computation()->root_instruction();
+  }
+
+  CpuPerformanceProfile profile_;
+  std::unique_ptr<HloModule> module_;
+  std::unique_ptr<HloCostAnalysis> cost_analysis_;
+};
+
+TEST_F(CpuPerformanceModelTest, ElementwiseIsMemoryBound) {
+  Analyze(R"(
+HloModule m
+
+ENTRY e {
+  p0 = f32[1000000] parameter(0)
+  p1 = f32[1000000] parameter(1)
+  ROOT add = f32[1000000] add(p0, p1)
+})");
+  CpuPerformanceModel model(profile_);
+  // 12MB accessed at 1GB/s dominates 1M flops at 10Gflop/s.
+  EXPECT_NEAR(absl::ToDoubleMilliseconds(
+                  model.EstimateRunTime(*root(), *cost_analysis_)),
+              12.0, 1e-6);
+  // Memory time only scales up to the parallel bandwidth, and every extra task
+  // costs a dispatch.
+  EXPECT_EQ(model.OptimalTaskCount(*root(), *cost_analysis_,
+                                   /*max_parallelism=*/16),
+            4);
+  EXPECT_NEAR(absl::ToDoubleMilliseconds(model.EstimateParallelRunTime(
+                  *root(), *cost_analysis_, /*num_tasks=*/4)),
+              3.0 + 3 * 0.01, 1e-6);
+}
+
+TEST_F(CpuPerformanceModelTest, TranscendentalsAreComputeBound) {
+  Analyze(R"(
+HloModule m
+
+ENTRY e {
+  p0 = f32[1000000] parameter(0)
+  ROOT exp = f32[1000000] exponential(p0)
+})");
+  profile_.set_transcendentals_per_second(1e8);
+  CpuPerformanceModel model(profile_);
+  // 1M transcendentals at 100M/s take 10ms, 8MB at 1GB/s take 8ms.
+  EXPECT_NEAR(absl::ToDoubleMilliseconds(
+                  model.EstimateRunTime(*root(), *cost_analysis_)),
+              10.0, 1e-6);
+  // Compute keeps scaling with more tasks while memory time stops at 2ms, so
+  // the best split is the first one where compute is no longer the bottleneck.
+  EXPECT_EQ(model.OptimalTaskCount(*root(), *cost_analysis_,
+                                   /*max_parallelism=*/16),
+            5);
+}
+
+TEST_F(CpuPerformanceModelTest, OpcodeThroughputOverridesDefault) {
+  Analyze(R"(
+HloModule m
+
+ENTRY e {
+  p0 = f32[1024,1024] parameter(0)
+  p1 = f32[1024,1024] parameter(1)
+  ROOT dot = f32[1024,1024] dot(p0, p1), lhs_contracting_dims={1},
+    rhs_contracting_dims={0}
+})");
+  CpuPerformanceModel model(profile_);
+  // 2G flops at the dot throughput of 100Gflop/s take longer than reading and
+  // writing 12MB at 1GB/s.
+  const double flops = cost_analysis_->flop_count(*root());
+  EXPECT_NEAR(absl::ToDoubleSeconds(
+                  model.EstimateRunTime(*root(), *cost_analysis_)),
+              flops / 1e11, 1e-9);
+}
+
+TEST_F(CpuPerformanceModelTest, SmallComputationIsCheaperThanDispatch) {
+  Analyze(R"(
+HloModule m
+
+ENTRY e {
+  p0 = f32[4] parameter(0)
+  p1 = f32[4] parameter(1)
+  add = f32[4] add(p0, p1)
+  ROOT mul = f32[4] multiply(add, p1)
+})");
+  CpuPerformanceModel model(profile_);
+  EXPECT_LT(model.EstimateRunTime(*module_->entry_computation(),
+                                  *cost_analysis_),
+            model.task_dispatch_time());
+  EXPECT_EQ(model.OptimalTaskCount(*root(), *cost_analysis_,
+                                   /*max_parallelism=*/16),
+            1);
+}
+
+TEST_F(CpuPerformanceModelTest, Load) {
+  std::string path = tsl::io::JoinPath(tsl::testing::TmpDir(), "profile.txt");
+  TF_ASSERT_OK(tsl::WriteTextProto(tsl::Env::Default(), path, profile_));
+  TF_ASSERT_OK_AND_ASSIGN(CpuPerformanceModel model,
+                          CpuPerformanceModel::Load(path));
+  EXPECT_EQ(model.profile().memory_bandwidth(), profile_.memory_bandwidth());
+  EXPECT_EQ(model.task_dispatch_time(), absl::Microseconds(10));
+
+  CpuPerformanceProfile incomplete;
+  incomplete.set_flops_per_second(1e10);
+  TF_ASSERT_OK(tsl::WriteTextProto(tsl::Env::Default(), path, incomplete));
+  EXPECT_FALSE(CpuPerformanceModel::Load(path).ok());
+}
+
+}  // namespace
+}  // namespace cpu
+}  // namespace xla
@@ -109,17 +109,45 @@ class DefaultCostModel : public ParallelCostModel {
   const std::unique_ptr<HloCostAnalysis> cost_analysis_;
 };
 
+// Cost model that picks the task count minimizing the run time estimated by a
+// CpuPerformanceModel calibrated for the host.
+class RooflineCostModel : public ParallelCostModel {
+ public:
+  RooflineCostModel(const int64_t max_parallelism,
+                    const CpuPerformanceModel* performance_model,
+                    std::unique_ptr<HloCostAnalysis> cost_analysis)
+      : max_parallelism_(max_parallelism),
+        performance_model_(*performance_model),
+        cost_analysis_(std::move(cost_analysis)) {}
+  ~RooflineCostModel() override {}
+
+  int64_t GetParallelTaskCount(HloInstruction* instruction) override {
+    return performance_model_.OptimalTaskCount(*instruction, *cost_analysis_,
+                                               max_parallelism_);
+  }
+
+ private:
+  const int64_t max_parallelism_;
+  const CpuPerformanceModel& performance_model_;
+  const std::unique_ptr<HloCostAnalysis> cost_analysis_;
+};
+
 ParallelTaskAssignment::ParallelTaskAssignment(
     const int64_t max_parallelism,
     const HloCostAnalysis::ShapeSizeFunction& shape_size, HloModule* module,
-    const TargetMachineFeatures* target_machine_features)
+    const TargetMachineFeatures* target_machine_features,
+    const CpuPerformanceModel* performance_model)
     : target_machine_features_(*target_machine_features) {
   VLOG(1) << "ParallelTaskAssignment max_parallelism: " << max_parallelism;
   // Run cost analysis on 'module'.
   auto cost_analysis = std::make_unique<HloCostAnalysis>(shape_size);
   HloComputation* computation = module->entry_computation();
   Status status = computation->root_instruction()->Accept(cost_analysis.get());
-  if (status.ok()) {
+  if (status.ok() && performance_model != nullptr) {
+    // Use the calibrated model of the host if one is available.
+    cost_model_.reset(new RooflineCostModel(max_parallelism, performance_model,
+                                            std::move(cost_analysis)));
+  } else if (status.ok()) {
     // Set default cost model based on 'cost_analysis'.
     cost_model_.reset(new DefaultCostModel(max_parallelism, shape_size,
                                            std::move(cost_analysis)));
@@ -256,9 +284,9 @@ bool ParallelTaskAssigner::AssignParallelTasksHelper(
 
 void ParallelTaskAssigner::ComputeTargetParallelTasks(
     HloModule* module, HloToParallelTasks* hlo_to_parallel_tasks) {
-  ParallelTaskAssignment parallel_task_assignment(max_parallelism_,
-                                                  shape_size_function_, module,
-                                                  &target_machine_features_);
+  ParallelTaskAssignment parallel_task_assignment(
+      max_parallelism_, shape_size_function_, module, &target_machine_features_,
+      performance_model_.has_value() ? &*performance_model_ : nullptr);
 
   // Compute parallel task counts for all instructions in 'module'.
   for (auto* computation : module->MakeNonfusionComputations()) {
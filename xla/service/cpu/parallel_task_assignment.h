@@ -16,8 +16,12 @@ limitations under the License.
 #ifndef TENSORFLOW_COMPILER_XLA_SERVICE_CPU_PARALLEL_TASK_ASSIGNMENT_H_
 #define TENSORFLOW_COMPILER_XLA_SERVICE_CPU_PARALLEL_TASK_ASSIGNMENT_H_
 
+#include <optional>
+#include <utility>
+
 #include "absl/container/flat_hash_map.h"
 #include "xla/hlo/ir/hlo_module.h"
+#include "xla/service/cpu/cpu_performance_model.h"
 #include "xla/service/cpu/target_machine_features.h"
 #include "xla/service/hlo_cost_analysis.h"
 #include "xla/service/hlo_pass_interface.h"
@@ -39,10 +43,13 @@ class ParallelTaskAssignment {
   // 'shape_size': shape size function used by HloCostAnalysis during parallel
   //               task assignment.
   // 'module': the containing HloModule.
-  ParallelTaskAssignment(const int64_t max_parallelism,
-                         const HloCostAnalysis::ShapeSizeFunction& shape_size,
-                         HloModule* module,
-                         const TargetMachineFeatures* target_machine_features);
+  // 'performance_model': if non-null, a calibrated model of the host used to
+  //                      pick task counts; must outlive this object.
+  ParallelTaskAssignment(
+      const int64_t max_parallelism,
+      const HloCostAnalysis::ShapeSizeFunction& shape_size, HloModule* module,
+      const TargetMachineFeatures* target_machine_features,
+      const CpuPerformanceModel* performance_model = nullptr);
   ~ParallelTaskAssignment() {}
 
   // Computes and returns the target parallel task count for 'instruction'.
@@ -66,12 +73,17 @@ class ParallelTaskAssigner : public HloModulePass {
   // 'max_parallelism': the maximum parallel task count per instruction.
   // 'shape_size': shape size function used by HloCostAnalysis during parallel
   //               task assignment.
-  ParallelTaskAssigner(const int64_t max_parallelism,
-                       const HloCostAnalysis::ShapeSizeFunction& shape_size,
-                       const TargetMachineFeatures* target_machine_features)
+  // 'performance_model': optional calibrated model of the host. If absent, a
+  //                      fixed heuristic cost model is used.
+  ParallelTaskAssigner(
+      const int64_t max_parallelism,
+      const HloCostAnalysis::ShapeSizeFunction& shape_size,
+      const TargetMachineFeatures* target_machine_features,
+      std::optional<CpuPerformanceModel> performance_model = std::nullopt)
       : max_parallelism_(max_parallelism),
         shape_size_function_(shape_size),
-        target_machine_features_(*target_machine_features) {}
+        target_machine_features_(*target_machine_features),
+        performance_model_(std::move(performance_model)) {}
   ~ParallelTaskAssigner() override {}
 
   absl::string_view name() const override {
@@ -107,6 +119,7 @@ class ParallelTaskAssigner : public HloModulePass {
   int64_t max_parallelism_;
   HloCostAnalysis::ShapeSizeFunction shape_size_function_;
   const TargetMachineFeatures& target_machine_features_;
+  std::optional<CpuPerformanceModel> performance_model_;
 };
 
 }  // namespace cpu
@@ -16,6 +16,8 @@ limitations under the License.
 #include "xla/service/cpu/parallel_task_assignment.h"
 
 #include "xla/service/cpu/cpu_executable.h"
+#include "xla/service/cpu/cpu_performance_model.h"
+#include "xla/service/cpu/cpu_performance_profile.pb.h"
 #include "xla/service/cpu/target_machine_features_fake.h"
 #include "xla/test.h"
 #include "xla/tests/hlo_test_base.h"
@@ -206,5 +208,43 @@ TEST_F(ParallelTaskAssignmentTest, ConstantNotParallelized) {
   EXPECT_FALSE(changed);
 }
 
+TEST_F(ParallelTaskAssignmentTest, PerformanceModelDecidesParallelization) {
+  constexpr char hlo_string[] = R"(
+  HloModule TestTaskParallel_performance_model
+    ENTRY add {
+      p0 = f32[1000000] parameter(0)
+      p1 = f32[1000000] parameter(1)
+      ROOT add = f32[1000000] add(p0, p1)
+    }
+  )";
+
+  cpu::CpuPerformanceProfile profile;
+  profile.set_flops_per_second(1e10);
+  profile.set_memory_bandwidth(1e9);
+  profile.set_parallel_memory_bandwidth(4e9);
+
+  // Dispatching a task costs more than the whole add.
+  profile.set_task_dispatch_seconds(1.0);
+  TF_ASSERT_OK_AND_ASSIGN(std::unique_ptr<HloModule> m,
+                          ParseAndReturnVerifiedModule(hlo_string));
+  TF_ASSERT_OK_AND_ASSIGN(
+      bool changed,
+      cpu::ParallelTaskAssigner(max_parallelism_, shape_size_func_,
+                                &target_machine_features_,
+                                cpu::CpuPerformanceModel(profile))
+          .Run(m.get()));
+  EXPECT_FALSE(changed);
+
+  // Dispatching is cheap and the add is memory bound.
+  profile.set_task_dispatch_seconds(1e-5);
+  TF_ASSERT_OK_AND_ASSIGN(m, ParseAndReturnVerifiedModule(hlo_string));
+  TF_ASSERT_OK_AND_ASSIGN(
+      changed, cpu::ParallelTaskAssigner(max_parallelism_, shape_size_func_,
+                                         &target_machine_features_,
+                                         cpu::CpuPerformanceModel(profile))
+                   .Run(m.get()));
+  EXPECT_TRUE(changed);
+}
+
 }  // namespace
 }  // namespace xla
@@ -68,6 +68,7 @@ limitations under the License.
 #include "xla/service/broadcast_canonicalizer.h"
 #include "xla/service/buffer_assignment.h"
 #include "xla/service/call_inliner.h"
+#include "xla/service/collective_pipeliner.h"
 #include "xla/service/collectives_schedule_linearizer.h"
 #include "xla/service/comparison_expander.h"
 #include "xla/service/conditional_canonicalizer.h"
@@ -139,6 +140,7 @@ limitations under the License.
 #include "xla/service/hlo_pass_fix.h"
 #include "xla/service/hlo_pass_pipeline.h"
 #include "xla/service/hlo_verifier.h"
+#include "xla/service/latency_hiding_scheduler.h"
 #include "xla/service/layout_normalization.h"
 #include "xla/service/llvm_ir/llvm_util.h"
 #include "xla/service/logistic_expander.h"
@@ -624,6 +626,23 @@ Status GpuCompiler::OptimizeHloModule(
     // Remove dead computations left over after ar/rs promotion.
     collectives_pipeline.AddPass<HloDCE>();
 
+    // Issue collectives in loops one iteration ahead, where the latency
+    // hiding scheduler could not overlap them with enough compute otherwise.
+    std::unique_ptr<LatencyEstimator> latency_estimator;
+    if (debug_options.xla_gpu_enable_pipelined_collectives() &&
+        debug_options.xla_gpu_enable_latency_hiding_scheduler()) {
+      CollectivePipeliner::Config config;
+      // The collective latency must be in the units of the estimator, which
+      // are abstract unless the module has a profile.
+      TF_ASSIGN_OR_RETURN(
+          latency_estimator,
+          GetLatencyEstimator(*hlo_module, pointer_size_,
+                              gpu_target_config.gpu_device_info,
+                              &config.collective_latency));
+      config.latency_estimator = latency_estimator.get();
+      collectives_pipeline.AddPass<CollectivePipeliner>(config);
+    }
+
     TF_RETURN_IF_ERROR(collectives_pipeline.Run(hlo_module).status());
   }
 
@@ -20,6 +20,7 @@ limitations under the License.
 #include <iostream>
 #include <memory>
 #include <optional>
+#include <string>
 #include <utility>
 #include <vector>
 
@@ -28,10 +29,12 @@ limitations under the License.
 #include "xla/hlo/ir/hlo_schedule.h"
 #include "xla/service/buffer_value.h"
 #include "xla/service/gpu/cublas_cudnn.h"
+#include "xla/service/gpu/gpu_hlo_cost_analysis.h"
 #include "xla/service/gpu/ir_emission_utils.h"
 #include "xla/service/hlo_memory_scheduler.h"
 #include "xla/service/hlo_pass_pipeline.h"
 #include "xla/service/latency_hiding_scheduler.h"
+#include "xla/service/profile_guided_latency_estimator.h"
 
 namespace xla {
 namespace gpu {
@@ -218,6 +221,53 @@ int64_t GetSizeOfShape(const Shape& shape, int pointer_size) {
   return size + metadata_size;
 }
 
+StatusOr<std::unique_ptr<LatencyEstimator>> GetLatencyEstimator(
+    const HloModule& module, int64_t pointer_size,
+    const GpuDeviceInfo& gpu_info,
+    LatencyEstimator::TimeCost* collective_latency) {
+  std::unique_ptr<LatencyEstimator> latency_estimator =
+      std::make_unique<GpuLatencyEstimator>();
+  if (collective_latency != nullptr) {
+    *collective_latency = ApproximateLatencyEstimator::kHighLatency;
+  }
+  const std::string& profile_path =
+      module.config()
+          .debug_options()
+          .xla_gpu_latency_hiding_scheduler_profile();
+  if (!profile_path.empty()) {
+    TF_ASSIGN_OR_RETURN(ProfiledInstructionsProto profile,
+                        LoadProfiledInstructions(profile_path));
+    // Instructions missing from the profile get a roofline estimate of their
+    // run time, so that their costs are in microseconds like the profiled
+    // ones. Only those that the cost analysis has no time for keep their
+    // approximate costs.
+    HloCostAnalysis::Options options{[pointer_size](const Shape& shape) {
+      return GetSizeOfShape(shape, pointer_size);
+    }};
+    options.set_flops_per_second(2 * 1e9 * gpu_info.clock_rate_ghz *
+                                 gpu_info.core_count * gpu_info.fpus_per_core);
+    options.set_bytes_per_second(gpu_info.memory_bandwidth);
+    auto cost_analysis = std::make_unique<GpuHloCostAnalysis>(options);
+    for (const HloComputation* computation :
+         module.MakeNonfusionComputations()) {
+      TF_RETURN_IF_ERROR(computation->Accept(cost_analysis.get()));
+    }
+    latency_estimator = std::make_unique<ProfileGuidedLatencyEstimator>(
+        std::move(latency_estimator), profile, std::move(cost_analysis));
+    // Profiled latencies are in microseconds, while unprofiled collectives
+    // keep the approximate latency above.
+    if (collective_latency != nullptr && profile.latencies_size() > 0) {
+      double total_latency_us = 0;
+      for (const auto& latency : profile.latencies()) {
+        total_latency_us += latency.latency_us();
+      }
+      *collective_latency = total_latency_us / profile.latencies_size() *
+                            latency_estimator->CyclesPerMicrosecond();
+    }
+  }
+  return latency_estimator;
+}
+
 Status ScheduleGpuModule(HloModule* module, int64_t pointer_size,
                          const GpuDeviceInfo& gpu_info) {
   const bool enable_latency_hiding_scheduler =
@@ -234,7 +284,8 @@ Status ScheduleGpuModule(HloModule* module, int64_t pointer_size,
     return OkStatus();
   }
   SchedulerConfig config = GetSchedulerConfig(gpu_info);
-  auto latency_estimator = std::make_unique<GpuLatencyEstimator>();
+  TF_ASSIGN_OR_RETURN(std::unique_ptr<LatencyEstimator> latency_estimator,
+                      GetLatencyEstimator(*module, pointer_size, gpu_info));
   auto async_tracker = std::make_unique<AsyncTracker>(config);
 
   auto shape_size_in_bytes = [pointer_size](const Shape& shape) {
@@ -22,12 +22,25 @@ limitations under the License.
 #include "xla/hlo/ir/hlo_module.h"
 #include "xla/service/gpu/gpu_device_info.h"
 #include "xla/service/hlo_cost_analysis.h"
+#include "xla/service/latency_hiding_scheduler.h"
+#include "xla/statusor.h"
 
 namespace xla {
 namespace gpu {
 
 int64_t GetSizeOfShape(const Shape& shape, int pointer_size);
 
+// Returns the latency estimator that the latency hiding scheduler uses for
+// `module`, which also decides which collectives are worth pipelining. If
+// `collective_latency` is not null, stores the latency of a typical collective
+// in the units of the returned estimator: the mean profiled collective latency
+// if the module has a profile with any, and GpuLatencyEstimator's approximate
+// async latency otherwise.
+StatusOr<std::unique_ptr<LatencyEstimator>> GetLatencyEstimator(
+    const HloModule& module, int64_t pointer_size,
+    const GpuDeviceInfo& gpu_info,
+    LatencyEstimator::TimeCost* collective_latency = nullptr);
+
 // Determines the schedule of HLO instructions for a module run on the GPU.
 Status ScheduleGpuModule(HloModule* module, int64_t pointer_size,
                          const GpuDeviceInfo& gpu_info);
@@ -32,6 +32,8 @@ limitations under the License.
 #include "xla/map_util.h"
 #include "xla/service/memory_space_assignment_repacking.h"
 #include "xla/util.h"
+#include "tsl/platform/env.h"
+#include "tsl/platform/threadpool.h"
 
 namespace xla {
 
@@ -612,12 +614,99 @@ void GlobalDecreasingSizeBestFitHeap<BufferType>::Free(const BufferType* buffer,
 
 using Chunk = HeapSimulator::Chunk;
 
+namespace {
+
+// Recomputes the `subtree_end` of `node` from its own end and its children.
+void UpdateSubtreeEnd(BufferIntervalTreeNode* node) {
+  node->subtree_end = node->end;
+  if (node->left != nullptr) {
+    node->subtree_end = std::max(node->subtree_end, node->left->subtree_end);
+  }
+  if (node->right != nullptr) {
+    node->subtree_end = std::max(node->subtree_end, node->right->subtree_end);
+  }
+}
+
+}  // namespace
+
+uint64_t BufferIntervalTree::NextPriority() {
+  // SplitMix64.
+  uint64_t z = (priority_state_ += 0x9e3779b97f4a7c15ULL);
+  z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+  z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+  return z ^ (z >> 31);
+}
+
+void BufferIntervalTree::RotateUp(BufferIntervalTreeNode* node) {
+  // Turn:
+  //        parent              node
+  //        /    \             /    \
+  //     node     c    into    a    parent
+  //     /  \                         /    \
+  //    a    b                      b      c
+  //
+  // or the mirror image if `node` is the right child of `parent`.
+  BufferIntervalTreeNode* parent = node->parent;
+  BufferIntervalTreeNode* grandparent = parent->parent;
+  if (parent->left == node) {
+    parent->left = node->right;
+    if (node->right != nullptr) {
+      node->right->parent = parent;
+    }
+    node->right = parent;
+  } else {
+    parent->right = node->left;
+    if (node->left != nullptr) {
+      node->left->parent = parent;
+    }
+    node->left = parent;
+  }
+  parent->parent = node;
+  node->parent = grandparent;
+  if (grandparent == nullptr) {
+    root_ = node;
+  } else if (grandparent->left == parent) {
+    grandparent->left = node;
+  } else {
+    grandparent->right = node;
+  }
+  // The set of nodes below `grandparent` is unchanged, so only the two rotated
+  // nodes need their subtree_end recomputed.
+  UpdateSubtreeEnd(parent);
+  UpdateSubtreeEnd(node);
+}
+
+void BufferIntervalTree::Splice(BufferIntervalTreeNode* node) {
+  DCHECK(node->left == nullptr || node->right == nullptr);
+  BufferIntervalTreeNode* child =
+      node->left != nullptr ? node->left : node->right;
+  BufferIntervalTreeNode* parent = node->parent;
+  if (child != nullptr) {
+    child->parent = parent;
+  }
+  if (parent == nullptr) {
+    root_ = child;
+    return;
+  }
+  if (parent->left == node) {
+    parent->left = child;
+  } else {
+    parent->right = child;
+  }
+  // Fix up the `subtree_end` invariant of the ancestors of the removed node.
+  for (; parent != nullptr; parent = parent->parent) {
+    UpdateSubtreeEnd(parent);
+  }
+}
+
 void BufferIntervalTree::Add(int64_t start, int64_t end, const Chunk& chunk) {
   node_storage_.emplace_back(BufferIntervalTreeNode{
       start, end, end, chunk,
-      /*left=*/nullptr, /*right=*/nullptr, /*parent=*/nullptr});
+      /*left=*/nullptr, /*right=*/nullptr, /*parent=*/nullptr,
+      /*priority=*/NextPriority()});
+  BufferIntervalTreeNode* node = &node_storage_.back();
   if (root_ == nullptr) {
-    root_ = &node_storage_.back();
+    root_ = node;
     // This is root.
     return;
   }
@@ -627,146 +716,62 @@ void BufferIntervalTree::Add(int64_t start, int64_t end, const Chunk& chunk) {
     parent->subtree_end = std::max(parent->subtree_end, end);
     if (parent->start > start) {
       if (parent->left == nullptr) {
-        parent->left = &node_storage_.back();
-        node_storage_.back().parent = parent;
-        return;
+        parent->left = node;
+        break;
       }
       parent = parent->left;
     } else {
       if (parent->right == nullptr) {
-        parent->right = &node_storage_.back();
-        node_storage_.back().parent = parent;
-        return;
+        parent->right = node;
+        break;
       }
       parent = parent->right;
     }
   }
+  node->parent = parent;
+
+  // Restore the heap order on priorities.
+  while (node->parent != nullptr && node->parent->priority < node->priority) {
+    RotateUp(node);
+  }
 }
 
 bool BufferIntervalTree::Remove(int64_t start, int64_t end,
                                 const Chunk& chunk) {
-  BufferIntervalTreeNode* to_delete = root_;
-  while (to_delete != nullptr) {
-    if (to_delete->start == start && to_delete->end == end &&
-        to_delete->chunk.offset == chunk.offset) {
+  // Rotations may move nodes with equal start times to either side of each
+  // other, so both subtrees need to be searched when the start times match.
+  BufferIntervalTreeNode* to_delete = nullptr;
+  std::vector<BufferIntervalTreeNode*> visiting_stack;
+  if (root_ != nullptr) {
+    visiting_stack.push_back(root_);
+  }
+  while (!visiting_stack.empty()) {
+    BufferIntervalTreeNode* top = visiting_stack.back();
+    visiting_stack.pop_back();
+    if (top->start == start && top->end == end &&
+        top->chunk.offset == chunk.offset) {
+      to_delete = top;
       break;
     }
-    if (start < to_delete->start) {
-      to_delete = to_delete->left;
-    } else {
-      to_delete = to_delete->right;
+    if (start <= top->start && top->left != nullptr) {
+      visiting_stack.push_back(top->left);
+    }
+    if (start >= top->start && top->right != nullptr) {
+      visiting_stack.push_back(top->right);
     }
   }
   if (to_delete == nullptr) {
     // Nothing to delete.
     return false;
   }
-  // Found the node to be deleted, enter deletion sequence.
-
-  // Recursively traverse the parents of node and fix up the `subtree_end`
-  // invariant of a node. Recursive lambda need an explicit
-  // std::function declaration.
-  std::function<void(BufferIntervalTreeNode*)> fix_up =
-      [&](BufferIntervalTreeNode* node) {
-        if (node == nullptr) {
-          return;
-        }
-        node->subtree_end = node->end;
-        if (node->left) {
-          node->subtree_end =
-              std::max(node->subtree_end, node->left->subtree_end);
-        }
-        if (node->right) {
-          node->subtree_end =
-              std::max(node->subtree_end, node->right->subtree_end);
-        }
-        // Recursively go up.
-        fix_up(node->parent);
-      };
-
-  if (to_delete->right == nullptr) {
-    // to_delete has no right child, simply move up left child of to_delete if
-    // any.
-    //
-    // Turn:
-    //      parent
-    //       /
-    // to_delete
-    //  /      \
-    // left    nullptr
-    //
-    // Into:
-    //      parent
-    //      /
-    //    left
-    if (root_ == to_delete) {
-      // Deleting root is simply reseting root;
-      root_ = to_delete->left;
-      return true;
-    }
-
-    if (to_delete == to_delete->parent->left) {
-      // to_delete is left child of parent.
-      to_delete->parent->left = to_delete->left;
-    }
-    if (to_delete == to_delete->parent->right) {
-      // to_delete is right child of parent.
-      to_delete->parent->right = to_delete->left;
-    }
-    // Rewire parent to the node being moved up.
-    if (to_delete->left) {
-      to_delete->left->parent = to_delete->parent;
-    }
-    // Fix up starting from subroot.
-    fix_up(to_delete);
-  } else {
-    // 1. Find left-most node of the right subtree, promote it to the position
-    // of to_delete.
-    BufferIntervalTreeNode* to_promote = to_delete->right;
-    while (to_promote->left != nullptr) {
-      // Go to left-most subtree.
-      to_promote = to_promote->left;
-    }
 
-    // 2. Copy the content of `to_promote` to `to_delete`.
-    to_delete->start = to_promote->start;
-    to_delete->end = to_promote->end;
-    // This is incorrect but we will fix this up later in the `fix_up`
-    // procedure.
-    to_delete->subtree_end = to_promote->subtree_end;
-    to_delete->chunk = to_promote->chunk;
-    auto to_promote_parent = to_promote->parent;
-    // 3. Move the right child of `to_promote` up if there is any.
-    //
-    // Turn
-    //
-    // to_delete
-    //         \
-    //        to_promote_parent
-    //         /
-    //    to_promote
-    //          \
-    //          right
-    // into
-    //
-    // to_promote
-    //         \
-    //         to_promote_parent
-    //         /
-    //      right
-    if (to_promote_parent->left == to_promote) {
-      to_promote_parent->left = to_promote->right;
-    } else {
-      to_promote_parent->right = to_promote->right;
-    }
-    if (to_promote->right) {
-      // Set correct parent.
-      to_promote->right->parent = to_promote_parent;
-    }
-    // 4. Recursive fix up the `subtree_end` starting from
-    // `to_promote_parent`.
-    fix_up(to_promote_parent);
+  // Rotate the node down until it has at most one child, then splice it out.
+  while (to_delete->left != nullptr && to_delete->right != nullptr) {
+    RotateUp(to_delete->left->priority > to_delete->right->priority
+                 ? to_delete->left
+                 : to_delete->right);
   }
+  Splice(to_delete);
   // Don't free the entry in node_storage_ until we free the entire tree.
   return true;
 }
@@ -874,9 +879,10 @@ GlobalDecreasingSizeBestFitHeap<BufferType>::FindChunkCandidate(
 
   // Find the max size of interval across its colocations and use this value to
   // determine whether the buffer will fit in the heap.
+  const absl::flat_hash_set<const BufferType*> colocations =
+      GetTransitiveColocations(buffer_interval);
   int64_t max_colocation_size = buffer_interval.size;
-  for (const BufferType* colocation :
-       GetTransitiveColocations(buffer_interval)) {
+  for (const BufferType* colocation : colocations) {
     max_colocation_size =
         std::max(max_colocation_size, buffer_intervals_.at(colocation).size);
   }
@@ -918,8 +924,7 @@ GlobalDecreasingSizeBestFitHeap<BufferType>::FindChunkCandidate(
   subtract_used_chunks(interval_tree_.ChunksOverlappingInTime(
       buffer_interval.start, buffer_interval.end));
 
-  for (const BufferType* colocation :
-       GetTransitiveColocations(buffer_interval)) {
+  for (const BufferType* colocation : colocations) {
     const BufferInterval& interval = buffer_intervals_.at(colocation);
     VLOG(1) << "  Alias size " << interval.size << ", start " << interval.start
             << ", end " << interval.end << " " << interval.buffer->ToString();
@@ -1034,10 +1039,26 @@ HeapSimulator::Result<BufferType>
 ChooseBestHeapAlgorithm<BufferType>::Finish() {
   DCHECK(!algorithms_.empty());
   std::vector<Result> results(algorithms_.size());
+  // The algorithms only touch their own state, but verbose logging stringifies
+  // the buffers, which lazily computes HloValue uses and is not thread-safe.
+  if (algorithms_.size() > 1 && num_allocs_ >= kMinAllocsForParallelFinish &&
+      !VLOG_IS_ON(1)) {
+    // The thread pool destructor waits for all scheduled work to complete.
+    tsl::thread::ThreadPool thread_pool(tsl::Env::Default(), "heap_simulator",
+                                        algorithms_.size());
+    for (int i = 0; i < algorithms_.size(); ++i) {
+      thread_pool.Schedule(
+          [this, &results, i] { results[i] = algorithms_[i]->Finish(); });
+    }
+  } else {
+    for (int i = 0; i < algorithms_.size(); ++i) {
+      results[i] = algorithms_[i]->Finish();
+    }
+  }
+
   int64_t min_size = INT64_MAX;
   int min_size_index = -1;
   for (int i = 0; i < algorithms_.size(); ++i) {
-    results[i] = algorithms_[i]->Finish();
     if (results[i].heap_size < min_size) {
       min_size = results[i].heap_size;
       min_size_index = i;
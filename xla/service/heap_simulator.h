@@ -332,9 +332,18 @@ struct BufferIntervalTreeNode {
   BufferIntervalTreeNode* right;
   // parent
   BufferIntervalTreeNode* parent;
+  // Heap priority used to keep the tree balanced. A node's priority is never
+  // smaller than the priorities of its children.
+  uint64_t priority;
 };
 
 // An interval tree that can query buffers overlapping in time.
+//
+// The tree is a treap ordered by start time: nodes are assigned
+// pseudo-random priorities and rotated to maintain heap order on them, so the
+// expected depth stays logarithmic even when intervals are added in start
+// order (e.g. many equally sized buffers with increasing ids). This keeps
+// ChunksOverlappingInTime at O(log n + k) for k overlapping chunks.
 class BufferIntervalTree {
  public:
   using Chunk = HeapSimulator::Chunk;
@@ -352,8 +361,20 @@ class BufferIntervalTree {
   BufferIntervalTreeNode* GetRoot() { return root_; }
 
  private:
+  // Returns the next node priority. Priorities are generated deterministically
+  // so that heap simulation results are reproducible.
+  uint64_t NextPriority();
+
+  // Rotates `node` above its parent, preserving the in-order sequence of the
+  // tree and updating the subtree_end of both nodes.
+  void RotateUp(BufferIntervalTreeNode* node);
+
+  // Replaces `node`, which must have at most one child, with that child.
+  void Splice(BufferIntervalTreeNode* node);
+
   BufferIntervalTreeNode* root_ = nullptr;
   std::list<BufferIntervalTreeNode> node_storage_;
+  uint64_t priority_state_ = 0;
 };
 
 // GlobalDecreasingSizeBestFitHeap collects the live intervals of all buffers,
@@ -504,6 +525,7 @@ class ChooseBestHeapAlgorithm : public HeapAlgorithm<BufferType> {
   ~ChooseBestHeapAlgorithm() override {}
 
   void Alloc(const BufferType* buffer, int64_t size) override {
+    ++num_allocs_;
     for (auto& algorithm : algorithms_) {
       algorithm->Alloc(buffer, size);
     }
@@ -511,6 +533,7 @@ class ChooseBestHeapAlgorithm : public HeapAlgorithm<BufferType> {
 
   void ShareWith(const BufferType* buffer, const BufferType* share_with,
                  int64_t size) override {
+    ++num_allocs_;
     for (auto& algorithm : algorithms_) {
       algorithm->ShareWith(buffer, share_with, size);
     }
@@ -522,10 +545,19 @@ class ChooseBestHeapAlgorithm : public HeapAlgorithm<BufferType> {
     }
   }
 
+  // Runs Finish() on all the algorithms and returns the result with the
+  // smallest heap size, preferring earlier algorithms on ties. The algorithms
+  // are independent of each other, so for large heaps they are finished
+  // concurrently.
   Result Finish() override;
 
  private:
+  // Minimum number of allocations for which the algorithms are finished on
+  // separate threads. Below this, thread startup dominates.
+  static constexpr int64_t kMinAllocsForParallelFinish = 4096;
+
   std::vector<std::unique_ptr<HeapAlgorithm<BufferType>>> algorithms_;
+  int64_t num_allocs_ = 0;
 };
 
 extern template class GlobalDecreasingSizeBestFitHeap<HloValue>;
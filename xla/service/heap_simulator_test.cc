@@ -15,11 +15,16 @@ limitations under the License.
 
 #include "xla/service/heap_simulator.h"
 
+#include <algorithm>
+#include <cstdint>
+#include <functional>
 #include <memory>
+#include <random>
 #include <utility>
 #include <vector>
 
 #include "absl/container/flat_hash_map.h"
+#include "absl/types/span.h"
 #include "xla/hlo/ir/hlo_computation.h"
 #include "xla/hlo/ir/hlo_instruction.h"
 #include "xla/hlo/ir/hlo_module.h"
@@ -32,6 +37,7 @@ limitations under the License.
 #include "xla/tests/hlo_test_base.h"
 #include "tsl/lib/core/status_test_util.h"
 #include "tsl/platform/test.h"
+#include "tsl/platform/test_benchmark.h"
 
 namespace xla {
 namespace {
@@ -1696,5 +1702,168 @@ TEST_F(IntervalTreeTest, ThreeLevelsRightLeftChunkDifferent) {
   ASSERT_EQ(tree.GetRoot(), nullptr);
 }
 
+TEST_F(IntervalTreeTest, BalancedWhenInsertedInOrder) {
+  // Intervals added in start order would degenerate an unbalanced tree into a
+  // list.
+  constexpr int64_t kNumIntervals = 1 << 14;
+  BufferIntervalTree tree;
+  for (int64_t i = 0; i < kNumIntervals; ++i) {
+    tree.Add(i, i + 2, HeapSimulator::Chunk{i, 1});
+  }
+  std::function<int64_t(const BufferIntervalTreeNode*)> depth =
+      [&](const BufferIntervalTreeNode* node) -> int64_t {
+    if (node == nullptr) {
+      return 0;
+    }
+    return 1 + std::max(depth(node->left), depth(node->right));
+  };
+  EXPECT_LT(depth(tree.GetRoot()), 64);
+
+  // Remove every other interval and check that queries still see exactly the
+  // remaining overlapping chunks.
+  for (int64_t i = 0; i < kNumIntervals; i += 2) {
+    EXPECT_TRUE(tree.Remove(i, i + 2, HeapSimulator::Chunk{i, 1}));
+  }
+  EXPECT_LT(depth(tree.GetRoot()), 64);
+  std::vector<int64_t> offsets;
+  for (const HeapSimulator::Chunk& chunk :
+       tree.ChunksOverlappingInTime(100, 104)) {
+    offsets.push_back(chunk.offset);
+  }
+  EXPECT_THAT(offsets, ::testing::UnorderedElementsAre(99, 101, 103));
+}
+
+TEST_F(IntervalTreeTest, RemoveWithEqualStartTimes) {
+  BufferIntervalTree tree;
+  for (int64_t i = 0; i < 64; ++i) {
+    tree.Add(10, 20 + i, HeapSimulator::Chunk{i, 1});
+  }
+  for (int64_t i = 63; i >= 0; i -= 3) {
+    EXPECT_TRUE(tree.Remove(10, 20 + i, HeapSimulator::Chunk{i, 1}));
+    EXPECT_FALSE(tree.Remove(10, 20 + i, HeapSimulator::Chunk{i, 1}));
+  }
+  EXPECT_EQ(tree.ChunksOverlappingInTime(0, 100).size(), 42);
+  EXPECT_EQ(tree.GetRoot()->subtree_end, 20 + 62);
+}
+
+// Creates `num_buffers` HloValues for heap algorithms. The values all share
+// `instruction`, since the algorithms only use them as keys.
+std::vector<std::unique_ptr<HloValue>> CreateSyntheticBuffers(
+    HloInstruction* instruction, int64_t num_buffers) {
+  std::vector<std::unique_ptr<HloValue>> buffers;
+  buffers.reserve(num_buffers);
+  for (int64_t i = 0; i < num_buffers; ++i) {
+    buffers.push_back(
+        std::make_unique<HloValue>(i, instruction, ShapeIndex{}));
+  }
+  return buffers;
+}
+
+// Replays a pseudo-random but deterministic sequence of Alloc and Free calls
+// on `algorithm`, with buffer sizes between 1 byte and 1MiB and on average
+// `average_live` buffers live at once.
+void RunSyntheticLiveRanges(
+    absl::Span<const std::unique_ptr<HloValue>> buffers, int64_t average_live,
+    HeapAlgorithm<HloValue>* algorithm) {
+  std::mt19937_64 rng(/*seed=*/42);
+  std::vector<std::pair<const HloValue*, int64_t>> live;
+  auto free_random_buffer = [&] {
+    std::swap(live[rng() % live.size()], live.back());
+    algorithm->Free(live.back().first, live.back().second);
+    live.pop_back();
+  };
+  for (const std::unique_ptr<HloValue>& buffer : buffers) {
+    const int64_t size = 1 + rng() % (int64_t{1} << (rng() % 21));
+    algorithm->Alloc(buffer.get(), size);
+    live.emplace_back(buffer.get(), size);
+    while (live.size() > average_live && rng() % 2 == 0) {
+      free_random_buffer();
+    }
+  }
+  while (!live.empty()) {
+    free_random_buffer();
+  }
+}
+
+class ChooseBestHeapAlgorithmTest : public ::testing::Test {};
+
+TEST_F(ChooseBestHeapAlgorithmTest, MatchesBestIndividualResult) {
+  // Use enough buffers for the algorithms to be finished concurrently.
+  std::unique_ptr<HloInstruction> constant =
+      HloInstruction::CreateConstant(LiteralUtil::CreateR0<float>(1.0));
+  std::vector<std::unique_ptr<HloValue>> buffers =
+      CreateSyntheticBuffers(constant.get(), 5000);
+
+  using Heap = GlobalDecreasingSizeBestFitHeap<HloValue>;
+  int64_t min_heap_size = INT64_MAX;
+  for (Heap::Type type : {Heap::kSpatial, Heap::kTemporal}) {
+    Heap heap(/*alignment=*/64, type);
+    RunSyntheticLiveRanges(buffers, /*average_live=*/100, &heap);
+    min_heap_size = std::min(min_heap_size, heap.Finish().heap_size);
+  }
+
+  auto algorithms = std::make_unique<
+      std::vector<std::unique_ptr<HeapAlgorithm<HloValue>>>>();
+  algorithms->push_back(
+      std::make_unique<Heap>(/*alignment=*/64, Heap::kSpatial));
+  algorithms->push_back(
+      std::make_unique<Heap>(/*alignment=*/64, Heap::kTemporal));
+  ChooseBestHeapAlgorithm<HloValue> choose_best(std::move(algorithms));
+  RunSyntheticLiveRanges(buffers, /*average_live=*/100, &choose_best);
+  const HeapSimulator::Result<HloValue> result = choose_best.Finish();
+  EXPECT_EQ(result.heap_size, min_heap_size);
+  ASSERT_EQ(result.heap_results.size(), 1);
+  EXPECT_EQ(result.heap_results[0].chunk_map.size(), buffers.size());
+}
+
+// Reports the heap size and runtime of the heap algorithm used by buffer
+// assignment on synthetic live ranges. The first argument is the number of
+// buffers and the second is the average number of live buffers.
+void BM_ChooseBestHeapAlgorithm(::testing::benchmark::State& state) {
+  const int64_t num_buffers = state.range(0);
+  const int64_t average_live = state.range(1);
+  std::unique_ptr<HloInstruction> constant =
+      HloInstruction::CreateConstant(LiteralUtil::CreateR0<float>(1.0));
+  std::vector<std::unique_ptr<HloValue>> buffers =
+      CreateSyntheticBuffers(constant.get(), num_buffers);
+
+  int64_t heap_size = 0;
+  for (auto s : state) {
+    using Heap = ConstrainedGlobalDecreasingSizeBestFitHeap;
+    auto algorithms = std::make_unique<
+        std::vector<std::unique_ptr<HeapAlgorithm<HloValue>>>>();
+    algorithms->push_back(std::make_unique<Heap>(
+        /*size_limit_per_heap=*/UINT64_MAX, /*alignment=*/64, Heap::kSpatial));
+    algorithms->push_back(std::make_unique<Heap>(
+        /*size_limit_per_heap=*/UINT64_MAX, /*alignment=*/64,
+        Heap::kTemporal));
+    ChooseBestHeapAlgorithm<HloValue> choose_best(std::move(algorithms));
+    RunSyntheticLiveRanges(buffers, average_live, &choose_best);
+    heap_size = choose_best.Finish().heap_size;
+  }
+  state.counters["heap_size"] = heap_size;
+}
+BENCHMARK(BM_ChooseBestHeapAlgorithm)
+    ->ArgPair(1 << 10, 64)
+    ->ArgPair(1 << 14, 256)
+    ->ArgPair(1 << 17, 1024)
+    ->ArgPair(1 << 19, 1024);
+
+// Inserts intervals in start order, which is the worst case for an unbalanced
+// interval tree, and queries each of them.
+void BM_BufferIntervalTreeInOrder(::testing::benchmark::State& state) {
+  const int64_t num_intervals = state.range(0);
+  for (auto s : state) {
+    BufferIntervalTree tree;
+    int64_t num_overlapping = 0;
+    for (int64_t i = 0; i < num_intervals; ++i) {
+      num_overlapping += tree.ChunksOverlappingInTime(i, i + 4).size();
+      tree.Add(i, i + 4, HeapSimulator::Chunk{i, 1});
+    }
+    tsl::testing::DoNotOptimize(num_overlapping);
+  }
+}
+BENCHMARK(BM_BufferIntervalTreeInOrder)->Range(1 << 10, 1 << 18);
+
 }  // namespace
 }  // namespace xla
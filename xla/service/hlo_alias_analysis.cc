@@ -393,29 +393,43 @@ StatusOr<std::unique_ptr<HloAliasAnalysis>> HloAliasAnalysis::Run(
                                                /*bitcast_defines_value=*/false,
                                                can_share_buffer));
 
-  size_t num_values = alias_analysis->dataflow_analysis_->values().size();
-  alias_analysis->buffers_ = CreateBuffers(alias_analysis->dataflow_analysis());
-  alias_analysis->value_to_buffer_.reserve(num_values);
+  alias_analysis->InitializeBuffers();
 
-  for (HloBuffer& buffer : alias_analysis->buffers_) {
+  XLA_VLOG_LINES(2, alias_analysis->ToString());
+  return std::move(alias_analysis);
+}
+
+Status HloAliasAnalysis::Update() {
+  VLOG(2) << "HloAliasAnalysis::Update on module " << module_->name();
+  TF_RETURN_IF_ERROR(dataflow_analysis_->Update());
+  InitializeBuffers();
+
+  XLA_VLOG_LINES(2, ToString());
+  return OkStatus();
+}
+
+void HloAliasAnalysis::InitializeBuffers() {
+  size_t num_values = dataflow_analysis_->values().size();
+  live_out_buffers_.clear();
+  value_to_buffer_.clear();
+  buffers_ = CreateBuffers(dataflow_analysis());
+  value_to_buffer_.reserve(num_values);
+
+  for (HloBuffer& buffer : buffers_) {
     for (const HloValue* value : buffer.values()) {
-      alias_analysis->value_to_buffer_[value] = &buffer;
+      value_to_buffer_[value] = &buffer;
     }
   }
 
-  CHECK_EQ(alias_analysis->value_to_buffer_.size(), num_values);
-  TF_DCHECK_OK(alias_analysis->Verify());
+  CHECK_EQ(value_to_buffer_.size(), num_values);
+  TF_DCHECK_OK(Verify());
 
-  HloInstruction* root = module->entry_computation()->root_instruction();
+  HloInstruction* root = module_->entry_computation()->root_instruction();
   ShapeUtil::ForEachSubshape(root->shape(), [&](const Shape& /*subshape*/,
                                                 const ShapeIndex& index) {
-    std::vector<const HloBuffer*> buffers =
-        alias_analysis->ComputeBuffersAt(root, index);
-    alias_analysis->live_out_buffers_.insert(buffers.begin(), buffers.end());
+    std::vector<const HloBuffer*> buffers = ComputeBuffersAt(root, index);
+    live_out_buffers_.insert(buffers.begin(), buffers.end());
   });
-
-  XLA_VLOG_LINES(2, alias_analysis->ToString());
-  return std::move(alias_analysis);
 }
 
 }  // namespace xla
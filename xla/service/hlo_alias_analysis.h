@@ -43,6 +43,12 @@ class HloAliasAnalysis {
       const HloModule* module,
       const HloDataflowAnalysis::CanShareBuffer& can_share_buffer = nullptr);
 
+  // Updates the analysis after the module has been modified. The underlying
+  // dataflow analysis is updated incrementally (see
+  // HloDataflowAnalysis::Update) and the buffers are then rebuilt from it.
+  // Buffers and their ids are not preserved across an update.
+  Status Update();
+
   std::string ToString() const;
 
   // Return the buffer containing the given value.
@@ -105,6 +111,10 @@ class HloAliasAnalysis {
   // Verify various invariants of the alias analysis.
   Status Verify() const;
 
+  // Builds the buffers, and everything derived from them, from the values of
+  // the dataflow analysis.
+  void InitializeBuffers();
+
   const HloModule* module_;
 
   // A set of buffers that live out the module.
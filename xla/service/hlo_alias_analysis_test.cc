@@ -1008,5 +1008,53 @@ ENTRY main {
             analysis.GetUniqueBufferAt(fusion));
 }
 
+TEST_F(HloAliasAnalysisTest, IncrementalUpdate) {
+  absl::string_view hlo_string = R"(
+HloModule Module
+
+body {
+  p = (f32[4], f32[4]) parameter(0)
+  gte0 = f32[4] get-tuple-element(p), index=0
+  gte1 = f32[4] get-tuple-element(p), index=1
+  add = f32[4] add(gte0, gte1)
+  ROOT tuple = (f32[4], f32[4]) tuple(add, gte1)
+}
+
+condition {
+  p = (f32[4], f32[4]) parameter(0)
+  ROOT c = pred[] constant(false)
+}
+
+ENTRY main {
+  p0 = f32[4] parameter(0)
+  p1 = f32[4] parameter(1)
+  tuple = (f32[4], f32[4]) tuple(p0, p1)
+  ROOT while = (f32[4], f32[4]) while(tuple), condition=condition, body=body
+}
+)";
+  TF_ASSERT_OK_AND_ASSIGN(module_, ParseAndReturnVerifiedModule(hlo_string));
+  HloAliasAnalysis& analysis = RunAnalysis();
+
+  // Insert a copy in front of the while loop, as copy insertion would.
+  HloComputation* entry = module_->entry_computation();
+  HloInstruction* p0 = entry->GetInstructionWithName("p0");
+  HloInstruction* tuple = entry->GetInstructionWithName("tuple");
+  HloInstruction* copy = entry->AddInstruction(
+      HloInstruction::CreateUnary(p0->shape(), HloOpcode::kCopy, p0));
+  TF_ASSERT_OK(tuple->ReplaceOperandWith(0, copy));
+  TF_ASSERT_OK(analysis.Update());
+  TF_EXPECT_OK(analysis.dataflow_analysis().VerifyAgainstFullRecompute());
+
+  TF_ASSERT_OK_AND_ASSIGN(std::unique_ptr<HloAliasAnalysis> expected,
+                          HloAliasAnalysis::Run(module_.get()));
+  EXPECT_EQ(analysis.buffers().size(), expected->buffers().size());
+  EXPECT_NE(analysis.GetUniqueBufferAt(p0), analysis.GetUniqueBufferAt(copy));
+  HloInstruction* xla_while = entry->root_instruction();
+  EXPECT_EQ(analysis.GetUniqueBufferAt(copy),
+            analysis.GetUniqueBufferAt(xla_while, {0}));
+  EXPECT_TRUE(
+      analysis.BufferLivesOut(analysis.GetUniqueBufferAt(xla_while, {0})));
+}
+
 }  // namespace
 }  // namespace xla
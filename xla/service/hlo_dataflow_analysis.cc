@@ -28,6 +28,7 @@ limitations under the License.
 #include "absl/container/flat_hash_set.h"
 #include "absl/container/inlined_vector.h"
 #include "absl/functional/function_ref.h"
+#include "absl/hash/hash.h"
 #include "absl/strings/str_cat.h"
 #include "xla/hlo/ir/hlo_casting_utils.h"
 #include "xla/hlo/ir/hlo_computation.h"
@@ -1197,7 +1198,8 @@ bool HloDataflowAnalysis::UpdateInstructionValueSet(
   }
 }
 
-void HloDataflowAnalysis::Propagate() {
+void HloDataflowAnalysis::Propagate(
+    absl::Span<HloInstruction* const> instructions) {
   using Work = std::pair<int64_t, HloInstruction*>;
   // Avoid duplicating work by preferring work items early in the post order
   // schedule. Intuitively, we start from entry parameters and propagate buffers
@@ -1212,12 +1214,8 @@ void HloDataflowAnalysis::Propagate() {
     }
   };
 
-  auto comps = module_.MakeComputationPostOrder();
-  for (HloComputation* computation : comps) {
-    for (HloInstruction* instruction :
-         computation->MakeInstructionPostOrder()) {
-      add_to_worklist(instruction);
-    }
+  for (HloInstruction* instruction : instructions) {
+    add_to_worklist(instruction);
   }
   VLOG(1) << "SSA_FORM_: " << ssa_form_;
 
@@ -1326,178 +1324,185 @@ InstructionValueSet& HloDataflowAnalysis::GetInstructionValueSet(
 
 Status HloDataflowAnalysis::InitializeInstructionValueSets() {
   for (const HloComputation* computation : module_.MakeComputationSorted()) {
-    const CallGraphNode& call_graph_node = call_graph_->GetNode(computation);
     for (HloInstruction* instruction :
          computation->MakeInstructionPostOrder()) {
-      // Create an empty shape tree.
-      value_sets_.insert({instruction, std::make_unique<InstructionValueSet>(
-                                           instruction->shape())});
-
-      // For each sub-shape of the instruction shape, add a new HloValue to its
-      // HloValueSet. should_define may be provided to define a subset of
-      // values.
-      auto define_all_values =
-          [this, &instruction](
-              absl::FunctionRef<bool(const ShapeIndex&)> should_define =
-                  [](const ShapeIndex&) { return true; }) {
-            for (auto& pair : GetInstructionValueSet(instruction)) {
-              const ShapeIndex& index = pair.first;
-              if (should_define(index)) {
-                HloValue* value =
-                    NewHloValue(instruction, index, /*is_phi=*/false);
-                GetValueSet(instruction, index).AddValue(value);
-              }
-            }
-          };
+      TF_RETURN_IF_ERROR(InitializeInstructionValueSet(instruction));
+    }
+  }
 
-      // Add a new HloValue to the HloValueSet corresponding to the given index
-      // of the instruction shape.
-      auto define_value_at = [this, &instruction](const ShapeIndex& index) {
-        HloValue* value = NewHloValue(instruction, index, /*is_phi=*/false);
-        GetValueSet(instruction, index).AddValue(value);
-      };
+  return OkStatus();
+}
 
-      switch (instruction->opcode()) {
-        case HloOpcode::kBitcast:
-          if (bitcast_defines_value_) {
-            define_all_values();
-          }
-          break;
-        case HloOpcode::kSetDimensionSize:
-        case HloOpcode::kAddDependency:
-        case HloOpcode::kWhile:
-        case HloOpcode::kCall:
-        case HloOpcode::kConditional:
-        case HloOpcode::kGetTupleElement:
-        case HloOpcode::kDomain:
-        case HloOpcode::kOptimizationBarrier:
-          // These instructions define no values. The values in their output
-          // flow from their operands or from cross computation dataflow.
-          break;
-        case HloOpcode::kParameter:
-          if (call_graph_node.context() == CallContext::kBoth) {
-            // We do not support a subcomputation that is called from both a
-            // parallel and sequential context. In this case, the parameter
-            // would both define a value and propagate a value from its
-            // caller. This limitation is not really a problem because the call
-            // graph is typically flattened.
-            return Unimplemented(
-                "Computation %s is called in both a parallel (eg, kMap) and "
-                "sequential (eg, kCall) context",
-                computation->name());
-          }
-          if (call_graph_node.caller_callsites().empty() ||
-              call_graph_node.context() == CallContext::kEmbedded) {
-            // Parameters of computations called in a parallel context (eg, map
-            // and reduce) as well as parameters of dead computations define all
-            // values in their output. Otherwise the values of the parameter
-            // come from the caller (eg, operands to the kCall instruction).
-            define_all_values();
-          }
-          break;
-        case HloOpcode::kCopy:
-        case HloOpcode::kTuple:
-          // These instructions only define their top-level values. Any other
-          // values flow from their operands.
-          define_value_at(/*index=*/{});
-          break;
-        case HloOpcode::kAsyncStart:
-          // AsyncStart produces a tuple of {{aliased operands}, {destination},
-          // contexts}. It defines all of the tuple-shaped values and the
-          // contexts.
-          define_all_values([&](const ShapeIndex& index) {
-            return ShapeUtil::GetSubshape(instruction->shape(), index)
-                       .IsTuple() ||
-                   index.front() > 1;
-          });
-          break;
-        case HloOpcode::kAsyncUpdate:
-          // AsyncUpdate produces a tuple of {{aliased operands}, {destination},
-          // contexts} where all of the array-typed values alias with the
-          // operand. So, only tuple-shaped values are defined by AsyncUpdate.
-          define_all_values([&](const ShapeIndex& index) {
-            return ShapeUtil::GetSubshape(instruction->shape(), index)
-                .IsTuple();
-          });
-          break;
-        case HloOpcode::kAsyncDone:
-          // AsyncDone's output aliases its output.
-          break;
-        case HloOpcode::kCopyStart:
-          // CopyStart produces a tuple of {destination buffer, aliased operand,
-          // U32 context}.
-          define_value_at(/*index=*/{});
-          define_value_at(/*index=*/{0});
-          define_value_at(/*index=*/{2});
-          break;
-        case HloOpcode::kCopyDone:
-          // CopyDone consumes a tuple produced by CopyStart and produces an
-          // element. Its output aliases its input tuple element {0}.
-          break;
-        case HloOpcode::kAllGatherStart:
-          // AllGatherStart produces a tuple of
-          // {aliased operand, destination buffer}.
-          define_value_at(/*index=*/{});
-          define_value_at(/*index=*/{1});
-          break;
-        case HloOpcode::kAllGatherDone:
-          // AllGatherDone's output aliases its input tuple element {1}.
-          if (instruction->shape().IsTuple()) {
-            define_value_at(/*index=*/{});
-          }
-          break;
-        case HloOpcode::kAllReduceDone:
-          // AllReduceDone's output aliases its input.
-          break;
-        case HloOpcode::kCollectivePermuteStart:
-          // CollectivePermuteStart produces a tuple of
-          // {aliased operand, destination buffer, U32 context, U32 context}.
-          define_value_at(/*index=*/{});
-          define_value_at(/*index=*/{1});
-          define_value_at(/*index=*/{2});
-          define_value_at(/*index=*/{3});
-          if (instruction->operand_count() > 1) {
-            CHECK_EQ(instruction->operand_count(), 4);
-            if (instruction->operand(1)->shape().IsTuple()) {
-              for (int i = 0; i < ShapeUtil::TupleElementCount(
-                                      instruction->operand(1)->shape());
-                   ++i) {
-                define_value_at(/*index=*/{1, i});
-              }
-            }
+Status HloDataflowAnalysis::InitializeInstructionValueSet(
+    HloInstruction* instruction) {
+  const HloComputation* computation = instruction->parent();
+  const CallGraphNode& call_graph_node = call_graph_->GetNode(computation);
+  // Create an empty shape tree.
+  value_sets_.insert({instruction, std::make_unique<InstructionValueSet>(
+                                       instruction->shape())});
+
+  // For each sub-shape of the instruction shape, add a new HloValue to its
+  // HloValueSet. should_define may be provided to define a subset of
+  // values.
+  auto define_all_values =
+      [this, &instruction](
+          absl::FunctionRef<bool(const ShapeIndex&)> should_define =
+              [](const ShapeIndex&) { return true; }) {
+        for (auto& pair : GetInstructionValueSet(instruction)) {
+          const ShapeIndex& index = pair.first;
+          if (should_define(index)) {
+            HloValue* value = NewHloValue(instruction, index, /*is_phi=*/false);
+            GetValueSet(instruction, index).AddValue(value);
           }
-          break;
-        case HloOpcode::kCollectivePermuteDone:
-          // CollectivePermuteDone's output aliases its input tuple element {1}.
-          if (instruction->shape().IsTuple()) {
-            define_value_at(/*index=*/{});
+        }
+      };
+
+  // Add a new HloValue to the HloValueSet corresponding to the given index
+  // of the instruction shape.
+  auto define_value_at = [this, &instruction](const ShapeIndex& index) {
+    HloValue* value = NewHloValue(instruction, index, /*is_phi=*/false);
+    GetValueSet(instruction, index).AddValue(value);
+  };
+
+  switch (instruction->opcode()) {
+    case HloOpcode::kBitcast:
+      if (bitcast_defines_value_) {
+        define_all_values();
+      }
+      break;
+    case HloOpcode::kSetDimensionSize:
+    case HloOpcode::kAddDependency:
+    case HloOpcode::kWhile:
+    case HloOpcode::kCall:
+    case HloOpcode::kConditional:
+    case HloOpcode::kGetTupleElement:
+    case HloOpcode::kDomain:
+    case HloOpcode::kOptimizationBarrier:
+      // These instructions define no values. The values in their output
+      // flow from their operands or from cross computation dataflow.
+      break;
+    case HloOpcode::kParameter:
+      if (call_graph_node.context() == CallContext::kBoth) {
+        // We do not support a subcomputation that is called from both a
+        // parallel and sequential context. In this case, the parameter
+        // would both define a value and propagate a value from its
+        // caller. This limitation is not really a problem because the call
+        // graph is typically flattened.
+        return Unimplemented(
+            "Computation %s is called in both a parallel (eg, kMap) and "
+            "sequential (eg, kCall) context",
+            computation->name());
+      }
+      if (call_graph_node.caller_callsites().empty() ||
+          call_graph_node.context() == CallContext::kEmbedded) {
+        // Parameters of computations called in a parallel context (eg, map
+        // and reduce) as well as parameters of dead computations define all
+        // values in their output. Otherwise the values of the parameter
+        // come from the caller (eg, operands to the kCall instruction).
+        define_all_values();
+      }
+      break;
+    case HloOpcode::kCopy:
+    case HloOpcode::kTuple:
+      // These instructions only define their top-level values. Any other
+      // values flow from their operands.
+      define_value_at(/*index=*/{});
+      break;
+    case HloOpcode::kAsyncStart:
+      // AsyncStart produces a tuple of {{aliased operands}, {destination},
+      // contexts}. It defines all of the tuple-shaped values and the
+      // contexts.
+      define_all_values([&](const ShapeIndex& index) {
+        return ShapeUtil::GetSubshape(instruction->shape(), index).IsTuple() ||
+               index.front() > 1;
+      });
+      break;
+    case HloOpcode::kAsyncUpdate:
+      // AsyncUpdate produces a tuple of {{aliased operands}, {destination},
+      // contexts} where all of the array-typed values alias with the
+      // operand. So, only tuple-shaped values are defined by AsyncUpdate.
+      define_all_values([&](const ShapeIndex& index) {
+        return ShapeUtil::GetSubshape(instruction->shape(), index).IsTuple();
+      });
+      break;
+    case HloOpcode::kAsyncDone:
+      // AsyncDone's output aliases its output.
+      break;
+    case HloOpcode::kCopyStart:
+      // CopyStart produces a tuple of {destination buffer, aliased operand,
+      // U32 context}.
+      define_value_at(/*index=*/{});
+      define_value_at(/*index=*/{0});
+      define_value_at(/*index=*/{2});
+      break;
+    case HloOpcode::kCopyDone:
+      // CopyDone consumes a tuple produced by CopyStart and produces an
+      // element. Its output aliases its input tuple element {0}.
+      break;
+    case HloOpcode::kAllGatherStart:
+      // AllGatherStart produces a tuple of
+      // {aliased operand, destination buffer}.
+      define_value_at(/*index=*/{});
+      define_value_at(/*index=*/{1});
+      break;
+    case HloOpcode::kAllGatherDone:
+      // AllGatherDone's output aliases its input tuple element {1}.
+      if (instruction->shape().IsTuple()) {
+        define_value_at(/*index=*/{});
+      }
+      break;
+    case HloOpcode::kAllReduceDone:
+      // AllReduceDone's output aliases its input.
+      break;
+    case HloOpcode::kCollectivePermuteStart:
+      // CollectivePermuteStart produces a tuple of
+      // {aliased operand, destination buffer, U32 context, U32 context}.
+      define_value_at(/*index=*/{});
+      define_value_at(/*index=*/{1});
+      define_value_at(/*index=*/{2});
+      define_value_at(/*index=*/{3});
+      if (instruction->operand_count() > 1) {
+        CHECK_EQ(instruction->operand_count(), 4);
+        if (instruction->operand(1)->shape().IsTuple()) {
+          for (int i = 0; i < ShapeUtil::TupleElementCount(
+                                  instruction->operand(1)->shape());
+               ++i) {
+            define_value_at(/*index=*/{1, i});
           }
-          break;
-        case HloOpcode::kRecvDone:
-          // RecvDone produces a two-element tuple. Element zero aliases its
-          // input tuple element {0}; element one is a token.
-          define_value_at(/*index=*/{});
-          define_value_at(/*index=*/{1});
-          break;
-        case HloOpcode::kSend:
-          // Send produces a tuple of {aliased operand, U32 context, token},
-          // therefore only defines the top-level tuple and the tuple elements
-          // at {1} and {2}.
-          define_value_at(/*index=*/{});
-          define_value_at(/*index=*/{1});
-          define_value_at(/*index=*/{2});
-          break;
-        default:
-          define_all_values();
-          break;
+        }
       }
-    }
+      break;
+    case HloOpcode::kCollectivePermuteDone:
+      // CollectivePermuteDone's output aliases its input tuple element {1}.
+      if (instruction->shape().IsTuple()) {
+        define_value_at(/*index=*/{});
+      }
+      break;
+    case HloOpcode::kRecvDone:
+      // RecvDone produces a two-element tuple. Element zero aliases its
+      // input tuple element {0}; element one is a token.
+      define_value_at(/*index=*/{});
+      define_value_at(/*index=*/{1});
+      break;
+    case HloOpcode::kSend:
+      // Send produces a tuple of {aliased operand, U32 context, token},
+      // therefore only defines the top-level tuple and the tuple elements
+      // at {1} and {2}.
+      define_value_at(/*index=*/{});
+      define_value_at(/*index=*/{1});
+      define_value_at(/*index=*/{2});
+      break;
+    default:
+      define_all_values();
+      break;
   }
 
   return OkStatus();
 }
 
-void HloDataflowAnalysis::OptimizePhiValues() {
+void HloDataflowAnalysis::OptimizePhiValues(
+    absl::Span<HloInstruction* const> instructions,
+    HloValue::Id first_value_id) {
   // Only applicable to SSA form where phis are defined.
   if (!ssa_form_) {
     return;
@@ -1509,30 +1514,29 @@ void HloDataflowAnalysis::OptimizePhiValues() {
   VLOG(1) << "After phi graph optimization";
   XLA_VLOG_LINES(1, phi_graph_.ToString());
 
-  for (const HloComputation* computation : module_.computations()) {
-    for (HloInstruction* instruction : computation->instructions()) {
-      InstructionValueSet& instruction_value_set =
-          GetInstructionValueSet(instruction);
-      VLOG(1) << "inst: " << instruction->name();
-      VLOG(1) << instruction_value_set.ToString();
-      instruction_value_set.ForEachMutableElement(
-          [&](const xla::ShapeIndex& index, HloValueSet* value_set) {
-            auto values = value_set->values();
-            if (!(values.size() == 1 && values[0]->is_phi())) {
-              return;
-            }
-            HloValue::Id phi_id = values[0]->id();
-            HloValue::Id new_id = phi_graph_.FindOptimizedValue(phi_id);
-            if (new_id != phi_id) {
-              VLOG(1) << "Replacing " << values[0]->ToString() << " with "
-                      << GetValue(new_id).ToString();
-              value_set->Clear();
-              const HloValue& new_value = GetValue(new_id);
-              value_set->AddValue(&new_value);
-              MarkValueForDeletion(phi_id);
-            }
-          });
-    }
+  for (HloInstruction* instruction : instructions) {
+    InstructionValueSet& instruction_value_set =
+        GetInstructionValueSet(instruction);
+    VLOG(1) << "inst: " << instruction->name();
+    VLOG(1) << instruction_value_set.ToString();
+    instruction_value_set.ForEachMutableElement(
+        [&](const xla::ShapeIndex& index, HloValueSet* value_set) {
+          auto values = value_set->values();
+          if (!(values.size() == 1 && values[0]->is_phi() &&
+                values[0]->id() >= first_value_id)) {
+            return;
+          }
+          HloValue::Id phi_id = values[0]->id();
+          HloValue::Id new_id = phi_graph_.FindOptimizedValue(phi_id);
+          if (new_id != phi_id) {
+            VLOG(1) << "Replacing " << values[0]->ToString() << " with "
+                    << GetValue(new_id).ToString();
+            value_set->Clear();
+            const HloValue& new_value = GetValue(new_id);
+            value_set->AddValue(&new_value);
+            MarkValueForDeletion(phi_id);
+          }
+        });
   }
 }
 
@@ -1547,8 +1551,15 @@ StatusOr<std::unique_ptr<HloDataflowAnalysis>> HloDataflowAnalysis::Run(
       module, ssa_form, bitcast_defines_value, can_share_buffer));
 
   TF_RETURN_IF_ERROR(dataflow_analysis->InitializeInstructionValueSets());
-  dataflow_analysis->Propagate();
-  dataflow_analysis->OptimizePhiValues();
+  std::vector<HloInstruction*> instructions;
+  for (HloComputation* computation : module.MakeComputationPostOrder()) {
+    for (HloInstruction* instruction :
+         computation->MakeInstructionPostOrder()) {
+      instructions.push_back(instruction);
+    }
+  }
+  dataflow_analysis->Propagate(instructions);
+  dataflow_analysis->OptimizePhiValues(instructions, /*first_value_id=*/0);
 
   // Delete all values marked for deletion.
   dataflow_analysis->DeleteMarkedValues();
@@ -1559,6 +1570,7 @@ StatusOr<std::unique_ptr<HloDataflowAnalysis>> HloDataflowAnalysis::Run(
   // lookup is faster.
   std::vector<std::vector<HloPosition>> value_positions(
       dataflow_analysis->next_value_id_);
+  dataflow_analysis->instruction_fingerprints_.reserve(instructions.size());
   for (const HloComputation* computation : module.computations()) {
     for (HloInstruction* instruction : computation->instructions()) {
       for (const auto& pair :
@@ -1572,6 +1584,9 @@ StatusOr<std::unique_ptr<HloDataflowAnalysis>> HloDataflowAnalysis::Run(
           }
         }
       }
+      dataflow_analysis->instruction_fingerprints_[instruction] = {
+          instruction->unique_id(),
+          dataflow_analysis->ComputeInstructionFingerprint(instruction)};
     }
   }
   for (auto& pair : dataflow_analysis->values_) {
@@ -1626,6 +1641,297 @@ Status HloDataflowAnalysis::Verify() const {
   return OkStatus();
 }
 
+size_t HloDataflowAnalysis::ComputeInstructionFingerprint(
+    const HloInstruction* instruction) const {
+  size_t fingerprint =
+      absl::HashOf(instruction->opcode(), instruction->IsRoot());
+  // Value sets follow the tuple structure of the shape.
+  ShapeUtil::ForEachSubshape(
+      instruction->shape(),
+      [&](const Shape& /*subshape*/, const ShapeIndex& index) {
+        fingerprint = absl::HashOf(fingerprint, index.size());
+      });
+  for (const HloInstruction* operand : instruction->operands()) {
+    fingerprint = absl::HashOf(fingerprint, operand->unique_id());
+  }
+  for (const HloComputation* computation :
+       instruction->called_computations()) {
+    fingerprint = absl::HashOf(fingerprint, computation->unique_id());
+  }
+  if (instruction->opcode() == HloOpcode::kGetTupleElement) {
+    fingerprint = absl::HashOf(fingerprint, instruction->tuple_index());
+  }
+  if (instruction->opcode() == HloOpcode::kParameter) {
+    // Whether a parameter defines its values depends on how its computation
+    // is called.
+    const CallGraphNode& call_graph_node =
+        call_graph_->GetNode(instruction->parent());
+    fingerprint =
+        absl::HashOf(fingerprint, call_graph_node.context(),
+                     call_graph_node.caller_callsites().empty());
+  }
+  return fingerprint;
+}
+
+Status HloDataflowAnalysis::Update() {
+  VLOG(1) << "HloDataflowAnalysis::Update on module " << module_.name();
+  call_graph_ = CallGraph::Build(&module_);
+
+  // Find the instructions which are new or whose fingerprint changed since
+  // their value set was computed, and the instructions which were removed.
+  // Instructions are identified by their unique id as well as their address,
+  // since a new instruction may be allocated where a removed one used to be.
+  std::vector<HloInstruction*> changed;
+  absl::flat_hash_set<const HloInstruction*> live;
+  for (const HloComputation* computation : module_.computations()) {
+    for (HloInstruction* instruction : computation->instructions()) {
+      live.insert(instruction);
+      auto it = instruction_fingerprints_.find(instruction);
+      if (it == instruction_fingerprints_.end() ||
+          it->second.first != instruction->unique_id() ||
+          it->second.second != ComputeInstructionFingerprint(instruction)) {
+        changed.push_back(instruction);
+      }
+    }
+  }
+  // Removed instructions must not be dereferenced.
+  absl::flat_hash_set<const HloInstruction*> removed;
+  for (const auto& pair : instruction_fingerprints_) {
+    if (!live.contains(pair.first)) {
+      removed.insert(pair.first);
+    }
+  }
+  VLOG(1) << changed.size() << " instructions changed, " << removed.size()
+          << " instructions removed";
+  if (changed.empty() && removed.empty()) {
+    return OkStatus();
+  }
+
+  // Compute the set of dirty instructions whose value sets may change: the
+  // changed instructions plus everything their values may flow to. This
+  // follows the same edges as Propagate, conservatively.
+  absl::flat_hash_set<HloInstruction*> dirty;
+  std::vector<HloInstruction*> stack;
+  auto mark_dirty = [&](HloInstruction* instruction) {
+    if (dirty.insert(instruction).second) {
+      stack.push_back(instruction);
+    }
+  };
+  auto mark_parameters_dirty = [&](const HloInstruction* caller) {
+    for (HloComputation* computation : caller->called_computations()) {
+      if (call_graph_->GetNode(computation).context() !=
+          CallContext::kEmbedded) {
+        for (HloInstruction* parameter :
+             computation->parameter_instructions()) {
+          mark_dirty(parameter);
+        }
+      }
+    }
+  };
+  for (HloInstruction* instruction : changed) {
+    mark_dirty(instruction);
+    // A changed caller may pass different values into the computations it
+    // calls.
+    mark_parameters_dirty(instruction);
+  }
+  while (!stack.empty()) {
+    HloInstruction* instruction = stack.back();
+    stack.pop_back();
+    for (HloInstruction* user : instruction->users()) {
+      mark_dirty(user);
+      mark_parameters_dirty(user);
+    }
+    if (instruction == instruction->parent()->root_instruction()) {
+      const CallGraphNode& call_graph_node =
+          call_graph_->GetNode(instruction->parent());
+      for (const CallSite& callsite : call_graph_node.caller_callsites()) {
+        HloInstruction* caller = callsite.instruction();
+        if (caller->opcode() == HloOpcode::kWhile) {
+          mark_dirty(caller);
+          mark_dirty(caller->while_body()->parameter_instruction(0));
+          mark_dirty(caller->while_condition()->parameter_instruction(0));
+        } else if (call_graph_node.context() != CallContext::kEmbedded) {
+          mark_dirty(caller);
+        }
+      }
+    }
+  }
+  VLOG(1) << dirty.size() << " instructions to recompute";
+
+  // Discard the value sets of dirty and removed instructions. Values defined
+  // there can only appear in the value sets of other dirty instructions, so
+  // they are deleted and redefined below. Values flowing into these
+  // instructions from elsewhere survive, but their positions must be
+  // recomputed.
+  absl::flat_hash_set<HloValue::Id> value_ids_to_delete;
+  absl::flat_hash_set<HloValue::Id> affected_value_ids;
+  auto discard_value_set = [&](const HloInstruction* instruction) {
+    auto it = value_sets_.find(instruction);
+    if (it == value_sets_.end()) {
+      return;
+    }
+    for (const auto& pair : *it->second) {
+      const HloValueSet& value_set = pair.second;
+      for (const HloValue* value : value_set.values()) {
+        if (value->defining_instruction() == instruction) {
+          value_ids_to_delete.insert(value->id());
+        } else {
+          affected_value_ids.insert(value->id());
+        }
+      }
+    }
+    value_sets_.erase(it);
+  };
+  for (const HloInstruction* instruction : removed) {
+    discard_value_set(instruction);
+    instruction_fingerprints_.erase(instruction);
+  }
+  // Initialize the dirty instructions in post order so that, like in Run,
+  // values are numbered in a deterministic order.
+  std::vector<HloInstruction*> dirty_instructions;
+  dirty_instructions.reserve(dirty.size());
+  for (HloComputation* computation : module_.MakeComputationPostOrder()) {
+    for (HloInstruction* instruction :
+         computation->MakeInstructionPostOrder()) {
+      if (dirty.contains(instruction)) {
+        dirty_instructions.push_back(instruction);
+      }
+    }
+  }
+  const HloValue::Id first_new_value_id = next_value_id_;
+  for (HloInstruction* instruction : dirty_instructions) {
+    discard_value_set(instruction);
+  }
+  for (HloInstruction* instruction : dirty_instructions) {
+    TF_RETURN_IF_ERROR(InitializeInstructionValueSet(instruction));
+  }
+
+  // Phis of clean instructions have been optimized already; they only appear
+  // as inputs of the phis created during this update.
+  phi_graph_ = PhiGraph();
+  Propagate(dirty_instructions);
+  OptimizePhiValues(dirty_instructions, first_new_value_id);
+
+  // Drop deleted values, taking care not to dereference them.
+  value_ids_to_delete.insert(value_ids_to_delete_.begin(),
+                             value_ids_to_delete_.end());
+  values_vector_.erase(
+      std::remove_if(values_vector_.begin(), values_vector_.end(),
+                     [&](const HloValue* value) {
+                       return value_ids_to_delete.contains(value->id());
+                     }),
+      values_vector_.end());
+  DeleteMarkedValues();
+  for (HloValue::Id value_id : value_ids_to_delete) {
+    values_.erase(value_id);
+    affected_value_ids.erase(value_id);
+  }
+  for (HloValue::Id value_id = first_new_value_id; value_id < next_value_id_;
+       ++value_id) {
+    auto it = values_.find(value_id);
+    if (it != values_.end()) {
+      values_vector_.push_back(it->second.get());
+    }
+  }
+
+  // Recompute the positions of all values appearing in dirty instructions, or
+  // which used to.
+  absl::flat_hash_map<HloValue::Id, std::vector<HloPosition>> new_positions;
+  for (HloInstruction* instruction : dirty_instructions) {
+    for (const auto& pair : GetInstructionValueSet(instruction)) {
+      const ShapeIndex& index = pair.first;
+      const HloValueSet& value_set = pair.second;
+      for (const HloValue* value : value_set.values()) {
+        affected_value_ids.insert(value->id());
+        if (value->defining_instruction() != instruction) {
+          new_positions[value->id()].push_back(
+              HloPosition{instruction, index});
+        }
+      }
+    }
+    instruction_fingerprints_[instruction] = {
+        instruction->unique_id(), ComputeInstructionFingerprint(instruction)};
+  }
+  for (HloValue::Id value_id : affected_value_ids) {
+    HloValue& value = GetValue(value_id);
+    std::vector<HloPosition> positions;
+    for (int64_t i = 1; i < value.positions().size(); ++i) {
+      const HloPosition& position = value.positions()[i];
+      if (!dirty.contains(position.instruction) &&
+          !removed.contains(position.instruction)) {
+        positions.push_back(position);
+      }
+    }
+    auto it = new_positions.find(value_id);
+    if (it != new_positions.end()) {
+      positions.insert(positions.end(), it->second.begin(), it->second.end());
+    }
+    value.ResetPositions(positions);
+  }
+  // The users of any instruction may have changed, so cached uses are stale.
+  for (auto& pair : values_) {
+    pair.second->ClearCachedUses();
+  }
+
+  TF_DCHECK_OK(Verify());
+  XLA_VLOG_LINES(2, ToString());
+  return OkStatus();
+}
+
+Status HloDataflowAnalysis::VerifyAgainstFullRecompute() const {
+  TF_ASSIGN_OR_RETURN(
+      std::unique_ptr<HloDataflowAnalysis> expected,
+      Run(module_, ssa_form_, bitcast_defines_value_, can_share_buffer_));
+  TF_RET_CHECK(value_count() == expected->value_count())
+      << "Expected " << expected->value_count() << " values, but have "
+      << value_count();
+
+  // Values are identified by their defining position and phi-ness. Value
+  // sets are ordered by value id, so they have to be sorted to compare.
+  auto value_sets_equal = [](const HloValueSet& a, const HloValueSet& b) {
+    auto definitions = [](const HloValueSet& value_set) {
+      std::vector<std::pair<HloPosition, bool>> definitions;
+      for (const HloValue* value : value_set.values()) {
+        definitions.push_back({value->defining_position(), value->is_phi()});
+      }
+      absl::c_sort(definitions);
+      return definitions;
+    };
+    return definitions(a) == definitions(b);
+  };
+  for (const HloComputation* computation : module_.computations()) {
+    for (HloInstruction* instruction : computation->instructions()) {
+      for (const auto& pair : GetInstructionValueSet(instruction)) {
+        const ShapeIndex& index = pair.first;
+        const HloValueSet& expected_value_set =
+            expected->GetValueSet(instruction, index);
+        TF_RET_CHECK(value_sets_equal(pair.second, expected_value_set))
+            << "Value set at " << HloPosition{instruction, index} << " is "
+            << pair.second << ", but a full recompute gives "
+            << expected_value_set;
+      }
+    }
+  }
+
+  for (const HloValue* expected_value : expected->values()) {
+    const HloValue& value = GetValueDefinedAt(
+        expected_value->defining_instruction(),
+        expected_value->defining_index());
+    std::vector<HloPosition> positions = value.positions();
+    std::vector<HloPosition> expected_positions = expected_value->positions();
+    absl::c_sort(positions);
+    absl::c_sort(expected_positions);
+    TF_RET_CHECK(positions == expected_positions)
+        << "Positions of " << value.ToShortString()
+        << " differ from a full recompute";
+    TF_RET_CHECK(value.live_out_of_module() ==
+                 expected_value->live_out_of_module())
+        << "Liveness of " << value.ToShortString()
+        << " differs from a full recompute";
+  }
+  return OkStatus();
+}
+
 bool HloDataflowAnalysis::DoesNotUseOperandBuffer(
     const HloInstruction* operand, const ShapeIndex& index,
     const HloInstruction* user) const {
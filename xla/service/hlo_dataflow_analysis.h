@@ -24,6 +24,7 @@ limitations under the License.
 #include <iterator>
 #include <memory>
 #include <string>
+#include <utility>
 #include <vector>
 
 #include "absl/container/flat_hash_map.h"
@@ -98,6 +99,27 @@ class HloDataflowAnalysis {
       bool bitcast_defines_value = false,
       const CanShareBuffer& can_share_buffer = nullptr);
 
+  // Updates the analysis to reflect changes made to the module since it was
+  // last run or updated, e.g. instructions being added, removed or replaced,
+  // operands being rewired, fusion, or a new computation root.
+  //
+  // Changed instructions are detected by comparing each instruction against a
+  // fingerprint (operands, called computations, shape and root-ness) recorded
+  // during the previous run. Only the value sets of changed instructions and
+  // of the instructions their values may flow to are recomputed; the rest of
+  // the analysis, including the HloValues defined there, is left untouched.
+  //
+  // HloValues defined at recomputed instructions are replaced by new values
+  // with new ids, so callers must not hold on to HloValue pointers or ids
+  // across an update. The result is otherwise identical to a fresh Run, which
+  // VerifyAgainstFullRecompute can check.
+  Status Update();
+
+  // Runs the analysis from scratch on the module and checks that it agrees
+  // with this (possibly incrementally updated) analysis. Values are matched by
+  // their defining position, as value ids differ between the two.
+  Status VerifyAgainstFullRecompute() const;
+
   // Returns true if 'instruction' defines an HLO value at the given shape index
   // of its output.
   bool ValueIsDefinedAt(const HloInstruction* instruction,
@@ -224,7 +246,11 @@ class HloDataflowAnalysis {
   // Note that this applies in SSA form, and Both of the functions are
   // guaranteed to exit.
   //
-  void OptimizePhiValues();
+  // Only phi values with an id of at least 'first_value_id' defined in the
+  // value sets of 'instructions' are considered; older phi values have
+  // already been optimized by a previous run.
+  void OptimizePhiValues(absl::Span<HloInstruction* const> instructions,
+                         HloValue::Id first_value_id);
 
   // Returns a new HloValue defined at the given instruction and shape index.
   HloValue* NewHloValue(HloInstruction* instruction, const ShapeIndex& index,
@@ -242,6 +268,15 @@ class HloDataflowAnalysis {
   // then propagated throughout the HLO graph by calling Propagate.
   Status InitializeInstructionValueSets();
 
+  // Constructs the InstructionValueSet of the given instruction, defining the
+  // HloValues it defines.
+  Status InitializeInstructionValueSet(HloInstruction* instruction);
+
+  // Returns a fingerprint of the properties of 'instruction' that the
+  // dataflow of the module depends on. Used by Update to detect changes.
+  size_t ComputeInstructionFingerprint(
+      const HloInstruction* instruction) const;
+
   // Updates the value set of the given instruction based on the values flowing
   // into the instruction (operands and cross-computation dataflow).
   bool UpdateInstructionValueSet(HloInstruction* instruction);
@@ -289,8 +324,9 @@ class HloDataflowAnalysis {
 
   // Propagates the dataflow through the module. In particular, it propagates
   // the HloValueSet from its defining instruction to the users of the
-  // instructions.
-  void Propagate();
+  // instructions. Propagation starts from 'instructions', and reaches any other
+  // instruction whose value set changes as a result.
+  void Propagate(absl::Span<HloInstruction* const> instructions);
 
   // Returns the result of the SSA Phi function applied to the given inputs at
   // the given instruction.
@@ -344,6 +380,11 @@ class HloDataflowAnalysis {
   // Backend specific function that decides whether an instruction can share
   // a buffer with its operand.
   CanShareBuffer can_share_buffer_ = nullptr;
+
+  // The unique id and fingerprint of every instruction at the time its value
+  // set was last computed. Used by Update to find changed instructions.
+  absl::flat_hash_map<const HloInstruction*, std::pair<int, size_t>>
+      instruction_fingerprints_;
 };
 
 }  // namespace xla
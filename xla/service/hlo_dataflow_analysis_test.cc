@@ -17,7 +17,9 @@ limitations under the License.
 
 #include <string>
 
+#include "xla/hlo/ir/hlo_casting_utils.h"
 #include "xla/hlo/ir/hlo_computation.h"
+#include "xla/hlo/ir/hlo_instructions.h"
 #include "xla/hlo/ir/hlo_opcode.h"
 #include "xla/literal.h"
 #include "xla/service/async_op_canonicalizer.h"
@@ -2058,6 +2060,145 @@ TEST_F(HloDataflowAnalysisTest, AllReduceStartAndDoneTwoOperands) {
               UnorderedElementsAre(HloUse{done, 0, {}}));
 }
 
+TEST_P(HloDataflowAnalysisTest, IncrementalUpdate) {
+  // Mutate a module with a while loop in ways passes commonly do and check
+  // that the incrementally updated analysis matches a full recompute.
+  const char* const hlo_text = R"(
+HloModule IncrementalUpdate
+
+body {
+  p = (f32[], f32[]) parameter(0)
+  gte0 = f32[] get-tuple-element(p), index=0
+  gte1 = f32[] get-tuple-element(p), index=1
+  add = f32[] add(gte0, gte1)
+  ROOT tuple = (f32[], f32[]) tuple(add, gte1)
+}
+
+condition {
+  p = (f32[], f32[]) parameter(0)
+  ROOT c = pred[] constant(false)
+}
+
+ENTRY entry {
+  p0 = f32[] parameter(0)
+  p1 = f32[] parameter(1)
+  neg = f32[] negate(p0)
+  tuple = (f32[], f32[]) tuple(neg, p1)
+  while = (f32[], f32[]) while(tuple), condition=condition, body=body
+  gte = f32[] get-tuple-element(while), index=0
+  ROOT exp = f32[] exponential(gte)
+}
+)";
+  TF_ASSERT_OK_AND_ASSIGN(module_, ParseAndReturnVerifiedModule(hlo_text));
+  bool ssa_form = GetParam();
+  RunAnalysis(ssa_form);
+
+  HloComputation* entry = module_->entry_computation();
+  HloComputation* body = module_->GetComputationWithName("body");
+  HloInstruction* p0 = entry->GetInstructionWithName("p0");
+  HloInstruction* p1 = entry->GetInstructionWithName("p1");
+  const HloValue* p0_value = &analysis_->GetValueDefinedAt(p0);
+  const HloValue* p1_value = &analysis_->GetValueDefinedAt(p1);
+
+  // Replace an instruction inside the loop body.
+  HloInstruction* add = body->GetInstructionWithName("add");
+  HloInstruction* mul = body->AddInstruction(HloInstruction::CreateBinary(
+      scalar_shape_, HloOpcode::kMultiply, add->mutable_operand(0),
+      add->mutable_operand(1)));
+  TF_ASSERT_OK(body->ReplaceInstruction(add, mul));
+  TF_ASSERT_OK(analysis_->Update());
+  TF_EXPECT_OK(analysis_->VerifyAgainstFullRecompute());
+  EXPECT_TRUE(analysis_->ValueIsDefinedAt(mul));
+  // Values defined outside of the affected region are preserved.
+  EXPECT_EQ(&analysis_->GetValueDefinedAt(p0), p0_value);
+  EXPECT_EQ(&analysis_->GetValueDefinedAt(p1), p1_value);
+
+  // Replace the instruction feeding the loop.
+  HloInstruction* neg = entry->GetInstructionWithName("neg");
+  HloInstruction* abs = entry->AddInstruction(
+      HloInstruction::CreateUnary(scalar_shape_, HloOpcode::kAbs, p0));
+  TF_ASSERT_OK(entry->ReplaceInstruction(neg, abs));
+  TF_ASSERT_OK(analysis_->Update());
+  TF_EXPECT_OK(analysis_->VerifyAgainstFullRecompute());
+  EXPECT_THAT(analysis_->GetValueDefinedAt(p0).GetUses(),
+              ElementsAre(HloUse{abs, 0, {}}));
+
+  // Fuse the root, which adds a computation and changes the entry root.
+  HloInstruction* exp = entry->GetInstructionWithName("exp");
+  HloInstruction* fusion = entry->CreateFusionInstruction(
+      {exp}, HloInstruction::FusionKind::kLoop);
+  TF_ASSERT_OK(analysis_->Update());
+  TF_EXPECT_OK(analysis_->VerifyAgainstFullRecompute());
+  EXPECT_TRUE(analysis_->ValueIsDefinedAt(fusion));
+  EXPECT_TRUE(analysis_->GetValueDefinedAt(fusion).live_out_of_module());
+
+  // Updating an unchanged module is a no-op.
+  const int64_t value_count = analysis_->value_count();
+  TF_ASSERT_OK(analysis_->Update());
+  EXPECT_EQ(analysis_->value_count(), value_count);
+  EXPECT_EQ(&analysis_->GetValueDefinedAt(p1), p1_value);
+}
+
+TEST_P(HloDataflowAnalysisTest, IncrementalUpdateAfterTupleSimplification) {
+  const char* const hlo_text = R"(
+HloModule IncrementalUpdateAfterTupleSimplification
+
+ENTRY entry {
+  p0 = f32[] parameter(0)
+  p1 = f32[] parameter(1)
+  tuple = (f32[], f32[]) tuple(p0, p1)
+  gte0 = f32[] get-tuple-element(tuple), index=0
+  gte1 = f32[] get-tuple-element(tuple), index=1
+  ROOT add = f32[] add(gte0, gte1)
+}
+)";
+  TF_ASSERT_OK_AND_ASSIGN(module_, ParseAndReturnVerifiedModule(hlo_text));
+  bool ssa_form = GetParam();
+  RunAnalysis(ssa_form);
+
+  HloComputation* entry = module_->entry_computation();
+  HloInstruction* tuple = entry->GetInstructionWithName("tuple");
+  for (const char* name : {"gte0", "gte1"}) {
+    HloInstruction* gte = entry->GetInstructionWithName(name);
+    TF_ASSERT_OK(entry->ReplaceInstruction(
+        gte, tuple->mutable_operand(gte->tuple_index())));
+  }
+  TF_ASSERT_OK(analysis_->Update());
+  TF_EXPECT_OK(analysis_->VerifyAgainstFullRecompute());
+
+  HloInstruction* add = entry->root_instruction();
+  EXPECT_THAT(analysis_->GetValueDefinedAt(add->operand(0)).GetUses(),
+              ElementsAre(HloUse{add, 0, {}}));
+  EXPECT_THAT(analysis_->GetValueDefinedAt(add->operand(1)).GetUses(),
+              ElementsAre(HloUse{add, 1, {}}));
+}
+
+TEST_P(HloDataflowAnalysisTest, IncrementalUpdateAfterTupleIndexChange) {
+  const char* const hlo_text = R"(
+HloModule IncrementalUpdateAfterTupleIndexChange
+
+ENTRY entry {
+  p0 = f32[] parameter(0)
+  p1 = f32[] parameter(1)
+  tuple = (f32[], f32[]) tuple(p0, p1)
+  ROOT gte = f32[] get-tuple-element(tuple), index=0
+}
+)";
+  TF_ASSERT_OK_AND_ASSIGN(module_, ParseAndReturnVerifiedModule(hlo_text));
+  bool ssa_form = GetParam();
+  RunAnalysis(ssa_form);
+
+  // Only the index of the GTE changes, not its operands or shape.
+  HloComputation* entry = module_->entry_computation();
+  HloInstruction* gte = entry->root_instruction();
+  Cast<HloGetTupleElementInstruction>(gte)->set_tuple_index(1);
+  TF_ASSERT_OK(analysis_->Update());
+  TF_EXPECT_OK(analysis_->VerifyAgainstFullRecompute());
+  EXPECT_EQ(analysis_->GetUniqueValueAt(gte),
+            analysis_->GetValueDefinedAt(
+                entry->GetInstructionWithName("p1")));
+}
+
 INSTANTIATE_TEST_SUITE_P(HloDataflowAnalysisInstantiation,
                          HloDataflowAnalysisTest,
                          ::testing::Values(false, true));
@@ -234,6 +234,53 @@ TEST_F(HloInstructionTest, RepeatedUser) {
   EXPECT_EQ(2, add->operand_count());
 }
 
+TEST_F(HloInstructionTest, ManyUsers) {
+  // Grow the number of users of a parameter well past the point where the
+  // instruction starts indexing its users, then shrink it again, checking that
+  // user queries stay consistent throughout.
+  constexpr int kNumUsers = 64;
+  HloComputation::Builder builder(TestName());
+  auto foo =
+      builder.AddInstruction(HloInstruction::CreateParameter(0, r0f32_, "foo"));
+  std::vector<HloInstruction*> negs;
+  for (int i = 0; i < kNumUsers; ++i) {
+    negs.push_back(builder.AddInstruction(
+        HloInstruction::CreateUnary(r0f32_, HloOpcode::kNegate, foo)));
+  }
+  builder.AddInstruction(HloInstruction::CreateTuple(negs));
+  auto module = CreateNewVerifiedModule();
+  auto* computation = module->AddEntryComputation(builder.Build());
+
+  EXPECT_EQ(kNumUsers, foo->user_count());
+  for (HloInstruction* neg : negs) {
+    EXPECT_TRUE(neg->IsUserOf(foo));
+    EXPECT_EQ(foo->users()[foo->UserId(neg)], neg);
+  }
+
+  auto bar = computation->AddInstruction(
+      HloInstruction::CreateConstant(LiteralUtil::CreateR0<float>(1.0f)));
+  for (int i = 0; i < kNumUsers; ++i) {
+    HloInstruction* neg = negs[i];
+    ASSERT_IS_OK(foo->ReplaceUseWith(neg, bar));
+    EXPECT_FALSE(neg->IsUserOf(foo));
+    EXPECT_TRUE(neg->IsUserOf(bar));
+    EXPECT_EQ(kNumUsers - i - 1, foo->user_count());
+    for (HloInstruction* user : foo->users()) {
+      EXPECT_TRUE(user->IsUserOf(foo));
+      EXPECT_EQ(foo->users()[foo->UserId(user)], user);
+    }
+  }
+  EXPECT_EQ(kNumUsers, bar->user_count());
+
+  ASSERT_IS_OK(bar->ReplaceAllUsesWith(foo));
+  EXPECT_EQ(0, bar->user_count());
+  EXPECT_EQ(kNumUsers, foo->user_count());
+  for (HloInstruction* neg : negs) {
+    EXPECT_TRUE(neg->IsUserOf(foo));
+    EXPECT_FALSE(neg->IsUserOf(bar));
+  }
+}
+
 TEST_F(HloInstructionTest, MultipleUsersAndOperands) {
   //        [param0]          [param1]
   //           |                 |
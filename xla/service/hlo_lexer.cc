@@ -373,14 +373,21 @@ TokKind HloLexer::LexPercent() {
 // int ::=  [-]?[0-9]+
 // negative inf ::= '-inf'
 TokKind HloLexer::LexNumberOrPattern() {
+  // Large constants consist almost entirely of plain numbers, so try to lex
+  // those by hand before falling back to the regexes below.
+  if (std::optional<TokKind> kind = TryLexPlainNumber()) {
+    return *kind;
+  }
+
   absl::string_view consumable = StringViewFromPointers(
       token_state_.token_start, buf_.data() + buf_.size());
   static LazyRE2 float_pattern = {
       R"([-]?((\d+|\d+[.]\d*|\d*[.]\d+)([eE][+-]?\d+))|[-]?(\d+[.]\d*|\d*[.]\d+))"};
   if (RE2::Consume(&consumable, *float_pattern)) {
     current_ptr_ = consumable.data();
-    CHECK(absl::SimpleAtod(std::string(token_state_.token_start, current_ptr_),
-                           &token_state_.decimal_val));
+    CHECK(absl::SimpleAtod(
+        StringViewFromPointers(token_state_.token_start, current_ptr_),
+        &token_state_.decimal_val));
     return TokKind::kDecimal;
   }
 
@@ -411,17 +418,8 @@ TokKind HloLexer::LexNumberOrPattern() {
   static LazyRE2 int_pattern = {R"([-]?\d+)"};
   if (RE2::Consume(&consumable, *int_pattern)) {
     current_ptr_ = consumable.data();
-    auto slice = StringViewFromPointers(token_state_.token_start, current_ptr_);
-    if (absl::SimpleAtoi(slice, &token_state_.int64_val)) {
-      return TokKind::kInt;
-    }
-    uint64_t uint64_val;
-    if (absl::SimpleAtoi(slice, &uint64_val)) {
-      token_state_.int64_val = absl::bit_cast<int64_t>(uint64_val);
-      return TokKind::kInt;
-    }
-    LOG(ERROR) << "Failed to parse int literal: " << slice;
-    return TokKind::kError;
+    return LexInt(
+        StringViewFromPointers(token_state_.token_start, current_ptr_));
   }
 
   static LazyRE2 neg_inf = {"-inf"};
@@ -449,6 +447,75 @@ TokKind HloLexer::LexNumberOrPattern() {
   return TokKind::kError;
 }
 
+// Accepts exactly the tokens that float_pattern and int_pattern in
+// LexNumberOrPattern accept, provided that they are not followed by a
+// character that could make them the prefix of a dim-labels, dxd or pad
+// pattern.
+std::optional<TokKind> HloLexer::TryLexPlainNumber() {
+  const char* const end = buf_.data() + buf_.size();
+  const char* ptr = token_state_.token_start;
+  auto skip_digits = [&] {
+    const char* start = ptr;
+    while (ptr < end && absl::ascii_isdigit(static_cast<unsigned char>(*ptr))) {
+      ++ptr;
+    }
+    return ptr != start;
+  };
+
+  if (ptr < end && *ptr == '-') {
+    ++ptr;
+  }
+  bool has_digits = skip_digits();
+  bool is_decimal = false;
+  if (ptr < end && *ptr == '.') {
+    ++ptr;
+    is_decimal = true;
+    has_digits |= skip_digits();
+  }
+  if (!has_digits) {
+    return std::nullopt;
+  }
+  if (ptr < end && (*ptr == 'e' || *ptr == 'E')) {
+    ++ptr;
+    if (ptr < end && (*ptr == '+' || *ptr == '-')) {
+      ++ptr;
+    }
+    if (!skip_digits()) {
+      return std::nullopt;
+    }
+    is_decimal = true;
+  }
+  if (ptr < end) {
+    const unsigned char next = static_cast<unsigned char>(*ptr);
+    if (absl::ascii_isalnum(next) || next == '_' || next == '.' ||
+        next == '-' || next == '?') {
+      return std::nullopt;
+    }
+  }
+
+  current_ptr_ = ptr;
+  absl::string_view slice =
+      StringViewFromPointers(token_state_.token_start, current_ptr_);
+  if (is_decimal) {
+    CHECK(absl::SimpleAtod(slice, &token_state_.decimal_val));
+    return TokKind::kDecimal;
+  }
+  return LexInt(slice);
+}
+
+TokKind HloLexer::LexInt(absl::string_view slice) {
+  if (absl::SimpleAtoi(slice, &token_state_.int64_val)) {
+    return TokKind::kInt;
+  }
+  uint64_t uint64_val;
+  if (absl::SimpleAtoi(slice, &uint64_val)) {
+    token_state_.int64_val = absl::bit_cast<int64_t>(uint64_val);
+    return TokKind::kInt;
+  }
+  LOG(ERROR) << "Failed to parse int literal: " << slice;
+  return TokKind::kError;
+}
+
 std::pair<unsigned, unsigned> HloLexer::GetLineAndColumn(LocTy location) const {
   unsigned line_no = 1;
   const char* start = buf_.data();
@@ -164,6 +164,16 @@ class HloLexer {
   TokKind LexNumberOrPattern();
   TokKind LexString();
 
+  // Lexes a plain integer or decimal number starting at the current token
+  // without going through the regex matchers. Returns nullopt if the token may
+  // be something other than a plain number, e.g. a dim-labels or padding
+  // pattern.
+  std::optional<TokKind> TryLexPlainNumber();
+
+  // Sets the int64 value of the current token from `slice`, which must consist
+  // of an optional minus sign followed by decimal digits.
+  TokKind LexInt(absl::string_view slice);
+
   std::optional<int64_t> LexNanPayload(absl::string_view& consumable);
 
   absl::string_view buf_;
@@ -16,6 +16,7 @@ limitations under the License.
 #include "xla/service/hlo_memory_scheduler.h"
 
 #include <algorithm>
+#include <iterator>
 #include <limits>
 #include <map>
 #include <queue>
@@ -36,14 +37,35 @@ limitations under the License.
 #include "xla/types.h"
 #include "xla/util.h"
 #include "tsl/lib/gtl/map_util.h"
+#include "tsl/lib/monitoring/sampler.h"
+#include "tsl/platform/env.h"
 #include "tsl/platform/errors.h"
 #include "tsl/platform/logging.h"
+#include "tsl/platform/threadpool.h"
 
 namespace xla {
 namespace {
 
 using ::tsl::strings::HumanReadableNumBytes;
 
+auto* memory_scheduler_time_usecs = tsl::monitoring::Sampler<0>::New(
+    {"/xla/service/memory_scheduler/schedule_time_usecs",
+     "The wall-clock time spent on computing memory minimizing schedules of "
+     "modules in microseconds."},
+    // These exponential buckets cover the following range:
+    // Minimum: 100 us
+    // Maximum: 100 us * 2 ^ 24 == ~28 minutes
+    {tsl::monitoring::Buckets::Exponential(100, 2, 25)});
+
+auto* memory_scheduler_peak_memory_bytes = tsl::monitoring::Sampler<0>::New(
+    {"/xla/service/memory_scheduler/peak_memory_bytes",
+     "The peak memory of the chosen schedules of modules according to the "
+     "heap simulator, in bytes."},
+    // These exponential buckets cover the following range:
+    // Minimum: 1 KiB
+    // Maximum: 1 KiB * 2 ^ 32 == 4 TiB
+    {tsl::monitoring::Buckets::Exponential(1024, 2, 33)});
+
 // Class implementing a list scheduler of HLO instructions which produces a
 // sequence which minimizes memory usage by preferring to schedule the node that
 // frees bigger buffer and defines smaller outputs.
@@ -73,6 +95,11 @@ using ::tsl::strings::HumanReadableNumBytes;
 //   A B C D E F G
 // , which has a maximum memory usage of 5 (when F is executing).
 //
+// In lookahead mode, the scheduler tracks the bytes that are live after each
+// scheduled instruction and picks among the few instructions with the highest
+// priority: it credits each with the bytes freed by a user that it makes
+// ready, and charges it with the bytes by which it raises the peak of the live
+// bytes so far.
 class ListScheduler {
  public:
   // Construct and return a memory-minimizing sequence of HLO instructions
@@ -82,9 +109,10 @@ class ListScheduler {
       const TuplePointsToAnalysis& points_to_analysis,
       const BufferValue::SizeFunction& size_function,
       const absl::flat_hash_map<const HloComputation*, int64_t>&
-          memory_by_computation) {
+          memory_by_computation,
+      bool lookahead = false) {
     ListScheduler scheduler(computation, points_to_analysis, size_function,
-                            memory_by_computation);
+                            memory_by_computation, lookahead);
     return scheduler.CreateSchedule();
   }
 
@@ -103,15 +131,21 @@ class ListScheduler {
   // comparison operators.
   using Priority = std::pair<int64_t, int64_t>;
 
+  // Number of ready instructions with the highest priority that lookahead
+  // mode chooses from.
+  static constexpr int64_t kLookaheadWidth = 8;
+
   ListScheduler(HloComputation* computation,
                 const TuplePointsToAnalysis& points_to_analysis,
                 const BufferValue::SizeFunction& size_function,
                 const absl::flat_hash_map<const HloComputation*, int64_t>&
-                    memory_by_computation)
+                    memory_by_computation,
+                bool lookahead)
       : computation_(computation),
         points_to_analysis_(points_to_analysis),
         size_function_(size_function),
-        memory_by_computation_(memory_by_computation) {
+        memory_by_computation_(memory_by_computation),
+        lookahead_(lookahead) {
     // Create a map containing the LogicalBuffer uses for each HLO
     // instruction. An HLO instruction "uses" a LogicalBuffer if the
     // LogicalBuffer is in an operand of the instruction as indicated by
@@ -232,6 +266,14 @@ class ListScheduler {
         freed_bytes += size_function_(*buffer);
       }
     }
+    return freed_bytes - BytesDefinedIfScheduled(entry);
+  }
+
+  // Returns the number of bytes that the HLO instruction defines, counting
+  // the memory used by the largest of its subcomputations.
+  int64_t BytesDefinedIfScheduled(const ReadyListEntry& entry) {
+    auto instruction = entry.instruction;
+    auto opcode = instruction->opcode();
     // We only count the memory usage of the largest subcomputation, instead of
     // adding them all, because subcomputations won't execute in parallel.
     int64_t max_subcomputation_bytes = 0;
@@ -244,17 +286,48 @@ class ListScheduler {
         }
       }
     }
-    int64_t bytes_defined;
     if (max_subcomputation_bytes > 0 &&
         (opcode == HloOpcode::kWhile || opcode == HloOpcode::kCall ||
          opcode == HloOpcode::kConditional)) {
       // The output buffer of while/call/conditional is always aliased with the
       // output buffer of the root instruction in the body. Don't double count.
-      bytes_defined = max_subcomputation_bytes;
-    } else {
-      bytes_defined = entry.bytes_defined + max_subcomputation_bytes;
+      return max_subcomputation_bytes;
     }
-    return freed_bytes - bytes_defined;
+    return entry.bytes_defined + max_subcomputation_bytes;
+  }
+
+  // Returns the largest number of bytes freed, net of the bytes it defines, by
+  // one of the users that become ready once `entry` is scheduled, or 0 if none
+  // of them frees more bytes than it defines.
+  int64_t BytesFreedByReadiedUser(
+      const ReadyListEntry& entry,
+      const absl::flat_hash_map<const HloInstruction*, int64_t>&
+          unscheduled_pred_count) {
+    absl::flat_hash_set<const LogicalBuffer*> used_by_entry;
+    for (const auto& kv : entry.used_buffer_unscheduled_use_counts) {
+      used_by_entry.insert(kv->first);
+    }
+    int64_t max_freed_bytes = 0;
+    for (HloInstruction* user : entry.instruction->users()) {
+      if (unscheduled_pred_count.at(user) != 1) {
+        continue;
+      }
+      ReadyListEntry user_entry = MakeReadyListEntry(user);
+      int64_t freed_bytes = 0;
+      for (const auto& kv : user_entry.used_buffer_unscheduled_use_counts) {
+        int64_t use_count = kv->second;
+        if (used_by_entry.contains(kv->first)) {
+          --use_count;
+        }
+        if (use_count == 1) {
+          freed_bytes += size_function_(*kv->first);
+        }
+      }
+      max_freed_bytes =
+          std::max(max_freed_bytes,
+                   freed_bytes - BytesDefinedIfScheduled(user_entry));
+    }
+    return max_freed_bytes;
   }
 
   // Constructs the scheduling priority of the given instruction.
@@ -269,6 +342,63 @@ class ListScheduler {
     return {BytesFreedIfScheduled(entry), entry.instruction->user_count()};
   }
 
+  // Returns the entry to schedule among the kLookaheadWidth entries with the
+  // highest priority in `ready_queue`: the one with the most bytes freed,
+  // including the bytes freed by a user that it makes ready, minus the bytes
+  // by which it raises the peak of the live bytes. Ties go to the entry with
+  // the highest priority.
+  std::multimap<Priority, ReadyListEntry>::iterator SelectWithLookahead(
+      std::multimap<Priority, ReadyListEntry>& ready_queue,
+      const absl::flat_hash_map<const HloInstruction*, int64_t>&
+          unscheduled_pred_count) {
+    auto best_it = std::prev(ready_queue.end());
+    // Scalars and outfeeds are scheduled as early as their priority asks for,
+    // and infeeds are only picked if nothing else is ready.
+    if (best_it->first.first == std::numeric_limits<int64_t>::max() ||
+        best_it->first.first == INT_MAX) {
+      return best_it;
+    }
+    int64_t best_score = std::numeric_limits<int64_t>::min();
+    auto it = ready_queue.end();
+    for (int64_t i = 0; i < kLookaheadWidth && it != ready_queue.begin(); ++i) {
+      --it;
+      const ReadyListEntry& entry = it->second;
+      int64_t freed_bytes = BytesFreedIfScheduled(entry);
+      if (freed_bytes == INT_MIN) {
+        continue;
+      }
+      freed_bytes += BytesFreedByReadiedUser(entry, unscheduled_pred_count);
+      int64_t peak_increase = std::max<int64_t>(
+          0, live_bytes_ + BytesDefinedIfScheduled(entry) - peak_bytes_);
+      if (freed_bytes - peak_increase > best_score) {
+        best_it = it;
+        best_score = freed_bytes - peak_increase;
+      }
+    }
+    return best_it;
+  }
+
+  // Updates the live bytes and their peak for scheduling `entry`, before the
+  // unscheduled use counts of its operands are decremented.
+  void TrackLiveBytes(const ReadyListEntry& entry) {
+    peak_bytes_ =
+        std::max(peak_bytes_, live_bytes_ + BytesDefinedIfScheduled(entry));
+    live_bytes_ += entry.bytes_defined;
+    for (const auto& kv : entry.used_buffer_unscheduled_use_counts) {
+      if (kv->second == 1) {
+        live_bytes_ -= size_function_(*kv->first);
+      }
+    }
+    // Buffers without uses die right away.
+    for (const LogicalBuffer* buffer :
+         points_to_analysis_.GetBuffersDefinedByInstruction(
+             entry.instruction)) {
+      if (!IgnoreBuffer(*buffer) && unscheduled_use_count_.at(buffer) == 0) {
+        live_bytes_ -= size_function_(*buffer);
+      }
+    }
+  }
+
   HloInstructionSequence CreateSchedule() {
     HloInstructionSequence schedule;
 
@@ -312,6 +442,10 @@ class ListScheduler {
       // schedule.
       auto best_it = ready_queue.end();
       --best_it;
+      if (lookahead_) {
+        best_it = SelectWithLookahead(ready_queue, unscheduled_pred_count);
+        TrackLiveBytes(best_it->second);
+      }
       HloInstruction* best = best_it->second.instruction;
       VLOG(2) << "Schedule instruction: " << best->ToShortString()
               << " Bytes freed: " << best_it->first.first;
@@ -398,6 +532,14 @@ class ListScheduler {
 
   // Set of instructions which have been scheduled.
   absl::flat_hash_set<const HloInstruction*> scheduled_instructions_;
+
+  // Whether to pick the next instruction with SelectWithLookahead.
+  const bool lookahead_;
+  // Bytes of the buffers defined by the scheduled instructions that still have
+  // unscheduled uses, and the peak of the bytes live during the schedule so
+  // far. Only tracked in lookahead mode.
+  int64_t live_bytes_ = 0;
+  int64_t peak_bytes_ = 0;
 };
 
 int64_t SumLogicalBufferSizes(
@@ -578,6 +720,30 @@ StatusOr<HloInstructionSequence> ListMemoryScheduler(
   return sequence;
 }
 
+StatusOr<HloInstructionSequence> LookaheadListMemoryScheduler(
+    HloComputation* computation,
+    const TuplePointsToAnalysis& points_to_analysis,
+    const HloAliasAnalysis& alias_analysis,
+    const BufferValue::SizeFunction& size_function,
+    const absl::flat_hash_map<const HloComputation*, int64_t>&
+        memory_by_computation,
+    const MemorySchedulerPostprocessor& postprocessor, int64_t* peak_memory) {
+  TF_ASSIGN_OR_RETURN(
+      HloInstructionSequence sequence,
+      ListScheduler::Run(computation, points_to_analysis, size_function,
+                         memory_by_computation, /*lookahead=*/true));
+  if (postprocessor) {
+    sequence = postprocessor(sequence);
+  }
+  if (peak_memory) {
+    TF_ASSIGN_OR_RETURN(
+        *peak_memory, HeapSimulator::MinimumMemoryForComputation(
+                          *computation, sequence, alias_analysis, size_function,
+                          &memory_by_computation));
+  }
+  return sequence;
+}
+
 StatusOr<HloInstructionSequence> PostOrderMemoryScheduler(
     HloComputation* computation,
     const TuplePointsToAnalysis& points_to_analysis,
@@ -720,11 +886,72 @@ StatusOr<HloSchedule> DefaultModuleScheduler(
   }
 }
 
+ModuleSchedulerAlgorithm ConcurrentModuleScheduler(int64_t num_threads) {
+  return [num_threads](
+             const HloModule* module,
+             const TuplePointsToAnalysis& points_to_analysis,
+             const HloAliasAnalysis& alias_analysis,
+             const LogicalBuffer::SizeFunction& size_function,
+             const absl::flat_hash_set<absl::string_view>& execution_threads,
+             int64_t* peak_memory) -> StatusOr<HloSchedule> {
+    // The candidates in the order of preference among schedules with the same
+    // peak memory.
+    struct Candidate {
+      absl::string_view name;
+      MemorySchedulerAlgorithm algorithm;
+    };
+    const std::vector<Candidate> candidates = {
+        {"list", ListMemoryScheduler},
+        {"lookahead list", LookaheadListMemoryScheduler},
+        {"dfs", DFSMemoryScheduler},
+        {"post order", PostOrderMemoryScheduler}};
+    std::vector<StatusOr<HloSchedule>> schedules(
+        candidates.size(), InternalError("Candidate was not scheduled"));
+    std::vector<int64_t> memories(candidates.size());
+    auto run_candidate = [&](int64_t i) {
+      schedules[i] = ComputationSchedulerToModuleScheduler(
+          candidates[i].algorithm)(module, points_to_analysis, alias_analysis,
+                                   size_function, execution_threads,
+                                   &memories[i]);
+    };
+    if (num_threads > 1) {
+      // The thread pool destructor waits for all scheduled work to complete.
+      tsl::thread::ThreadPool thread_pool(
+          tsl::Env::Default(), "memory_scheduler",
+          std::min<int64_t>(num_threads, candidates.size()));
+      for (int64_t i = 0; i < candidates.size(); ++i) {
+        thread_pool.Schedule([&run_candidate, i] { run_candidate(i); });
+      }
+    } else {
+      for (int64_t i = 0; i < candidates.size(); ++i) {
+        run_candidate(i);
+      }
+    }
+
+    int64_t best = -1;
+    for (int64_t i = 0; i < candidates.size(); ++i) {
+      TF_RETURN_IF_ERROR(schedules[i].status());
+      VLOG(2) << "Min-memory " << candidates[i].name
+              << " sequence: " << HumanReadableNumBytes(memories[i]);
+      if (best < 0 || memories[i] < memories[best]) {
+        best = i;
+      }
+    }
+    VLOG(2) << "Chose min-memory " << candidates[best].name
+            << " sequence: " << HumanReadableNumBytes(memories[best]);
+    if (peak_memory) {
+      *peak_memory = memories[best];
+    }
+    return std::move(schedules[best]);
+  };
+}
+
 StatusOr<HloSchedule> ScheduleModule(
     const HloModule* module, const BufferValue::SizeFunction& size_function,
     const ModuleSchedulerAlgorithm& algorithm,
     const absl::flat_hash_set<absl::string_view>& execution_threads,
     int64_t* peak_memory) {
+  const uint64_t start_usecs = tsl::Env::Default()->NowMicros();
   TF_ASSIGN_OR_RETURN(std::unique_ptr<TuplePointsToAnalysis> points_to_analysis,
                       TuplePointsToAnalysis::Run(module));
   TF_ASSIGN_OR_RETURN(std::unique_ptr<HloAliasAnalysis> alias_analysis,
@@ -737,6 +964,9 @@ StatusOr<HloSchedule> ScheduleModule(
 
   TF_RETURN_IF_ERROR(schedule.Verify());
 
+  static auto* schedule_time_cell = memory_scheduler_time_usecs->GetCell();
+  schedule_time_cell->Add(tsl::Env::Default()->NowMicros() - start_usecs);
+
   return std::move(schedule);
 }
 
@@ -757,15 +987,26 @@ StatusOr<HloInstructionSequence> ScheduleComputation(
 
 HloMemoryScheduler::HloMemoryScheduler(
     const BufferValue::SizeFunction& size_function,
-    const ModuleSchedulerAlgorithm& algorithm)
-    : size_function_(size_function), algorithm_(algorithm) {}
+    const ModuleSchedulerAlgorithm& algorithm, bool record_peak_memory)
+    : size_function_(size_function),
+      algorithm_(algorithm),
+      record_peak_memory_(record_peak_memory) {}
 
 StatusOr<bool> HloMemoryScheduler::Run(
     HloModule* module,
     const absl::flat_hash_set<absl::string_view>& execution_threads) {
+  int64_t peak_memory = 0;
   TF_ASSIGN_OR_RETURN(
       HloSchedule schedule,
-      ScheduleModule(module, size_function_, algorithm_, execution_threads));
+      ScheduleModule(module, size_function_, algorithm_, execution_threads,
+                     record_peak_memory_ ? &peak_memory : nullptr));
+  if (record_peak_memory_) {
+    static auto* peak_memory_cell =
+        memory_scheduler_peak_memory_bytes->GetCell();
+    peak_memory_cell->Add(peak_memory);
+    VLOG(1) << "Peak memory of the " << module->name()
+            << " schedule: " << HumanReadableNumBytes(peak_memory);
+  }
   TF_RETURN_IF_ERROR(module->set_schedule(std::move(schedule)));
   return true;
 }
@@ -77,6 +77,19 @@ StatusOr<HloInstructionSequence> ListMemoryScheduler(
         memory_by_computation,
     const MemorySchedulerPostprocessor& postprocessor, int64_t* peak_memory);
 
+// List scheduler that tracks the live bytes as it schedules. Among the ready
+// instructions with the highest priority, it picks the one that frees the most
+// bytes, looking ahead at the bytes freed by the users that it makes ready,
+// net of the bytes by which it raises the peak of the live bytes.
+StatusOr<HloInstructionSequence> LookaheadListMemoryScheduler(
+    HloComputation* computation,
+    const TuplePointsToAnalysis& points_to_analysis,
+    const HloAliasAnalysis& alias_analysis,
+    const LogicalBuffer::SizeFunction& size_function,
+    const absl::flat_hash_map<const HloComputation*, int64_t>&
+        memory_by_computation,
+    const MemorySchedulerPostprocessor& postprocessor, int64_t* peak_memory);
+
 // DFS-order scheduler
 StatusOr<HloInstructionSequence> DFSMemoryScheduler(
     HloComputation* computation,
@@ -117,10 +130,18 @@ StatusOr<HloSchedule> DefaultModuleScheduler(
     const absl::flat_hash_set<absl::string_view>& execution_threads,
     int64_t* peak_memory);
 
+// Returns a module scheduler that schedules the module with the list, lookahead
+// list, DFS and post-order schedulers on up to num_threads threads, and
+// chooses whichever returns a lower min-memory according to the HeapSimulator.
+// Meant for large modules, where each of the simulations is expensive. The
+// size function passed to the scheduler must be thread-safe.
+ModuleSchedulerAlgorithm ConcurrentModuleScheduler(int64_t num_threads);
+
 // Returns an HloSchedule which seeks to minimize the memory required for the
 // module. size_function is the function returning the number of bytes required
 // for a LogicalBuffer. peak_memory (if not nullptr) is set to the largest peak
 // memory (according to the HeapSimulator) of all computations in the module.
+// The scheduling time is recorded in the compile metrics.
 StatusOr<HloSchedule> ScheduleModule(
     const HloModule* module, const LogicalBuffer::SizeFunction& size_function,
     const ModuleSchedulerAlgorithm& algorithm = {},
@@ -141,9 +162,13 @@ class HloMemoryScheduler : public HloModulePass {
  public:
   // size_function is the function returning the number of bytes required for a
   // LogicalBuffer. algorithm is the memory scheduling algorithm to use. If not
-  // specified, then DefaultMemoryScheduler is used.
+  // specified, then DefaultMemoryScheduler is used. If record_peak_memory is
+  // true, the peak memory of the schedule is recorded in the compile metrics
+  // and logged at VLOG(1). It is off by default, since algorithms that do not
+  // simulate their schedules anyway need an extra heap simulation for it.
   HloMemoryScheduler(const LogicalBuffer::SizeFunction& size_function,
-                     const ModuleSchedulerAlgorithm& algorithm = {});
+                     const ModuleSchedulerAlgorithm& algorithm = {},
+                     bool record_peak_memory = false);
 
   ~HloMemoryScheduler() override = default;
 
@@ -158,6 +183,8 @@ class HloMemoryScheduler : public HloModulePass {
   LogicalBuffer::SizeFunction size_function_;
 
   ModuleSchedulerAlgorithm algorithm_;
+
+  bool record_peak_memory_;
 };
 
 // A pass which produces a naive, but correct schedule. The schedule is produced
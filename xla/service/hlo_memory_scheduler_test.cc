@@ -15,6 +15,8 @@ limitations under the License.
 
 #include "xla/service/hlo_memory_scheduler.h"
 
+#include <algorithm>
+#include <limits>
 #include <memory>
 #include <string>
 
@@ -172,6 +174,159 @@ ENTRY root {
             peak_memory);
 }
 
+TEST_F(HloSchedulingTest, LookaheadListSchedulerHandlesAliasing) {
+  const char* module_str = R"(
+HloModule test_aliasing_module
+
+ENTRY root {
+  param = s32[1000] parameter(0)
+  p0 = s32[1000] copy(param)
+  p1 = s32[1000] copy(param)
+  t = (s32[1000], s32[1000]) tuple(p0, p1)
+  a = s32[1000] get-tuple-element(t), index=0
+  b = s32[1000] get-tuple-element(t), index=1
+  c = s32[1000] add(a, b)
+  d = s32[1000] add(c, b)
+  e = s32[1000] add(c, c)
+  f = s32[1000] add(e, e)
+  ROOT result = (s32[1000], s32[1000], s32[1000]) tuple(d, e, f)
+})";
+
+  TF_ASSERT_OK_AND_ASSIGN(std::unique_ptr<HloModule> module,
+                          ParseAndReturnVerifiedModule(module_str));
+
+  auto size_fn = [](const BufferValue& buffer) {
+    return ShapeUtil::ByteSizeOf(buffer.shape(), /*pointer_size=*/8);
+  };
+  int64_t peak_memory;
+  TF_ASSERT_OK_AND_ASSIGN(
+      HloSchedule schedule,
+      ScheduleModule(
+          module.get(), size_fn,
+          ComputationSchedulerToModuleScheduler(LookaheadListMemoryScheduler),
+          /*execution_threads=*/{}, &peak_memory));
+  TF_ASSERT_OK(module->set_schedule(schedule));
+  const std::vector<HloInstruction*>& sequence =
+      schedule.sequence(module->entry_computation()).instructions();
+  EXPECT_EQ(module->entry_computation()->instruction_count(), sequence.size());
+
+  // Neither "d" nor "e" raises the peak reached by "c", but "d" frees the
+  // buffer of "p1" while the user that "e" makes ready frees nothing.
+  HloComputation* entry = module->entry_computation();
+  SequentialHloOrdering ordering(schedule);
+  EXPECT_TRUE(ordering.ExecutesBefore(entry->GetInstructionWithName("d"),
+                                      entry->GetInstructionWithName("e")));
+  EXPECT_EQ(PeakMemoryUseOfEntryComputation(module.get(), size_fn),
+            peak_memory);
+}
+
+TEST_F(HloSchedulingTest, ConcurrentModuleSchedulerChoosesMinMemory) {
+  const char* module_str = R"(
+HloModule module
+
+body {
+  param.b = (s32[], f32[1000]) parameter(0)
+  i = s32[] get-tuple-element(param.b), index=0
+  x = f32[1000] get-tuple-element(param.b), index=1
+  one = s32[] constant(1)
+  next_i = s32[] add(i, one)
+  exp = f32[1000] exponential(x)
+  negate = f32[1000] negate(x)
+  next_x = f32[1000] add(exp, negate)
+  ROOT tuple = (s32[], f32[1000]) tuple(next_i, next_x)
+}
+
+cond {
+  param.c = (s32[], f32[1000]) parameter(0)
+  i = s32[] get-tuple-element(param.c), index=0
+  n = s32[] constant(4)
+  ROOT lt = pred[] compare(i, n), direction=LT
+}
+
+ENTRY entry {
+  p = f32[1000] parameter(0)
+  zero = s32[] constant(0)
+  abs = f32[1000] abs(p)
+  init = (s32[], f32[1000]) tuple(zero, abs)
+  while = (s32[], f32[1000]) while(init), condition=cond, body=body
+  x = f32[1000] get-tuple-element(while), index=1
+  sqrt = f32[1000] sqrt(abs)
+  ROOT add = f32[1000] add(x, sqrt)
+})";
+
+  TF_ASSERT_OK_AND_ASSIGN(std::unique_ptr<HloModule> module,
+                          ParseAndReturnVerifiedModule(module_str));
+  auto size_fn = [](const BufferValue& buffer) {
+    return ShapeUtil::ByteSizeOf(buffer.shape(), /*pointer_size=*/8);
+  };
+
+  int64_t min_memory = std::numeric_limits<int64_t>::max();
+  for (const MemorySchedulerAlgorithm& algorithm :
+       {MemorySchedulerAlgorithm(ListMemoryScheduler),
+        MemorySchedulerAlgorithm(LookaheadListMemoryScheduler),
+        MemorySchedulerAlgorithm(DFSMemoryScheduler),
+        MemorySchedulerAlgorithm(PostOrderMemoryScheduler)}) {
+    int64_t memory;
+    TF_ASSERT_OK(
+        ScheduleModule(module.get(), size_fn,
+                       ComputationSchedulerToModuleScheduler(algorithm),
+                       /*execution_threads=*/{}, &memory)
+            .status());
+    min_memory = std::min(min_memory, memory);
+  }
+
+  int64_t serial_memory;
+  TF_ASSERT_OK_AND_ASSIGN(
+      HloSchedule serial_schedule,
+      ScheduleModule(module.get(), size_fn, ConcurrentModuleScheduler(1),
+                     /*execution_threads=*/{}, &serial_memory));
+  int64_t concurrent_memory;
+  TF_ASSERT_OK_AND_ASSIGN(
+      HloSchedule concurrent_schedule,
+      ScheduleModule(module.get(), size_fn, ConcurrentModuleScheduler(4),
+                     /*execution_threads=*/{}, &concurrent_memory));
+  EXPECT_EQ(serial_memory, min_memory);
+  EXPECT_EQ(concurrent_memory, min_memory);
+  EXPECT_EQ(serial_schedule.ToString(), concurrent_schedule.ToString());
+}
+
+TEST_F(HloSchedulingTest, PeakMemoryIsOnlyRequestedWhenRecorded) {
+  auto module = CreateNewVerifiedModule();
+  const Shape vec = ShapeUtil::MakeShape(xla::F32, {42});
+  auto builder = HloComputation::Builder(TestName());
+  auto param =
+      builder.AddInstruction(HloInstruction::CreateParameter(0, vec, "param"));
+  builder.AddInstruction(
+      HloInstruction::CreateUnary(vec, HloOpcode::kNegate, param));
+  module->AddEntryComputation(builder.Build());
+
+  auto size_fn = [](const BufferValue& buffer) {
+    return ShapeUtil::ByteSizeOf(buffer.shape());
+  };
+  bool requested = false;
+  ModuleSchedulerAlgorithm algorithm =
+      [&](const HloModule* module,
+          const TuplePointsToAnalysis& points_to_analysis,
+          const HloAliasAnalysis& alias_analysis,
+          const LogicalBuffer::SizeFunction& size_function,
+          const absl::flat_hash_set<absl::string_view>& execution_threads,
+          int64_t* peak_memory) {
+        requested = peak_memory != nullptr;
+        return DefaultModuleScheduler(module, points_to_analysis,
+                                      alias_analysis, size_function,
+                                      execution_threads, peak_memory);
+      };
+
+  HloMemoryScheduler scheduler(size_fn, algorithm);
+  TF_ASSERT_OK(scheduler.Run(module.get()).status());
+  EXPECT_FALSE(requested);
+
+  HloMemoryScheduler recording_scheduler(size_fn, algorithm,
+                                         /*record_peak_memory=*/true);
+  TF_ASSERT_OK(recording_scheduler.Run(module.get()).status());
+  EXPECT_TRUE(requested);
+}
+
 TEST_F(HloSchedulingTest, HostSendDoneSchedule) {
   const char* const module_str = R"(
 HloModule module
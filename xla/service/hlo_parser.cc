@@ -3859,7 +3859,11 @@ bool HloParserImpl::ParseDenseLiteral(Literal* literal, const Shape& shape) {
     }  // end of switch
   } while (nest_level > 0);
 
-  *literal = literal->Relayout(shape.layout());
+  // The literal was created in the default layout; only pay for a copy of its
+  // (possibly very large) buffer if the requested layout differs.
+  if (literal->shape().layout() != shape.layout()) {
+    *literal = literal->Relayout(shape.layout());
+  }
   return true;
 }
 
@@ -15,6 +15,7 @@ limitations under the License.
 
 #include "xla/service/hlo_parser.h"
 
+#include <limits>
 #include <memory>
 #include <string>
 #include <string_view>
@@ -37,6 +38,7 @@ limitations under the License.
 #include "tsl/platform/status_matchers.h"
 #include "tsl/platform/statusor.h"
 #include "tsl/platform/test.h"
+#include "tsl/platform/test_benchmark.h"
 
 namespace xla {
 namespace {
@@ -45,6 +47,7 @@ namespace m = ::xla::match;
 
 using ::absl::string_view;
 using ::testing::ElementsAre;
+using ::testing::FloatEq;
 using ::testing::HasSubstr;
 
 struct TestData {
@@ -4410,5 +4413,84 @@ comp2 {
       Layout({1, 0, 2, 3}));
 }
 
+TEST_F(HloParserTest, ParseNumbersNextToPatterns) {
+  // Plain numbers are lexed without regexes; make sure that numbers that are
+  // prefixes of dxd, pad and dim-labels tokens are still lexed as patterns.
+  const std::string original = R"(
+HloModule module
+
+ENTRY entry {
+  f = f32[6]{0} constant({1, -2.5, 3e2, -4.E-1, -.5, 6.})
+  u = u64[2]{0} constant({0, 18446744073709551615})
+  input = f32[1,2,2,1]{3,2,1,0} parameter(0)
+  kernel = f32[3,3,1,1]{3,2,1,0} parameter(1)
+  conv = f32[1,2,2,1]{3,2,1,0} convolution(input, kernel), window={size=3x3 pad=1_1x1_1}, dim_labels=b01f_01io->b01f
+  ROOT t = (f32[6]{0}, u64[2]{0}, f32[1,2,2,1]{3,2,1,0}) tuple(f, u, conv)
+}
+)";
+  TF_ASSERT_OK_AND_ASSIGN(auto module,
+                          ParseAndReturnUnverifiedModule(original));
+  const HloInstruction* root = module->entry_computation()->root_instruction();
+  EXPECT_THAT(root->operand(0)->literal().data<float>(),
+              ElementsAre(FloatEq(1), FloatEq(-2.5), FloatEq(300),
+                          FloatEq(-0.4), FloatEq(-0.5), FloatEq(6)));
+  EXPECT_THAT(root->operand(1)->literal().data<uint64_t>(),
+              ElementsAre(0, std::numeric_limits<uint64_t>::max()));
+  const HloInstruction* conv = root->operand(2);
+  EXPECT_EQ(window_util::ToString(conv->window()), "size=3x3 pad=1_1x1_1");
+  EXPECT_EQ(ConvolutionDimensionNumbersToString(
+                conv->convolution_dimension_numbers()),
+            "b01f_01io->b01f");
+}
+
+// Returns the text of a module whose entry computation is a single f32
+// constant with `num_elements` elements.
+std::string LargeConstantModuleText(int64_t num_elements) {
+  std::string text = "HloModule module\n\nENTRY entry {\n  ROOT c = f32[";
+  absl::StrAppend(&text, num_elements, "]{0} constant({");
+  for (int64_t i = 0; i < num_elements; ++i) {
+    absl::StrAppend(&text, i == 0 ? "" : ", ", i % 2 == 0 ? "-" : "", i,
+                    ".", i % 997, "e-3");
+  }
+  absl::StrAppend(&text, "})\n}\n");
+  return text;
+}
+
+// Returns the text of a module whose entry computation is a chain of
+// `num_instructions` elementwise instructions.
+std::string LongChainModuleText(int64_t num_instructions) {
+  std::string text =
+      "HloModule module\n\nENTRY entry {\n  p0 = f32[8,128]{1,0} "
+      "parameter(0)\n";
+  std::string previous = "p0";
+  for (int64_t i = 0; i < num_instructions; ++i) {
+    std::string name = absl::StrCat("add.", i);
+    absl::StrAppend(&text, i + 1 == num_instructions ? "  ROOT " : "  ", name,
+                    " = f32[8,128]{1,0} add(", previous, ", p0), ",
+                    "metadata={op_name=\"layer_", i, "\"}\n");
+    previous = std::move(name);
+  }
+  absl::StrAppend(&text, "}\n");
+  return text;
+}
+
+void BM_ParseLargeConstant(::testing::benchmark::State& state) {
+  const std::string text = LargeConstantModuleText(state.range(0));
+  for (auto s : state) {
+    TF_CHECK_OK(ParseAndReturnUnverifiedModule(text).status());
+  }
+  state.SetBytesProcessed(state.iterations() * text.size());
+}
+BENCHMARK(BM_ParseLargeConstant)->Arg(1 << 10)->Arg(1 << 16)->Arg(1 << 20);
+
+void BM_ParseLongChain(::testing::benchmark::State& state) {
+  const std::string text = LongChainModuleText(state.range(0));
+  for (auto s : state) {
+    TF_CHECK_OK(ParseAndReturnUnverifiedModule(text).status());
+  }
+  state.SetBytesProcessed(state.iterations() * text.size());
+}
+BENCHMARK(BM_ParseLongChain)->Arg(1 << 8)->Arg(1 << 12)->Arg(1 << 16);
+
 }  // namespace
 }  // namespace xla
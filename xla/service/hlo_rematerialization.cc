@@ -17,10 +17,13 @@ limitations under the License.
 
 #include <algorithm>
 #include <iterator>
+#include <limits>
 #include <memory>
 #include <set>
 #include <string>
+#include <tuple>
 #include <utility>
+#include <vector>
 
 #include "absl/algorithm/container.h"
 #include "absl/container/flat_hash_map.h"
@@ -30,6 +33,7 @@ limitations under the License.
 #include "absl/strings/str_cat.h"
 #include "absl/strings/str_format.h"
 #include "absl/strings/str_join.h"
+#include "absl/types/span.h"
 #include "xla/hlo/ir/hlo_casting_utils.h"
 #include "xla/hlo/ir/hlo_computation.h"
 #include "xla/hlo/ir/hlo_instruction.h"
@@ -119,7 +123,7 @@ using BufferId = int64_t;
 using BufferIdList = absl::InlinedVector<BufferId, 3>;
 
 struct RematStrategy {
-  enum {
+  enum Kind {
     // Recompute the node at a later program point.
     kRecompute,
     // Change the layout into a compact form and uncompress it back at a later
@@ -155,6 +159,15 @@ struct Item {
 
   bool is_skip_node = false;
 
+  // Position of the item in the order in which the memory tracker finished
+  // placing items, or -1 if it has not been finished yet.
+  int64_t finish_order = -1;
+
+  // Whether the memory tracker considers recomputing this item, and if so,
+  // whether that is free because none of its users have been placed yet.
+  bool recompute_candidate = false;
+  bool recompute_cost_free = false;
+
  private:
   friend class InstructionList;
 
@@ -661,6 +674,75 @@ class MemoryUsageTracker {
   // to avoid computing the shape multiple times.
   StatusOr<Shape> GetCompactShape(const HloInstruction* hlo);
 
+  // PickRematerializationCandidates for blocks of a single instruction. The
+  // candidates are kept in remat_candidates_, which is updated as instructions
+  // are placed, and evaluated in order of increasing cost bound until the bound
+  // exceeds the best cost found so far. This picks the same candidate as the
+  // linear scan, but neither visits every placed instruction nor computes the
+  // exact memory reduction of most candidates on long sequences.
+  std::tuple<std::vector<Item*>, RematStrategy, int>
+  PickSingleRematerializationCandidate(
+      absl::flat_hash_map<const HloInstruction*, bool>* rematerializable_map,
+      int64_t memory_limit_bytes, int64_t peak_memory_bytes);
+
+  // A strategy applied to a finished item. Candidates are ordered by a lower
+  // bound on their cost: recomputations that are free come first, then all
+  // others by decreasing number of bytes they can free at most, which orders
+  // memory_limit_bytes / max_memory_reduced for any non-negative limit. Ties
+  // are broken by 'order', the position at which the linear scan would have
+  // evaluated the candidate.
+  struct RematCandidate {
+    bool cost_free;
+    int64_t max_memory_reduced;
+    int64_t order;
+    Item* item;
+    RematStrategy::Kind kind;
+
+    bool operator<(const RematCandidate& other) const {
+      return std::make_tuple(!cost_free, -max_memory_reduced, order) <
+             std::make_tuple(!other.cost_free, -other.max_memory_reduced,
+                             other.order);
+    }
+  };
+
+  RematCandidate RecomputeCandidate(Item* item) const {
+    return {item->recompute_cost_free, AllocatedSize(item),
+            2 * item->finish_order + 1, item, RematStrategy::kRecompute};
+  }
+
+  // Updates the recompute candidate 'item' after one of its users has been
+  // placed.
+  void UpdateRecomputeCandidateForPlacedUser(Item* item);
+
+  // Removes 'item' from the recompute candidates after one of its control
+  // successors has been placed.
+  void RemoveRecomputeCandidate(Item* item);
+
+  // Adds the candidates among the items finished since the last call to
+  // remat_candidates_.
+  void AddFinishedItemsToRematCandidates(
+      absl::flat_hash_map<const HloInstruction*, bool>* rematerializable_map);
+
+  // Returns the buffers that 'candidate' frees, one of which must be live for
+  // it to reduce memory use.
+  absl::Span<const BufferId> FreedBuffers(
+      const RematCandidate& candidate) const {
+    if (candidate.kind == RematStrategy::kCompress) {
+      return absl::MakeConstSpan(candidate.item->buffers_output).subspan(0, 1);
+    }
+    return candidate.item->buffers_defined;
+  }
+
+  // Moves the candidate at 'it', none of whose freed buffers are live, from
+  // remat_candidates_ to parked_remat_candidates_, and returns the iterator
+  // following it.
+  std::set<RematCandidate>::iterator ParkRematCandidate(
+      std::set<RematCandidate>::iterator it);
+
+  // Moves the candidates parked on 'buffer_id' back to remat_candidates_ after
+  // the buffer has become live again.
+  void UnparkRematCandidates(BufferId buffer_id);
+
   // Creates a Buffer representing the given logical buffer. The buffer is added
   // to buffers_ and a reference is returned.
   Buffer& CreateBufferFromLogicalBuffer(
@@ -789,6 +871,29 @@ class MemoryUsageTracker {
   HloRematerialization::RematerializationMode mode_;
   // All buffers in the computation.
   std::vector<Buffer> buffers_;
+
+  // The number of items finished so far.
+  int64_t num_finished_items_ = 0;
+
+  // Items finished since the last call to
+  // AddFinishedItemsToRematCandidates.
+  std::vector<Item*> unchecked_items_;
+
+  // Candidates for single instruction rematerialization among the finished
+  // items that have been checked.
+  std::set<RematCandidate> remat_candidates_;
+
+  // Candidates that cannot reduce memory use because none of the buffers they
+  // free are live, by each of these buffers. A dead buffer only becomes live
+  // again when an unplaced rematerialization uses it, so this keeps the dead
+  // values of long sequences out of the search.
+  absl::flat_hash_map<BufferId,
+                      std::vector<std::pair<Item*, RematStrategy::Kind>>>
+      parked_remat_candidates_;
+
+  // The number of (item, strategy) pairs that the linear scan would consider,
+  // which is reported as the effort of picking a single candidate.
+  int remat_candidates_effort_ = 0;
 };
 
 MemoryUsageTracker::MemoryUsageTracker(
@@ -879,6 +984,16 @@ Status MemoryUsageTracker::BeginInstruction(Item* item) {
 
   item->placed = true;
 
+  // Recomputing an operand is no longer free, and recomputing a control
+  // predecessor would violate the control dependency.
+  for (const HloInstruction* operand : instruction->operands()) {
+    UpdateRecomputeCandidateForPlacedUser(instruction_list_.GetItem(operand));
+  }
+  for (const HloInstruction* predecessor :
+       instruction->control_predecessors()) {
+    RemoveRecomputeCandidate(instruction_list_.GetItem(predecessor));
+  }
+
   // All buffers defined by this instruction need memory.
   for (BufferId buffer_id : item->buffers_defined) {
     VLOG(3) << "  Buffer " << buffers_.at(buffer_id).ToString()
@@ -928,6 +1043,8 @@ Status MemoryUsageTracker::EndInstruction() {
     }
   }
 
+  in_progress_item_->finish_order = num_finished_items_++;
+  unchecked_items_.push_back(in_progress_item_);
   in_progress_item_ = nullptr;
 
   VLOG(3) << "  memory usage = " << memory_usage_;
@@ -1028,6 +1145,8 @@ Status MemoryUsageTracker::AddCompressInstructions(Item* original_item,
   memory_usage_ -= size_function_(original_item->instruction->shape());
   // Compressed buffer is now alive.
   memory_usage_ += size_function_(compressed_item->instruction->shape());
+  // The compressed instruction is placed right away.
+  UpdateRecomputeCandidateForPlacedUser(original_item);
 
   UsesList placed_users;
   UsesList unplaced_users;
@@ -1097,6 +1216,7 @@ Status MemoryUsageTracker::AddRematerializedInstruction(
     if (buffer.unfinished_user_count == 0) {
       // Buffer used by this instruction was dead, now is alive.
       memory_usage_ += AllocatedSize(buffer.id);
+      UnparkRematCandidates(buffer.id);
     }
     buffer.unfinished_user_count++;
     absl::InlinedVector<ItemUse, 2> filtered_users;
@@ -1389,6 +1509,13 @@ MemoryUsageTracker::PickRematerializationCandidates(
     const InstructionList& instruction_list, int64_t memory_limit_bytes,
     absl::flat_hash_map<const HloInstruction*, bool>* rematerializable_map,
     int min_block_size, int max_block_size, int64_t peak_memory_bytes) {
+  // The bounds are only monotonic in the memory reduced for a non-negative
+  // limit.
+  if (max_block_size == 1 && memory_limit_bytes >= 0) {
+    return PickSingleRematerializationCandidate(
+        rematerializable_map, memory_limit_bytes, peak_memory_bytes);
+  }
+
   std::vector<Item*> best_items;
   int64_t best_cost = 0;
   RematStrategy best_strategy;
@@ -1523,6 +1650,180 @@ MemoryUsageTracker::PickRematerializationCandidates(
   return {best_items, best_strategy, effort};
 }
 
+void MemoryUsageTracker::UpdateRecomputeCandidateForPlacedUser(Item* item) {
+  if (!item->recompute_candidate || !item->recompute_cost_free) {
+    return;
+  }
+  const bool in_candidates = remat_candidates_.erase(RecomputeCandidate(item));
+  item->recompute_cost_free = false;
+  if (in_candidates) {
+    remat_candidates_.insert(RecomputeCandidate(item));
+  }
+}
+
+void MemoryUsageTracker::RemoveRecomputeCandidate(Item* item) {
+  if (!item->recompute_candidate) {
+    return;
+  }
+  remat_candidates_.erase(RecomputeCandidate(item));
+  item->recompute_candidate = false;
+  --remat_candidates_effort_;
+}
+
+void MemoryUsageTracker::AddFinishedItemsToRematCandidates(
+    absl::flat_hash_map<const HloInstruction*, bool>* rematerializable_map) {
+  const bool try_compress =
+      mode_ == HloRematerialization::RematerializationMode::kCompressOnly ||
+      mode_ ==
+          HloRematerialization::RematerializationMode::kRecomputeAndCompress;
+  const bool try_recompute =
+      mode_ != HloRematerialization::RematerializationMode::kCompressOnly;
+  for (Item* item : unchecked_items_) {
+    if (!item->is_skip_node || item->denylisted ||
+        !CanBeRematerialized(item->instruction, rematerializable_map)) {
+      continue;
+    }
+    if (try_compress && item->buffers_output.size() == 1 &&
+        item->instruction->shape().IsArray()) {
+      const Buffer& output_buffer = buffers_.at(item->buffers_output[0]);
+      if (!output_buffer.live_out) {
+        // Compression frees at most the whole output buffer.
+        ++remat_candidates_effort_;
+        if (output_buffer.size > 0) {
+          remat_candidates_.insert({/*cost_free=*/false, output_buffer.size,
+                                    2 * item->finish_order, item,
+                                    RematStrategy::kCompress});
+        }
+      }
+    }
+    if (!try_recompute ||
+        absl::c_any_of(item->instruction->control_successors(),
+                       [this](const HloInstruction* inst) {
+                         return IsPlaced(inst);
+                       })) {
+      continue;
+    }
+    // Recomputation frees at most the buffers the instruction defines, and is
+    // free if none of its users have been placed yet.
+    ++remat_candidates_effort_;
+    item->recompute_candidate = true;
+    item->recompute_cost_free =
+        absl::c_none_of(item->instruction->users(),
+                        [this](const HloInstruction* inst) {
+                          return IsPlaced(inst);
+                        });
+    if (AllocatedSize(item) > 0) {
+      remat_candidates_.insert(RecomputeCandidate(item));
+    }
+  }
+  unchecked_items_.clear();
+}
+
+std::set<MemoryUsageTracker::RematCandidate>::iterator
+MemoryUsageTracker::ParkRematCandidate(std::set<RematCandidate>::iterator it) {
+  for (BufferId buffer_id : FreedBuffers(*it)) {
+    parked_remat_candidates_[buffer_id].push_back({it->item, it->kind});
+  }
+  return remat_candidates_.erase(it);
+}
+
+void MemoryUsageTracker::UnparkRematCandidates(BufferId buffer_id) {
+  auto parked = parked_remat_candidates_.find(buffer_id);
+  if (parked == parked_remat_candidates_.end()) {
+    return;
+  }
+  // A candidate may have been parked on several buffers, or been unparked
+  // already, in which case inserting it again has no effect.
+  for (const auto& [item, kind] : parked->second) {
+    if (kind == RematStrategy::kCompress) {
+      remat_candidates_.insert(
+          {/*cost_free=*/false, buffers_.at(item->buffers_output[0]).size,
+           2 * item->finish_order, item, RematStrategy::kCompress});
+    } else if (item->recompute_candidate) {
+      remat_candidates_.insert(RecomputeCandidate(item));
+    }
+  }
+  parked_remat_candidates_.erase(parked);
+}
+
+std::tuple<std::vector<Item*>, RematStrategy, int>
+MemoryUsageTracker::PickSingleRematerializationCandidate(
+    absl::flat_hash_map<const HloInstruction*, bool>* rematerializable_map,
+    int64_t memory_limit_bytes, int64_t peak_memory_bytes) {
+  AddFinishedItemsToRematCandidates(rematerializable_map);
+
+  std::vector<Item*> best_items;
+  RematStrategy best_strategy;
+  int64_t best_cost = 0;
+  int64_t best_order = 0;
+  int64_t evaluated = 0;
+  for (auto it = remat_candidates_.begin(); it != remat_candidates_.end();) {
+    const RematCandidate& candidate = *it;
+    const int64_t cost_bound =
+        candidate.cost_free ? 0
+                            : memory_limit_bytes / candidate.max_memory_reduced;
+    if (!best_items.empty() && cost_bound > best_cost) {
+      break;
+    }
+    if (!best_items.empty() && cost_bound == best_cost &&
+        candidate.order > best_order) {
+      // Neither this nor any later candidate with the same bound can win the
+      // tie, so skip to the next bound.
+      it = remat_candidates_.upper_bound(
+          {candidate.cost_free, candidate.max_memory_reduced,
+           std::numeric_limits<int64_t>::max(), nullptr, candidate.kind});
+      continue;
+    }
+    if (absl::c_none_of(FreedBuffers(candidate), [this](BufferId buffer_id) {
+          return IsCurrentlyLive(buffer_id);
+        })) {
+      it = ParkRematCandidate(it);
+      continue;
+    }
+    ++it;
+    ++evaluated;
+    Item* item = candidate.item;
+    int64_t cost;
+    RematStrategy strategy;
+    strategy.kind = candidate.kind;
+    if (candidate.kind == RematStrategy::kCompress) {
+      Shape compact_shape = GetCompactShape(item->instruction).value();
+      const int64_t memory_reduced =
+          MemoryReducedIfCompressed(item, compact_shape);
+      // Since the compressed and uncompressed buffers need to be alive while
+      // performing the compression/uncompression, only perform the
+      // compression if the sum of the two sizes is less than the peak memory.
+      const int64_t size = size_function_(item->instruction->shape());
+      const int64_t reduced_size = size_function_(compact_shape);
+      if (memory_reduced <= 0 || size + reduced_size >= peak_memory_bytes) {
+        continue;
+      }
+      cost = memory_limit_bytes / memory_reduced;
+      strategy.compact_shape = std::move(compact_shape);
+    } else {
+      const int64_t memory_reduced = MemoryReducedIfRematerialized({item});
+      if (memory_reduced <= 0) {
+        continue;
+      }
+      cost = RematerializationCost({item}, memory_reduced, memory_limit_bytes);
+    }
+    if (best_items.empty() ||
+        std::tie(cost, candidate.order) < std::tie(best_cost, best_order)) {
+      VLOG(5) << "Candidate " << item->instruction->name() << " now best with "
+              << (candidate.kind == RematStrategy::kCompress ? "compression"
+                                                              : "recomputation")
+              << ", cost per byte " << cost;
+      best_items = {item};
+      best_strategy = std::move(strategy);
+      best_cost = cost;
+      best_order = candidate.order;
+    }
+  }
+  VLOG(5) << "Evaluated " << evaluated << " of " << remat_candidates_.size()
+          << " single instruction candidates";
+  return {best_items, best_strategy, remat_candidates_effort_};
+}
+
 bool MemoryUsageTracker::HasUnplacedUsers(Item* item) const {
   for (BufferId buffer_id : item->buffers_defined) {
     const Buffer& buffer = buffers_.at(buffer_id);
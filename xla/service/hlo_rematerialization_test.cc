@@ -17,17 +17,24 @@ limitations under the License.
 
 #include <memory>
 #include <string>
+#include <vector>
+
+#include "absl/strings/str_cat.h"
+#include "absl/strings/str_format.h"
+#include "absl/strings/str_join.h"
 
 #include "xla/hlo/ir/hlo_computation.h"
 #include "xla/hlo/ir/hlo_instruction.h"
 #include "xla/hlo/ir/hlo_opcode.h"
 #include "xla/service/hlo_matchers.h"
 #include "xla/service/hlo_ordering.h"
+#include "xla/service/hlo_parser.h"
 #include "xla/service/hlo_rematerialization_test_utils.h"
 #include "xla/shape_util.h"
 #include "xla/tests/hlo_test_base.h"
 #include "xla/types.h"
 #include "tsl/lib/core/status_test_util.h"
+#include "tsl/platform/test_benchmark.h"
 
 namespace xla {
 namespace {
@@ -1197,6 +1204,169 @@ ENTRY %entry {
                       op::Fusion(AllOf(op::Fusion(), ::testing::Ne(fusion0)))));
 }
 
+// Rematerializes the module in its given schedule, without scheduling it for
+// memory first.
+StatusOr<bool> RematerializeScheduledModule(
+    int64_t memory_limit_bytes, HloModule* module,
+    HloRematerialization::RematerializationSizes* sizes) {
+  HloRematerialization remat(
+      [](const Shape& shape) {
+        return ShapeUtil::ByteSizeOf(shape, sizeof(void*));
+      },
+      memory_limit_bytes, sizes,
+      HloRematerialization::RematerializationPass::kPreFusion,
+      /*block_size_limit=*/1, /*block_rematerialization_factor=*/1,
+      /*compact_shape_function=*/nullptr,
+      HloRematerialization::RematerializationMode::kRecomputeOnly);
+  return remat.Run(module);
+}
+
+// Both %large (4KB) and %small (1KB) are live while %pressure (8KB) is, for a
+// peak of about 13KB. Rematerializing %large alone meets the 10KB limit, and
+// is cheaper per byte than rematerializing %small.
+TEST_F(HloRematerializationTest, PicksCandidateThatFreesMostMemory) {
+  const std::string hlo_string = R"(
+HloModule module, is_scheduled=true
+
+%add {
+  %x = f32[] parameter(0)
+  %y = f32[] parameter(1)
+  ROOT %add = f32[] add(%x, %y)
+}
+
+ENTRY %entry {
+  %param = f32[] parameter(0)
+  %zero = f32[] constant(0)
+  %large = f32[1024]{0} broadcast(%param), dimensions={}
+  %small = f32[256]{0} broadcast(%param), dimensions={}
+  %large.early = f32[] reduce(%large, %zero), dimensions={0}, to_apply=%add
+  %small.early = f32[] reduce(%small, %zero), dimensions={0}, to_apply=%add
+  %pressure = f32[2048]{0} broadcast(%param), dimensions={}
+  %pressure.use = f32[] reduce(%pressure, %zero), dimensions={0}, to_apply=%add
+  %large.late = f32[] reduce(%large, %zero), dimensions={0}, to_apply=%add
+  %small.late = f32[] reduce(%small, %zero), dimensions={0}, to_apply=%add
+  ROOT %tuple = (f32[], f32[], f32[], f32[], f32[]) tuple(%large.early,
+    %small.early, %pressure.use, %large.late, %small.late)
+}
+)";
+  TF_ASSERT_OK_AND_ASSIGN(auto module,
+                          ParseAndReturnVerifiedModule(hlo_string));
+  const HloInstruction* large = FindInstruction(module.get(), "large");
+  const HloInstruction* small = FindInstruction(module.get(), "small");
+  const HloInstruction* large_late = FindInstruction(module.get(), "large.late");
+  const HloInstruction* small_late = FindInstruction(module.get(), "small.late");
+
+  HloRematerialization::RematerializationSizes sizes;
+  TF_ASSERT_OK_AND_ASSIGN(
+      bool changed, RematerializeScheduledModule(
+                        /*memory_limit_bytes=*/10 * 1024, module.get(), &sizes));
+  EXPECT_TRUE(changed);
+  EXPECT_THAT(large_late->operand(0),
+              AllOf(op::Broadcast(op::Parameter()), ::testing::Ne(large)));
+  EXPECT_EQ(small_late->operand(0), small);
+  EXPECT_GT(sizes.before_bytes, 12 * 1024);
+  EXPECT_LE(sizes.after_bytes, 10 * 1024);
+}
+
+// Recomputing %large after %pressure would violate the control dependency, so
+// only %small is rematerialized, and the limit cannot be met.
+TEST_F(HloRematerializationTest, SkipsCandidateWithPlacedControlSuccessor) {
+  const std::string hlo_string = R"(
+HloModule module, is_scheduled=true
+
+%add {
+  %x = f32[] parameter(0)
+  %y = f32[] parameter(1)
+  ROOT %add = f32[] add(%x, %y)
+}
+
+ENTRY %entry {
+  %param = f32[] parameter(0)
+  %zero = f32[] constant(0)
+  %large = f32[1024]{0} broadcast(%param), dimensions={}
+  %small = f32[256]{0} broadcast(%param), dimensions={}
+  %large.early = f32[] reduce(%large, %zero), dimensions={0}, to_apply=%add
+  %small.early = f32[] reduce(%small, %zero), dimensions={0}, to_apply=%add
+  %pressure = f32[2048]{0} broadcast(%param), dimensions={},
+    control-predecessors={%large}
+  %pressure.use = f32[] reduce(%pressure, %zero), dimensions={0}, to_apply=%add
+  %large.late = f32[] reduce(%large, %zero), dimensions={0}, to_apply=%add
+  %small.late = f32[] reduce(%small, %zero), dimensions={0}, to_apply=%add
+  ROOT %tuple = (f32[], f32[], f32[], f32[], f32[]) tuple(%large.early,
+    %small.early, %pressure.use, %large.late, %small.late)
+}
+)";
+  TF_ASSERT_OK_AND_ASSIGN(auto module,
+                          ParseAndReturnVerifiedModule(hlo_string));
+  const HloInstruction* large = FindInstruction(module.get(), "large");
+  const HloInstruction* small = FindInstruction(module.get(), "small");
+  const HloInstruction* large_late = FindInstruction(module.get(), "large.late");
+  const HloInstruction* small_late = FindInstruction(module.get(), "small.late");
+
+  HloRematerialization::RematerializationSizes sizes;
+  TF_ASSERT_OK_AND_ASSIGN(
+      bool changed, RematerializeScheduledModule(
+                        /*memory_limit_bytes=*/10 * 1024, module.get(), &sizes));
+  EXPECT_TRUE(changed);
+  EXPECT_EQ(large_late->operand(0), large);
+  EXPECT_THAT(small_late->operand(0),
+              AllOf(op::Broadcast(op::Parameter()), ::testing::Ne(small)));
+  EXPECT_GT(sizes.after_bytes, 10 * 1024);
+  EXPECT_LT(sizes.after_bytes, sizes.before_bytes);
+}
+
+// Rematerializes a computation in which each of 'num_broadcasts' broadcasts is
+// used right away and again at the end, so that all of them are candidates at
+// every program point that exceeds the limit.
+void BM_RematerializeManyCandidates(::testing::benchmark::State& state) {
+  const int num_broadcasts = state.range(0);
+  std::string hlo_string = R"(
+HloModule module, is_scheduled=true
+
+%add {
+  %x = f32[] parameter(0)
+  %y = f32[] parameter(1)
+  ROOT %add = f32[] add(%x, %y)
+}
+
+ENTRY %entry {
+  %param = f32[] parameter(0)
+  %zero = f32[] constant(0)
+)";
+  std::vector<std::string> uses;
+  for (int i = 0; i < num_broadcasts; ++i) {
+    absl::StrAppendFormat(
+        &hlo_string,
+        "  %%bcast.%d = f32[1024]{0} broadcast(%%param), dimensions={}\n"
+        "  %%early.%d = f32[] reduce(%%bcast.%d, %%zero), dimensions={0}, "
+        "to_apply=%%add\n",
+        i, i, i);
+    uses.push_back(absl::StrCat("%early.", i));
+  }
+  for (int i = 0; i < num_broadcasts; ++i) {
+    absl::StrAppendFormat(&hlo_string,
+                          "  %%late.%d = f32[] reduce(%%bcast.%d, %%zero), "
+                          "dimensions={0}, to_apply=%%add\n",
+                          i, i);
+    uses.push_back(absl::StrCat("%late.", i));
+  }
+  absl::StrAppend(&hlo_string, "  ROOT %tuple = tuple(",
+                  absl::StrJoin(uses, ", "), ")\n}\n");
+
+  for (auto s : state) {
+    state.PauseTiming();
+    auto module = ParseAndReturnUnverifiedModule(hlo_string).value();
+    state.ResumeTiming();
+    // Half of the broadcasts fit into the limit.
+    TF_CHECK_OK(RematerializeScheduledModule(
+                    /*memory_limit_bytes=*/num_broadcasts * 2 * 1024,
+                    module.get(), /*sizes=*/nullptr)
+                    .status());
+  }
+}
+
+BENCHMARK(BM_RematerializeManyCandidates)->Arg(1024)->Arg(4096)->Arg(16384);
+
 }  // namespace
 
 }  // namespace xla
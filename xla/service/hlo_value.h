@@ -118,6 +118,16 @@ class HloValue : public BufferValue {
   // 'positions' as this is set at construction time.
   void SetPositions(absl::Span<const HloPosition> positions);
 
+  // Replaces the non-defining positions of the HloValue and discards the
+  // lazily computed uses. Unlike SetPositions this may be called repeatedly;
+  // it is used when HloDataflowAnalysis is updated after the module changed.
+  void ResetPositions(absl::Span<const HloPosition> positions);
+
+  // Discards the lazily computed uses, which are recomputed on the next call
+  // to GetUses(). Must be called when the users of any position of this value
+  // may have changed.
+  void ClearCachedUses();
+
   // Returns whether this value is a phi value.
   bool is_phi() const { return is_phi_; }
 
@@ -52,12 +52,6 @@ limitations under the License.
 
 namespace xla {
 
-namespace {
-struct CanonicalAsyncOp {
-  HloOpcode outer;  // kAsyncStart or kAsyncDone
-  HloOpcode inner;  // kAllReduce, kAllGather, kAllToAll, kCollectivePermute
-};
-
 CanonicalAsyncOp GetCanonicalAsyncOp(const HloInstruction& hlo) {
   switch (hlo.opcode()) {
     case HloOpcode::kAsyncStart:
@@ -80,14 +74,8 @@ CanonicalAsyncOp GetCanonicalAsyncOp(const HloInstruction& hlo) {
   }
 }
 
-}  // namespace
-
 LatencyEstimator::TimeCost ApproximateLatencyEstimator::GetLatencyBetween(
     const HloGraphNode& from, const HloGraphNode& target) const {
-  // These values are empirically derived to obtain an overlap of one output
-  // fusion/convolution with 1 async op or 5 loop fusions with an async op.
-  static constexpr TimeCost kLowLatency = 1.0;
-  static constexpr TimeCost kHighLatency = 5000.0;
   CanonicalAsyncOp from_op = GetCanonicalAsyncOp(from.GetInstr());
   CanonicalAsyncOp target_op = GetCanonicalAsyncOp(target.GetInstr());
   if (from_op.outer == HloOpcode::kAsyncStart &&
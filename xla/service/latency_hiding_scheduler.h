@@ -26,6 +26,8 @@ limitations under the License.
 #include <vector>
 
 #include "absl/container/inlined_vector.h"
+#include "xla/hlo/ir/hlo_instruction.h"
+#include "xla/hlo/ir/hlo_opcode.h"
 #include "xla/service/hlo_alias_analysis.h"
 #include "xla/service/hlo_cost_analysis.h"
 #include "xla/service/hlo_pass_interface.h"
@@ -65,6 +67,15 @@ using ResourcesVector = absl::InlinedVector<ResourcePair, 1>;
 class HloGraphNode;
 class HloScheduleGraph;
 
+struct CanonicalAsyncOp {
+  HloOpcode outer;  // kAsyncStart or kAsyncDone
+  HloOpcode inner;  // kAllReduce, kAllGather, kAllToAll, kCollectivePermute
+};
+
+// Maps both the generic async ops and the dedicated collective start/done ops
+// to an (outer, inner) pair. Other instructions map to {opcode, opcode}.
+CanonicalAsyncOp GetCanonicalAsyncOp(const HloInstruction& hlo);
+
 struct SchedulerConfig {
   int64_t collective_permute_overlap_limit = 1;
   int64_t all_to_all_overlap_limit = 1;
@@ -113,6 +124,12 @@ class ApproximateLatencyEstimator : public LatencyEstimator {
   static constexpr TimeCost kLowCost = 1.0;
   static constexpr TimeCost kMediumCost = 1000.0;
   static constexpr TimeCost kHighCost = 5000.0;
+  // Latency between an async start and its done, and between all other
+  // instructions. These values are empirically derived to obtain an overlap
+  // of one output fusion/convolution with 1 async op or 5 loop fusions with an
+  // async op.
+  static constexpr TimeCost kLowLatency = 1.0;
+  static constexpr TimeCost kHighLatency = 5000.0;
 };
 
 // Helper class to keep track of which instructions are to be supported and
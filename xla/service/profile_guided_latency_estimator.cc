@@ -0,0 +1,344 @@
+/* Copyright 2023 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "xla/service/profile_guided_latency_estimator.h"
+
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+#include "absl/container/flat_hash_map.h"
+#include "absl/strings/match.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/string_view.h"
+#include "xla/hlo/ir/hlo_computation.h"
+#include "xla/hlo/ir/hlo_instruction.h"
+#include "xla/hlo/ir/hlo_opcode.h"
+#include "tsl/platform/env.h"
+#include "tsl/platform/errors.h"
+#include "tsl/platform/fingerprint.h"
+#include "tsl/platform/logging.h"
+#include "tsl/profiler/utils/tf_xplane_visitor.h"
+#include "tsl/profiler/utils/xplane_schema.h"
+#include "tsl/profiler/utils/xplane_visitor.h"
+
+namespace xla {
+
+namespace {
+
+constexpr double kPicosPerMicro = 1e6;
+
+// Returns whether the "hlo_module" stat `value`, which is either a module name
+// or "<name>(<program id>)", refers to `module`.
+bool IsEventOfModule(absl::string_view value, const HloModule& module) {
+  return value == module.name() ||
+         absl::StartsWith(value, absl::StrCat(module.name(), "("));
+}
+
+bool IsAsyncStart(const HloInstruction& instr) {
+  return GetCanonicalAsyncOp(instr).outer == HloOpcode::kAsyncStart;
+}
+
+bool IsAsyncDone(const HloInstruction& instr) {
+  return GetCanonicalAsyncOp(instr).outer == HloOpcode::kAsyncDone;
+}
+
+}  // namespace
+
+uint64_t ProfiledInstructionFingerprint(const HloInstruction& instr) {
+  const OpMetadata& metadata = instr.metadata();
+  return tsl::Fingerprint64(absl::StrCat(
+      instr.ToString(HloPrintOptions::Fingerprint()), ";", metadata.op_type(),
+      ";", metadata.op_name(), ";", metadata.source_file(), ":",
+      metadata.source_line()));
+}
+
+ProfiledInstructionsProto ConvertXSpaceToProfiledInstructions(
+    const tensorflow::profiler::XSpace& space, const HloModule& module) {
+  absl::flat_hash_map<absl::string_view, const HloInstruction*> instructions;
+  for (const HloComputation* computation : module.computations()) {
+    for (const HloInstruction* instr : computation->instructions()) {
+      instructions[instr->name()] = instr;
+    }
+  }
+
+  struct Durations {
+    int64_t total_ps = 0;
+    int64_t count = 0;
+  };
+  absl::flat_hash_map<const HloInstruction*, Durations> durations;
+  for (const tensorflow::profiler::XPlane& plane : space.planes()) {
+    if (!absl::StartsWith(plane.name(), tsl::profiler::kGpuPlanePrefix) &&
+        !absl::StartsWith(plane.name(), tsl::profiler::kTpuPlanePrefix)) {
+      continue;
+    }
+    tsl::profiler::XPlaneVisitor visitor =
+        tsl::profiler::CreateTfXPlaneVisitor(&plane);
+    visitor.ForEachLine([&](const tsl::profiler::XLineVisitor& line) {
+      const bool is_xla_op_line =
+          line.Name() == tsl::profiler::kXlaOpLineName;
+      line.ForEachEvent([&](const tsl::profiler::XEventVisitor& event) {
+        if (auto hlo_module =
+                event.GetStat(tsl::profiler::StatType::kHloModule);
+            hlo_module.has_value() &&
+            !IsEventOfModule(hlo_module->StrOrRefValue(), module)) {
+          return;
+        }
+        absl::string_view hlo_op;
+        if (auto stat = event.GetStat(tsl::profiler::StatType::kHloOp)) {
+          hlo_op = stat->StrOrRefValue();
+        } else if (is_xla_op_line) {
+          hlo_op = event.Name();
+        } else {
+          return;
+        }
+        auto it = instructions.find(hlo_op);
+        if (it == instructions.end()) {
+          return;
+        }
+        Durations& d = durations[it->second];
+        d.total_ps += event.DurationPs();
+        ++d.count;
+      });
+    });
+  }
+
+  ProfiledInstructionsProto profile;
+  auto mean_us = [](const Durations& d) {
+    return static_cast<double>(d.total_ps) / d.count / kPicosPerMicro;
+  };
+  for (const HloComputation* computation : module.computations()) {
+    for (const HloInstruction* instr : computation->instructions()) {
+      auto it = durations.find(instr);
+      if (it == durations.end()) {
+        continue;
+      }
+      const uint64_t fingerprint = ProfiledInstructionFingerprint(*instr);
+      if (!IsAsyncStart(*instr)) {
+        auto* cost = profile.add_costs();
+        cost->set_name(instr->name());
+        cost->set_fingerprint(fingerprint);
+        cost->set_cost_us(mean_us(it->second));
+        continue;
+      }
+      for (const HloInstruction* user : instr->users()) {
+        if (!IsAsyncDone(*user)) {
+          continue;
+        }
+        auto* latency = profile.add_latencies();
+        latency->set_source(instr->name());
+        latency->set_source_fingerprint(fingerprint);
+        latency->set_target(user->name());
+        latency->set_target_fingerprint(ProfiledInstructionFingerprint(*user));
+        latency->set_latency_us(mean_us(it->second));
+      }
+    }
+  }
+  VLOG(1) << "Collected " << profile.costs_size() << " instruction costs and "
+          << profile.latencies_size() << " latencies for module "
+          << module.name();
+  return profile;
+}
+
+void MergeProfiledInstructions(const ProfiledInstructionsProto& latest,
+                               double latest_weight,
+                               ProfiledInstructionsProto* table) {
+  CHECK(latest_weight > 0 && latest_weight <= 1) << latest_weight;
+  auto blend = [&](double old_value, double new_value) {
+    return (1 - latest_weight) * old_value + latest_weight * new_value;
+  };
+
+  absl::flat_hash_map<std::pair<absl::string_view, uint64_t>,
+                      ProfiledInstructionsProto::InstructionCost*>
+      costs;
+  for (auto& cost : *table->mutable_costs()) {
+    costs[{cost.name(), cost.fingerprint()}] = &cost;
+  }
+  std::vector<const ProfiledInstructionsProto::InstructionCost*> new_costs;
+  for (const auto& cost : latest.costs()) {
+    auto it = costs.find({cost.name(), cost.fingerprint()});
+    if (it == costs.end()) {
+      new_costs.push_back(&cost);
+    } else {
+      it->second->set_cost_us(blend(it->second->cost_us(), cost.cost_us()));
+    }
+  }
+
+  using LatencyKey =
+      std::tuple<absl::string_view, uint64_t, absl::string_view, uint64_t>;
+  absl::flat_hash_map<LatencyKey, ProfiledInstructionsProto::Latency*>
+      latencies;
+  for (auto& latency : *table->mutable_latencies()) {
+    latencies[{latency.source(), latency.source_fingerprint(),
+               latency.target(), latency.target_fingerprint()}] = &latency;
+  }
+  std::vector<const ProfiledInstructionsProto::Latency*> new_latencies;
+  for (const auto& latency : latest.latencies()) {
+    auto it = latencies.find({latency.source(), latency.source_fingerprint(),
+                              latency.target(), latency.target_fingerprint()});
+    if (it == latencies.end()) {
+      new_latencies.push_back(&latency);
+    } else {
+      it->second->set_latency_us(
+          blend(it->second->latency_us(), latency.latency_us()));
+    }
+  }
+
+  // Appending may reallocate the repeated fields, so only do it once the
+  // pointers into them are no longer used.
+  for (const auto* cost : new_costs) {
+    *table->add_costs() = *cost;
+  }
+  for (const auto* latency : new_latencies) {
+    *table->add_latencies() = *latency;
+  }
+}
+
+StatusOr<ProfiledInstructionsProto> LoadProfiledInstructions(
+    const std::string& path) {
+  ProfiledInstructionsProto profile;
+  TF_RETURN_IF_ERROR(
+      tsl::ReadTextOrBinaryProto(tsl::Env::Default(), path, &profile));
+  return profile;
+}
+
+Status UpdateProfiledInstructionsFile(const std::string& path,
+                                      const ProfiledInstructionsProto& latest,
+                                      double latest_weight) {
+  tsl::Env* env = tsl::Env::Default();
+  ProfiledInstructionsProto table;
+  if (env->FileExists(path).ok()) {
+    TF_ASSIGN_OR_RETURN(table, LoadProfiledInstructions(path));
+  }
+  MergeProfiledInstructions(latest, latest_weight, &table);
+  return tsl::WriteBinaryProto(env, path, table);
+}
+
+ProfileGuidedLatencyEstimator::ProfileGuidedLatencyEstimator(
+    std::unique_ptr<LatencyEstimator> latency_estimator,
+    const ProfiledInstructionsProto& profile,
+    std::unique_ptr<const HloCostAnalysis> cost_analysis)
+    : latency_estimator_(std::move(latency_estimator)),
+      cost_analysis_(std::move(cost_analysis)) {
+  for (const auto& cost : profile.costs()) {
+    cost_by_name_and_fingerprint_[{cost.name(), cost.fingerprint()}] =
+        cost.cost_us();
+    if (cost.fingerprint() != 0) {
+      cost_by_fingerprint_[cost.fingerprint()] = cost.cost_us();
+    }
+  }
+  for (const auto& latency : profile.latencies()) {
+    latency_by_name_and_fingerprint_[{
+        latency.source(), latency.source_fingerprint(), latency.target(),
+        latency.target_fingerprint()}] = latency.latency_us();
+    if (latency.source_fingerprint() != 0 &&
+        latency.target_fingerprint() != 0) {
+      latency_by_fingerprint_[{latency.source_fingerprint(),
+                               latency.target_fingerprint()}] =
+          latency.latency_us();
+    }
+  }
+}
+
+uint64_t ProfileGuidedLatencyEstimator::GetFingerprint(
+    const HloInstruction& instr) const {
+  auto [it, inserted] = fingerprints_.try_emplace(&instr, 0);
+  if (inserted) {
+    it->second = ProfiledInstructionFingerprint(instr);
+  }
+  return it->second;
+}
+
+std::optional<double> ProfileGuidedLatencyEstimator::FindCostUs(
+    const HloInstruction& instr) const {
+  if (cost_by_name_and_fingerprint_.empty()) {
+    return std::nullopt;
+  }
+  const uint64_t fingerprint = GetFingerprint(instr);
+  if (auto it = cost_by_name_and_fingerprint_.find({instr.name(), fingerprint});
+      it != cost_by_name_and_fingerprint_.end()) {
+    return it->second;
+  }
+  if (auto it = cost_by_fingerprint_.find(fingerprint);
+      it != cost_by_fingerprint_.end()) {
+    return it->second;
+  }
+  if (auto it = cost_by_name_and_fingerprint_.find({instr.name(), 0});
+      it != cost_by_name_and_fingerprint_.end()) {
+    return it->second;
+  }
+  return std::nullopt;
+}
+
+std::optional<double> ProfileGuidedLatencyEstimator::FindLatencyUs(
+    const HloInstruction& from, const HloInstruction& target) const {
+  if (latency_by_name_and_fingerprint_.empty()) {
+    return std::nullopt;
+  }
+  const uint64_t from_fingerprint = GetFingerprint(from);
+  const uint64_t target_fingerprint = GetFingerprint(target);
+  if (auto it = latency_by_name_and_fingerprint_.find(
+          {from.name(), from_fingerprint, target.name(), target_fingerprint});
+      it != latency_by_name_and_fingerprint_.end()) {
+    return it->second;
+  }
+  if (auto it =
+          latency_by_fingerprint_.find({from_fingerprint, target_fingerprint});
+      it != latency_by_fingerprint_.end()) {
+    return it->second;
+  }
+  if (auto it = latency_by_name_and_fingerprint_.find(
+          {from.name(), 0, target.name(), 0});
+      it != latency_by_name_and_fingerprint_.end()) {
+    return it->second;
+  }
+  return std::nullopt;
+}
+
+LatencyEstimator::TimeCost ProfileGuidedLatencyEstimator::GetLatencyBetween(
+    const HloGraphNode& from, const HloGraphNode& target) const {
+  // Only async pairs are profiled; every other edge is as cheap as the
+  // fallback says.
+  if (IsAsyncStart(from.GetInstr()) && IsAsyncDone(target.GetInstr())) {
+    if (std::optional<double> latency_us =
+            FindLatencyUs(from.GetInstr(), target.GetInstr())) {
+      return *latency_us * CyclesPerMicrosecond();
+    }
+    VLOG(2) << "No profiled latency between " << from.GetInstr().name()
+            << " and " << target.GetInstr().name();
+  }
+  return latency_estimator_->GetLatencyBetween(from, target);
+}
+
+LatencyEstimator::TimeCost ProfileGuidedLatencyEstimator::NodeCost(
+    const HloInstruction* instr) const {
+  if (std::optional<double> cost_us = FindCostUs(*instr)) {
+    return *cost_us * CyclesPerMicrosecond();
+  }
+  if (cost_analysis_ != nullptr) {
+    const float seconds = cost_analysis_->optimal_seconds(*instr);
+    if (seconds > 0) {
+      return seconds * 1e6 * CyclesPerMicrosecond();
+    }
+  }
+  VLOG(2) << "No profiled cost for " << instr->name();
+  return latency_estimator_->NodeCost(instr);
+}
+
+}  // namespace xla
@@ -0,0 +1,124 @@
+/* Copyright 2023 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef TENSORFLOW_COMPILER_XLA_SERVICE_PROFILE_GUIDED_LATENCY_ESTIMATOR_H_
+#define TENSORFLOW_COMPILER_XLA_SERVICE_PROFILE_GUIDED_LATENCY_ESTIMATOR_H_
+
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string>
+#include <tuple>
+#include <utility>
+
+#include "absl/container/flat_hash_map.h"
+#include "xla/hlo/ir/hlo_instruction.h"
+#include "xla/hlo/ir/hlo_module.h"
+#include "xla/service/hlo_cost_analysis.h"
+#include "xla/service/latency_hiding_scheduler.h"
+#include "xla/service/profiled_instructions.pb.h"
+#include "xla/status.h"
+#include "xla/statusor.h"
+#include "tsl/profiler/protobuf/xplane.pb.h"
+
+namespace xla {
+
+// Returns a fingerprint of the opcode, shape and metadata of `instr`. Unlike
+// the instruction name, it does not depend on the order in which instructions
+// were created, so it usually identifies the same instruction across
+// compilations of the same program.
+uint64_t ProfiledInstructionFingerprint(const HloInstruction& instr);
+
+// Collects the run times of the instructions of `module` from the device
+// planes of `space`, a profile of a previous run of `module`. Events are
+// matched to instructions by their "hlo_op" stat, or by their name on the "XLA
+// Ops" lines. The durations of async collective starts become latencies to
+// their dones, all others become instruction costs. Repeated events (e.g. of
+// several steps or devices) are averaged; events of other modules are ignored.
+ProfiledInstructionsProto ConvertXSpaceToProfiledInstructions(
+    const tensorflow::profiler::XSpace& space, const HloModule& module);
+
+// Folds `latest` into `table` as an exponential moving average with weight
+// `latest_weight` (in (0, 1]) for the new measurements. Entries that only
+// appear in one of them are kept as is.
+void MergeProfiledInstructions(const ProfiledInstructionsProto& latest,
+                               double latest_weight,
+                               ProfiledInstructionsProto* table);
+
+// Loads a text or binary ProfiledInstructionsProto from `path`.
+StatusOr<ProfiledInstructionsProto> LoadProfiledInstructions(
+    const std::string& path);
+
+// Merges `latest` into the table stored at `path` (see
+// MergeProfiledInstructions) and writes the result back, creating the file if
+// it does not exist yet. Calling this after every profiled run lets the
+// scheduler of the next compilation use all the runs so far.
+Status UpdateProfiledInstructionsFile(const std::string& path,
+                                      const ProfiledInstructionsProto& latest,
+                                      double latest_weight = 0.5);
+
+// Implementation of LatencyEstimator using the instruction costs and latencies
+// measured in a previous run. Instructions are looked up by name and
+// ProfiledInstructionFingerprint together first, and by fingerprint alone
+// second, so that renamed instructions still match but changed instructions
+// that kept their name do not. Entries without a fingerprint match by name
+// alone. Costs of instructions missing from
+// the profile come from `cost_analysis` if it estimated a run time for them,
+// and from `latency_estimator` otherwise. Latencies missing from the profile
+// always come from `latency_estimator`. Measured times are in microseconds and
+// are scaled by latency_estimator->CyclesPerMicrosecond().
+class ProfileGuidedLatencyEstimator : public LatencyEstimator {
+ public:
+  // `cost_analysis` may be null; otherwise it must have been run on the module
+  // being scheduled, with per-second rates so that it estimates run times.
+  ProfileGuidedLatencyEstimator(
+      std::unique_ptr<LatencyEstimator> latency_estimator,
+      const ProfiledInstructionsProto& profile,
+      std::unique_ptr<const HloCostAnalysis> cost_analysis = nullptr);
+
+  TimeCost GetLatencyBetween(const HloGraphNode& from,
+                             const HloGraphNode& target) const override;
+  TimeCost NodeCost(const HloInstruction* instr) const override;
+  int CyclesPerMicrosecond() const override {
+    return latency_estimator_->CyclesPerMicrosecond();
+  }
+
+ private:
+  std::optional<double> FindCostUs(const HloInstruction& instr) const;
+  std::optional<double> FindLatencyUs(const HloInstruction& from,
+                                      const HloInstruction& target) const;
+  // Returns ProfiledInstructionFingerprint(instr), which prints the
+  // instruction, computing it only once per instruction.
+  uint64_t GetFingerprint(const HloInstruction& instr) const;
+
+  std::unique_ptr<LatencyEstimator> latency_estimator_;
+  std::unique_ptr<const HloCostAnalysis> cost_analysis_;
+  // Keyed by name and fingerprint; the fingerprint is 0 if the profile has
+  // none.
+  absl::flat_hash_map<std::pair<std::string, uint64_t>, double>
+      cost_by_name_and_fingerprint_;
+  absl::flat_hash_map<uint64_t, double> cost_by_fingerprint_;
+  // Keyed by the names and fingerprints of the source and the target.
+  absl::flat_hash_map<std::tuple<std::string, uint64_t, std::string, uint64_t>,
+                      double>
+      latency_by_name_and_fingerprint_;
+  absl::flat_hash_map<std::pair<uint64_t, uint64_t>, double>
+      latency_by_fingerprint_;
+  mutable absl::flat_hash_map<const HloInstruction*, uint64_t> fingerprints_;
+};
+
+}  // namespace xla
+
+#endif  // TENSORFLOW_COMPILER_XLA_SERVICE_PROFILE_GUIDED_LATENCY_ESTIMATOR_H_
@@ -0,0 +1,229 @@
+/* Copyright 2023 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "xla/service/profile_guided_latency_estimator.h"
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "xla/hlo/ir/hlo_instruction.h"
+#include "xla/hlo/ir/hlo_module.h"
+#include "xla/service/latency_hiding_scheduler.h"
+#include "xla/service/profiled_instructions.pb.h"
+#include "xla/tests/hlo_test_base.h"
+#include "tsl/lib/core/status_test_util.h"
+#include "tsl/platform/env.h"
+#include "tsl/platform/path.h"
+#include "tsl/platform/test.h"
+#include "tsl/profiler/protobuf/xplane.pb.h"
+#include "tsl/profiler/utils/xplane_builder.h"
+#include "tsl/profiler/utils/xplane_schema.h"
+
+namespace xla {
+namespace {
+
+constexpr char kHloString[] = R"(
+HloModule module
+
+add {
+  a = f32[] parameter(0)
+  b = f32[] parameter(1)
+  ROOT add = f32[] add(a, b)
+}
+
+ENTRY entry {
+  p0 = f32[1024] parameter(0)
+  p1 = f32[1024] parameter(1)
+  ars = f32[1024] all-reduce-start(p0), replica_groups={}, to_apply=add
+  ard = f32[1024] all-reduce-done(ars)
+  mul = f32[1024] multiply(p1, p1), metadata={op_type="Mul" op_name="m"}
+  ROOT out = f32[1024] add(ard, mul)
+}
+)";
+
+// Same program as kHloString with different instruction names.
+constexpr char kRenamedHloString[] = R"(
+HloModule module
+
+add {
+  a = f32[] parameter(0)
+  b = f32[] parameter(1)
+  ROOT add = f32[] add(a, b)
+}
+
+ENTRY entry {
+  p0 = f32[1024] parameter(0)
+  p1 = f32[1024] parameter(1)
+  all-reduce-start.3 = f32[1024] all-reduce-start(p0), replica_groups={},
+    to_apply=add
+  all-reduce-done.3 = f32[1024] all-reduce-done(all-reduce-start.3)
+  multiply.7 = f32[1024] multiply(p1, p1), metadata={op_type="Mul" op_name="m"}
+  ROOT out = f32[1024] add(all-reduce-done.3, multiply.7)
+}
+)";
+
+class ProfileGuidedLatencyEstimatorTest : public HloTestBase {
+ protected:
+  // Records one "XLA Ops" event of `duration_ps` per (name, duration) pair on
+  // a GPU plane of `space`.
+  static void AddEvents(
+      const std::vector<std::pair<std::string, int64_t>>& events,
+      tensorflow::profiler::XSpace* space) {
+    tensorflow::profiler::XPlane* plane = space->add_planes();
+    tsl::profiler::XPlaneBuilder builder(plane);
+    builder.SetName(tsl::profiler::GpuPlaneName(0));
+    tsl::profiler::XLineBuilder line = builder.GetOrCreateLine(0);
+    line.SetName(tsl::profiler::kXlaOpLineName);
+    int64_t offset_ps = 0;
+    for (const auto& [name, duration_ps] : events) {
+      tsl::profiler::XEventBuilder event =
+          line.AddEvent(*builder.GetOrCreateEventMetadata(name));
+      event.SetOffsetPs(offset_ps);
+      event.SetDurationPs(duration_ps);
+      offset_ps += duration_ps;
+    }
+  }
+
+  static LatencyEstimator::TimeCost Latency(const LatencyEstimator& estimator,
+                                            const HloInstruction* from,
+                                            const HloInstruction* target) {
+    return estimator.GetLatencyBetween(HloGraphNode(from, 0),
+                                       HloGraphNode(target, 1));
+  }
+};
+
+TEST_F(ProfileGuidedLatencyEstimatorTest, ConvertXSpace) {
+  TF_ASSERT_OK_AND_ASSIGN(auto module,
+                          ParseAndReturnVerifiedModule(kHloString));
+  tensorflow::profiler::XSpace space;
+  AddEvents({{"ars", 30'000'000},
+             {"mul", 2'000'000},
+             {"ars", 50'000'000},
+             {"mul", 4'000'000},
+             {"unknown", 1'000'000}},
+            &space);
+
+  ProfiledInstructionsProto profile =
+      ConvertXSpaceToProfiledInstructions(space, *module);
+  ASSERT_EQ(profile.costs_size(), 1);
+  EXPECT_EQ(profile.costs(0).name(), "mul");
+  EXPECT_DOUBLE_EQ(profile.costs(0).cost_us(), 3.0);
+  EXPECT_EQ(profile.costs(0).fingerprint(),
+            ProfiledInstructionFingerprint(*FindInstruction(module.get(),
+                                                            "mul")));
+  ASSERT_EQ(profile.latencies_size(), 1);
+  EXPECT_EQ(profile.latencies(0).source(), "ars");
+  EXPECT_EQ(profile.latencies(0).target(), "ard");
+  EXPECT_DOUBLE_EQ(profile.latencies(0).latency_us(), 40.0);
+}
+
+TEST_F(ProfileGuidedLatencyEstimatorTest, UsesProfileAndFallsBack) {
+  TF_ASSERT_OK_AND_ASSIGN(auto module,
+                          ParseAndReturnVerifiedModule(kHloString));
+  tensorflow::profiler::XSpace space;
+  AddEvents({{"ars", 40'000'000}, {"mul", 3'000'000}}, &space);
+  ProfileGuidedLatencyEstimator estimator(
+      std::make_unique<ApproximateLatencyEstimator>(),
+      ConvertXSpaceToProfiledInstructions(space, *module));
+
+  EXPECT_DOUBLE_EQ(estimator.NodeCost(FindInstruction(module.get(), "mul")),
+                   3.0);
+  EXPECT_DOUBLE_EQ(Latency(estimator, FindInstruction(module.get(), "ars"),
+                           FindInstruction(module.get(), "ard")),
+                   40.0);
+  EXPECT_DOUBLE_EQ(estimator.NodeCost(FindInstruction(module.get(), "out")),
+                   ApproximateLatencyEstimator::kLowCost);
+  EXPECT_DOUBLE_EQ(Latency(estimator, FindInstruction(module.get(), "mul"),
+                           FindInstruction(module.get(), "out")),
+                   1.0);
+}
+
+TEST_F(ProfileGuidedLatencyEstimatorTest, MatchesRenamedInstructions) {
+  TF_ASSERT_OK_AND_ASSIGN(auto module,
+                          ParseAndReturnVerifiedModule(kHloString));
+  TF_ASSERT_OK_AND_ASSIGN(auto renamed,
+                          ParseAndReturnVerifiedModule(kRenamedHloString));
+  tensorflow::profiler::XSpace space;
+  AddEvents({{"ars", 40'000'000}, {"mul", 3'000'000}}, &space);
+  ProfileGuidedLatencyEstimator estimator(
+      std::make_unique<ApproximateLatencyEstimator>(),
+      ConvertXSpaceToProfiledInstructions(space, *module));
+
+  EXPECT_DOUBLE_EQ(
+      estimator.NodeCost(FindInstruction(renamed.get(), "multiply.7")), 3.0);
+  EXPECT_DOUBLE_EQ(
+      Latency(estimator, FindInstruction(renamed.get(), "all-reduce-start.3"),
+              FindInstruction(renamed.get(), "all-reduce-done.3")),
+      40.0);
+}
+
+TEST_F(ProfileGuidedLatencyEstimatorTest,
+       NameAloneMatchesOnlyWithoutFingerprint) {
+  TF_ASSERT_OK_AND_ASSIGN(auto module,
+                          ParseAndReturnVerifiedModule(kHloString));
+  ProfiledInstructionsProto profile;
+  // A different instruction that had the same name in the profiled program.
+  auto* cost = profile.add_costs();
+  cost->set_name("mul");
+  cost->set_fingerprint(1);
+  cost->set_cost_us(5.0);
+  // An entry without a fingerprint, e.g. written by hand.
+  cost = profile.add_costs();
+  cost->set_name("out");
+  cost->set_cost_us(7.0);
+  ProfileGuidedLatencyEstimator estimator(
+      std::make_unique<ApproximateLatencyEstimator>(), profile);
+
+  EXPECT_DOUBLE_EQ(estimator.NodeCost(FindInstruction(module.get(), "mul")),
+                   ApproximateLatencyEstimator::kLowCost);
+  EXPECT_DOUBLE_EQ(estimator.NodeCost(FindInstruction(module.get(), "out")),
+                   7.0);
+}
+
+TEST_F(ProfileGuidedLatencyEstimatorTest, UpdateFileAveragesRuns) {
+  ProfiledInstructionsProto first;
+  auto* cost = first.add_costs();
+  cost->set_name("mul");
+  cost->set_fingerprint(1);
+  cost->set_cost_us(2.0);
+  ProfiledInstructionsProto second;
+  cost = second.add_costs();
+  cost->set_name("mul");
+  cost->set_fingerprint(1);
+  cost->set_cost_us(4.0);
+  cost = second.add_costs();
+  cost->set_name("add");
+  cost->set_fingerprint(2);
+  cost->set_cost_us(1.0);
+
+  std::string path =
+      tsl::io::JoinPath(tsl::testing::TmpDir(), "profiled_instructions.pb");
+  tsl::Env::Default()->DeleteFile(path).IgnoreError();
+  TF_ASSERT_OK(UpdateProfiledInstructionsFile(path, first));
+  TF_ASSERT_OK(UpdateProfiledInstructionsFile(path, second, 0.25));
+  TF_ASSERT_OK_AND_ASSIGN(ProfiledInstructionsProto table,
+                          LoadProfiledInstructions(path));
+  ASSERT_EQ(table.costs_size(), 2);
+  EXPECT_EQ(table.costs(0).name(), "mul");
+  EXPECT_DOUBLE_EQ(table.costs(0).cost_us(), 2.5);
+  EXPECT_EQ(table.costs(1).name(), "add");
+  EXPECT_DOUBLE_EQ(table.costs(1).cost_us(), 1.0);
+}
+
+}  // namespace
+}  // namespace xla
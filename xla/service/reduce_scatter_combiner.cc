@@ -109,10 +109,12 @@ Status CombineReduceScatters(absl::Span<HloInstruction* const> to_combine) {
 }
 }  // namespace
 
-ReduceScatterCombiner::ReduceScatterCombiner(int64_t combine_threshold_in_bytes,
-                                             int64_t combine_threshold_count)
+ReduceScatterCombiner::ReduceScatterCombiner(
+    int64_t combine_threshold_in_bytes, int64_t combine_threshold_count,
+    std::shared_ptr<const CollectiveCombinerCostModel> cost_model)
     : combine_threshold_in_bytes_(combine_threshold_in_bytes),
-      combine_threshold_count_(combine_threshold_count) {}
+      combine_threshold_count_(combine_threshold_count),
+      cost_model_(std::move(cost_model)) {}
 
 StatusOr<bool> ReduceScatterCombiner::Run(
     HloModule* module,
@@ -153,11 +155,21 @@ StatusOr<bool> ReduceScatterCombiner::Run(
       return ReduceScatterKey{std::move(*key), rs->scatter_dimension()};
     };
 
-    TF_ASSIGN_OR_RETURN(
-        bool computation_changed,
-        CombineInstructionsByKey<ReduceScatterKey>(
-            computation, key_fn, &CombineReduceScatters,
-            combine_threshold_in_bytes_, combine_threshold_count_));
+    bool computation_changed;
+    if (cost_model_ != nullptr) {
+      TF_ASSIGN_OR_RETURN(
+          computation_changed,
+          CombineInstructionsByCost<ReduceScatterKey>(
+              computation, key_fn, &CombineReduceScatters,
+              combine_threshold_in_bytes_, combine_threshold_count_,
+              *cost_model_));
+    } else {
+      TF_ASSIGN_OR_RETURN(
+          computation_changed,
+          CombineInstructionsByKey<ReduceScatterKey>(
+              computation, key_fn, &CombineReduceScatters,
+              combine_threshold_in_bytes_, combine_threshold_count_));
+    }
     changed |= computation_changed;
   }
 
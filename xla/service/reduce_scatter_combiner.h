@@ -17,6 +17,7 @@ limitations under the License.
 #define TENSORFLOW_COMPILER_XLA_SERVICE_REDUCE_SCATTER_COMBINER_H_
 
 #include "xla/hlo/ir/hlo_module.h"
+#include "xla/service/collective_combiner_cost_model.h"
 #include "xla/service/hlo_pass_interface.h"
 #include "xla/statusor.h"
 
@@ -28,8 +29,13 @@ namespace xla {
 // more efficient than many small ones.
 class ReduceScatterCombiner : public HloModulePass {
  public:
+  // If `cost_model` is set, the thresholds only bound the combined ops, whose
+  // grouping is chosen to minimize the exposed communication time. See
+  // CombineInstructionsByCost.
   ReduceScatterCombiner(int64_t combine_threshold_in_bytes,
-                        int64_t combine_threshold_count);
+                        int64_t combine_threshold_count,
+                        std::shared_ptr<const CollectiveCombinerCostModel>
+                            cost_model = nullptr);
 
   absl::string_view name() const override { return "reduce-scatter-combiner"; }
 
@@ -44,6 +50,8 @@ class ReduceScatterCombiner : public HloModulePass {
 
   // Combine reduce-scatter ops up to this threshold (number of operands).
   int64_t combine_threshold_count_;
+
+  std::shared_ptr<const CollectiveCombinerCostModel> cost_model_;
 };
 
 }  // namespace xla
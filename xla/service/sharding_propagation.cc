@@ -28,6 +28,7 @@ limitations under the License.
 #include <vector>
 
 #include "absl/algorithm/container.h"
+#include "absl/container/btree_set.h"
 #include "absl/container/flat_hash_map.h"
 #include "absl/container/flat_hash_set.h"
 #include "absl/strings/str_join.h"
@@ -2681,64 +2682,116 @@ StatusOr<bool> ShardingPropagation::Run(
   int64_t iterations = 0;
 
   std::unique_ptr<CallGraph> call_graph = CallGraph::Build(module);
+
+  // Propagation only changes shardings and never the graph, so the post orders
+  // are computed once and instructions are identified by their computation and
+  // their index in its post order.
+  std::vector<const HloComputation*> computations;
+  std::vector<std::vector<HloInstruction*>> post_orders;
+  absl::flat_hash_map<const HloInstruction*, std::pair<int64_t, int64_t>>
+      post_order_positions;
+  for (const HloComputation* computation :
+       module->computations(execution_threads)) {
+    computations.push_back(computation);
+    post_orders.push_back(computation->MakeInstructionPostOrder());
+    for (int64_t i = 0; i < post_orders.back().size(); ++i) {
+      post_order_positions[post_orders.back()[i]] = {post_orders.size() - 1,
+                                                     i};
+    }
+  }
   auto run_to_fix_point = [&](int64_t aggressiveness) {
-    absl::flat_hash_set<const HloInstruction*> already_inferred_from_operands;
-    absl::flat_hash_set<const HloInstruction*> already_inferred_from_users;
+    // Worklists of the instructions whose sharding has to be inferred (again)
+    // from their operands and from their users, as post order indices per
+    // computation. Every instruction starts out pending and is enqueued again
+    // whenever the sharding of one of its neighbors changes. The sweeps below
+    // visit the pending instructions in the same order as a full sweep over the
+    // post order that skips all the others, so the propagated shardings do not
+    // depend on the worklists, but an iteration only costs as much as the
+    // instructions it revisits.
+    using Worklist = absl::btree_set<int64_t>;
+    std::vector<Worklist> pending_from_operands;
+    std::vector<Worklist> pending_from_users;
+    for (const std::vector<HloInstruction*>& instructions : post_orders) {
+      std::vector<int64_t> all(instructions.size());
+      absl::c_iota(all, 0);
+      pending_from_operands.emplace_back(all.begin(), all.end());
+      pending_from_users.emplace_back(all.begin(), all.end());
+    }
+    auto enqueue = [&](std::vector<Worklist>& worklists,
+                       const HloInstruction* hlo) {
+      auto it = post_order_positions.find(hlo);
+      if (it != post_order_positions.end()) {
+        worklists[it->second.first].insert(it->second.second);
+      }
+    };
+    auto dequeue = [&](std::vector<Worklist>& worklists,
+                       const HloInstruction* hlo) {
+      auto it = post_order_positions.find(hlo);
+      if (it != post_order_positions.end()) {
+        worklists[it->second.first].erase(it->second.second);
+      }
+    };
+    auto clear_cache = [&](HloInstruction* hlo,
+                           HloInstruction* hlo_for_users = nullptr) {
+      for (auto operand : hlo->operands()) {
+        enqueue(pending_from_users, operand);
+      }
+      if (hlo_for_users == nullptr) {
+        hlo_for_users = hlo;
+      }
+      for (auto user : hlo_for_users->users()) {
+        enqueue(pending_from_operands, user);
+      }
+    };
     bool changed_last_iter = true;
     const bool may_merge_partial = is_spmd_ && aggressiveness > 0;
     while (changed_last_iter) {
       changed_last_iter = false;
       int64_t inferred_from_operand_counter = 0;
       int64_t inferred_from_user_counter = 0;
-      int64_t instruction_counter = 0;
+      int64_t visited_counter = 0;
       int64_t already_sharded_counter = 0;
-      for (const HloComputation* computation :
-           module->computations(execution_threads)) {
-        VLOG(2) << "Consider computation: " << computation->name();
-        std::vector<HloInstruction*> instructions =
-            computation->MakeInstructionPostOrder();
-
-        instruction_counter += instructions.size();
-        already_sharded_counter += absl::c_count_if(
-            instructions,
-            [](const HloInstruction* inst) { return inst->has_sharding(); });
-        auto clear_cache = [&](HloInstruction* hlo,
-                               HloInstruction* hlo_for_users = nullptr) {
-          for (auto operand : hlo->operands()) {
-            already_inferred_from_users.erase(operand);
-          }
-          if (hlo_for_users == nullptr) {
-            hlo_for_users = hlo;
-          }
-          for (auto user : hlo_for_users->users()) {
-            already_inferred_from_operands.erase(user);
-          }
-        };
+      if (VLOG_IS_ON(1)) {
+        for (const std::vector<HloInstruction*>& instructions : post_orders) {
+          already_sharded_counter += absl::c_count_if(
+              instructions,
+              [](const HloInstruction* inst) { return inst->has_sharding(); });
+        }
+      }
+      for (int64_t c = 0; c < post_orders.size(); ++c) {
+        const std::vector<HloInstruction*>& instructions = post_orders[c];
+        Worklist& from_operands = pending_from_operands[c];
+        Worklist& from_users = pending_from_users[c];
+        if (from_operands.empty() && from_users.empty()) {
+          continue;
+        }
+        VLOG(2) << "Consider computation: " << computations[c]->name();
         // First iterate the HLO graph in post order taking shardings from
-        // operands.
-        for (HloInstruction* instruction : instructions) {
-          if (already_inferred_from_operands.contains(instruction)) {
-            continue;
-          }
+        // operands. Instructions enqueued behind the current one are visited in
+        // this sweep, the others in the next iteration.
+        for (auto next = from_operands.begin(); next != from_operands.end();) {
+          const int64_t index = *next;
+          HloInstruction* instruction = instructions[index];
+          ++visited_counter;
           if (provided_shardings.contains(instruction)) {
-            if (!may_merge_partial) {
-              continue;
-            }
-            auto it = unspecified_dims.find(instruction);
-            HloInstruction* man_conversion_op_after;
-            if (it != unspecified_dims.end() &&
-                InferUnspecifiedDimsFromOperand(instruction, it->second,
-                                                &man_conversion_op_after)) {
-              ++inferred_from_operand_counter;
-              VLOG(2) << "Refined partial sharding (forward-pass): "
-                      << instruction->ToString();
-              clear_cache(instruction, man_conversion_op_after);
-              already_inferred_from_operands.insert(instruction);
-              changed_last_iter = true;
+            if (may_merge_partial) {
+              auto it = unspecified_dims.find(instruction);
+              HloInstruction* man_conversion_op_after;
+              if (it != unspecified_dims.end() &&
+                  InferUnspecifiedDimsFromOperand(instruction, it->second,
+                                                  &man_conversion_op_after)) {
+                ++inferred_from_operand_counter;
+                VLOG(2) << "Refined partial sharding (forward-pass): "
+                        << instruction->ToString();
+                clear_cache(instruction, man_conversion_op_after);
+                from_operands.erase(index);
+                changed_last_iter = true;
+              }
             }
+            next = from_operands.upper_bound(index);
             continue;
           }
-          already_inferred_from_operands.insert(instruction);
+          from_operands.erase(index);
           if (InferShardingFromOperands(instruction, computation_map,
                                         aggressiveness, *call_graph)) {
             ++inferred_from_operand_counter;
@@ -2753,54 +2806,59 @@ StatusOr<bool> ShardingPropagation::Run(
             }
             changed_last_iter = true;
           }
+          next = from_operands.upper_bound(index);
         }
         // Then iterate the HLO graph in reverse post order taking shardings
         // from users.
-        for (auto it = instructions.rbegin(); it != instructions.rend(); ++it) {
-          if ((*it)->IsCustomCall("SPMDFullToShardShape") ||
-              (*it)->IsCustomCall("SPMDShardToFullShape")) {
+        for (int64_t end = instructions.size();;) {
+          auto next = from_users.lower_bound(end);
+          if (next == from_users.begin()) {
+            break;
+          }
+          const int64_t index = *--next;
+          end = index;
+          HloInstruction* instruction = instructions[index];
+          ++visited_counter;
+          if (instruction->IsCustomCall("SPMDFullToShardShape") ||
+              instruction->IsCustomCall("SPMDShardToFullShape")) {
             // The manual conversion op is processed together with the sharding
             // op before it. If the conversion op is removed from cache, the
             // sharding op should also be removed.
-            if (!already_inferred_from_users.contains(*it)) {
-              already_inferred_from_users.erase((*it)->operand(0));
-            }
+            enqueue(pending_from_users, instruction->operand(0));
           }
-          if (already_inferred_from_users.contains(*it)) {
-            continue;
-          }
-          if (provided_shardings.contains(*it)) {
+          if (provided_shardings.contains(instruction)) {
             if (!may_merge_partial) {
               continue;
             }
-            auto uit = unspecified_dims.find(*it);
+            auto uit = unspecified_dims.find(instruction);
             HloInstruction* man_conversion_op_after;
             if (uit != unspecified_dims.end() &&
                 InferUnspecifiedDimsFromUsers(
-                    *it, uit->second, aggressiveness, is_spmd_,
+                    instruction, uit->second, aggressiveness, is_spmd_,
                     &man_conversion_op_after, *call_graph)) {
               ++inferred_from_user_counter;
               VLOG(2) << "Refined partial sharding (backward-pass): "
-                      << (*it)->ToString();
-              clear_cache(*it, man_conversion_op_after);
-              already_inferred_from_users.insert(*it);
+                      << instruction->ToString();
+              clear_cache(instruction, man_conversion_op_after);
+              from_users.erase(index);
               if (man_conversion_op_after != nullptr) {
-                already_inferred_from_users.insert(man_conversion_op_after);
+                dequeue(pending_from_users, man_conversion_op_after);
               }
               changed_last_iter = true;
             }
             continue;
           }
-          already_inferred_from_users.insert(*it);
-          if (InferShardingFromUsers(*it, computation_map, aggressiveness,
-                                     is_spmd_, sharding_helper_.get(),
-                                     *call_graph)) {
+          from_users.erase(index);
+          if (InferShardingFromUsers(instruction, computation_map,
+                                     aggressiveness, is_spmd_,
+                                     sharding_helper_.get(), *call_graph)) {
             ++inferred_from_user_counter;
             any_changed = true;
-            VLOG(2) << "Add sharding (backward-pass): " << (*it)->ToString();
+            VLOG(2) << "Add sharding (backward-pass): "
+                    << instruction->ToString();
             absl::flat_hash_set<HloInstruction*> changed_in_comp_prop;
-            maybe_computation_propagation(*it, &changed_in_comp_prop);
-            clear_cache(*it);
+            maybe_computation_propagation(instruction, &changed_in_comp_prop);
+            clear_cache(instruction);
             for (auto hlo : changed_in_comp_prop) {
               clear_cache(hlo);
             }
@@ -2809,7 +2867,8 @@ StatusOr<bool> ShardingPropagation::Run(
         }
       }
       VLOG(1) << "Sharding propagation iteration " << iterations << ";";
-      VLOG(1) << "  total instructions: " << instruction_counter;
+      VLOG(1) << "  total instructions: " << post_order_positions.size();
+      VLOG(1) << "  instructions visited: " << visited_counter;
       VLOG(1) << "  instructions already sharded: " << already_sharded_counter;
       VLOG(1) << "  shardings inferred from operands: "
               << inferred_from_operand_counter;
@@ -20,6 +20,7 @@ limitations under the License.
 #include <vector>
 
 #include "absl/strings/str_cat.h"
+#include "absl/strings/str_format.h"
 #include "absl/strings/str_join.h"
 #include "xla/hlo/ir/hlo_op_metadata.h"
 #include "xla/protobuf_util.h"
@@ -27,6 +28,7 @@ limitations under the License.
 #include "xla/service/hlo_parser.h"
 #include "xla/tests/hlo_test_base.h"
 #include "xla/xla_data.pb.h"
+#include "tsl/platform/test_benchmark.h"
 
 namespace op = xla::testing::opcode_matchers;
 
@@ -9121,5 +9123,43 @@ ENTRY %entry {
   EXPECT_THAT(module->entry_computation()->parameter_instruction(1),
               op::Sharding("{devices=[4]0,1,2,3}"));
 }
+
+// Propagates shardings through `num_layers` transformer-like blocks (a matmul,
+// a bias add, a nonlinearity and a residual add each) from a batch sharded
+// input and model sharded weights.
+void BM_PropagateTransformerLike(::testing::benchmark::State& state) {
+  const int64_t num_layers = state.range(0);
+  std::string hlo_string = R"(
+HloModule module
+
+ENTRY %entry {
+  %x0 = f32[8,128,256] parameter(0), sharding={devices=[4,1,1]0,1,2,3}
+  %w = f32[256,256] parameter(1), sharding={devices=[1,4]0,1,2,3}
+  %zero = f32[] constant(0)
+  %bias = f32[8,128,256] broadcast(%zero), dimensions={}
+)";
+  for (int64_t i = 0; i < num_layers; ++i) {
+    absl::StrAppendFormat(
+        &hlo_string,
+        "  %%dot%d = f32[8,128,256] dot(%%x%d, %%w), lhs_contracting_dims={2}, "
+        "rhs_contracting_dims={0}\n"
+        "  %%add%d = f32[8,128,256] add(%%dot%d, %%bias)\n"
+        "  %%tanh%d = f32[8,128,256] tanh(%%add%d)\n"
+        "  %%x%d = f32[8,128,256] add(%%x%d, %%tanh%d)\n",
+        i, i, i, i, i, i, i + 1, i, i);
+  }
+  absl::StrAppendFormat(&hlo_string,
+                        "  ROOT %%copy = f32[8,128,256] copy(%%x%d)\n}\n",
+                        num_layers);
+  for (auto s : state) {
+    state.PauseTiming();
+    auto module = ParseAndReturnUnverifiedModule(hlo_string).value();
+    state.ResumeTiming();
+    TF_CHECK_OK(ShardingPropagation(/*is_spmd=*/true).Run(module.get()).status());
+  }
+}
+
+BENCHMARK(BM_PropagateTransformerLike)->Arg(1 << 6)->Arg(1 << 10)->Arg(1 << 14);
+
 }  // namespace
 }  // namespace xla
@@ -0,0 +1,254 @@
+/* Copyright 2023 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "xla/service/spmd/collective_cost_model.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <limits>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "absl/strings/str_cat.h"
+#include "xla/hlo/ir/hlo_casting_utils.h"
+#include "xla/hlo/ir/hlo_computation.h"
+#include "xla/hlo/ir/hlo_instructions.h"
+#include "xla/hlo/ir/hlo_opcode.h"
+#include "xla/service/hlo_cost_analysis.h"
+#include "xla/shape_util.h"
+#include "tsl/platform/logging.h"
+
+namespace xla {
+namespace spmd {
+namespace {
+
+// Returns the total size of the arrays in `shape`.
+int64_t ArrayBytes(const Shape& shape) {
+  int64_t bytes = 0;
+  ShapeUtil::ForEachSubshape(
+      shape, [&](const Shape& subshape, const ShapeIndex& /*index*/) {
+        if (subshape.IsArray()) {
+          bytes += ShapeUtil::ByteSizeOf(subshape);
+        }
+      });
+  return bytes;
+}
+
+int64_t OperandBytes(const HloInstruction* hlo) {
+  int64_t bytes = 0;
+  for (const HloInstruction* operand : hlo->operands()) {
+    bytes += ArrayBytes(operand->shape());
+  }
+  return bytes;
+}
+
+// Time of a ring collective that runs `steps` rounds, each of which moves
+// `bytes` / `group_size` bytes per device.
+double RingSeconds(int64_t bytes, int64_t group_size, int64_t steps,
+                   double bytes_per_second, double latency_seconds) {
+  if (group_size <= 1 || bytes_per_second <= 0) {
+    return 0;
+  }
+  return steps * (latency_seconds + static_cast<double>(bytes) / group_size /
+                                        bytes_per_second);
+}
+
+}  // namespace
+
+CollectiveCostModel::CollectiveCostModel(std::vector<MeshAxis> axes,
+                                         double flops_per_second)
+    : axes_(std::move(axes)),
+      strides_(axes_.size()),
+      num_devices_(1),
+      flops_per_second_(flops_per_second) {
+  for (int64_t i = static_cast<int64_t>(axes_.size()) - 1; i >= 0; --i) {
+    CHECK_GT(axes_[i].size, 0);
+    strides_[i] = num_devices_;
+    num_devices_ *= axes_[i].size;
+  }
+}
+
+int64_t CollectiveCostModel::Coordinate(int64_t device, int64_t axis) const {
+  return (device % num_devices_) / strides_[axis] % axes_[axis].size;
+}
+
+CollectiveCostModel::RingParameters CollectiveCostModel::GetRingParameters(
+    absl::Span<const ReplicaGroup> groups) const {
+  RingParameters params;
+  std::vector<bool> spanned(axes_.size(), false);
+  if (groups.empty()) {
+    params.group_size = num_devices_;
+    for (int64_t axis = 0; axis < axes_.size(); ++axis) {
+      spanned[axis] = axes_[axis].size > 1;
+    }
+  }
+  for (const ReplicaGroup& group : groups) {
+    params.group_size =
+        std::max<int64_t>(params.group_size, group.replica_ids_size());
+    for (int64_t axis = 0; axis < axes_.size(); ++axis) {
+      for (int64_t i = 1; i < group.replica_ids_size() && !spanned[axis];
+           ++i) {
+        spanned[axis] = Coordinate(group.replica_ids(i), axis) !=
+                        Coordinate(group.replica_ids(0), axis);
+      }
+    }
+  }
+  params.bytes_per_second = std::numeric_limits<double>::infinity();
+  for (int64_t axis = 0; axis < axes_.size(); ++axis) {
+    if (spanned[axis]) {
+      params.bytes_per_second =
+          std::min(params.bytes_per_second, axes_[axis].bytes_per_second);
+      params.latency_seconds =
+          std::max(params.latency_seconds, axes_[axis].latency_seconds);
+    }
+  }
+  return params;
+}
+
+double CollectiveCostModel::AllGatherSeconds(
+    int64_t bytes, absl::Span<const ReplicaGroup> groups) const {
+  RingParameters ring = GetRingParameters(groups);
+  return RingSeconds(bytes, ring.group_size, ring.group_size - 1,
+                     ring.bytes_per_second, ring.latency_seconds);
+}
+
+double CollectiveCostModel::ReduceScatterSeconds(
+    int64_t bytes, absl::Span<const ReplicaGroup> groups) const {
+  return AllGatherSeconds(bytes, groups);
+}
+
+double CollectiveCostModel::AllReduceSeconds(
+    int64_t bytes, absl::Span<const ReplicaGroup> groups) const {
+  // A reduce-scatter followed by an all-gather.
+  RingParameters ring = GetRingParameters(groups);
+  return RingSeconds(bytes, ring.group_size, 2 * (ring.group_size - 1),
+                     ring.bytes_per_second, ring.latency_seconds);
+}
+
+double CollectiveCostModel::AllToAllSeconds(
+    int64_t bytes, absl::Span<const ReplicaGroup> groups) const {
+  // Every device keeps one chunk and sends one to each of the other devices.
+  RingParameters ring = GetRingParameters(groups);
+  return RingSeconds(bytes, ring.group_size, ring.group_size - 1,
+                     ring.bytes_per_second, ring.latency_seconds);
+}
+
+double CollectiveCostModel::CollectivePermuteSeconds(
+    int64_t bytes,
+    absl::Span<const std::pair<int64_t, int64_t>> source_target_pairs) const {
+  double seconds = 0;
+  for (const auto& [source, target] : source_target_pairs) {
+    double bytes_per_second = std::numeric_limits<double>::infinity();
+    double latency_seconds = 0;
+    for (int64_t axis = 0; axis < axes_.size(); ++axis) {
+      int64_t distance =
+          std::abs(Coordinate(source, axis) - Coordinate(target, axis));
+      // Axes are assumed to wrap around.
+      distance = std::min(distance, axes_[axis].size - distance);
+      if (distance > 0) {
+        bytes_per_second =
+            std::min(bytes_per_second, axes_[axis].bytes_per_second);
+        latency_seconds += distance * axes_[axis].latency_seconds;
+      }
+    }
+    seconds = std::max(seconds, latency_seconds + bytes / bytes_per_second);
+  }
+  return seconds;
+}
+
+double CollectiveCostModel::ComputeSeconds(const HloInstruction& hlo) const {
+  if (flops_per_second_ <= 0) {
+    return 0;
+  }
+  int64_t flops = 0;
+  if (hlo.opcode() == HloOpcode::kDot) {
+    flops = HloCostAnalysis::GetDotFlops(hlo.operand(0)->shape(), hlo.shape(),
+                                         hlo.dot_dimension_numbers());
+  } else if (hlo.opcode() == HloOpcode::kConvolution) {
+    flops = HloCostAnalysis::GetConvolutionFlops(
+        &hlo, hlo.operand(0)->shape(), hlo.operand(1)->shape(), hlo.shape());
+  }
+  return flops / flops_per_second_;
+}
+
+std::string CollectiveCostModel::Estimate::ToString() const {
+  return absl::StrCat(num_collectives, " collectives, ", bytes,
+                      " bytes sent per device, ", seconds * 1e3, " ms");
+}
+
+CollectiveCostModel::Estimate CollectiveCostModel::EstimateCommunication(
+    const HloModule& module) const {
+  Estimate estimate;
+  for (const HloComputation* computation : module.computations()) {
+    if (computation->IsFusionComputation()) {
+      continue;
+    }
+    for (const HloInstruction* hlo : computation->instructions()) {
+      double seconds = 0;
+      int64_t bytes = 0;
+      int64_t sent_bytes = 0;
+      switch (hlo->opcode()) {
+        case HloOpcode::kAllGather:
+        case HloOpcode::kReduceScatter:
+        case HloOpcode::kAllToAll:
+        case HloOpcode::kAllReduce: {
+          absl::Span<const ReplicaGroup> groups = hlo->replica_groups();
+          int64_t group_size = GetRingParameters(groups).group_size;
+          int64_t steps = group_size - 1;
+          switch (hlo->opcode()) {
+            case HloOpcode::kAllGather:
+              bytes = ArrayBytes(hlo->shape());
+              seconds = AllGatherSeconds(bytes, groups);
+              break;
+            case HloOpcode::kReduceScatter:
+              bytes = OperandBytes(hlo);
+              seconds = ReduceScatterSeconds(bytes, groups);
+              break;
+            case HloOpcode::kAllToAll:
+              bytes = OperandBytes(hlo);
+              seconds = AllToAllSeconds(bytes, groups);
+              break;
+            default:
+              bytes = OperandBytes(hlo);
+              seconds = AllReduceSeconds(bytes, groups);
+              steps *= 2;
+              break;
+          }
+          sent_bytes = bytes / group_size * steps;
+          break;
+        }
+        case HloOpcode::kCollectivePermute: {
+          bytes = ArrayBytes(hlo->operand(0)->shape());
+          const auto& pairs = Cast<HloCollectivePermuteInstruction>(hlo)
+                                  ->source_target_pairs();
+          seconds = CollectivePermuteSeconds(bytes, pairs);
+          sent_bytes = pairs.empty() ? 0 : bytes;
+          break;
+        }
+        default:
+          continue;
+      }
+      ++estimate.num_collectives;
+      estimate.bytes += sent_bytes;
+      estimate.seconds += seconds;
+    }
+  }
+  return estimate;
+}
+
+}  // namespace spmd
+}  // namespace xla
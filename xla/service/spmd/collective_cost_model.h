@@ -0,0 +1,126 @@
+/* Copyright 2023 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef TENSORFLOW_COMPILER_XLA_SERVICE_SPMD_COLLECTIVE_COST_MODEL_H_
+#define TENSORFLOW_COMPILER_XLA_SERVICE_SPMD_COLLECTIVE_COST_MODEL_H_
+
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "absl/types/span.h"
+#include "xla/hlo/ir/hlo_instruction.h"
+#include "xla/hlo/ir/hlo_module.h"
+#include "xla/xla_data.pb.h"
+
+namespace xla {
+namespace spmd {
+
+// Estimates the time of collectives on a device mesh, which the SPMD
+// partitioner uses to choose between partitioning strategies.
+//
+// Devices are laid out on the mesh in row-major order, i.e. the last axis
+// varies fastest with the device id. Device ids in replica groups are taken
+// modulo the number of devices in the mesh, so a mesh describing the
+// partitions can be used with the global device ids of a multi-replica
+// program.
+//
+// Collectives over a group are modeled as rings that are limited by the
+// slowest mesh axis the group spans. Subclasses can override any of the
+// estimates to model a specific interconnect.
+class CollectiveCostModel {
+ public:
+  struct MeshAxis {
+    int64_t size = 1;
+    // Bandwidth of a link along this axis, per device and direction.
+    double bytes_per_second = 1e11;
+    // Cost of a single hop along this axis.
+    double latency_seconds = 0;
+  };
+
+  // `flops_per_second` is the compute throughput of a single device and is
+  // only used by ComputeSeconds.
+  explicit CollectiveCostModel(std::vector<MeshAxis> axes,
+                               double flops_per_second = 0);
+  virtual ~CollectiveCostModel() = default;
+
+  const std::vector<MeshAxis>& axes() const { return axes_; }
+  int64_t num_devices() const { return num_devices_; }
+  double flops_per_second() const { return flops_per_second_; }
+
+  // `bytes` is the size of the gathered buffer, i.e. of the output of an
+  // all-gather or the input of a reduce-scatter.
+  virtual double AllGatherSeconds(
+      int64_t bytes, absl::Span<const ReplicaGroup> groups) const;
+  virtual double ReduceScatterSeconds(
+      int64_t bytes, absl::Span<const ReplicaGroup> groups) const;
+  // `bytes` is the size of the reduced buffer.
+  virtual double AllReduceSeconds(int64_t bytes,
+                                  absl::Span<const ReplicaGroup> groups) const;
+  // `bytes` is the size of the buffer that each device exchanges.
+  virtual double AllToAllSeconds(int64_t bytes,
+                                 absl::Span<const ReplicaGroup> groups) const;
+  // `bytes` is the size of the buffer that each source sends.
+  virtual double CollectivePermuteSeconds(
+      int64_t bytes,
+      absl::Span<const std::pair<int64_t, int64_t>> source_target_pairs) const;
+
+  // Returns the time of the floating point operations of a dot or convolution
+  // on a single device, or 0 for other instructions or if no compute
+  // throughput was given.
+  virtual double ComputeSeconds(const HloInstruction& hlo) const;
+
+  // Communication of a partitioned module.
+  struct Estimate {
+    int64_t num_collectives = 0;
+    // Bytes that each device sends.
+    int64_t bytes = 0;
+    double seconds = 0;
+
+    std::string ToString() const;
+  };
+
+  // Sums the estimates of the collectives in `module`. Every instruction is
+  // counted once, regardless of how often its computation runs. Collectives
+  // without replica groups are assumed to span the whole mesh.
+  Estimate EstimateCommunication(const HloModule& module) const;
+
+ protected:
+  // Returns the number of devices in the largest group, and the bandwidth and
+  // per-hop latency of the slowest mesh axis the groups span.
+  struct RingParameters {
+    int64_t group_size = 1;
+    double bytes_per_second = 0;
+    double latency_seconds = 0;
+  };
+  RingParameters GetRingParameters(
+      absl::Span<const ReplicaGroup> groups) const;
+
+  // Returns the coordinate of `device` along `axis`.
+  int64_t Coordinate(int64_t device, int64_t axis) const;
+
+ private:
+  std::vector<MeshAxis> axes_;
+  // strides_[i] is the distance between device ids of neighbors along axis i.
+  std::vector<int64_t> strides_;
+  int64_t num_devices_;
+  double flops_per_second_;
+};
+
+}  // namespace spmd
+}  // namespace xla
+
+#endif  // TENSORFLOW_COMPILER_XLA_SERVICE_SPMD_COLLECTIVE_COST_MODEL_H_
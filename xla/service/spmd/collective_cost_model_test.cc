@@ -0,0 +1,177 @@
+/* Copyright 2023 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "xla/service/spmd/collective_cost_model.h"
+
+#include <cstdint>
+#include <initializer_list>
+#include <utility>
+#include <vector>
+
+#include "absl/types/span.h"
+#include "xla/hlo/ir/hlo_instruction.h"
+#include "xla/tests/hlo_test_base.h"
+#include "xla/xla_data.pb.h"
+#include "tsl/lib/core/status_test_util.h"
+#include "tsl/platform/test.h"
+
+namespace xla {
+namespace spmd {
+namespace {
+
+using CollectiveCostModelTest = HloTestBase;
+
+ReplicaGroup MakeGroup(std::initializer_list<int64_t> ids) {
+  ReplicaGroup group;
+  for (int64_t id : ids) {
+    group.add_replica_ids(id);
+  }
+  return group;
+}
+
+// A 2x4 mesh whose major axis is ten times slower than its minor axis.
+CollectiveCostModel MakeMesh() {
+  return CollectiveCostModel(
+      {{/*size=*/2, /*bytes_per_second=*/1e9, /*latency_seconds=*/1e-3},
+       {/*size=*/4, /*bytes_per_second=*/1e10, /*latency_seconds=*/0}},
+      /*flops_per_second=*/1e12);
+}
+
+TEST_F(CollectiveCostModelTest, RingUsesSlowestSpannedAxis) {
+  CollectiveCostModel model = MakeMesh();
+  EXPECT_EQ(model.num_devices(), 8);
+
+  // Devices 0-3 only differ along the fast axis.
+  std::vector<ReplicaGroup> minor = {MakeGroup({0, 1, 2, 3}),
+                                     MakeGroup({4, 5, 6, 7})};
+  EXPECT_DOUBLE_EQ(model.AllGatherSeconds(4000, minor), 3 * 1000 / 1e10);
+  EXPECT_DOUBLE_EQ(model.ReduceScatterSeconds(4000, minor), 3 * 1000 / 1e10);
+  EXPECT_DOUBLE_EQ(model.AllReduceSeconds(4000, minor), 6 * 1000 / 1e10);
+  EXPECT_DOUBLE_EQ(model.AllToAllSeconds(4000, minor), 3 * 1000 / 1e10);
+
+  // Devices 0 and 4 only differ along the slow axis.
+  std::vector<ReplicaGroup> major = {MakeGroup({0, 4}), MakeGroup({1, 5}),
+                                     MakeGroup({2, 6}), MakeGroup({3, 7})};
+  EXPECT_DOUBLE_EQ(model.AllGatherSeconds(4000, major), 1e-3 + 2000 / 1e9);
+
+  // Groups spanning both axes are limited by the slow one, as are empty
+  // groups, which span the whole mesh.
+  std::vector<ReplicaGroup> all = {MakeGroup({0, 1, 2, 3, 4, 5, 6, 7})};
+  EXPECT_DOUBLE_EQ(model.AllGatherSeconds(8000, all), 7 * (1e-3 + 1000 / 1e9));
+  EXPECT_DOUBLE_EQ(model.AllGatherSeconds(8000, {}),
+                   model.AllGatherSeconds(8000, all));
+
+  // Ids beyond the mesh belong to other replicas laid out the same way.
+  std::vector<ReplicaGroup> replica1 = {MakeGroup({8, 9, 10, 11})};
+  EXPECT_DOUBLE_EQ(model.AllGatherSeconds(4000, replica1),
+                   model.AllGatherSeconds(4000, minor));
+
+  std::vector<ReplicaGroup> singletons = {MakeGroup({0}), MakeGroup({1})};
+  EXPECT_EQ(model.AllReduceSeconds(4000, singletons), 0);
+}
+
+TEST_F(CollectiveCostModelTest, CollectivePermute) {
+  CollectiveCostModel model = MakeMesh();
+  // Neighbors along the minor axis, including the wrap around link.
+  EXPECT_DOUBLE_EQ(model.CollectivePermuteSeconds(1000, {{0, 1}, {3, 0}}),
+                   1000 / 1e10);
+  // The slowest pair determines the time.
+  EXPECT_DOUBLE_EQ(model.CollectivePermuteSeconds(1000, {{0, 1}, {1, 5}}),
+                   1e-3 + 1000 / 1e9);
+  EXPECT_EQ(model.CollectivePermuteSeconds(1000, {{2, 2}}), 0);
+}
+
+TEST_F(CollectiveCostModelTest, EstimateCommunication) {
+  absl::string_view hlo_string = R"(
+HloModule module
+
+add {
+  x = f32[] parameter(0)
+  y = f32[] parameter(1)
+  ROOT add = f32[] add(x, y)
+}
+
+ENTRY entry {
+  p0 = f32[4,250] parameter(0)
+  p1 = f32[250,4] parameter(1)
+  dot = f32[4,4] dot(p0, p1), lhs_contracting_dims={1},
+    rhs_contracting_dims={0}
+  ar = f32[250,4] all-reduce(p1), channel_id=1,
+    replica_groups={{0,1,2,3},{4,5,6,7}}, use_global_device_ids=true,
+    to_apply=add
+  ag = f32[1000,4] all-gather(ar), channel_id=2,
+    replica_groups={{0,1,2,3},{4,5,6,7}}, dimensions={0},
+    use_global_device_ids=true
+  ROOT cp = f32[1000,4] collective-permute(ag), channel_id=3,
+    source_target_pairs={{0,4},{4,0}}
+})";
+  TF_ASSERT_OK_AND_ASSIGN(
+      auto module, ParseAndReturnVerifiedModule(hlo_string, /*replica_count=*/1,
+                                                /*num_partitions=*/8));
+  CollectiveCostModel model = MakeMesh();
+
+  CollectiveCostModel::Estimate estimate = model.EstimateCommunication(*module);
+  EXPECT_EQ(estimate.num_collectives, 3);
+  // The all-reduce sends 6 quarters of 4000 bytes and the all-gather 3
+  // quarters of 16000 bytes.
+  EXPECT_EQ(estimate.bytes, 6000 + 12000 + 16000);
+  EXPECT_DOUBLE_EQ(estimate.seconds,
+                   6000 / 1e10 + 12000 / 1e10 + 1e-3 + 16000 / 1e9);
+
+  const HloInstruction* dot =
+      module->entry_computation()->GetInstructionWithName("dot");
+  EXPECT_DOUBLE_EQ(model.ComputeSeconds(*dot), 2 * 4 * 4 * 250 / 1e12);
+}
+
+// Charges a fixed time for every all-reduce.
+class FixedAllReduceCostModel : public CollectiveCostModel {
+ public:
+  using CollectiveCostModel::CollectiveCostModel;
+
+  double AllReduceSeconds(
+      int64_t bytes, absl::Span<const ReplicaGroup> groups) const override {
+    return 1.0;
+  }
+};
+
+TEST_F(CollectiveCostModelTest, EstimateCommunicationUsesOverrides) {
+  absl::string_view hlo_string = R"(
+HloModule module
+
+add {
+  x = f32[] parameter(0)
+  y = f32[] parameter(1)
+  ROOT add = f32[] add(x, y)
+}
+
+ENTRY entry {
+  p0 = f32[250,4] parameter(0)
+  ROOT ar = f32[250,4] all-reduce(p0), channel_id=1,
+    replica_groups={{0,1,2,3},{4,5,6,7}}, use_global_device_ids=true,
+    to_apply=add
+})";
+  TF_ASSERT_OK_AND_ASSIGN(
+      auto module, ParseAndReturnVerifiedModule(hlo_string, /*replica_count=*/1,
+                                                /*num_partitions=*/8));
+  FixedAllReduceCostModel model(MakeMesh().axes());
+  CollectiveCostModel::Estimate estimate = model.EstimateCommunication(*module);
+  EXPECT_EQ(estimate.num_collectives, 1);
+  EXPECT_EQ(estimate.bytes, 6000);
+  EXPECT_DOUBLE_EQ(estimate.seconds, 1.0);
+}
+
+}  // namespace
+}  // namespace spmd
+}  // namespace xla
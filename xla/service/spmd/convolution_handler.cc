@@ -503,8 +503,8 @@ PartitionConvolutionWithSpatialDimensionHaloExchangeOnRHS(
       auto conv, create_sharded_conv(conv_lhs, rhs_with_halo, b, new_window));
 
   auto ar = collective_ops_creator.create_cross_partition_all_reduce(
-      b, conv, MakeBinaryAdd(original_hlo->shape().element_type(), module), {},
-      (*lhs.state().next_channel_id)++);
+      b, conv, MakeBinaryAdd(original_hlo->shape().element_type(), lhs.state()),
+      {}, (*lhs.state().next_channel_id)++);
   ar->set_sharding(HloSharding::Replicate());
   return PartitionedHlo(ar, output_base_shape, lhs.state())
       .Reshard(output_sharding)
@@ -728,7 +728,8 @@ PartitionConvolutionWithSpatialDimensionHaloExchangeOnLHS(
       auto conv, create_sharded_conv(lhs_with_halo, rhs.hlo(), b, new_window));
   auto ar =
       lhs.state().collective_ops_creator.create_cross_partition_all_reduce(
-          b, conv, MakeBinaryAdd(output_base_shape.element_type(), module), {},
+          b, conv,
+          MakeBinaryAdd(output_base_shape.element_type(), lhs.state()), {},
           (*lhs.state().next_channel_id)++);
   ar->set_sharding(HloSharding::Replicate());
   return PartitionedHlo(ar, output_base_shape, lhs.state())
@@ -189,8 +189,8 @@ Status SpmdPartitioningVisitor::HandleCustomCallTopK(HloInstruction* hlo) {
   TF_ASSIGN_OR_RETURN(auto new_module,
                       HloModule::CreateFromProto(comparator.proto(), config));
   HloCloneContext context(module_);
-  auto compare_computation =
-      module_->DeepCloneComputation(new_module->entry_computation(), &context);
+  auto compare_computation = AddEmbeddedComputation(
+      new_module->entry_computation()->Clone(context.suffix(), &context));
   // Each partition needs to do TopK separately, thus the base shape for sort
   // becomes [ceil(batch_size / batch_dim_partition), k * shard_count].
   const Shape sort_shape = ShapeUtil::MakeTupleShape(
@@ -17,6 +17,7 @@ limitations under the License.
 #include <deque>
 #include <memory>
 #include <optional>
+#include <vector>
 
 #include "absl/algorithm/container.h"
 #include "absl/cleanup/cleanup.h"
@@ -558,7 +559,7 @@ std::optional<WindowedEinsumConfig> GetWindowedEinsumConfiguration(
           collective->opcode() == HloOpcode::kAllReduce) {
         communication_time_in_ms = visitor->GetCommunicationTimeInMilliSec(
             ShapeUtil::ByteSizeOf(collective->shape()),
-            collective->replica_groups());
+            collective->replica_groups(), collective->opcode());
       }
     } else {
       auto new_lhs =
@@ -594,12 +595,13 @@ std::optional<WindowedEinsumConfig> GetWindowedEinsumConfiguration(
       collective = new_lhs.state().partitioner->AllReduceAlongShardingDims(
           b, dot, new_lhs.sharding(), new_lhs.state().next_channel_id,
           lhs_contracting_dims, new_lhs.state().collective_ops_creator,
-          MakeBinaryAdd(dot->shape().element_type(), module));
+          MakeBinaryAdd(dot->shape().element_type(), new_lhs.state()));
       if (collective->opcode() == HloOpcode::kConvert) {
         collective = collective->mutable_operand(0);
       }
       communication_time_in_ms = visitor->GetCommunicationTimeInMilliSec(
-          ShapeUtil::ByteSizeOf(dot->shape()), collective->replica_groups());
+          ShapeUtil::ByteSizeOf(dot->shape()), collective->replica_groups(),
+          HloOpcode::kAllReduce);
     }
 
     VLOG(2) << "collective: " << collective->ToString() << "\n"
@@ -1739,11 +1741,11 @@ StatusOr<HloInstruction*> PartitionBaseCase(
             operands_sharded_at_contracting_dims ? o
             : windowed_op_is_lhs                 ? l
                                                  : r,
-            module->AddEmbeddedComputation(cp_b.Build()),
+            AddEmbeddedComputation(lhs.state(), cp_b.Build()),
             operands_sharded_at_contracting_dims ? o
             : windowed_op_is_lhs                 ? l
                                                  : r,
-            module->AddEmbeddedComputation(ncp_b.Build())));
+            AddEmbeddedComputation(lhs.state(), ncp_b.Build())));
       }
       if (operands_sharded_at_contracting_dims) {
         o = conditional;
@@ -1775,8 +1777,9 @@ StatusOr<HloInstruction*> PartitionBaseCase(
             LiteralUtil::CreateR0<uint32_t>(adapted_num_partitions))),
         ComparisonDirection::kLt));
     auto while_loop = b->AddInstruction(HloInstruction::CreateWhile(
-        cond_param->shape(), module->AddEmbeddedComputation(cond_b.Build()),
-        module->AddEmbeddedComputation(body_b.Build()),
+        cond_param->shape(),
+        AddEmbeddedComputation(lhs.state(), cond_b.Build()),
+        AddEmbeddedComputation(lhs.state(), body_b.Build()),
         b->AddInstruction(HloInstruction::CreateTuple(
             {lhs_hlo, rhs_hlo, result_buffer, extra_buffer, iteration}))));
     windowed_dot_general_loops->push_back(
@@ -1884,7 +1887,7 @@ StatusOr<HloInstruction*> PartitionBaseCase(
     auto ar = lhs.state().partitioner->AllReduceAlongShardingDims(
         b, dot, lhs.sharding(), lhs.state().next_channel_id,
         lhs_contracting_dims, lhs.state().collective_ops_creator,
-        MakeBinaryAdd(output_base_shape.element_type(), module));
+        MakeBinaryAdd(output_base_shape.element_type(), lhs.state()));
     ar->set_sharding(HloSharding::Replicate());
     return PartitionedHlo(ar, output_base_shape, lhs.state())
         .Reshard(output_sharding)
@@ -1952,19 +1955,35 @@ StatusOr<HloInstruction*> PartitionBaseCase(
       return false;
     }
 
-    if (operand_idx == 0) {
-      // If LHS and output are replicated, we compare the cost of all-gather
-      // on RHS vs all-reduce on the output.
-      return (rhs_contracting_partitions == num_partitions) &&
-             lhs.sharding().IsReplicated() &&
-             ShapeUtil::ElementsIn(rhs.base_shape()) >
-                 ShapeUtil::ElementsIn(output_base_shape);
-    } else {
-      return (lhs_contracting_partitions == num_partitions) &&
-             rhs.sharding().IsReplicated() &&
-             ShapeUtil::ElementsIn(lhs.base_shape()) >
-                 ShapeUtil::ElementsIn(output_base_shape);
+    // If the operand and output are replicated, we compare the cost of
+    // all-gather on the other operand vs all-reduce on the output.
+    const PartitionedHlo& operand = operand_idx == 0 ? lhs : rhs;
+    const PartitionedHlo& other = operand_idx == 0 ? rhs : lhs;
+    const int64_t other_contracting_partitions =
+        operand_idx == 0 ? rhs_contracting_partitions
+                         : lhs_contracting_partitions;
+    if (other_contracting_partitions != num_partitions ||
+        !operand.sharding().IsReplicated()) {
+      return false;
+    }
+    if (options.collective_cost_model != nullptr) {
+      std::vector<std::vector<int64_t>> all_partitions(1);
+      all_partitions[0].resize(num_partitions);
+      absl::c_iota(all_partitions[0], 0);
+      const std::vector<ReplicaGroup> groups =
+          visitor->CreateReplicaGroups(all_partitions);
+      const double all_gather_seconds =
+          options.collective_cost_model->AllGatherSeconds(
+              ShapeUtil::ByteSizeOf(other.base_shape()), groups);
+      const double all_reduce_seconds =
+          options.collective_cost_model->AllReduceSeconds(
+              ShapeUtil::ByteSizeOf(output_base_shape), groups);
+      VLOG(2) << "all_gather_seconds: " << all_gather_seconds
+              << " all_reduce_seconds: " << all_reduce_seconds;
+      return all_gather_seconds > all_reduce_seconds;
     }
+    return ShapeUtil::ElementsIn(other.base_shape()) >
+           ShapeUtil::ElementsIn(output_base_shape);
   };
 
   // When the output is replicated and one of the operands is partitioned along
@@ -1990,7 +2009,7 @@ StatusOr<HloInstruction*> PartitionBaseCase(
     return lhs.state().partitioner->AllReduceAlongShardingDims(
         b, dot, lhs.sharding(), lhs.state().next_channel_id,
         lhs_contracting_dims, lhs.state().collective_ops_creator,
-        MakeBinaryAdd(output_base_shape.element_type(), module));
+        MakeBinaryAdd(output_base_shape.element_type(), lhs.state()));
   }
   return nullptr;
 }
@@ -2712,7 +2731,7 @@ StatusOr<HloInstruction*> PartitionDotGroupOnContracting(
       result = lhs.state().partitioner->AllReduceAlongShardingDims(
           b, result, outer_output_tmp_sharding, lhs.state().next_channel_id,
           output_slice_dims, lhs.state().collective_ops_creator,
-          MakeBinaryAdd(output_base_shape.element_type(), module));
+          MakeBinaryAdd(output_base_shape.element_type(), lhs.state()));
       // Use resharding to slice the output. Use a temporary reshard cache since
       // we are faking with replicated sharding.
       PartitionedHlo::PartitioningState new_state = lhs.state();
@@ -2733,13 +2752,13 @@ StatusOr<HloInstruction*> PartitionDotGroupOnContracting(
         result = lhs.state().partitioner->AllReduceAlongShardingDims(
             b, result, outer_output_tmp_sharding, lhs.state().next_channel_id,
             {output_base_shape.rank()}, lhs.state().collective_ops_creator,
-            MakeBinaryAdd(output_base_shape.element_type(), module));
+            MakeBinaryAdd(output_base_shape.element_type(), lhs.state()));
       }
     } else {
       result = lhs.state().partitioner->AllReduceAlongShardingDims(
           b, result, lhs_sharding, lhs.state().next_channel_id, lhs_dims,
           lhs.state().collective_ops_creator,
-          MakeBinaryAdd(output_base_shape.element_type(), module));
+          MakeBinaryAdd(output_base_shape.element_type(), lhs.state()));
     }
     return result;
   };
@@ -2795,7 +2814,7 @@ StatusOr<HloInstruction*> PartitionDotGroupOnContracting(
       HloInstruction* ar = lhs.state().partitioner->AllReduceAlongShardingDims(
           b, maybe_windowed_dot, lhs_sharding, lhs.state().next_channel_id,
           lhs_dims, lhs.state().collective_ops_creator,
-          MakeBinaryAdd(output_base_shape.element_type(), module));
+          MakeBinaryAdd(output_base_shape.element_type(), lhs.state()));
       maybe_windowed_dot = ar;
       outer_output_tmp_sharding =
           hlo_sharding_util::PartiallyReplicateTiledShardingOnDims(
@@ -3201,11 +3220,13 @@ bool PrioritizeContractingDimensionsPartitioning(
   auto reduce_scatter_subgroups = GetPartitionGroupsForReplication(
       outer_output_tmp_sharding, output_slice_dims);
   const double all_gather_time_in_ms = visitor->GetCommunicationTimeInMilliSec(
-      all_gather_bytes, visitor->CreateReplicaGroups(all_gather_subgroups));
+      all_gather_bytes, visitor->CreateReplicaGroups(all_gather_subgroups),
+      HloOpcode::kAllGather);
   const double reduce_scatter_time_in_ms =
       visitor->GetCommunicationTimeInMilliSec(
           reduce_scatter_bytes,
-          visitor->CreateReplicaGroups(reduce_scatter_subgroups));
+          visitor->CreateReplicaGroups(reduce_scatter_subgroups),
+          HloOpcode::kReduceScatter);
 
   Shape other_original_shape = other_hlo->shape();
   *other_hlo->mutable_shape() =
@@ -3320,11 +3341,13 @@ bool LhsIsBestMatchForNonContractingPartitioning(
       const double lhs_all_gather_time_in_ms =
           visitor->GetCommunicationTimeInMilliSec(
               lhs_all_gather_bytes,
-              visitor->CreateReplicaGroups(lhs_all_gather_subgroups));
+              visitor->CreateReplicaGroups(lhs_all_gather_subgroups),
+              HloOpcode::kAllGather);
       const double rhs_all_gather_time_in_ms =
           visitor->GetCommunicationTimeInMilliSec(
               rhs_all_gather_bytes,
-              visitor->CreateReplicaGroups(rhs_all_gather_subgroups));
+              visitor->CreateReplicaGroups(rhs_all_gather_subgroups),
+              HloOpcode::kAllGather);
 
       HloInstruction* compute_lhs = lhs.hlo();
       Shape lhs_original_shape = compute_lhs->shape();
@@ -226,7 +226,8 @@ HloInstruction* GetFinalFftUsingCollectivePermute(
     HloInstruction* hlo, const HloSharding& sharding,
     const SPMDCollectiveOpsCreator& collective_ops_creator,
     int64_t num_partitions, HloInstruction* partition_id,
-    int64_t* next_channel_id, HloModule* module, SpmdBuilder* b) {
+    int64_t* next_channel_id, const PartitionedHlo::PartitioningState& state,
+    SpmdBuilder* b) {
   auto iteration = b->AddInstruction(
       HloInstruction::CreateConstant(LiteralUtil::CreateR0<uint32_t>(0)));
   auto converted_partition_id = b->AddInstruction(HloInstruction::CreateConvert(
@@ -324,8 +325,8 @@ HloInstruction* GetFinalFftUsingCollectivePermute(
 
   // Build while loop.
   auto while_loop = b->AddInstruction(HloInstruction::CreateWhile(
-      cond_param->shape(), module->AddEmbeddedComputation(cond_b.Build()),
-      module->AddEmbeddedComputation(body_b.Build()),
+      cond_param->shape(), AddEmbeddedComputation(state, cond_b.Build()),
+      AddEmbeddedComputation(state, body_b.Build()),
       b->AddInstruction(
           HloInstruction::CreateTuple({zero, hlo, converted_partition_id,
                                        converted_partition_id, iteration}))));
@@ -420,7 +421,7 @@ Status SpmdPartitioningVisitor::HandleFft(HloInstruction* hlo) {
   result = GetFinalFftUsingCollectivePermute(
       result, hlo->sharding(), partitioned_input.state().collective_ops_creator,
       num_partitions_, partitioned_input.state().partition_id,
-      partitioned_input.state().next_channel_id, module_,
+      partitioned_input.state().next_channel_id, partitioned_input.state(),
       partitioned_input.state().b);
 
   result->set_sharding(hlo->sharding());
@@ -439,7 +439,7 @@ StatusOr<HloInstruction*> PartitionGatherTrivialSlicedOperandDimensions(
       filter = b->AddInstruction(HloInstruction::CreateReduce(
           ShapeUtil::MakeShape(PRED, reduced_filter_dims), filter,
           CreateR0WithType(PRED, false, b), {dnums.index_vector_dim()},
-          MakeBinaryAdd(PRED, indices.state().module)));
+          MakeBinaryAdd(PRED, indices.state())));
     }
     std::vector<int64_t> batch_dims;
     for (int64_t i = 0; i < pgather->shape().rank(); ++i) {
@@ -461,8 +461,7 @@ StatusOr<HloInstruction*> PartitionGatherTrivialSlicedOperandDimensions(
     auto ar = operand.state().partitioner->AllReduceAlongShardingDims(
         b, filtered, original_operand_sharding, operand.state().next_channel_id,
         all_dims, operand.state().collective_ops_creator,
-        MakeBinaryAdd(filtered->shape().element_type(),
-                      operand.state().module));
+        MakeBinaryAdd(filtered->shape().element_type(), operand.state()));
     VLOG(5) << "[Gather partitioning]: Partitioned as trivial operand "
                "batch_dim slice";
     ar->set_sharding(hlo_sharding_util::UngroupSharding(output_grouped));
@@ -18,6 +18,8 @@ limitations under the License.
 #include <algorithm>
 #include <cstdint>
 #include <functional>
+#include <iterator>
+#include <limits>
 #include <memory>
 #include <numeric>
 #include <optional>
@@ -31,6 +33,7 @@ limitations under the License.
 #include "absl/container/inlined_vector.h"
 #include "absl/strings/str_cat.h"
 #include "absl/strings/str_join.h"
+#include "absl/synchronization/notification.h"
 #include "absl/types/span.h"
 #include "xla/comparison_util.h"
 #include "xla/hlo/ir/dfs_hlo_visitor_with_default.h"
@@ -57,6 +60,8 @@ limitations under the License.
 #include "xla/util.h"
 #include "xla/window_util.h"
 #include "xla/xla_data.pb.h"
+#include "tsl/platform/env.h"
+#include "tsl/platform/threadpool.h"
 
 namespace xla {
 namespace spmd {
@@ -65,6 +70,79 @@ namespace {
 using hlo_sharding_util::GroupedSharding;
 }  // namespace
 
+// While a task runs, its visitor records the changes that the serial
+// partitioner would make to the module as steps: the computations it creates
+// and the called computations, which are partitioned by tasks of their own.
+// Committing the task replays the steps in order, which gives the new
+// computations and instructions the same names and unique ids as partitioning
+// serially.
+struct SpmdPartitioningTask {
+  // State shared by the tasks that partition a module.
+  struct Context {
+    tsl::thread::ThreadPool* thread_pool = nullptr;
+    SpmdLogger* logger = nullptr;
+    const CallGraph* call_graph = nullptr;
+    // Every task allocates channel ids from its own counter, starting from
+    // this id, and renumbers them when it is committed.
+    int64_t first_channel_id = 0;
+  };
+
+  struct Step {
+    // A computation created by the visitor, or
+    std::unique_ptr<HloComputation> computation;
+    // a called computation.
+    std::unique_ptr<SpmdPartitioningTask> callee;
+    // The channel id counter of this task when `callee` was scheduled.
+    int64_t next_channel_id = 0;
+  };
+
+  SpmdPartitioningTask(const Context* context, HloComputation* computation,
+                       const HloSharding& root_sharding)
+      : context(context),
+        computation(computation),
+        root_sharding(root_sharding),
+        next_channel_id(context->first_channel_id) {}
+
+  const Context* context;
+  HloComputation* computation;
+  HloSharding root_sharding;
+  int64_t next_channel_id;
+  std::vector<Step> steps;
+  std::unique_ptr<SpmdPartitioningVisitor> visitor;
+
+  // Set when the task is done.
+  Status status;
+  std::unique_ptr<HloComputation> partitioned;
+  absl::Notification done;
+
+  // Set when the task is committed.
+  HloComputation* partitioned_computation = nullptr;
+};
+
+namespace {
+
+HloComputation* AddOrRecordEmbeddedComputation(
+    HloModule* module, SpmdPartitioningTask* task,
+    std::unique_ptr<HloComputation> computation) {
+  if (task == nullptr) {
+    return module->AddEmbeddedComputation(std::move(computation));
+  }
+  HloComputation* recorded = computation.get();
+  SpmdPartitioningTask::Step step;
+  step.computation = std::move(computation);
+  task->steps.push_back(std::move(step));
+  return recorded;
+}
+
+}  // namespace
+
+HloComputation* AddEmbeddedComputation(
+    const PartitionedHlo::PartitioningState& state,
+    std::unique_ptr<HloComputation> computation) {
+  return AddOrRecordEmbeddedComputation(state.module, state.task,
+                                        std::move(computation));
+}
+
 std::string SpmdLogger::MakeReport() {
   std::string report;
   absl::StrAppend(&report,
@@ -1313,7 +1391,7 @@ HloInstruction* PartitionedHlo::ReplicatePartial(
         state_.b->AddInstruction(HloInstruction::CreateDynamicUpdateSlice(
             padded_target_shape, zero_bcast, result, offsets));
     HloComputation* reduction =
-        MakeBinaryAdd(shard_shape.element_type(), state_.module);
+        MakeBinaryAdd(shard_shape.element_type(), state_);
     result = state_.partitioner->AllReduceAlongShardingDims(
         state_.b, dus, sharding(), state_.next_channel_id, dus_ar_dims,
         state_.collective_ops_creator, reduction);
@@ -1497,7 +1575,7 @@ PartitionedHlo PartitionedHlo::Broadcast() const {
   auto operand = state_.b->AddInstruction(HloInstruction::CreateTernary(
       shape, HloOpcode::kSelect, is_src_core, hlo(), zero_bcast));
   HloComputation* reduction =
-      MakeBinaryAdd(shape.element_type(), state_.module);
+      MakeBinaryAdd(shape.element_type(), state_);
 
   auto result = state_.collective_ops_creator.create_cross_partition_all_reduce(
       state_.b, operand, reduction, {}, NewChannel());
@@ -2269,6 +2347,7 @@ SpmdPartitioningVisitor::MakePartitioningState() {
   state.next_channel_id = next_channel_id_;
   state.reshard_cache = &reshard_cache_;
   state.partitioner = partitioner_;
+  state.task = partitioning_task_;
   if (!device_groups_.empty()) {
     // Use the original collective creator and partition_id to call
     // CreatePerGroupPartitioningState(). Current collective_ops_creator_ and
@@ -2283,6 +2362,36 @@ SpmdPartitioningVisitor::MakePartitioningState() {
   return state;
 }
 
+double SpmdPartitioningVisitor::GetComputationTimeInMilliSec(
+    HloInstruction* hlo) {
+  const CollectiveCostModel* model = options_.collective_cost_model.get();
+  if (model == nullptr || model->flops_per_second() <= 0) {
+    return 0.0;
+  }
+  return model->ComputeSeconds(*hlo) * 1e3;
+}
+
+double SpmdPartitioningVisitor::GetCommunicationTimeInMilliSec(
+    int64_t bytes, absl::Span<const ReplicaGroup> device_groups,
+    HloOpcode opcode) {
+  const CollectiveCostModel* model = options_.collective_cost_model.get();
+  if (model == nullptr || model->flops_per_second() <= 0) {
+    return 0.0;
+  }
+  switch (opcode) {
+    case HloOpcode::kAllGather:
+      return model->AllGatherSeconds(bytes, device_groups) * 1e3;
+    case HloOpcode::kReduceScatter:
+      return model->ReduceScatterSeconds(bytes, device_groups) * 1e3;
+    case HloOpcode::kAllReduce:
+      return model->AllReduceSeconds(bytes, device_groups) * 1e3;
+    case HloOpcode::kAllToAll:
+      return model->AllToAllSeconds(bytes, device_groups) * 1e3;
+    default:
+      LOG(FATAL) << "Unexpected collective " << HloOpcodeString(opcode);
+  }
+}
+
 std::vector<ReplicaGroup> SpmdPartitioningVisitor::CreateReplicaGroups(
     std::vector<std::vector<int64_t>>& groups) {
   std::vector<ReplicaGroup> device_groups;
@@ -2629,7 +2738,8 @@ Status SpmdPartitioningVisitor::HandleConcatenate(HloInstruction* hlo) {
   auto all_reduce = per_group_partitioner_state.collective_ops_creator
                         .create_cross_partition_all_reduce(
                             &b_, temp_output,
-                            MakeBinaryAdd(hlo->shape().element_type(), module_),
+                            MakeBinaryAdd(hlo->shape().element_type(),
+                                          per_group_partitioner_state),
                             {}, NewChannel());
   SetPartitionedHlo(hlo, [&] {
     auto start_indices = MakeTiledPartitionOrdinals(
@@ -3197,7 +3307,7 @@ Status SpmdPartitioningVisitor::HandleSingleDevice(const HloInstruction* hlo) {
     }
     auto root = true_b.AddInstruction(
         hlo->CloneWithNewOperands(hlo->shape(), new_operands));
-    true_computation = module_->AddEmbeddedComputation(true_b.Build(root));
+    true_computation = AddEmbeddedComputation(true_b.Build(root));
   }
 
   SpmdBuilder false_b("false_computation", visiting_hlo_);
@@ -3206,7 +3316,7 @@ Status SpmdPartitioningVisitor::HandleSingleDevice(const HloInstruction* hlo) {
     false_b.AddInstruction(HloInstruction::CreateParameter(
         /*parameter_number=*/0, operand_shape, "false_branch_param"));
     auto root = CreateZero(hlo->shape(), &false_b);
-    false_computation = module_->AddEmbeddedComputation(false_b.Build(root));
+    false_computation = AddEmbeddedComputation(false_b.Build(root));
   }
 
   SetPartitionedHlo(hlo, [&]() {
@@ -3697,7 +3807,7 @@ Status SpmdPartitioningVisitor::HandleInfeed(HloInstruction* hlo) {
       };
       pad_infeed({}, infeed);
     }
-    branches[i] = module_->AddEmbeddedComputation(branch_b.Build());
+    branches[i] = AddEmbeddedComputation(branch_b.Build());
   }
   SetPartitionedHlo(hlo, [&]() {
     return b_.AddInstruction(HloInstruction::CreateConditional(
@@ -3919,19 +4029,11 @@ Status SpmdPartitioningVisitor::HandleWhile(HloInstruction* hlo) {
   hlo->while_body()->parameter_instruction(0)->set_sharding(sharding);
   const HloSharding& cond_root_sharding =
       hlo->while_condition()->root_instruction()->sharding();
-  TF_RETURN_IF_ERROR(partitioner_
-                         ->PartitionComputation(hlo->while_condition(),
-                                                cond_root_sharding.IsManual()
-                                                    ? cond_root_sharding
-                                                    : HloSharding::Replicate(),
-                                                next_channel_id_, logger_,
-                                                call_graph_)
-                         .status());
-  TF_RETURN_IF_ERROR(partitioner_
-                         ->PartitionComputation(hlo->while_body(), sharding,
-                                                next_channel_id_, logger_,
-                                                call_graph_)
-                         .status());
+  TF_RETURN_IF_ERROR(PartitionCalledComputation(
+      hlo->while_condition(), cond_root_sharding.IsManual()
+                                  ? cond_root_sharding
+                                  : HloSharding::Replicate()));
+  TF_RETURN_IF_ERROR(PartitionCalledComputation(hlo->while_body(), sharding));
   SetPartitionedHlo(hlo, [&] {
     return b_.AddInstruction(HloInstruction::CreateWhile(
         MakePartitionedShape(hlo->shape(), sharding), hlo->while_condition(),
@@ -3957,11 +4059,8 @@ Status SpmdPartitioningVisitor::HandleConditional(HloInstruction* hlo) {
   // conditional instruction.
   for (int64_t i = 0; i < hlo->branch_count(); ++i) {
     HloComputation* computation = hlo->branch_computation(i);
-    TF_RETURN_IF_ERROR(partitioner_
-                           ->PartitionComputation(computation, hlo->sharding(),
-                                                  next_channel_id_, logger_,
-                                                  call_graph_)
-                           .status());
+    TF_RETURN_IF_ERROR(
+        PartitionCalledComputation(computation, hlo->sharding()));
   }
   SetPartitionedHlo(hlo, [&] {
     HloInstruction* cond = GetPartitionedHlo(hlo->operand(0)).hlo();
@@ -4136,7 +4235,7 @@ Status SpmdPartitioningVisitor::HandleOutfeed(HloInstruction* hlo) {
     branch_b.AddInstruction(HloInstruction::CreateOutfeed(
         per_branch_partitioned_shapes[i], outfeed_data, outfeed_token,
         hlo->outfeed_config()));
-    branches[i] = module_->AddEmbeddedComputation(branch_b.Build());
+    branches[i] = AddEmbeddedComputation(branch_b.Build());
   }
   SetPartitionedHlo(hlo, [&]() {
     return b_.AddInstruction(HloInstruction::CreateConditional(
@@ -4517,16 +4616,32 @@ Status SpmdPartitioningVisitor::HandleTuple(HloInstruction* hlo) {
 StatusOr<bool> SpmdPartitioningVisitor::DoPartition(
     HloComputation* computation, const HloSharding& root_sharding,
     const SpmdPartitionerOptions& options) {
+  TF_ASSIGN_OR_RETURN(std::unique_ptr<HloComputation> partitioned,
+                      BuildPartitionedComputation(computation, root_sharding));
+  TF_RETURN_IF_ERROR(
+      CommitPartitionedComputation(computation, std::move(partitioned), options)
+          .status());
+  return changed_;
+}
+
+StatusOr<std::unique_ptr<HloComputation>>
+SpmdPartitioningVisitor::BuildPartitionedComputation(
+    HloComputation* computation, const HloSharding& root_sharding) {
   VLOG(2) << "Partitioning computation " << computation->name() << " for "
           << num_replicas_ << " replicas and " << num_partitions_
           << " partitions";
   TF_RETURN_IF_ERROR(computation->Accept(this));
 
-  HloModule* module = computation->parent();
   auto new_root =
       GetPartitionedHlo(computation->root_instruction()).Reshard(root_sharding);
-  auto new_computation =
-      module->AddEmbeddedComputation(b_.Build(new_root.hlo()));
+  return b_.Build(new_root.hlo());
+}
+
+StatusOr<HloComputation*> SpmdPartitioningVisitor::CommitPartitionedComputation(
+    HloComputation* computation, std::unique_ptr<HloComputation> partitioned,
+    const SpmdPartitionerOptions& options) {
+  HloModule* module = computation->parent();
+  auto new_computation = module->AddEmbeddedComputation(std::move(partitioned));
   TF_RETURN_IF_ERROR(
       DoCodeMotionForWindowedDotGeneralLoops(new_computation, options));
 
@@ -4534,7 +4649,26 @@ StatusOr<bool> SpmdPartitioningVisitor::DoPartition(
   absl::flat_hash_map<HloComputation*, HloComputation*> replacement;
   replacement[computation] = new_computation;
   module->ReplaceComputations(replacement);
-  return changed_;
+  return new_computation;
+}
+
+Status SpmdPartitioningVisitor::PartitionCalledComputation(
+    HloComputation* computation, const HloSharding& root_sharding) {
+  if (partitioning_task_ != nullptr) {
+    partitioner_->SchedulePartitioning(partitioning_task_, computation,
+                                       root_sharding);
+    return OkStatus();
+  }
+  return partitioner_
+      ->PartitionComputation(computation, root_sharding, next_channel_id_,
+                             logger_, call_graph_)
+      .status();
+}
+
+HloComputation* SpmdPartitioningVisitor::AddEmbeddedComputation(
+    std::unique_ptr<HloComputation> computation) {
+  return AddOrRecordEmbeddedComputation(module_, partitioning_task_,
+                                        std::move(computation));
 }
 
 Status SpmdPartitioningVisitor::HandlePartitionId(HloInstruction* hlo) {
@@ -4799,6 +4933,126 @@ StatusOr<bool> SpmdPartitioner::PartitionComputation(
   return visitor->DoPartition(computation, root_sharding, options_);
 }
 
+StatusOr<bool> SpmdPartitioner::PartitionComputationsInParallel(
+    HloComputation* computation, const HloSharding& root_sharding,
+    int64_t* next_channel_id, SpmdLogger* logger,
+    const CallGraph& call_graph) {
+  SpmdPartitioningTask::Context context;
+  context.logger = logger;
+  context.call_graph = &call_graph;
+  context.first_channel_id = *next_channel_id;
+  SpmdPartitioningTask task(&context, computation, root_sharding);
+  // Declared after the tasks, so that its destructor waits for the scheduled
+  // tasks before they are destroyed, also when committing fails.
+  tsl::thread::ThreadPool thread_pool(tsl::Env::Default(), "spmd_partitioner",
+                                      options_.num_partitioning_threads);
+  context.thread_pool = &thread_pool;
+  RunPartitioningTask(&task);
+  return CommitPartitioningTask(&task, next_channel_id);
+}
+
+void SpmdPartitioner::SchedulePartitioning(SpmdPartitioningTask* caller,
+                                           HloComputation* computation,
+                                           const HloSharding& root_sharding) {
+  auto callee = std::make_unique<SpmdPartitioningTask>(
+      caller->context, computation, root_sharding);
+  SpmdPartitioningTask* task = callee.get();
+  SpmdPartitioningTask::Step step;
+  step.callee = std::move(callee);
+  step.next_channel_id = caller->next_channel_id;
+  caller->steps.push_back(std::move(step));
+  caller->context->thread_pool->Schedule(
+      [this, task] { RunPartitioningTask(task); });
+}
+
+void SpmdPartitioner::RunPartitioningTask(SpmdPartitioningTask* task) {
+  task->visitor = CreateVisitor(
+      task->computation, num_partitions_, num_replicas_,
+      collective_ops_creator_, &task->next_channel_id, task->context->logger,
+      options_, *task->context->call_graph);
+  task->visitor->set_partitioning_task(task);
+  StatusOr<std::unique_ptr<HloComputation>> partitioned =
+      task->visitor->BuildPartitionedComputation(task->computation,
+                                                 task->root_sharding);
+  if (partitioned.ok()) {
+    task->partitioned = std::move(partitioned).value();
+  } else {
+    task->status = partitioned.status();
+  }
+  task->done.Notify();
+}
+
+StatusOr<bool> SpmdPartitioner::CommitPartitioningTask(
+    SpmdPartitioningTask* task, int64_t* next_channel_id) {
+  task->done.WaitForNotification();
+  TF_RETURN_IF_ERROR(task->status);
+  HloModule* module = task->computation->parent();
+
+  // The channel ids that the task allocated before, between and after
+  // scheduling its callees are renumbered around the ids of the callees. Each
+  // range maps the first local id of a run to the id it gets.
+  std::vector<std::pair<int64_t, int64_t>> channel_id_ranges;
+  int64_t local_channel_id = task->context->first_channel_id;
+  auto allocate_channel_ids = [&](int64_t local_end) {
+    channel_id_ranges.push_back({local_channel_id, *next_channel_id});
+    *next_channel_id += local_end - local_channel_id;
+    local_channel_id = local_end;
+  };
+
+  // The visitor referred to its callees by their original computations, which
+  // serial partitioning would already have replaced.
+  absl::flat_hash_map<HloComputation*, HloComputation*> replacements;
+  auto replace_callees = [&](HloComputation* computation) {
+    if (replacements.empty()) {
+      return;
+    }
+    for (HloInstruction* instruction : computation->instructions()) {
+      instruction->ReplaceCalledComputations([&](HloComputation* callee) {
+        auto it = replacements.find(callee);
+        return it == replacements.end() ? callee : it->second;
+      });
+    }
+  };
+
+  std::vector<HloComputation*> created;
+  for (SpmdPartitioningTask::Step& step : task->steps) {
+    if (step.callee == nullptr) {
+      replace_callees(step.computation.get());
+      created.push_back(
+          module->AddEmbeddedComputation(std::move(step.computation)));
+      continue;
+    }
+    allocate_channel_ids(step.next_channel_id);
+    HloComputation* original = step.callee->computation;
+    TF_RETURN_IF_ERROR(
+        CommitPartitioningTask(step.callee.get(), next_channel_id).status());
+    replacements[original] = step.callee->partitioned_computation;
+  }
+  allocate_channel_ids(task->next_channel_id);
+  replace_callees(task->partitioned.get());
+  created.push_back(task->partitioned.get());
+
+  for (HloComputation* computation : created) {
+    for (HloInstruction* instruction : computation->instructions()) {
+      std::optional<int64_t> channel_id = instruction->channel_id();
+      // Smaller ids were copied from the original module.
+      if (!channel_id.has_value() ||
+          *channel_id < task->context->first_channel_id) {
+        continue;
+      }
+      auto range = std::prev(absl::c_upper_bound(
+          channel_id_ranges,
+          std::make_pair(*channel_id, std::numeric_limits<int64_t>::max())));
+      instruction->set_channel_id(range->second + *channel_id - range->first);
+    }
+  }
+  TF_ASSIGN_OR_RETURN(task->partitioned_computation,
+                      task->visitor->CommitPartitionedComputation(
+                          task->computation, std::move(task->partitioned),
+                          options_));
+  return task->visitor->changed();
+}
+
 std::unique_ptr<SpmdPartitioningVisitor> SpmdPartitioner::CreateVisitor(
     HloComputation* computation, int64_t num_partitions, int64_t num_replicas,
     const SPMDCollectiveOpsCreator& collective_ops_creator,
@@ -4845,10 +5099,18 @@ StatusOr<bool> SpmdPartitioner::Run(
 
   std::unique_ptr<CallGraph> call_graph = CallGraph::Build(module);
   CHECK(call_graph->IsFlattened());
+  // The logger is not thread-safe, so only partition in parallel when it is
+  // disabled.
+  const bool partition_in_parallel =
+      options_.num_partitioning_threads > 1 && !VLOG_IS_ON(1);
   TF_ASSIGN_OR_RETURN(
       bool partition_changed,
-      PartitionComputation(module->entry_computation(), root_sharding,
-                           &next_channel_id, &logger, *call_graph));
+      partition_in_parallel
+          ? PartitionComputationsInParallel(module->entry_computation(),
+                                            root_sharding, &next_channel_id,
+                                            &logger, *call_graph)
+          : PartitionComputation(module->entry_computation(), root_sharding,
+                                 &next_channel_id, &logger, *call_graph));
   changed |= partition_changed;
 
   // For the entry computation, make sure that the root instruction and the
@@ -4907,6 +5169,12 @@ StatusOr<bool> SpmdPartitioner::Run(
     TF_RETURN_IF_ERROR(pass.Run(module, execution_threads).status());
   }
 
+  if (options_.collective_cost_model != nullptr && VLOG_IS_ON(1)) {
+    VLOG(1) << "Estimated communication after SPMD partitioning: "
+            << options_.collective_cost_model->EstimateCommunication(*module)
+                   .ToString();
+  }
+
   TF_RETURN_IF_ERROR(ClearShardingAttributes(module, execution_threads));
   return changed;
 }
@@ -36,6 +36,7 @@ limitations under the License.
 #include "xla/service/call_graph.h"
 #include "xla/service/custom_call_sharding_helper.h"
 #include "xla/service/hlo_pass_interface.h"
+#include "xla/service/spmd/collective_cost_model.h"
 #include "xla/xla_data.pb.h"
 
 namespace xla {
@@ -76,6 +77,17 @@ struct SpmdPartitionerOptions {
   // Whether doing bidirectional communication when decomposing independent
   // all-gathers.
   bool bidirectional_decomposed_all_gather = false;
+
+  // If set, the partitioner estimates the time of collectives and dots on the
+  // described device mesh and uses the estimates to choose between
+  // partitioning strategies of dots, instead of comparing operand sizes.
+  std::shared_ptr<const CollectiveCostModel> collective_cost_model;
+
+  // Number of threads used to partition the bodies and conditions of while
+  // loops and the branches of conditionals in parallel with their callers. The
+  // result is identical to partitioning them one after another, which is done
+  // if this is at most 1 or if the partitioning report is logged.
+  int64_t num_partitioning_threads = 1;
 };
 
 // Class to wrap the computation builder to capture information during SPMD
@@ -204,6 +216,10 @@ class SpmdLogger {
 
 class SpmdPartitioningVisitor;
 
+// A computation that is partitioned in parallel with others. Defined in
+// spmd_partitioner.cc.
+struct SpmdPartitioningTask;
+
 class SpmdPartitioner : public HloModulePass {
  public:
   SpmdPartitioner(int64_t num_partitions, int64_t num_replicas,
@@ -251,6 +267,13 @@ class SpmdPartitioner : public HloModulePass {
 
   const SpmdPartitionerOptions& options() { return options_; }
 
+  // Schedules `computation`, which is called by the computation of `caller`,
+  // to be partitioned in parallel with the rest of `caller`. The result is
+  // added to the module when `caller` is committed.
+  void SchedulePartitioning(SpmdPartitioningTask* caller,
+                            HloComputation* computation,
+                            const HloSharding& root_sharding);
+
  protected:
   virtual std::unique_ptr<SpmdPartitioningVisitor> CreateVisitor(
       HloComputation* computation, int64_t num_partitions, int64_t num_replicas,
@@ -258,6 +281,14 @@ class SpmdPartitioner : public HloModulePass {
       int64_t* next_channel_id, SpmdLogger* logger,
       SpmdPartitionerOptions options, const CallGraph& call_graph);
 
+  // Same as PartitionComputation, but partitions the computations called by
+  // `computation` in parallel, then adds all partitioned computations to the
+  // module in the order PartitionComputation would have.
+  StatusOr<bool> PartitionComputationsInParallel(
+      HloComputation* computation, const HloSharding& root_sharding,
+      int64_t* next_channel_id, SpmdLogger* logger,
+      const CallGraph& call_graph);
+
   HloInstruction* AllGatherShardsInternal(
       SpmdBuilder* b, HloInstruction* operand, const HloSharding& sharding,
       int64_t* next_channel_id, absl::Span<const int64_t> selected_dims,
@@ -301,6 +332,16 @@ class SpmdPartitioner : public HloModulePass {
   SpmdPartitionerOptions options_;
   SPMDCollectiveOpsCreator collective_ops_creator_;
   std::vector<std::vector<int64_t>> device_groups_;
+
+ private:
+  // Partitions the computation of `task` without adding it to the module.
+  void RunPartitioningTask(SpmdPartitioningTask* task);
+
+  // Waits for `task` to finish, then commits the computations it called and
+  // created, and its partitioned computation, allocating their channel ids
+  // from `next_channel_id`.
+  StatusOr<bool> CommitPartitioningTask(SpmdPartitioningTask* task,
+                                        int64_t* next_channel_id);
 };
 
 // Class describes partition state of the data represented by an HLO created
@@ -342,6 +383,8 @@ class PartitionedHlo {
     int64_t* next_channel_id;
     ReshardCache* reshard_cache;
     SpmdPartitioner* partitioner;
+    // Set when partitioning in parallel; see AddEmbeddedComputation.
+    SpmdPartitioningTask* task = nullptr;
   };
   PartitionedHlo(HloInstruction* hlo, Shape base_shape, PartitioningState state)
       : hlo_(hlo), base_shape_(base_shape), state_(std::move(state)) {
@@ -459,6 +502,14 @@ class PartitionedHlo {
   PartitioningState state_;
 };
 
+// Adds `computation`, which was created while partitioning, to the module. When
+// partitioning in parallel, the addition is recorded in the task of `state`
+// instead and made when the task is committed, in the same order as when
+// partitioning serially. The returned computation can be used right away.
+HloComputation* AddEmbeddedComputation(
+    const PartitionedHlo::PartitioningState& state,
+    std::unique_ptr<HloComputation> computation);
+
 struct DotConvDimsMapping {
   // The dimension numbers for the operands and output corresponding to a
   // logical dimension (e.g., batch, contracting, non-contracting). If an
@@ -575,14 +626,38 @@ class SpmdPartitioningVisitor : public DfsHloVisitorWithDefault {
                                      const HloSharding& root_sharding,
                                      const SpmdPartitionerOptions& options);
 
-  virtual double GetComputationTimeInMilliSec(HloInstruction* hlo) {
-    return 0.0;
+  // The two halves of DoPartition. The first builds the partitioned
+  // computation without adding it to the module, the second adds it and
+  // replaces `computation` with it.
+  StatusOr<std::unique_ptr<HloComputation>> BuildPartitionedComputation(
+      HloComputation* computation, const HloSharding& root_sharding);
+  StatusOr<HloComputation*> CommitPartitionedComputation(
+      HloComputation* computation, std::unique_ptr<HloComputation> partitioned,
+      const SpmdPartitionerOptions& options);
+
+  // Makes the visitor run as part of `task`: the computations it creates are
+  // recorded in the task instead of being added to the module, and the
+  // computations called by while loops and conditionals are scheduled to be
+  // partitioned by tasks of their own. The reshard cache stays private to the
+  // visitor.
+  void set_partitioning_task(SpmdPartitioningTask* task) {
+    partitioning_task_ = task;
   }
 
+  bool changed() const { return changed_; }
+
+  // The default implementations of the two methods below use the
+  // collective_cost_model of the options. They return 0 when no cost model is
+  // set or when it has no compute throughput, since comparing a communication
+  // time against a zero computation time would disable every windowed einsum.
+  virtual double GetComputationTimeInMilliSec(HloInstruction* hlo);
+
+  // Returns the time of a collective of kind `opcode` over each of
+  // `device_groups`. `bytes` is the size of the gathered buffer of an
+  // all-gather or reduce-scatter, and of the reduced buffer of an all-reduce.
   virtual double GetCommunicationTimeInMilliSec(
-      int64_t bytes, absl::Span<const ReplicaGroup> device_groups) {
-    return 0.0;
-  }
+      int64_t bytes, absl::Span<const ReplicaGroup> device_groups,
+      HloOpcode opcode);
 
   virtual int GetCommunicationMultiplier(
       absl::Span<const ReplicaGroup> device_groups) {
@@ -617,6 +692,16 @@ class SpmdPartitioningVisitor : public DfsHloVisitorWithDefault {
   Status DoCodeMotionForWindowedDotGeneralLoops(
       HloComputation* computation, const SpmdPartitionerOptions& options);
 
+  // Partitions `computation`, which is called by the visited instruction, so
+  // that its root gets `root_sharding`.
+  Status PartitionCalledComputation(HloComputation* computation,
+                                    const HloSharding& root_sharding);
+
+  // Adds `computation`, which was created while partitioning, to the module.
+  // See the free function of the same name.
+  HloComputation* AddEmbeddedComputation(
+      std::unique_ptr<HloComputation> computation);
+
   bool changed_;
   HloModule* module_;
   int64_t num_partitions_;
@@ -651,6 +736,7 @@ class SpmdPartitioningVisitor : public DfsHloVisitorWithDefault {
   std::vector<PartitionedHlo::PartitioningState> visiting_state_;
   std::vector<std::vector<int64_t>> device_groups_;
   const CallGraph& call_graph_;
+  SpmdPartitioningTask* partitioning_task_ = nullptr;
 };
 
 }  // namespace spmd
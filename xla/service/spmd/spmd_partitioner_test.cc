@@ -15,24 +15,32 @@ limitations under the License.
 
 #include "xla/service/spmd/spmd_partitioner.h"
 
+#include <cstdint>
 #include <memory>
 #include <optional>
+#include <string>
 #include <utility>
+#include <vector>
 
 #include "absl/algorithm/container.h"
+#include "absl/strings/str_format.h"
 #include "xla/hlo/ir/hlo_casting_utils.h"
 #include "xla/hlo/ir/hlo_computation.h"
 #include "xla/hlo/ir/hlo_instruction.h"
 #include "xla/hlo/ir/hlo_instructions.h"
 #include "xla/service/hlo_matchers.h"
+#include "xla/service/hlo_parser.h"
 #include "xla/service/hlo_pass_pipeline.h"
 #include "xla/service/hlo_sharding_util.h"
 #include "xla/service/hlo_verifier.h"
 #include "xla/service/sharding_propagation.h"
+#include "xla/service/spmd/collective_cost_model.h"
+#include "xla/shape_util.h"
 #include "xla/tests/hlo_test_base.h"
 #include "xla/util.h"
 #include "xla/xla_data.pb.h"
 #include "tsl/lib/core/status_test_util.h"
+#include "tsl/platform/test_benchmark.h"
 
 namespace xla {
 namespace spmd {
@@ -50,7 +58,10 @@ class SpmdPartitioningTest : public HloTestBase {
       bool choose_faster_windowed_einsum = false,
       bool unroll_windowed_einsum = false,
       bool bidirectional_windowed_einsum = false,
-      int64_t threshold_for_windowed_einsum_mib = -1) {
+      int64_t threshold_for_windowed_einsum_mib = -1,
+      std::shared_ptr<const CollectiveCostModel> collective_cost_model =
+          nullptr,
+      int64_t num_partitioning_threads = 1) {
     // Some tests (BackpropFilter convs) set this flag false to test two
     // different paths of the implementation.
     SpmdPartitionerOptions options;
@@ -64,6 +75,8 @@ class SpmdPartitioningTest : public HloTestBase {
       options.threshold_for_windowed_einsum_mib =
           threshold_for_windowed_einsum_mib;
     }
+    options.collective_cost_model = std::move(collective_cost_model);
+    options.num_partitioning_threads = num_partitioning_threads;
     auto collective_ops_creator =
         GetDefaultCollectiveOpsCreator(num_devices, /*num_replicas=*/1);
     // Do not use all-gather for pattern-matching purpose, as the partitioner
@@ -4176,6 +4189,80 @@ ENTRY entry {
   EXPECT_THAT(root, AllOf(op::While(zero), op::Shape("s32[]")));
 }
 
+TEST_F(SpmdPartitioningTest, ParallelPartitioningMatchesSerial) {
+  absl::string_view hlo_string = R"(
+HloModule module
+
+LoopCond {
+  p = (s32[], f32[8,8]) parameter(0),
+    sharding={{replicated}, {devices=[2,1]0,1}}
+  i = s32[] get-tuple-element(p), index=0, sharding={replicated}
+  limit = s32[] constant(4), sharding={replicated}
+  ROOT lt = pred[] compare(i, limit), direction=LT, sharding={replicated}
+}
+
+Negate {
+  x = f32[8,8] parameter(0), sharding={devices=[1,2]0,1}
+  ROOT negate = f32[8,8] negate(x), sharding={devices=[1,2]0,1}
+}
+
+Identity {
+  y = f32[8,8] parameter(0), sharding={devices=[1,2]0,1}
+  ROOT copy = f32[8,8] copy(y), sharding={devices=[1,2]0,1}
+}
+
+Body {
+  p = (s32[], f32[8,8]) parameter(0),
+    sharding={{replicated}, {devices=[2,1]0,1}}
+  i = s32[] get-tuple-element(p), index=0, sharding={replicated}
+  one = s32[] constant(1), sharding={replicated}
+  next_i = s32[] add(i, one), sharding={replicated}
+  x = f32[8,8] get-tuple-element(p), index=1, sharding={devices=[2,1]0,1}
+  dot = f32[8,8] dot(x, x), lhs_contracting_dims={1},
+    rhs_contracting_dims={0}, sharding={devices=[2,1]0,1}
+  pred = pred[] compare(i, one), direction=EQ, sharding={replicated}
+  cond = f32[8,8] conditional(pred, dot, x), true_computation=Negate,
+    false_computation=Identity, sharding={devices=[2,1]0,1}
+  ROOT t = (s32[], f32[8,8]) tuple(next_i, cond),
+    sharding={{replicated}, {devices=[2,1]0,1}}
+}
+
+ENTRY entry {
+  p0 = f32[8,8] parameter(0), sharding={devices=[2,1]0,1}
+  p1 = f32[8,8] parameter(1), sharding={devices=[2,1]0,1}
+  zero = s32[] constant(0), sharding={replicated}
+  init0 = (s32[], f32[8,8]) tuple(zero, p0),
+    sharding={{replicated}, {devices=[2,1]0,1}}
+  init1 = (s32[], f32[8,8]) tuple(zero, p1),
+    sharding={{replicated}, {devices=[2,1]0,1}}
+  w0 = (s32[], f32[8,8]) while(init0), body=Body, condition=LoopCond,
+    sharding={{replicated}, {devices=[2,1]0,1}}
+  w1 = (s32[], f32[8,8]) while(init1), body=Body, condition=LoopCond,
+    sharding={{replicated}, {devices=[2,1]0,1}}
+  x0 = f32[8,8] get-tuple-element(w0), index=1, sharding={devices=[2,1]0,1}
+  x1 = f32[8,8] get-tuple-element(w1), index=1, sharding={devices=[2,1]0,1}
+  ROOT add = f32[8,8] add(x0, x1), sharding={replicated}
+})";
+
+  TF_ASSERT_OK_AND_ASSIGN(auto serial,
+                          PartitionComputation(hlo_string, /*num_devices=*/2));
+  TF_ASSERT_OK_AND_ASSIGN(
+      auto parallel,
+      PartitionComputation(hlo_string, /*num_devices=*/2,
+                           /*conv_halo_exchange_always_on_lhs=*/true,
+                           /*choose_faster_windowed_einsum=*/false,
+                           /*unroll_windowed_einsum=*/false,
+                           /*bidirectional_windowed_einsum=*/false,
+                           /*threshold_for_windowed_einsum_mib=*/-1,
+                           /*collective_cost_model=*/nullptr,
+                           /*num_partitioning_threads=*/4));
+
+  // Names, channel ids and the order of computations do not depend on the
+  // order in which the called computations finish partitioning.
+  EXPECT_EQ(parallel->ToString(), serial->ToString());
+  EXPECT_EQ(parallel->computation_count(), serial->computation_count());
+}
+
 TEST_F(SpmdPartitioningTest, SelectAndScatter_RetinaNet) {
   absl::string_view hlo_string = R"(
 HloModule module
@@ -13161,6 +13248,141 @@ ENTRY main.4 {
   EXPECT_NE(alltoall, nullptr);
 }
 
+TEST_F(SpmdPartitioningTest, CostModelPrefersAllGatherOverAllReduce) {
+  // Partitioning the contracting dimension of the LHS all-reduces 48x32
+  // elements, whereas replicating the RHS gathers 64x32 elements. An
+  // all-reduce moves twice the data of an all-gather over the same ring, so
+  // the cost model picks the all-gather, unlike the element count heuristic.
+  absl::string_view hlo_string = R"(
+HloModule module
+
+ENTRY entry {
+  %lhs = f32[48,64] parameter(0), sharding={replicated}
+  %rhs = f32[64,32] parameter(1), sharding={devices=[2,1]0,1}
+  ROOT %dot = f32[48,32] dot(%lhs, %rhs),
+    lhs_contracting_dims={1}, rhs_contracting_dims={0},
+    sharding={replicated}
+})";
+  TF_ASSERT_OK_AND_ASSIGN(auto heuristic_module,
+                          PartitionComputation(hlo_string, /*num_devices=*/2));
+  EXPECT_THAT(heuristic_module->entry_computation()->root_instruction(),
+              AllOf(op::AllReduce(op::Dot()), op::Shape("f32[48,32]")));
+
+  auto model = std::make_shared<CollectiveCostModel>(
+      std::vector<CollectiveCostModel::MeshAxis>{{/*size=*/2}});
+  TF_ASSERT_OK_AND_ASSIGN(
+      auto module,
+      PartitionComputation(hlo_string, /*num_devices=*/2,
+                           /*conv_halo_exchange_always_on_lhs=*/true,
+                           /*choose_faster_windowed_einsum=*/false,
+                           /*unroll_windowed_einsum=*/false,
+                           /*bidirectional_windowed_einsum=*/false,
+                           /*threshold_for_windowed_einsum_mib=*/-1, model));
+  EXPECT_THAT(module->entry_computation()->root_instruction(),
+              AllOf(op::Dot(op::Parameter(0),
+                            AllOf(op::AllReduce(), op::Shape("f32[64,32]"))),
+                    op::Shape("f32[48,32]")));
+  EXPECT_EQ(model->EstimateCommunication(*module).bytes,
+            2 * ShapeUtil::ByteSizeOf(ShapeUtil::MakeShape(F32, {32, 32})));
+}
+
+TEST_F(SpmdPartitioningTest, CostModelWithoutFlopsKeepsWindowedEinsum) {
+  // Without a compute throughput the cost model cannot compare communication
+  // against computation, so it must not disable windowed einsum.
+  absl::string_view hlo_string = R"(
+HloModule module
+
+ENTRY entry {
+  %p0 = f32[2048,2,3264]{2,1,0} parameter(0), sharding={devices=[1,1,2]0,1}
+  %p1 = f32[2,3264,2176]{2,1,0} parameter(1), sharding={devices=[2,1,1]0,1}
+  ROOT %dot.224 = f32[2048,2176]{1,0} dot(f32[2048,2,3264]{2,1,0} %p0, f32[2,3264,2176]{2,1,0} %p1), lhs_contracting_dims={1,2}, rhs_contracting_dims={0,1}, sharding={devices=[1,2]0,1}
+})";
+  const auto root =
+      AllOf(op::GetTupleElement(op::While()), op::Shape("f32[2048,1088]"));
+  TF_ASSERT_OK_AND_ASSIGN(
+      auto heuristic_module,
+      PartitionComputation(hlo_string, /*num_devices=*/2,
+                           /*conv_halo_exchange_always_on_lhs=*/true,
+                           /*choose_faster_windowed_einsum=*/false,
+                           /*unroll_windowed_einsum=*/false,
+                           /*bidirectional_windowed_einsum=*/false,
+                           /*threshold_for_windowed_einsum_mib=*/0));
+  EXPECT_THAT(heuristic_module->entry_computation()->root_instruction(), root);
+
+  auto model = std::make_shared<CollectiveCostModel>(
+      std::vector<CollectiveCostModel::MeshAxis>{{/*size=*/2}});
+  TF_ASSERT_OK_AND_ASSIGN(
+      auto module,
+      PartitionComputation(hlo_string, /*num_devices=*/2,
+                           /*conv_halo_exchange_always_on_lhs=*/true,
+                           /*choose_faster_windowed_einsum=*/false,
+                           /*unroll_windowed_einsum=*/false,
+                           /*bidirectional_windowed_einsum=*/false,
+                           /*threshold_for_windowed_einsum_mib=*/0, model));
+  EXPECT_THAT(module->entry_computation()->root_instruction(), root);
+}
+
+// Partitions `num_layers` matmuls whose weights are sharded along the
+// contracting dimension and whose outputs are replicated, on a 2x4 mesh whose
+// major axis is four times slower than its minor axis, and reports the
+// estimated communication of the chosen plans. The cost model is used when
+// state.range(1) is 1.
+void BM_PartitionDotsWithCostModel(::testing::benchmark::State& state) {
+  const int64_t num_layers = state.range(0);
+  const bool use_cost_model = state.range(1) == 1;
+  std::string hlo_string = R"(
+HloModule module
+
+ENTRY %entry {
+  %x0 = f32[192,256] parameter(0), sharding={replicated}
+  %w = f32[256,256] parameter(1), sharding={devices=[8,1]0,1,2,3,4,5,6,7}
+)";
+  for (int64_t i = 0; i < num_layers; ++i) {
+    absl::StrAppendFormat(
+        &hlo_string,
+        "  %%x%d = f32[192,256] dot(%%x%d, %%w), lhs_contracting_dims={1}, "
+        "rhs_contracting_dims={0}, sharding={replicated}\n",
+        i + 1, i);
+  }
+  absl::StrAppendFormat(&hlo_string,
+                        "  ROOT %%copy = f32[192,256] copy(%%x%d), "
+                        "sharding={replicated}\n}\n",
+                        num_layers);
+  auto model = std::make_shared<CollectiveCostModel>(
+      std::vector<CollectiveCostModel::MeshAxis>{
+          {/*size=*/2, /*bytes_per_second=*/25e9, /*latency_seconds=*/5e-6},
+          {/*size=*/4, /*bytes_per_second=*/100e9, /*latency_seconds=*/1e-6}});
+  SpmdPartitionerOptions options;
+  if (use_cost_model) {
+    options.collective_cost_model = model;
+  }
+  CollectiveCostModel::Estimate estimate;
+  for (auto s : state) {
+    state.PauseTiming();
+    HloModuleConfig config;
+    config.set_use_spmd_partitioning(true);
+    config.set_num_partitions(8);
+    auto module = ParseAndReturnUnverifiedModule(hlo_string, config).value();
+    state.ResumeTiming();
+    TF_CHECK_OK(
+        SpmdPartitioner(/*num_partitions=*/8, /*num_replicas=*/1, options)
+            .Run(module.get())
+            .status());
+    state.PauseTiming();
+    estimate = model->EstimateCommunication(*module);
+    state.ResumeTiming();
+  }
+  state.counters["collectives"] = estimate.num_collectives;
+  state.counters["bytes_per_device"] = estimate.bytes;
+  state.counters["communication_ms"] = estimate.seconds * 1e3;
+}
+
+BENCHMARK(BM_PartitionDotsWithCostModel)
+    ->ArgPair(1, 0)
+    ->ArgPair(1, 1)
+    ->ArgPair(16, 0)
+    ->ArgPair(16, 1);
+
 }  // namespace
 }  // namespace spmd
 }  // namespace xla
@@ -54,7 +54,8 @@ bool HasReplicatedSharding(const HloSharding& sharding) {
   return sharding.IsReplicated();
 }
 
-HloComputation* MakeBinaryAdd(PrimitiveType type, HloModule* module) {
+HloComputation* MakeBinaryAdd(PrimitiveType type,
+                              const PartitionedHlo::PartitioningState& state) {
   HloComputation::Builder sum_b("add");
   auto x = sum_b.AddInstruction(HloInstruction::CreateParameter(
       /*parameter_number=*/0, ShapeUtil::MakeShape(type, {}), "x"));
@@ -67,7 +68,7 @@ HloComputation* MakeBinaryAdd(PrimitiveType type, HloModule* module) {
     sum_b.AddInstruction(HloInstruction::CreateBinary(
         ShapeUtil::MakeShape(type, {}), HloOpcode::kAdd, x, y));
   }
-  HloComputation* reduction = module->AddEmbeddedComputation(sum_b.Build());
+  HloComputation* reduction = AddEmbeddedComputation(state, sum_b.Build());
   return reduction;
 }
 
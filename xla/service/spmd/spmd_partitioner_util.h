@@ -133,8 +133,10 @@ inline HloInstruction* CreateLastWithType(PrimitiveType type, T* b) {
   return b->AddInstruction(HloInstruction::CreateConstant(std::move(literal)));
 }
 
-// Create a binary add computation of the given type and add to the module.
-HloComputation* MakeBinaryAdd(PrimitiveType type, HloModule* module);
+// Create a binary add computation of the given type and add it to the module
+// through AddEmbeddedComputation.
+HloComputation* MakeBinaryAdd(PrimitiveType type,
+                              const PartitionedHlo::PartitioningState& state);
 
 // Returns true if the shape can be evenly partitioned for the given sharding.
 // All tile sharded dimensions should be evenly divisible and there should be no
@@ -60,6 +60,19 @@ tsl::Status HostExecutor::Init(int device_ordinal,
           it->second);
     }
   }
+  it = device_options.non_portable_tags.find("host_stream_worker_threads");
+  if (it != device_options.non_portable_tags.end()) {
+    int num_threads;
+    if (!absl::SimpleAtoi(it->second, &num_threads)) {
+      return tsl::errors::InvalidArgument(
+          "Unable to parse host_stream_worker_threads as an integer: ",
+          it->second);
+    }
+    if (num_threads > 0) {
+      stream_worker_pool_ = std::make_shared<tsl::thread::ThreadPool>(
+          tsl::Env::Default(), "host_stream_worker", num_threads);
+    }
+  }
   return ::tsl::OkStatus();
 }
 
@@ -104,34 +117,25 @@ bool HostExecutor::Memcpy(Stream* stream, void* host_dst,
                           const DeviceMemoryBase& gpu_src, uint64_t size) {
   // Enqueue the [asynchronous] memcpy on the stream (HostStream) associated
   // with the HostExecutor.
-  void* src_mem = const_cast<void*>(gpu_src.opaque());
-  AsHostStream(stream)->EnqueueTask(
-      [host_dst, src_mem, size]() { memcpy(host_dst, src_mem, size); });
-  return true;
+  return AsHostStream(stream)->EnqueueMemcpy(host_dst, gpu_src.opaque(), size);
 }
 
 bool HostExecutor::Memcpy(Stream* stream, DeviceMemoryBase* gpu_dst,
                           const void* host_src, uint64_t size) {
-  void* dst_mem = gpu_dst->opaque();
   // Enqueue the [asynchronous] memcpy on the stream (HostStream) associated
   // with the HostExecutor.
-  AsHostStream(stream)->EnqueueTask(
-      [dst_mem, host_src, size]() { memcpy(dst_mem, host_src, size); });
-  return true;
+  return AsHostStream(stream)->EnqueueMemcpy(gpu_dst->opaque(), host_src, size);
 }
 
 bool HostExecutor::MemcpyDeviceToDevice(Stream* stream,
                                         DeviceMemoryBase* gpu_dst,
                                         const DeviceMemoryBase& gpu_src,
                                         uint64_t size) {
-  void* dst_mem = gpu_dst->opaque();
-  void* src_mem = const_cast<void*>(gpu_src.opaque());
   // Enqueue this [asynchronous] "device-to-device" (i.e., host-to-host, given
   // the nature of the HostExecutor) memcpy  on the stream (HostStream)
   // associated with the HostExecutor.
-  AsHostStream(stream)->EnqueueTask(
-      [src_mem, dst_mem, size]() { memcpy(dst_mem, src_mem, size); });
-  return true;
+  return AsHostStream(stream)->EnqueueMemcpy(gpu_dst->opaque(), gpu_src.opaque(),
+                                             size);
 }
 
 tsl::Status HostExecutor::MemZero(Stream* stream, DeviceMemoryBase* location,
@@ -357,7 +361,7 @@ rng::RngSupport* HostExecutor::CreateRng() {
 std::unique_ptr<internal::StreamInterface>
 HostExecutor::GetStreamImplementation() {
   return std::unique_ptr<internal::StreamInterface>(
-      new HostStream(thread_stack_size_in_bytes_));
+      new HostStream(thread_stack_size_in_bytes_, stream_worker_pool_));
 }
 
 }  // namespace host
@@ -17,10 +17,14 @@ limitations under the License.
 // the HostExecutor implementation.
 #include "xla/stream_executor/host/host_stream.h"
 
-#include <queue>
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <memory>
 #include <utility>
 
 #include "absl/functional/any_invocable.h"
+#include "absl/synchronization/mutex.h"
 #include "absl/synchronization/notification.h"
 #include "tsl/platform/denormal.h"
 #include "tsl/platform/env.h"
@@ -37,20 +41,32 @@ tsl::ThreadOptions GetThreadOptions(size_t stack_size_in_bytes) {
   return options;
 }
 
+// Memcpys smaller than this run on the stream thread, since handing them to
+// the worker pool costs more than it saves.
+constexpr uint64_t kMinOffloadedMemcpySize = 1 << 20;
+
+bool Overlaps(const void* a, const void* b, uint64_t size_a, uint64_t size_b) {
+  auto begin_a = reinterpret_cast<uintptr_t>(a);
+  auto begin_b = reinterpret_cast<uintptr_t>(b);
+  return begin_a < begin_b + size_b && begin_b < begin_a + size_a;
+}
+
 }  // namespace
 
-HostStream::HostStream(size_t stack_size_in_bytes)
-    : thread_(tsl::Env::Default()->StartThread(
+HostStream::HostStream(size_t stack_size_in_bytes,
+                       std::shared_ptr<tsl::thread::ThreadPool> worker_pool)
+    : head_(new WorkItem),
+      tail_(head_),
+      worker_pool_(std::move(worker_pool)),
+      thread_(tsl::Env::Default()->StartThread(
           GetThreadOptions(stack_size_in_bytes), "host_executor",
           [this]() { WorkLoop(); })) {}
 
 HostStream::~HostStream() {
-  {
-    absl::MutexLock lock(&mu_);
-    work_queue_.push(nullptr);
-  }
+  Push(Work());
   // thread_'s destructor blocks until the thread finishes running.
   thread_.reset();
+  delete head_;
 }
 
 bool HostStream::EnqueueTask(absl::AnyInvocable<void() &&> task) {
@@ -63,12 +79,99 @@ bool HostStream::EnqueueTask(absl::AnyInvocable<void() &&> task) {
 bool HostStream::EnqueueTaskWithStatus(
     absl::AnyInvocable<tsl::Status() &&> task) {
   CHECK(task != nullptr);
-  absl::MutexLock lock(&mu_);
-  work_queue_.push(std::move(task));
+  Work work;
+  work.task = std::move(task);
+  Push(std::move(work));
+  return true;
+}
+
+bool HostStream::EnqueueMemcpy(void* dst, const void* src, uint64_t size) {
+  if (size == 0) {
+    return true;
+  }
+  Work work;
+  work.dst = dst;
+  work.src = src;
+  work.size = size;
+  Push(std::move(work));
+  return true;
+}
+
+void HostStream::Push(Work work) {
+  WorkItem* node = new WorkItem;
+  node->work = std::move(work);
+  WorkItem* prev = tail_.exchange(node);
+  prev->next.store(node);
+  // If the work loop went to sleep before it could see `node`, releasing the
+  // mutex makes it reevaluate its wait condition.
+  if (waiting_.load()) {
+    absl::MutexLock lock(&mu_);
+  }
+}
+
+bool HostStream::Pop(Work* work) {
+  WorkItem* next = head_->next.load();
+  if (next == nullptr) {
+    return false;
+  }
+  // `next` becomes the new consumed head.
+  *work = std::move(next->work);
+  delete head_;
+  head_ = next;
   return true;
 }
 
-bool HostStream::WorkAvailable() { return !work_queue_.empty(); }
+bool HostStream::WorkAvailable() const { return head_->next.load() != nullptr; }
+
+void HostStream::WaitForWork() {
+  absl::MutexLock lock(&mu_);
+  waiting_.store(true);
+  mu_.Await(absl::Condition(this, &HostStream::WorkAvailable));
+  waiting_.store(false);
+}
+
+void HostStream::RunMemcpy(void* dst, const void* src, uint64_t size) {
+  for (const MemcpyRange& range : offloaded_memcpys_) {
+    if (Overlaps(dst, range.dst, size, range.size) ||
+        Overlaps(dst, range.src, size, range.size) ||
+        Overlaps(src, range.dst, size, range.size)) {
+      JoinOffloadedMemcpys();
+      break;
+    }
+  }
+  if (!worker_pool_ || size < kMinOffloadedMemcpySize) {
+    std::memcpy(dst, src, size);
+    return;
+  }
+
+  offloaded_memcpys_.push_back({dst, src, size});
+  const int64_t num_chunks = std::min<int64_t>(
+      worker_pool_->NumThreads(), size / kMinOffloadedMemcpySize);
+  const uint64_t chunk_size = (size + num_chunks - 1) / num_chunks;
+  {
+    absl::MutexLock lock(&offload_mu_);
+    num_offloaded_tasks_ += num_chunks;
+  }
+  for (int64_t i = 0; i < num_chunks; ++i) {
+    const uint64_t offset = i * chunk_size;
+    const uint64_t length = std::min(chunk_size, size - offset);
+    worker_pool_->Schedule([this, dst, src, offset, length]() {
+      std::memcpy(static_cast<char*>(dst) + offset,
+                  static_cast<const char*>(src) + offset, length);
+      absl::MutexLock lock(&offload_mu_);
+      --num_offloaded_tasks_;
+    });
+  }
+}
+
+void HostStream::JoinOffloadedMemcpys() {
+  if (offloaded_memcpys_.empty()) {
+    return;
+  }
+  absl::MutexLock lock(&offload_mu_);
+  offload_mu_.Await(absl::Condition(this, &HostStream::NoOffloadedTasks));
+  offloaded_memcpys_.clear();
+}
 
 void HostStream::WorkLoop() {
   // Set denormal and rounding behavior to match the default TF ThreadPool
@@ -77,19 +180,19 @@ void HostStream::WorkLoop() {
   tsl::port::ScopedFlushDenormal flush;
   tsl::port::ScopedSetRound round(FE_TONEAREST);
   while (true) {
-    std::queue<absl::AnyInvocable<tsl::Status() &&>> queue;
-    {
-      absl::MutexLock lock(&mu_);
-      mu_.Await(absl::Condition(this, &HostStream::WorkAvailable));
-      std::swap(queue, work_queue_);
+    Work work;
+    if (!Pop(&work)) {
+      WaitForWork();
+      continue;
     }
-    while (!queue.empty()) {
-      absl::AnyInvocable<tsl::Status()&&>& fn = queue.front();
-      if (!fn) {
-        return;
-      }
-      status_.Update(std::move(fn)());
-      queue.pop();
+    if (work.task) {
+      JoinOffloadedMemcpys();
+      status_.Update(std::move(work.task)());
+    } else if (work.size > 0) {
+      RunMemcpy(work.dst, work.src, work.size);
+    } else {
+      JoinOffloadedMemcpys();
+      return;
     }
   }
 }
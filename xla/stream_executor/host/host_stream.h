@@ -18,14 +18,17 @@ limitations under the License.
 #ifndef TENSORFLOW_COMPILER_XLA_STREAM_EXECUTOR_HOST_HOST_STREAM_H_
 #define TENSORFLOW_COMPILER_XLA_STREAM_EXECUTOR_HOST_HOST_STREAM_H_
 
+#include <atomic>
+#include <cstdint>
 #include <functional>
 #include <memory>
-#include <queue>
+#include <vector>
 
 #include "absl/functional/any_invocable.h"
 #include "absl/synchronization/mutex.h"
 #include "xla/stream_executor/stream_executor_internal.h"
 #include "tsl/platform/env.h"
+#include "tsl/platform/threadpool.h"
 
 namespace stream_executor {
 namespace host {
@@ -34,7 +37,15 @@ class HostStream : public internal::StreamInterface {
  public:
   // stack_size_in_bytes may be '0', meaning "use the default thread stack
   // size".
-  explicit HostStream(size_t stack_size_in_bytes);
+  //
+  // If `worker_pool` is set, large memcpys enqueued with EnqueueMemcpy are
+  // split across its threads, and run concurrently with the memcpys that
+  // follow them unless their memory overlaps. Any other task waits for all of
+  // the memcpys before it to finish, so the stream still appears to run its
+  // tasks in order. The pool may be shared by several streams.
+  explicit HostStream(
+      size_t stack_size_in_bytes,
+      std::shared_ptr<tsl::thread::ThreadPool> worker_pool = nullptr);
   ~HostStream() override;
 
   // Enqueue a task that reports a status when finished. Tasks that fail do not
@@ -44,6 +55,8 @@ class HostStream : public internal::StreamInterface {
   bool EnqueueTaskWithStatus(absl::AnyInvocable<tsl::Status() &&> task);
   // Enqueue a task that doesn't report any status.
   bool EnqueueTask(absl::AnyInvocable<void() &&> task);
+  // Enqueue a copy of `size` bytes from `src` to `dst`.
+  bool EnqueueMemcpy(void* dst, const void* src, uint64_t size);
 
   void* GpuStreamHack() override { return nullptr; }
   void** GpuStreamMemberHack() override { return nullptr; }
@@ -53,14 +66,58 @@ class HostStream : public internal::StreamInterface {
   tsl::Status BlockUntilDone();
 
  private:
-  bool WorkAvailable() TF_EXCLUSIVE_LOCKS_REQUIRED(mu_);
+  // A unit of work of the stream. A null `task` with a non-zero `size` is a
+  // memcpy, and a null `task` with a zero `size` stops the work loop.
+  struct Work {
+    absl::AnyInvocable<tsl::Status() &&> task;
+    void* dst = nullptr;
+    const void* src = nullptr;
+    uint64_t size = 0;
+  };
+  struct WorkItem {
+    Work work;
+    std::atomic<WorkItem*> next{nullptr};
+  };
+
+  // The work queue is a multi-producer single-consumer linked list, so that
+  // enqueueing never takes a lock. Producers append to `tail_`, and the work
+  // loop pops from `head_`, which always points to an already consumed item.
+  void Push(Work work);
+  bool Pop(Work* work);
+
+  bool WorkAvailable() const;
+  void WaitForWork();
   void WorkLoop();
 
+  void RunMemcpy(void* dst, const void* src, uint64_t size);
+  // Waits for all memcpys running on the worker pool.
+  void JoinOffloadedMemcpys();
+  bool NoOffloadedTasks() const ABSL_EXCLUSIVE_LOCKS_REQUIRED(offload_mu_) {
+    return num_offloaded_tasks_ == 0;
+  }
+
+  WorkItem* head_;  // Only accessed by the work loop.
+  std::atomic<WorkItem*> tail_;
+
+  // The work loop sleeps on `mu_` when the queue is empty. `waiting_` tells
+  // producers that they need to wake it up.
   absl::Mutex mu_;
-  std::queue<absl::AnyInvocable<tsl::Status() &&>> work_queue_
-      ABSL_GUARDED_BY(mu_);
-  std::unique_ptr<tsl::Thread> thread_;
+  std::atomic<bool> waiting_{false};
+
+  std::shared_ptr<tsl::thread::ThreadPool> worker_pool_;
+  // Memory ranges of the memcpys running on the worker pool. Only accessed by
+  // the work loop.
+  struct MemcpyRange {
+    void* dst;
+    const void* src;
+    uint64_t size;
+  };
+  std::vector<MemcpyRange> offloaded_memcpys_;
+  absl::Mutex offload_mu_;
+  int64_t num_offloaded_tasks_ ABSL_GUARDED_BY(offload_mu_) = 0;
+
   tsl::Status status_;
+  std::unique_ptr<tsl::Thread> thread_;
 };
 
 }  // namespace host
@@ -13,14 +13,25 @@ See the License for the specific language governing permissions and
 limitations under the License.
 ==============================================================================*/
 
+#include "xla/stream_executor/host/host_stream.h"
+
+#include <cstdint>
+#include <memory>
+#include <numeric>
+#include <vector>
+
 #include "absl/synchronization/mutex.h"
 #include "xla/stream_executor/multi_platform_manager.h"
 #include "xla/stream_executor/platform.h"
 #include "xla/stream_executor/stream.h"
 #include "xla/stream_executor/stream_executor.h"
 #include "tsl/lib/core/status_test_util.h"
+#include "tsl/platform/env.h"
 #include "tsl/platform/errors.h"
+#include "tsl/platform/status.h"
 #include "tsl/platform/test.h"
+#include "tsl/platform/test_benchmark.h"
+#include "tsl/platform/threadpool.h"
 
 namespace se = stream_executor;
 
@@ -78,3 +89,60 @@ TEST(HostStream, ReportsFirstHostCallbackError) {
   // "error 2" is just lost.
   ASSERT_EQ(stream.BlockHostUntilDone().error_message(), "error 1");
 }
+
+std::shared_ptr<tsl::thread::ThreadPool> MakeWorkerPool() {
+  return std::make_shared<tsl::thread::ThreadPool>(tsl::Env::Default(),
+                                                   "host_stream_worker", 4);
+}
+
+TEST(HostStream, WorkerPoolKeepsOverlappingMemcpysInOrder) {
+  se::host::HostStream stream(/*stack_size_in_bytes=*/0, MakeWorkerPool());
+
+  // Each memcpy reads what the previous one wrote.
+  constexpr int64_t kSize = 4 << 20;
+  std::vector<std::vector<int32_t>> buffers(
+      4, std::vector<int32_t>(kSize / sizeof(int32_t)));
+  std::iota(buffers[0].begin(), buffers[0].end(), 0);
+  for (size_t i = 1; i < buffers.size(); ++i) {
+    ASSERT_TRUE(stream.EnqueueMemcpy(buffers[i].data(), buffers[i - 1].data(),
+                                     kSize));
+  }
+  TF_ASSERT_OK(stream.BlockUntilDone());
+  EXPECT_EQ(buffers.back(), buffers.front());
+}
+
+TEST(HostStream, WorkerPoolRunsTasksAfterMemcpys) {
+  se::host::HostStream stream(/*stack_size_in_bytes=*/0, MakeWorkerPool());
+
+  constexpr int64_t kSize = 4 << 20;
+  std::vector<char> src0(kSize, 1), src1(kSize, 2);
+  std::vector<char> dst0(kSize), dst1(kSize);
+  ASSERT_TRUE(stream.EnqueueMemcpy(dst0.data(), src0.data(), kSize));
+  ASSERT_TRUE(stream.EnqueueMemcpy(dst1.data(), src1.data(), kSize));
+  bool ok = false;
+  stream.EnqueueTask([&]() { ok = dst0 == src0 && dst1 == src1; });
+  TF_ASSERT_OK(stream.BlockUntilDone());
+  EXPECT_TRUE(ok);
+}
+
+void BM_HostStreamMemcpy(benchmark::State& state) {
+  const bool use_worker_pool = state.range(0);
+  const int64_t size = state.range(1);
+  se::host::HostStream stream(
+      /*stack_size_in_bytes=*/0, use_worker_pool ? MakeWorkerPool() : nullptr);
+  std::vector<char> src(size, 1);
+  std::vector<std::vector<char>> dsts(4, std::vector<char>(size));
+  for (auto s : state) {
+    for (std::vector<char>& dst : dsts) {
+      stream.EnqueueMemcpy(dst.data(), src.data(), size);
+    }
+    TF_CHECK_OK(stream.BlockUntilDone());
+  }
+  state.SetBytesProcessed(state.iterations() * dsts.size() * size);
+}
+BENCHMARK(BM_HostStreamMemcpy)
+    ->ArgPair(false, 64 << 10)
+    ->ArgPair(true, 64 << 10)
+    ->ArgPair(false, 16 << 20)
+    ->ArgPair(true, 16 << 20)
+    ->UseRealTime();
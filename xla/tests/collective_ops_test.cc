@@ -13,14 +13,19 @@ See the License for the specific language governing permissions and
 limitations under the License.
 ==============================================================================*/
 
+#include <functional>
 #include <memory>
 #include <string>
 #include <vector>
 
+#include "absl/container/flat_hash_set.h"
 #include "absl/strings/str_replace.h"
 #include "absl/types/span.h"
 #include "xla/literal.h"
+#include "xla/literal_util.h"
 #include "xla/primitive_util.h"
+#include "xla/service/collective_combiner_cost_model.h"
+#include "xla/service/collective_pipeliner.h"
 #include "xla/test.h"
 #include "xla/tests/hlo_test_base.h"
 #include "xla/tests/literal_test_util.h"
@@ -1691,5 +1696,115 @@ XLA_TEST_F(CollectiveOpsTest, DISABLED_ON_CPU(AsyncAllToAll)) {
   LiteralTestUtil::ExpectR1Equal<uint32_t>({15, 16}, results[1]);
 }
 
+// Returns the simulated collective time of one iteration of `loop` that
+// cannot be overlapped with compute, if every collective is issued as soon as
+// its operands are ready.
+double ExposedCollectiveSecondsPerIteration(const HloInstruction* loop) {
+  CollectiveCombinerCostModel::Options options;
+  options.collective_latency_seconds = 10e-6;
+  // Slow enough for the few elementwise ops of the loop to take a comparable
+  // time.
+  options.memory_bytes_per_second = 1e7;
+  CollectiveCombinerCostModel cost_model(options);
+
+  HloComputation* body = loop->while_body();
+  std::vector<HloInstruction*> sequence;
+  absl::flat_hash_set<HloInstruction*> visited;
+  std::function<void(HloInstruction*)> visit = [&](HloInstruction* hlo) {
+    if (!visited.insert(hlo).second) {
+      return;
+    }
+    for (HloInstruction* operand : hlo->operands()) {
+      visit(operand);
+    }
+    sequence.push_back(hlo);
+  };
+  // Sequence the collectives and their operands first, as a latency hiding
+  // scheduler would.
+  for (HloInstruction* hlo : body->MakeInstructionPostOrder()) {
+    if (IsCombinableCollective(*hlo)) {
+      visit(hlo);
+    }
+  }
+  visit(body->root_instruction());
+  return SimulateCollectiveOverlap(sequence, cost_model)
+      .exposed_collective_seconds;
+}
+
+XLA_TEST_F(CollectiveOpsTest, PipelinedAllGatherInLoop) {
+  const char* const kModuleStr = R"(
+  HloModule test
+
+  cond {
+    param = (s32[], f32[4], f32[3,2]) parameter(0)
+    i = s32[] get-tuple-element(param), index=0
+    n = s32[] constant(3)
+    ROOT lt = pred[] compare(i, n), direction=LT
+  }
+
+  body {
+    param = (s32[], f32[4], f32[3,2]) parameter(0)
+    i = s32[] get-tuple-element(param), index=0
+    x = f32[4] get-tuple-element(param), index=1
+    w = f32[3,2] get-tuple-element(param), index=2
+    zero = s32[] constant(0)
+    ds = f32[1,2] dynamic-slice(w, i, zero), dynamic_slice_sizes={1,2}
+    slice = f32[2] reshape(ds)
+    id = u32[] replica-id()
+    id_f32 = f32[] convert(id)
+    id_broadcast = f32[2] broadcast(id_f32), dimensions={}
+    shard = f32[2] add(slice, id_broadcast)
+    allgather = f32[4] all-gather(shard), replica_groups={{0,1}}, dimensions={0}
+    mul = f32[4] multiply(x, allgather)
+    next_x = f32[4] add(mul, allgather)
+    one = s32[] constant(1)
+    next_i = s32[] add(i, one)
+    ROOT tuple = (s32[], f32[4], f32[3,2]) tuple(next_i, next_x, w)
+  }
+
+  ENTRY test_computation {
+    x = f32[4] parameter(0)
+    w = f32[3,2] parameter(1)
+    zero = s32[] constant(0)
+    init = (s32[], f32[4], f32[3,2]) tuple(zero, x, w)
+    while = (s32[], f32[4], f32[3,2]) while(init), condition=cond, body=body
+    ROOT result = f32[4] get-tuple-element(while), index=1
+  }
+  )";
+  const int64_t kNumReplicas = 2;
+  HloModuleConfig config =
+      GetModuleConfigForTest(/*replica_count=*/kNumReplicas);
+  TF_ASSERT_OK_AND_ASSIGN(auto module,
+                          ParseAndReturnVerifiedModule(kModuleStr, config));
+  std::unique_ptr<HloModule> pipelined = module->Clone();
+  CollectivePipeliner pipeliner(CollectivePipeliner::Config{});
+  TF_ASSERT_OK_AND_ASSIGN(bool changed,
+                          RunHloPass(&pipeliner, pipelined.get()));
+  ASSERT_TRUE(changed);
+
+  // Without pipelining, the all-gather is needed right after it is issued.
+  // Pipelined, it overlaps with the rest of the iteration.
+  double exposed = ExposedCollectiveSecondsPerIteration(
+      FindInstruction(module.get(), HloOpcode::kWhile));
+  double pipelined_exposed = ExposedCollectiveSecondsPerIteration(
+      FindInstruction(pipelined.get(), HloOpcode::kWhile));
+  EXPECT_LT(pipelined_exposed, 0.5 * exposed);
+
+  Literal x = LiteralUtil::CreateR1<float>({1, 2, 3, 4});
+  Literal w = LiteralUtil::CreateR2<float>({{1, 2}, {3, 4}, {5, 6}});
+  TF_ASSERT_OK_AND_ASSIGN(
+      std::vector<Literal> expected,
+      ExecuteReplicated(std::move(module), {&x, &w}, kNumReplicas,
+                        /*use_threads=*/true, /*run_hlo_passes=*/true));
+  TF_ASSERT_OK_AND_ASSIGN(
+      std::vector<Literal> results,
+      ExecuteReplicated(std::move(pipelined), {&x, &w}, kNumReplicas,
+                        /*use_threads=*/true, /*run_hlo_passes=*/true));
+  ASSERT_EQ(results.size(), kNumReplicas);
+  for (int64_t i = 0; i < kNumReplicas; ++i) {
+    EXPECT_TRUE(LiteralTestUtil::Equal(expected[i], results[i]));
+  }
+}
+
 }  // namespace
 }  // namespace xla
@@ -0,0 +1,344 @@
+/* Copyright 2023 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "xla/tools/memory_space_assignment_simulator.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <optional>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "absl/algorithm/container.h"
+#include "absl/container/flat_hash_map.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/str_format.h"
+#include "xla/hlo/ir/hlo_computation.h"
+#include "xla/hlo/ir/hlo_instruction.h"
+#include "xla/hlo/ir/hlo_opcode.h"
+#include "xla/hlo/utils/hlo_live_range.h"
+#include "xla/service/hlo_alias_analysis.h"
+#include "xla/service/hlo_cost_analysis.h"
+#include "xla/service/memory_space_assignment.h"
+#include "xla/service/memory_space_assignment_best_fit_repacker.h"
+#include "xla/service/memory_space_assignment_utils.h"
+#include "xla/shape_util.h"
+#include "xla/status.h"
+#include "xla/util.h"
+#include "tsl/platform/env.h"
+#include "tsl/platform/errors.h"
+#include "tsl/platform/numbers.h"
+#include "tsl/platform/threadpool.h"
+
+namespace xla {
+
+namespace {
+
+using memory_space_assignment::CostAnalysisPrefetchIntervalPicker;
+using memory_space_assignment::MemorySpaceAssignment;
+using memory_space_assignment::MemorySpaceAssignmentCostAnalysis;
+using memory_space_assignment::Options;
+using ::tsl::strings::HumanReadableNumBytes;
+
+constexpr int64_t kPointerSize = 8;
+constexpr int64_t kAlternateMemorySpace = 1;
+
+int64_t ShapeSize(const Shape& shape) {
+  return ShapeUtil::ByteSizeOf(shape, kPointerSize);
+}
+
+bool IsInAlternateMemory(const Shape& shape) {
+  return shape.has_layout() &&
+         shape.layout().memory_space() == kAlternateMemorySpace;
+}
+
+StatusOr<std::unique_ptr<HloCostAnalysis>> RunCostAnalysis(
+    const HloModule& module, const MsaHardwareModel& hardware) {
+  HloCostAnalysis::Options options{ShapeSize};
+  options.set_flops_per_second(hardware.flops_per_second);
+  options.set_transcendentals_per_second(hardware.transcendentals_per_second);
+  options.set_bytes_per_second(hardware.bytes_per_second);
+  auto cost_analysis = std::make_unique<HloCostAnalysis>(options);
+  for (HloComputation* computation : module.MakeNonfusionComputations()) {
+    TF_RETURN_IF_ERROR(computation->Accept(cost_analysis.get()));
+  }
+  return cost_analysis;
+}
+
+// Fills in the alternate memory occupancy of `result` from the live ranges of
+// the buffers that were placed in the alternate memory.
+void ComputeAlternateMemoryOccupancy(const HloAliasAnalysis& alias_analysis,
+                                     const HloLiveRange& live_range,
+                                     MsaSimulationResult* result) {
+  std::vector<int64_t> delta(live_range.schedule_end_time() + 2, 0);
+  for (const HloBuffer& buffer : alias_analysis.buffers()) {
+    // Values of the same buffer (e.g. of a while loop and its body) share one
+    // allocation.
+    int64_t start = std::numeric_limits<int64_t>::max();
+    int64_t end = -1;
+    int64_t size = 0;
+    for (const HloValue* value : buffer.values()) {
+      auto it = live_range.buffer_live_ranges().find(value);
+      if (it == live_range.buffer_live_ranges().end() ||
+          !IsInAlternateMemory(value->shape())) {
+        continue;
+      }
+      start = std::min(start, it->second.start);
+      end = std::max(end, it->second.end);
+      size = std::max(size, ShapeSize(value->shape()));
+    }
+    if (end < start) {
+      continue;
+    }
+    delta[start] += size;
+    delta[end + 1] -= size;
+  }
+  result->alternate_mem_occupancy.resize(delta.size() - 1);
+  int64_t occupancy = 0;
+  for (int64_t time = 0; time + 1 < delta.size(); ++time) {
+    occupancy += delta[time];
+    result->alternate_mem_occupancy[time] = occupancy;
+    result->peak_alternate_mem_bytes =
+        std::max(result->peak_alternate_mem_bytes, occupancy);
+  }
+}
+
+}  // namespace
+
+std::string MsaTuningConfig::ToString() const {
+  return absl::StrFormat(
+      "min_overlap_ratio=%g preferred_overlap_ratio=%g max_overlap_ratio=%g "
+      "max_outstanding_prefetches=%d max_outstanding_evictions=%d "
+      "max_retries=%d max_repacks=%d enforce_prefetch_fifo_order=%d",
+      min_overlap_to_async_copy_ratio, preferred_overlap_to_async_copy_ratio,
+      max_overlap_to_mem_size_async_copy_ratio, max_outstanding_prefetches,
+      max_outstanding_evictions, max_retries, max_repacks,
+      enforce_prefetch_fifo_order);
+}
+
+std::string MsaSimulationResult::ToString(int max_stalls) const {
+  std::string s;
+  absl::StrAppend(&s, "config: ", config.ToString(), "\n");
+  absl::StrAppendFormat(
+      &s, "predicted step time: %.6g s (compute %.6g s, stalls %.6g s)\n",
+      step_seconds, compute_seconds, stall_seconds);
+  absl::StrAppendFormat(&s, "prefetches: %d (%s), evictions: %d (%s)\n",
+                        num_prefetches, HumanReadableNumBytes(prefetch_bytes),
+                        num_evictions, HumanReadableNumBytes(eviction_bytes));
+  absl::StrAppendFormat(&s, "peak alternate memory: %s over %d logical times\n",
+                        HumanReadableNumBytes(peak_alternate_mem_bytes),
+                        alternate_mem_occupancy.size());
+  if (!stalls.empty()) {
+    absl::StrAppendFormat(&s, "stalls (%d total):\n", stalls.size());
+  }
+  for (int i = 0; i < stalls.size() && i < max_stalls; ++i) {
+    absl::StrAppendFormat(&s, "  %s waiting for %s: %.6g s\n",
+                          stalls[i].copy_done, stalls[i].copied_value,
+                          stalls[i].seconds);
+  }
+  return s;
+}
+
+StatusOr<MsaSimulationResult> SimulateMemorySpaceAssignment(
+    HloModule* module, const MsaHardwareModel& hardware,
+    const MsaTuningConfig& config) {
+  TF_RET_CHECK(module->has_schedule());
+
+  Options options;
+  options.alternate_memory_space = kAlternateMemorySpace;
+  options.max_size_in_bytes = hardware.alternate_mem_size_bytes;
+  options.alignment_in_bytes = hardware.alternate_mem_alignment_bytes;
+  options.size_fn = [](const BufferValue& buffer) {
+    return ShapeSize(buffer.shape());
+  };
+  options.is_allowed_in_alternate_mem_fn = [](const HloValue& value) {
+    return MemorySpaceAssignmentUtils::IsValueAllowedInAlternateMemory(&value);
+  };
+  options.async_copy_bandwidth_bytes_per_second =
+      hardware.async_copy_bytes_per_second;
+  options.alternate_mem_bandwidth_bytes_per_second =
+      hardware.alternate_mem_bytes_per_second;
+  options.xla_tpu_memory_space_assignment_while_execution_count =
+      hardware.while_execution_count;
+  options.max_outstanding_prefetches = config.max_outstanding_prefetches;
+  options.max_outstanding_evictions = config.max_outstanding_evictions;
+  options.max_retries = config.max_retries;
+  options.max_repacks = config.max_repacks;
+  options.enforce_prefetch_fifo_order = config.enforce_prefetch_fifo_order;
+  std::optional<MemorySpaceAssignmentBestFitRepacker> repacker;
+  if (config.max_repacks > 0) {
+    repacker.emplace(options.max_size_in_bytes, options.alignment_in_bytes);
+    options.repacker = &*repacker;
+  }
+
+  {
+    TF_ASSIGN_OR_RETURN(std::unique_ptr<HloCostAnalysis> hlo_cost_analysis,
+                        RunCostAnalysis(*module, hardware));
+    TF_ASSIGN_OR_RETURN(auto cost_analysis,
+                        MemorySpaceAssignmentCostAnalysis::Create(
+                            *hlo_cost_analysis, options, *module));
+    CostAnalysisPrefetchIntervalPicker prefetch_interval_picker(
+        *cost_analysis, config.min_overlap_to_async_copy_ratio,
+        config.preferred_overlap_to_async_copy_ratio,
+        config.max_overlap_to_mem_size_async_copy_ratio,
+        options.max_size_in_bytes);
+    MemorySpaceAssignmentCostAnalysis::Cache cache;
+    options.buffer_interval_compare =
+        MemorySpaceAssignment::GetMemoryBoundednessBufferIntervalCompare(
+            *cost_analysis, &cache);
+    options.prefetch_interval_picker = &prefetch_interval_picker;
+    options.cost_analysis = cost_analysis.get();
+
+    TF_ASSIGN_OR_RETURN(std::unique_ptr<HloAliasAnalysis> alias_analysis,
+                        HloAliasAnalysis::Run(module));
+    TF_ASSIGN_OR_RETURN(std::unique_ptr<HloLiveRange> live_range,
+                        HloLiveRange::Run(module->schedule(), *alias_analysis,
+                                          module->entry_computation()));
+    TF_RETURN_IF_ERROR(MemorySpaceAssignment::Run(module, *live_range,
+                                                  *alias_analysis, options)
+                           .status());
+    options.buffer_interval_compare = std::nullopt;
+    options.prefetch_interval_picker = nullptr;
+    options.cost_analysis = nullptr;
+  }
+
+  // Memory space assignment added copies and changed layouts, so analyze the
+  // module again.
+  TF_ASSIGN_OR_RETURN(std::unique_ptr<HloCostAnalysis> hlo_cost_analysis,
+                      RunCostAnalysis(*module, hardware));
+  TF_ASSIGN_OR_RETURN(auto cost_analysis,
+                      MemorySpaceAssignmentCostAnalysis::Create(
+                          *hlo_cost_analysis, options, *module));
+  TF_ASSIGN_OR_RETURN(std::unique_ptr<HloAliasAnalysis> alias_analysis,
+                      HloAliasAnalysis::Run(module));
+  TF_ASSIGN_OR_RETURN(std::unique_ptr<HloLiveRange> live_range,
+                      HloLiveRange::Run(module->schedule(), *alias_analysis,
+                                        module->entry_computation()));
+
+  MsaSimulationResult result;
+  result.config = config;
+  double now = 0;
+  double copy_engine_free = 0;
+  absl::flat_hash_map<const HloInstruction*, double> copy_finish_times;
+  for (const HloInstruction* instruction :
+       live_range->flattened_instruction_sequence().instructions()) {
+    const double multiplier = IPow<double>(
+        hardware.while_execution_count,
+        cost_analysis->CalculateComputationNestLevel(instruction,
+                                                     /*while_only=*/true));
+    switch (instruction->opcode()) {
+      case HloOpcode::kCopyStart: {
+        const Shape& shape = instruction->operand(0)->shape();
+        if (IsInAlternateMemory(instruction->shape().tuple_shapes(0))) {
+          ++result.num_prefetches;
+          result.prefetch_bytes += ShapeSize(shape);
+        } else {
+          ++result.num_evictions;
+          result.eviction_bytes += ShapeSize(shape);
+        }
+        copy_engine_free =
+            std::max(now, copy_engine_free) +
+            multiplier * (hardware.async_copy_latency_seconds +
+                          cost_analysis->GetAsyncCopyElapsed(shape));
+        copy_finish_times[instruction] = copy_engine_free;
+        break;
+      }
+      case HloOpcode::kCopyDone: {
+        auto it = copy_finish_times.find(instruction->operand(0));
+        if (it != copy_finish_times.end() && it->second > now) {
+          const double stall = it->second - now;
+          result.stall_seconds += stall;
+          result.stalls.push_back(
+              {instruction->name(),
+               instruction->operand(0)->operand(0)->name(), stall});
+          now = it->second;
+        }
+        break;
+      }
+      case HloOpcode::kCall:
+      case HloOpcode::kConditional:
+      case HloOpcode::kWhile:
+        // The called computations are part of the flattened sequence.
+        break;
+      default: {
+        const double elapsed =
+            multiplier * cost_analysis->GetInstructionElapsedInAlternateMemory(
+                             *instruction,
+                             [](std::optional<int> /*operand_num*/,
+                                const ShapeIndex& /*index*/,
+                                const Shape& shape) {
+                               return IsInAlternateMemory(shape);
+                             });
+        result.compute_seconds += elapsed;
+        now += elapsed;
+        break;
+      }
+    }
+  }
+  result.step_seconds = now;
+  absl::c_stable_sort(result.stalls, [](const MsaSimulationResult::Stall& a,
+                                        const MsaSimulationResult::Stall& b) {
+    return a.seconds > b.seconds;
+  });
+  ComputeAlternateMemoryOccupancy(*alias_analysis, *live_range, &result);
+  VLOG(1) << "Simulated memory space assignment of " << module->name() << ":\n"
+          << result.ToString();
+  return result;
+}
+
+StatusOr<std::vector<MsaSimulationResult>> SweepMemorySpaceAssignment(
+    const HloModule& module, const MsaHardwareModel& hardware,
+    absl::Span<const MsaTuningConfig> configs, int num_threads) {
+  // Cloning reads the module, so do it before any of the runs start.
+  std::vector<std::unique_ptr<HloModule>> clones;
+  clones.reserve(configs.size());
+  for (int i = 0; i < configs.size(); ++i) {
+    clones.push_back(module.Clone(/*suffix=*/""));
+  }
+  std::vector<MsaSimulationResult> results(configs.size());
+  std::vector<Status> statuses(configs.size());
+  auto simulate = [&](int i) {
+    StatusOr<MsaSimulationResult> result =
+        SimulateMemorySpaceAssignment(clones[i].get(), hardware, configs[i]);
+    if (result.ok()) {
+      results[i] = *std::move(result);
+    } else {
+      statuses[i] = result.status();
+    }
+    clones[i].reset();
+  };
+  if (num_threads <= 1 || configs.size() <= 1) {
+    for (int i = 0; i < configs.size(); ++i) {
+      simulate(i);
+    }
+  } else {
+    // The destructor of the pool waits for all runs to finish.
+    tsl::thread::ThreadPool thread_pool(
+        tsl::Env::Default(), "msa_sweep",
+        std::min<int>(num_threads, configs.size()));
+    for (int i = 0; i < configs.size(); ++i) {
+      thread_pool.Schedule([&simulate, i] { simulate(i); });
+    }
+  }
+  for (const Status& status : statuses) {
+    TF_RETURN_IF_ERROR(status);
+  }
+  return results;
+}
+
+}  // namespace xla
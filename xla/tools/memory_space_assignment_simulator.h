@@ -0,0 +1,112 @@
+/* Copyright 2023 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef TENSORFLOW_COMPILER_XLA_TOOLS_MEMORY_SPACE_ASSIGNMENT_SIMULATOR_H_
+#define TENSORFLOW_COMPILER_XLA_TOOLS_MEMORY_SPACE_ASSIGNMENT_SIMULATOR_H_
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "absl/types/span.h"
+#include "xla/hlo/ir/hlo_module.h"
+#include "xla/statusor.h"
+
+namespace xla {
+
+// Throughputs and sizes of the machine that memory space assignment targets.
+struct MsaHardwareModel {
+  float flops_per_second = 1e12;
+  float transcendentals_per_second = 1e11;
+  // Bandwidth of the default memory.
+  float bytes_per_second = 1e11;
+  float alternate_mem_bytes_per_second = 1e12;
+  float async_copy_bytes_per_second = 1e10;
+  // Fixed cost of every asynchronous copy, on top of its transfer time.
+  float async_copy_latency_seconds = 0;
+  int64_t alternate_mem_size_bytes = 16 * 1024 * 1024;
+  int64_t alternate_mem_alignment_bytes = 64;
+  // Number of iterations assumed for every while loop.
+  uint64_t while_execution_count = 5;
+};
+
+// The memory space assignment options that are swept by the tuning tool.
+struct MsaTuningConfig {
+  float min_overlap_to_async_copy_ratio = 1.0;
+  float preferred_overlap_to_async_copy_ratio = 1.5;
+  float max_overlap_to_mem_size_async_copy_ratio = 10.0;
+  int64_t max_outstanding_prefetches = -1;
+  int64_t max_outstanding_evictions = -1;
+  int64_t max_retries = 1;
+  int64_t max_repacks = 0;
+  bool enforce_prefetch_fifo_order = false;
+
+  std::string ToString() const;
+};
+
+struct MsaSimulationResult {
+  // Time that an asynchronous copy made its copy-done wait for.
+  struct Stall {
+    std::string copy_done;
+    // The instruction whose output was being copied.
+    std::string copied_value;
+    double seconds;
+  };
+
+  MsaTuningConfig config;
+  // Predicted run time of the module, which is the sum of the compute and
+  // stall times.
+  double step_seconds = 0;
+  double compute_seconds = 0;
+  double stall_seconds = 0;
+  int64_t num_prefetches = 0;
+  int64_t prefetch_bytes = 0;
+  int64_t num_evictions = 0;
+  int64_t eviction_bytes = 0;
+  // Bytes live in the alternate memory at every logical time of the flattened
+  // schedule.
+  std::vector<int64_t> alternate_mem_occupancy;
+  int64_t peak_alternate_mem_bytes = 0;
+  // Sorted by decreasing duration.
+  std::vector<Stall> stalls;
+
+  // Returns a human readable report, listing at most `max_stalls` stalls.
+  std::string ToString(int max_stalls = 10) const;
+};
+
+// Runs memory space assignment on `module` with `config`, then replays the
+// resulting schedule on `hardware`. `module` must be scheduled and is
+// rewritten in place.
+//
+// The replay walks the flattened schedule once. Instructions take the time
+// MemorySpaceAssignmentCostAnalysis estimates for them given the memory
+// spaces of their operands and outputs. Asynchronous copies are serialized on
+// a single copy engine, and a copy-done stalls the program until its copy has
+// finished. The times of instructions in while loops are multiplied by
+// hardware.while_execution_count per nesting level.
+StatusOr<MsaSimulationResult> SimulateMemorySpaceAssignment(
+    HloModule* module, const MsaHardwareModel& hardware,
+    const MsaTuningConfig& config);
+
+// Runs SimulateMemorySpaceAssignment on a clone of `module` for each of
+// `configs` on up to `num_threads` threads. Results are in the order of
+// `configs`.
+StatusOr<std::vector<MsaSimulationResult>> SweepMemorySpaceAssignment(
+    const HloModule& module, const MsaHardwareModel& hardware,
+    absl::Span<const MsaTuningConfig> configs, int num_threads);
+
+}  // namespace xla
+
+#endif  // TENSORFLOW_COMPILER_XLA_TOOLS_MEMORY_SPACE_ASSIGNMENT_SIMULATOR_H_
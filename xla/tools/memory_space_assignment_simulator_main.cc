@@ -0,0 +1,241 @@
+/* Copyright 2023 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+// A tool for tuning memory space assignment without running on hardware. See
+// kUsage for details.
+
+#include <algorithm>
+#include <cstdint>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "absl/strings/numbers.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/str_split.h"
+#include "xla/debug_options_flags.h"
+#include "xla/hlo/ir/hlo_module.h"
+#include "xla/service/flatten_call_graph.h"
+#include "xla/service/hlo_memory_scheduler.h"
+#include "xla/shape_util.h"
+#include "xla/tools/hlo_module_loader.h"
+#include "xla/tools/memory_space_assignment_simulator.h"
+#include "tsl/platform/env.h"
+#include "tsl/platform/init_main.h"
+#include "tsl/platform/logging.h"
+#include "tsl/util/command_line_flags.h"
+
+namespace {
+const char* const kUsage = R"(
+This tool runs memory space assignment (MSA) on an HLO module and simulates the
+resulting schedule on a bandwidth model of the target. It reports the predicted
+step time, the occupancy of the alternate memory and the copies that stalled
+the program.
+
+Every option that takes a comma separated list is swept: MSA runs once for each
+combination of the listed values, in parallel, and the results are printed from
+fastest to slowest followed by the full report of the fastest configuration.
+
+Modules without a schedule are flattened and scheduled first.
+
+Usage:
+
+  bazel run memory_space_assignment_simulator -- \
+    --input=path/to/hlo_module --format=[hlo|pb|pbtxt] \
+    --alternate_mem_size_bytes=16777216 \
+    --min_overlap_ratios=0.5,1 --max_outstanding_prefetches=-1,8
+)";
+
+template <typename T>
+bool ParseList(const std::string& list, bool (*parse)(absl::string_view, T*),
+               std::vector<T>* values) {
+  values->clear();
+  for (absl::string_view item : absl::StrSplit(list, ',', absl::SkipEmpty())) {
+    T value;
+    if (!parse(item, &value)) {
+      return false;
+    }
+    values->push_back(value);
+  }
+  return !values->empty();
+}
+
+bool ParseFloat(absl::string_view text, float* value) {
+  return absl::SimpleAtof(text, value);
+}
+
+bool ParseInt(absl::string_view text, int64_t* value) {
+  return absl::SimpleAtoi(text, value);
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  std::string input, format;
+  xla::MsaHardwareModel hardware;
+  std::string min_overlap_ratios = "1";
+  std::string preferred_overlap_ratios = "1.5";
+  std::string max_overlap_ratios = "10";
+  std::string max_outstanding_prefetches = "-1";
+  std::string max_outstanding_evictions = "-1";
+  std::string max_retries = "1";
+  std::string max_repacks = "0";
+  bool enforce_prefetch_fifo_order = false;
+  int32_t num_threads = 8;
+  int32_t max_stalls = 10;
+  std::string occupancy_csv;
+  int64_t while_execution_count = hardware.while_execution_count;
+  std::vector<tsl::Flag> flag_list = {
+      tsl::Flag("input", &input, "input file"),
+      tsl::Flag("format", &format, "hlo|pb|pbtxt"),
+      tsl::Flag("flops_per_second", &hardware.flops_per_second,
+                "Compute throughput."),
+      tsl::Flag("transcendentals_per_second",
+                &hardware.transcendentals_per_second,
+                "Transcendental throughput."),
+      tsl::Flag("bytes_per_second", &hardware.bytes_per_second,
+                "Bandwidth of the default memory."),
+      tsl::Flag("alternate_mem_bytes_per_second",
+                &hardware.alternate_mem_bytes_per_second,
+                "Bandwidth of the alternate memory."),
+      tsl::Flag("async_copy_bytes_per_second",
+                &hardware.async_copy_bytes_per_second,
+                "Bandwidth of copies between the two memories."),
+      tsl::Flag("async_copy_latency_seconds",
+                &hardware.async_copy_latency_seconds,
+                "Fixed cost of every copy between the two memories."),
+      tsl::Flag("alternate_mem_size_bytes", &hardware.alternate_mem_size_bytes,
+                "Size of the alternate memory."),
+      tsl::Flag("alternate_mem_alignment_bytes",
+                &hardware.alternate_mem_alignment_bytes,
+                "Alignment of the alternate memory."),
+      tsl::Flag("while_execution_count", &while_execution_count,
+                "Number of iterations assumed for every while loop."),
+      tsl::Flag("min_overlap_ratios", &min_overlap_ratios,
+                "Comma separated values of the minimum ratio of the time a "
+                "prefetch overlaps with to its copy time."),
+      tsl::Flag("preferred_overlap_ratios", &preferred_overlap_ratios,
+                "Comma separated values of the preferred ratio of the time a "
+                "prefetch overlaps with to its copy time."),
+      tsl::Flag("max_overlap_ratios", &max_overlap_ratios,
+                "Comma separated values of the maximum ratio of the time a "
+                "buffer may stay in the alternate memory to the time to copy "
+                "a buffer of the size of the alternate memory."),
+      tsl::Flag("max_outstanding_prefetches", &max_outstanding_prefetches,
+                "Comma separated values, -1 for unlimited."),
+      tsl::Flag("max_outstanding_evictions", &max_outstanding_evictions,
+                "Comma separated values, -1 for unlimited."),
+      tsl::Flag("max_retries", &max_retries, "Comma separated values."),
+      tsl::Flag("max_repacks", &max_repacks, "Comma separated values."),
+      tsl::Flag("enforce_prefetch_fifo_order", &enforce_prefetch_fifo_order,
+                "Whether prefetches must finish in the order they start."),
+      tsl::Flag("num_threads", &num_threads,
+                "Number of configurations simulated at the same time."),
+      tsl::Flag("max_stalls", &max_stalls,
+                "Number of stalls listed in the report."),
+      tsl::Flag("occupancy_csv", &occupancy_csv,
+                "If set, the alternate memory occupancy of the fastest "
+                "configuration is written to this file as "
+                "'logical_time,bytes' lines."),
+  };
+  xla::AppendDebugOptionsFlags(&flag_list);
+  const std::string kUsageString =
+      absl::StrCat(kUsage, "\n\n", tsl::Flags::Usage(argv[0], flag_list));
+  bool parse_ok = tsl::Flags::Parse(&argc, argv, flag_list);
+  tsl::port::InitMain(kUsageString.c_str(), &argc, &argv);
+  if (!parse_ok) {
+    LOG(QFATAL) << kUsageString;
+  }
+  hardware.while_execution_count = while_execution_count;
+
+  std::vector<float> min_overlaps, preferred_overlaps, max_overlaps;
+  std::vector<int64_t> prefetches, evictions, retries, repacks;
+  if (!ParseList(min_overlap_ratios, ParseFloat, &min_overlaps) ||
+      !ParseList(preferred_overlap_ratios, ParseFloat, &preferred_overlaps) ||
+      !ParseList(max_overlap_ratios, ParseFloat, &max_overlaps) ||
+      !ParseList(max_outstanding_prefetches, ParseInt, &prefetches) ||
+      !ParseList(max_outstanding_evictions, ParseInt, &evictions) ||
+      !ParseList(max_retries, ParseInt, &retries) ||
+      !ParseList(max_repacks, ParseInt, &repacks)) {
+    LOG(QFATAL) << "Malformed list of values.\n" << kUsageString;
+  }
+  std::vector<xla::MsaTuningConfig> configs;
+  for (float min_overlap : min_overlaps) {
+    for (float preferred_overlap : preferred_overlaps) {
+      for (float max_overlap : max_overlaps) {
+        for (int64_t prefetch : prefetches) {
+          for (int64_t eviction : evictions) {
+            for (int64_t retry : retries) {
+              for (int64_t repack : repacks) {
+                xla::MsaTuningConfig config;
+                config.min_overlap_to_async_copy_ratio = min_overlap;
+                config.preferred_overlap_to_async_copy_ratio =
+                    preferred_overlap;
+                config.max_overlap_to_mem_size_async_copy_ratio = max_overlap;
+                config.max_outstanding_prefetches = prefetch;
+                config.max_outstanding_evictions = eviction;
+                config.max_retries = retry;
+                config.max_repacks = repack;
+                config.enforce_prefetch_fifo_order =
+                    enforce_prefetch_fifo_order;
+                configs.push_back(config);
+              }
+            }
+          }
+        }
+      }
+    }
+  }
+
+  std::unique_ptr<xla::HloModule> module =
+      xla::LoadModuleFromFile(input, {}, format).value();
+  if (!module->has_schedule()) {
+    TF_CHECK_OK(xla::FlattenCallGraph().Run(module.get()).status());
+    xla::HloSchedule schedule =
+        xla::ScheduleModule(module.get(), [](const xla::BufferValue& buffer) {
+          return xla::ShapeUtil::ByteSizeOf(buffer.shape(), 8);
+        }).value();
+    TF_CHECK_OK(module->set_schedule(std::move(schedule)));
+  }
+
+  std::vector<xla::MsaSimulationResult> results =
+      xla::SweepMemorySpaceAssignment(*module, hardware, configs, num_threads)
+          .value();
+  std::stable_sort(results.begin(), results.end(),
+                   [](const xla::MsaSimulationResult& a,
+                      const xla::MsaSimulationResult& b) {
+                     return a.step_seconds < b.step_seconds;
+                   });
+  for (const xla::MsaSimulationResult& result : results) {
+    std::cout << result.step_seconds << " s (stalls " << result.stall_seconds
+              << " s, peak alternate memory " << result.peak_alternate_mem_bytes
+              << " bytes): " << result.config.ToString() << std::endl;
+  }
+  std::cout << std::endl << results.front().ToString(max_stalls);
+
+  if (!occupancy_csv.empty()) {
+    std::string csv;
+    for (int64_t time = 0; time < results.front().alternate_mem_occupancy.size();
+         ++time) {
+      absl::StrAppend(&csv, time, ",",
+                      results.front().alternate_mem_occupancy[time], "\n");
+    }
+    TF_CHECK_OK(
+        tsl::WriteStringToFile(tsl::Env::Default(), occupancy_csv, csv));
+  }
+  return 0;
+}
@@ -0,0 +1,117 @@
+/* Copyright 2023 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "xla/tools/memory_space_assignment_simulator.h"
+
+#include <cstdint>
+#include <vector>
+
+#include "xla/tests/hlo_test_base.h"
+#include "tsl/lib/core/status_test_util.h"
+#include "tsl/platform/test.h"
+
+namespace xla {
+namespace {
+
+constexpr char kHloString[] = R"(
+HloModule module, is_scheduled=true
+
+ENTRY entry {
+  p0 = f32[1024] parameter(0)
+  p1 = f32[1024] parameter(1)
+  negate0 = f32[1024] negate(p0)
+  negate1 = f32[1024] negate(negate0)
+  negate2 = f32[1024] negate(negate1)
+  negate3 = f32[1024] negate(negate2)
+  negate4 = f32[1024] negate(negate3)
+  negate5 = f32[1024] negate(negate4)
+  ROOT add = f32[1024] add(negate5, p1)
+}
+)";
+
+class MemorySpaceAssignmentSimulatorTest : public HloTestBase {
+ protected:
+  // A memory bound machine whose alternate memory is ten times faster.
+  static MsaHardwareModel Hardware(int64_t alternate_mem_size_bytes) {
+    MsaHardwareModel hardware;
+    hardware.flops_per_second = 1e12;
+    hardware.transcendentals_per_second = 1e12;
+    hardware.bytes_per_second = 1e9;
+    hardware.alternate_mem_bytes_per_second = 1e10;
+    hardware.async_copy_bytes_per_second = 1e9;
+    hardware.alternate_mem_size_bytes = alternate_mem_size_bytes;
+    hardware.alternate_mem_alignment_bytes = 8;
+    return hardware;
+  }
+};
+
+TEST_F(MemorySpaceAssignmentSimulatorTest, AlternateMemoryReducesStepTime) {
+  TF_ASSERT_OK_AND_ASSIGN(auto module,
+                          ParseAndReturnVerifiedModule(kHloString));
+  TF_ASSERT_OK_AND_ASSIGN(auto baseline_module,
+                          ParseAndReturnVerifiedModule(kHloString));
+
+  TF_ASSERT_OK_AND_ASSIGN(
+      MsaSimulationResult result,
+      SimulateMemorySpaceAssignment(module.get(), Hardware(64 * 1024),
+                                    MsaTuningConfig()));
+  TF_ASSERT_OK_AND_ASSIGN(
+      MsaSimulationResult baseline,
+      SimulateMemorySpaceAssignment(baseline_module.get(), Hardware(0),
+                                    MsaTuningConfig()));
+
+  EXPECT_NEAR(result.step_seconds,
+              result.compute_seconds + result.stall_seconds, 1e-12);
+  EXPECT_GT(result.peak_alternate_mem_bytes, 0);
+  EXPECT_LE(result.peak_alternate_mem_bytes, 64 * 1024);
+  EXPECT_LT(result.compute_seconds, baseline.compute_seconds);
+
+  EXPECT_EQ(baseline.peak_alternate_mem_bytes, 0);
+  EXPECT_EQ(baseline.num_prefetches, 0);
+  EXPECT_EQ(baseline.stall_seconds, 0);
+  EXPECT_EQ(baseline.step_seconds, baseline.compute_seconds);
+}
+
+TEST_F(MemorySpaceAssignmentSimulatorTest, SweepMatchesSequentialRuns) {
+  TF_ASSERT_OK_AND_ASSIGN(auto module,
+                          ParseAndReturnVerifiedModule(kHloString));
+  std::vector<MsaTuningConfig> configs(3);
+  configs[1].min_overlap_to_async_copy_ratio = 0.5;
+  configs[2].max_outstanding_prefetches = 1;
+  configs[2].max_repacks = 2;
+
+  TF_ASSERT_OK_AND_ASSIGN(
+      std::vector<MsaSimulationResult> sequential,
+      SweepMemorySpaceAssignment(*module, Hardware(8 * 1024), configs,
+                                 /*num_threads=*/1));
+  TF_ASSERT_OK_AND_ASSIGN(
+      std::vector<MsaSimulationResult> parallel,
+      SweepMemorySpaceAssignment(*module, Hardware(8 * 1024), configs,
+                                 /*num_threads=*/3));
+
+  ASSERT_EQ(sequential.size(), configs.size());
+  ASSERT_EQ(parallel.size(), configs.size());
+  for (int i = 0; i < configs.size(); ++i) {
+    EXPECT_EQ(parallel[i].config.ToString(), configs[i].ToString());
+    EXPECT_EQ(parallel[i].step_seconds, sequential[i].step_seconds);
+    EXPECT_EQ(parallel[i].alternate_mem_occupancy,
+              sequential[i].alternate_mem_occupancy);
+  }
+  // The sweep works on clones, so no copies were added to the module.
+  EXPECT_EQ(module->entry_computation()->instruction_count(), 9);
+}
+
+}  // namespace
+}  // namespace xla